@@ -2,7 +2,7 @@
 
 // IN
 layout (location = 0) in vec3 inPosition;
-layout (location = 1) in vec3 inNormal;
+layout (location = 1) in vec2 inNormal;
 layout (location = 2) in vec2 inTexcoords;
 
 // Out
@@ -20,6 +20,7 @@ void main()
 in vec2 vTexcoords;
 uniform sampler2D uTexSource;
 uniform int uSampleCount;
+uniform vec2 uTexcoordScale; // the viewport over the size of the source
 
 // OUT
 out vec3 fragColor;
@@ -82,7 +83,7 @@ vec3 toSRGB(vec3 v)
 // ----------------------------------------------------------------------------
 void main() 
 {
-    vec3 samples = texture(uTexSource, vTexcoords).rgb;
+    vec3 samples = texture(uTexSource, vTexcoords * uTexcoordScale).rgb;
 
     // normalize
     const int NUM_SAMPLES = 4;
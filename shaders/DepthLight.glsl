@@ -2,7 +2,7 @@
 
 // IN
 layout (location = 0) in vec3 aPosition;
-layout (location = 1) in vec3 aNormal;
+layout (location = 1) in vec2 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
 uniform mat4 uWorld;
@@ -1,14 +1,16 @@
 -- Vertex
 // IN
 layout (location = 0) in vec3 inPosition;
+layout (location = 3) in uint inInstance; // per-instance record
 
-uniform mat4 uWorld;
 uniform mat4 uView;
 uniform mat4 uProjection;
 
+#include "VertexUtility.glsli"
+
 void main()
 {
-    mat4 worldViewProj = uProjection*uView*uWorld;
+    mat4 worldViewProj = uProjection*uView*InstanceWorld(inInstance);
 	gl_Position = worldViewProj * vec4(inPosition, 1.0);
 }
 
@@ -0,0 +1,102 @@
+-- Downsample
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// depth buffer for the first level, the pyramid itself afterward
+uniform sampler2D uSource;
+uniform int uSourceLevel;
+layout(r32f) writeonly uniform image2D uDest;
+
+void main()
+{
+    ivec2 dst = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 dstSize = imageSize(uDest);
+    if (any(greaterThanEqual(dst, dstSize)))
+        return;
+
+    // 1 when copying the depth buffer, 2 otherwise; the last row and column
+    // of an odd sized source are folded in the border texels
+    ivec2 srcSize = textureSize(uSource, uSourceLevel);
+    ivec2 ratio = srcSize / dstSize;
+    ivec2 extra = ivec2(equal(dst, dstSize - 1)) * (srcSize - ratio * dstSize);
+    ivec2 base = dst * ratio;
+
+    float depth = 0.0;
+    for (int y = 0; y < ratio.y + extra.y; y++)
+    for (int x = 0; x < ratio.x + extra.x; x++)
+        depth = max(depth, texelFetch(uSource, min(base + ivec2(x, y), srcSize - 1), uSourceLevel).r);
+
+    imageStore(uDest, dst, vec4(depth));
+}
+
+-- Cull
+layout(local_size_x = 64) in;
+
+// the model index in the bits of Min.w
+struct Bounds
+{
+    vec4 Min;
+    vec4 Max;
+};
+
+layout(std430, binding = 0) readonly buffer BoundsBuffer { Bounds uBounds[]; };
+layout(std430, binding = 1) writeonly buffer VisibilityBuffer { uint uVisible[]; };
+layout(std430, binding = 2) writeonly buffer ModelVisibilityBuffer { uint uModelVisible[]; };
+
+void setVisible(uint index, uint model, bool bVisible)
+{
+    uVisible[index] = bVisible ? 1u : 0u;
+    uModelVisible[model] = bVisible ? 1u : 0u;
+}
+
+uniform sampler2D uHiZ;
+uniform mat4 uViewProj;
+uniform int uLevelCount;
+uniform int uCount;
+uniform ivec2 uSize; // the viewport in level 0, the pyramid can be larger
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= uint(uCount))
+        return;
+
+    Bounds bounds = uBounds[index];
+    uint model = floatBitsToUint(bounds.Min.w);
+    vec3 rectMin = vec3(1.0);
+    vec3 rectMax = vec3(0.0);
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 corner = mix(bounds.Min.xyz, bounds.Max.xyz, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+        vec4 clip = uViewProj * vec4(corner, 1.0);
+        // crosses the near plane
+        if (clip.w <= 1e-4)
+        {
+            setVisible(index, model, true);
+            return;
+        }
+        vec3 ndc = clip.xyz / clip.w * 0.5 + 0.5;
+        rectMin = min(rectMin, ndc);
+        rectMax = max(rectMax, ndc);
+    }
+    rectMin.xy = clamp(rectMin.xy, 0.0, 1.0);
+    rectMax.xy = clamp(rectMax.xy, 0.0, 1.0);
+
+    // level where the rectangle spans at most 2x2 texels
+    ivec2 size = uSize;
+    ivec2 texelMin = min(ivec2(rectMin.xy * vec2(size)), size - 1);
+    ivec2 texelMax = min(ivec2(rectMax.xy * vec2(size)), size - 1);
+    ivec2 extent = texelMax - texelMin + 1;
+    int level = int(ceil(log2(float(max(max(extent.x, extent.y), 1)))));
+    level = clamp(level, 0, uLevelCount - 1);
+
+    // the border texels also cover the odd row and column, see Downsample
+    ivec2 levelSize = textureSize(uHiZ, level);
+    ivec2 t0 = min(texelMin >> level, levelSize - 1);
+    ivec2 t1 = min(texelMax >> level, levelSize - 1);
+
+    float depth = max(
+        max(texelFetch(uHiZ, t0, level).r, texelFetch(uHiZ, ivec2(t1.x, t0.y), level).r),
+        max(texelFetch(uHiZ, ivec2(t0.x, t1.y), level).r, texelFetch(uHiZ, t1, level).r));
+
+    setVisible(index, model, rectMin.z <= depth);
+}
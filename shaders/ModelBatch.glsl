@@ -0,0 +1,36 @@
+-- Compact
+layout(local_size_x = 64) in;
+
+// DrawElementsIndirectCommand, see VertexBufferDrawCommand
+struct DrawCommand
+{
+    uint Count;
+    uint InstanceCount;
+    uint FirstIndex;
+    int BaseVertex;
+    uint BaseInstance;
+};
+
+// record, model and command of each visible instance of the group
+layout(std430, binding = 0) readonly buffer CandidateBuffer { uvec4 uCandidates[]; };
+layout(std430, binding = 1) readonly buffer FlagBuffer { uint uFlags[]; };
+layout(std430, binding = 2) buffer CommandBuffer { DrawCommand uCommands[]; };
+layout(std430, binding = 3) writeonly buffer StreamBuffer { uint uStream[]; };
+
+uniform int uFirst;
+uniform int uCount;
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= uint(uCount))
+        return;
+
+    uvec4 candidate = uCandidates[uint(uFirst) + index];
+    if (uFlags[candidate.y] == 0u)
+        return;
+
+    // the order within a level does not matter
+    uint slot = atomicAdd(uCommands[candidate.z].InstanceCount, 1u);
+    uStream[uCommands[candidate.z].BaseInstance + slot] = candidate.x;
+}
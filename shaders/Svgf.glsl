@@ -0,0 +1,267 @@
+-- Guide
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// world normal from the depth buffer and view depth, the color pass has no
+// normal buffer in forward
+uniform sampler2D uDepth;
+uniform mat4 uViewProj;
+uniform mat4 uViewProjInv;
+uniform vec3 uViewPositionW;
+uniform ivec2 uSize; // the viewport, the pooled targets can be larger
+layout(rgba16f) writeonly uniform image2D uGuide; // normal, view depth (negative when empty)
+
+vec3 WorldPosition(ivec2 texel, ivec2 size)
+{
+    texel = clamp(texel, ivec2(0), size - 1);
+    float depth = texelFetch(uDepth, texel, 0).r;
+    vec2 uv = (vec2(texel) + 0.5) / vec2(size);
+    vec4 position = uViewProjInv * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = uSize;
+    if (any(greaterThanEqual(texel, size)))
+        return;
+
+    if (texelFetch(uDepth, texel, 0).r == 1.0)
+    {
+        imageStore(uGuide, texel, vec4(0.0, 0.0, 0.0, -1.0));
+        return;
+    }
+
+    // the smaller one sided difference does not cross the silhouettes
+    vec3 p = WorldPosition(texel, size);
+    vec3 dx0 = p - WorldPosition(texel - ivec2(1, 0), size);
+    vec3 dx1 = WorldPosition(texel + ivec2(1, 0), size) - p;
+    vec3 dy0 = p - WorldPosition(texel - ivec2(0, 1), size);
+    vec3 dy1 = WorldPosition(texel + ivec2(0, 1), size) - p;
+    vec3 dx = dot(dx0, dx0) < dot(dx1, dx1) ? dx0 : dx1;
+    vec3 dy = dot(dy0, dy0) < dot(dy1, dy1) ? dy0 : dy1;
+
+    vec3 normal = normalize(cross(dx, dy));
+    if (dot(normal, uViewPositionW - p) < 0.0)
+        normal = -normal;
+
+    imageStore(uGuide, texel, vec4(normal, (uViewProj * vec4(p, 1.0)).w));
+}
+
+-- Temporal
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D uColor;       // this frame
+uniform sampler2D uDepth;
+uniform sampler2D uGuide;
+uniform sampler2D uPrevGuide;
+uniform sampler2D uPrevColor;   // first wavelet iteration of the last frame
+uniform sampler2D uPrevMoments; // luminance, squared luminance, history length
+layout(rgba16f) writeonly uniform image2D uColorOut;
+layout(rgba32f) writeonly uniform image2D uMomentsOut;
+
+uniform mat4 uViewProjInv;
+uniform mat4 uPrevViewProj;
+uniform float uMaxHistory;
+uniform bool ubReset;
+uniform ivec2 uSize; // the viewport, the pooled targets can be larger
+
+float Luminance(vec3 rgb)
+{
+    return dot(rgb, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = uSize;
+    if (any(greaterThanEqual(texel, size)))
+        return;
+
+    vec3 color = texelFetch(uColor, texel, 0).rgb;
+    float luminance = Luminance(color);
+    vec2 moments = vec2(luminance, luminance * luminance);
+    vec4 guide = texelFetch(uGuide, texel, 0);
+
+    // bilinear footprint in the last frame, each tap checked for the same
+    // surface and the valid ones renormalized
+    vec3 prevColor = vec3(0.0);
+    vec2 prevMoments = vec2(0.0);
+    float historyLength = 0.0;
+    if (!ubReset && guide.w > 0.0)
+    {
+        vec2 uv = (vec2(texel) + 0.5) / vec2(size);
+        float depth = texelFetch(uDepth, texel, 0).r;
+        vec4 world = uViewProjInv * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+        vec4 prevClip = uPrevViewProj * vec4(world.xyz / world.w, 1.0);
+        vec2 prevPos = (prevClip.xy / prevClip.w * 0.5 + 0.5) * vec2(size) - 0.5;
+
+        ivec2 base = ivec2(floor(prevPos));
+        vec2 f = prevPos - vec2(base);
+        float weightSum = 0.0;
+        for (int i = 0; i < 4; i++)
+        {
+            ivec2 offset = ivec2(i & 1, i >> 1);
+            ivec2 tap = base + offset;
+            if (any(lessThan(tap, ivec2(0))) || any(greaterThanEqual(tap, size)))
+                continue;
+
+            vec4 prevGuide = texelFetch(uPrevGuide, tap, 0);
+            if (prevGuide.w < 0.0 || abs(prevGuide.w - prevClip.w) > 0.05 * prevClip.w || dot(prevGuide.xyz, guide.xyz) < 0.9)
+                continue;
+
+            vec2 b = mix(1.0 - f, f, vec2(offset));
+            float weight = b.x * b.y;
+            vec3 m = texelFetch(uPrevMoments, tap, 0).xyz;
+            prevColor += texelFetch(uPrevColor, tap, 0).rgb * weight;
+            prevMoments += m.xy * weight;
+            historyLength += m.z * weight;
+            weightSum += weight;
+        }
+        if (weightSum > 1e-3)
+        {
+            prevColor /= weightSum;
+            prevMoments /= weightSum;
+            historyLength = floor(historyLength / weightSum + 0.5);
+        }
+        else
+            historyLength = 0.0;
+    }
+
+    historyLength = min(historyLength + 1.0, uMaxHistory);
+    float alpha = 1.0 / historyLength;
+    color = mix(prevColor, color, alpha);
+    moments = mix(prevMoments, moments, alpha);
+
+    imageStore(uColorOut, texel, vec4(color, 0.0));
+    imageStore(uMomentsOut, texel, vec4(moments, historyLength, 0.0));
+}
+
+-- Variance
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D uColor;   // temporally integrated
+uniform sampler2D uMoments;
+uniform sampler2D uGuide;
+layout(rgba16f) writeonly uniform image2D uDest; // color, variance
+uniform ivec2 uSize; // the viewport, the pooled targets can be larger
+
+float Luminance(vec3 rgb)
+{
+    return dot(rgb, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = uSize;
+    if (any(greaterThanEqual(texel, size)))
+        return;
+
+    vec3 color = texelFetch(uColor, texel, 0).rgb;
+    vec3 moments = texelFetch(uMoments, texel, 0).xyz;
+    vec4 guide = texelFetch(uGuide, texel, 0);
+    if (moments.z >= 4.0 || guide.w < 0.0)
+    {
+        imageStore(uDest, texel, vec4(color, max(moments.y - moments.x * moments.x, 0.0)));
+        return;
+    }
+
+    // too few frames, the moments are estimated over the surface around
+    vec3 colorSum = vec3(0.0);
+    vec2 momentsSum = vec2(0.0);
+    float weightSum = 0.0;
+    for (int y = -3; y <= 3; y++)
+    for (int x = -3; x <= 3; x++)
+    {
+        ivec2 tap = clamp(texel + ivec2(x, y), ivec2(0), size - 1);
+        vec4 g = texelFetch(uGuide, tap, 0);
+        if (g.w < 0.0)
+            continue;
+
+        float depthWeight = exp(-abs(g.w - guide.w) / (0.02 * guide.w * length(vec2(x, y)) + 1e-4));
+        float normalWeight = pow(max(dot(g.xyz, guide.xyz), 0.0), 128.0);
+        float weight = depthWeight * normalWeight;
+
+        colorSum += texelFetch(uColor, tap, 0).rgb * weight;
+        momentsSum += texelFetch(uMoments, tap, 0).xy * weight;
+        weightSum += weight;
+    }
+    colorSum /= weightSum;
+    momentsSum /= weightSum;
+
+    // the first frames get a larger variance, thus a wider blur
+    float variance = max(momentsSum.y - momentsSum.x * momentsSum.x, 0.0) * 4.0 / moments.z;
+    imageStore(uDest, texel, vec4(colorSum, variance));
+}
+
+-- Atrous
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// one iteration of the edge avoiding a-trous wavelet, the luminance edge
+// stopping is scaled by the prefiltered standard deviation
+uniform sampler2D uSource; // color, variance
+uniform sampler2D uGuide;
+uniform int uStepSize;
+uniform float uPhiColor;
+uniform ivec2 uSize; // the viewport, the pooled targets can be larger
+layout(rgba16f) writeonly uniform image2D uDest;
+
+float Luminance(vec3 rgb)
+{
+    return dot(rgb, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = uSize;
+    if (any(greaterThanEqual(texel, size)))
+        return;
+
+    vec4 center = texelFetch(uSource, texel, 0);
+    vec4 guide = texelFetch(uGuide, texel, 0);
+    if (guide.w < 0.0)
+    {
+        imageStore(uDest, texel, center);
+        return;
+    }
+
+    // 3x3 gaussian of the variance
+    const float gaussian[2] = float[](0.25, 0.125);
+    float variance = 0.0;
+    for (int y = -1; y <= 1; y++)
+    for (int x = -1; x <= 1; x++)
+    {
+        ivec2 tap = clamp(texel + ivec2(x, y), ivec2(0), size - 1);
+        variance += texelFetch(uSource, tap, 0).a * gaussian[abs(x)] * gaussian[abs(y)] * 4.0;
+    }
+    float luminance = Luminance(center.rgb);
+    float phiLuminance = uPhiColor * sqrt(max(variance, 0.0)) + 1e-4;
+
+    const float kernel[3] = float[](3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0);
+    vec3 colorSum = vec3(0.0);
+    float varianceSum = 0.0;
+    float weightSum = 0.0;
+    for (int y = -2; y <= 2; y++)
+    for (int x = -2; x <= 2; x++)
+    {
+        ivec2 tap = texel + ivec2(x, y) * uStepSize;
+        if (any(lessThan(tap, ivec2(0))) || any(greaterThanEqual(tap, size)))
+            continue;
+        vec4 g = texelFetch(uGuide, tap, 0);
+        if (g.w < 0.0)
+            continue;
+
+        vec4 s = texelFetch(uSource, tap, 0);
+        float depthWeight = abs(g.w - guide.w) / (0.02 * guide.w * float(uStepSize) * length(vec2(x, y)) + 1e-4);
+        float luminanceWeight = abs(Luminance(s.rgb) - luminance) / phiLuminance;
+        float normalWeight = pow(max(dot(g.xyz, guide.xyz), 0.0), 128.0);
+        float weight = kernel[abs(x)] * kernel[abs(y)] * normalWeight * exp(-depthWeight - luminanceWeight);
+
+        colorSum += s.rgb * weight;
+        varianceSum += s.a * weight * weight;
+        weightSum += weight;
+    }
+    imageStore(uDest, texel, vec4(colorSum / weightSum, varianceSum / (weightSum * weightSum)));
+}
@@ -0,0 +1,97 @@
+-- Resolve
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D uColor;          // this frame
+uniform sampler2D uDepth;
+uniform sampler2D uHistory;        // mean, view depth
+uniform sampler2D uHistoryLength;  // frames in the mean
+layout(rgba32f) writeonly uniform image2D uHistoryOut;
+layout(r32f) writeonly uniform image2D uHistoryLengthOut;
+
+uniform mat4 uViewProj;
+uniform mat4 uViewProjInv;
+uniform mat4 uPrevViewProj;
+uniform float uMaxHistory;
+uniform bool ubCameraMoved;
+uniform bool ubReset;
+uniform ivec2 uSize; // the viewport, the pooled targets can be larger
+
+// relative view depth difference accepted as the same surface
+const float DepthTolerance = 0.02;
+// half width of the neighbourhood box, in standard deviations
+const float ClampGamma = 1.5;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = uSize;
+    if (any(greaterThanEqual(texel, size)))
+        return;
+
+    vec3 current = texelFetch(uColor, texel, 0).rgb;
+
+    // the depth was rendered jittered, the error is below a pixel
+    vec2 uv = (vec2(texel) + 0.5) / vec2(size);
+    float depth = texelFetch(uDepth, texel, 0).r;
+    vec4 world = uViewProjInv * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    world /= world.w;
+    float viewDepth = (uViewProj * world).w;
+
+    float historyLength = 0.0;
+    vec3 history = vec3(0.0);
+    if (!ubReset)
+    {
+        vec2 prevUV = uv;
+        float prevDepth = viewDepth;
+        if (ubCameraMoved)
+        {
+            vec4 prevClip = uPrevViewProj * world;
+            prevUV = prevClip.xy / prevClip.w * 0.5 + 0.5;
+            prevDepth = prevClip.w;
+        }
+
+        ivec2 prevTexel = ivec2(floor(prevUV * vec2(size)));
+        if (all(greaterThanEqual(prevTexel, ivec2(0))) && all(lessThan(prevTexel, size)))
+        {
+            vec4 stored = texelFetch(uHistory, prevTexel, 0);
+            if (abs(stored.a - prevDepth) <= DepthTolerance * prevDepth)
+            {
+                historyLength = texelFetch(uHistoryLength, prevTexel, 0).r;
+                // exact texel when static, the mean would blur otherwise; the
+                // pooled history is larger than the viewport, keep the
+                // footprint half a texel inside it
+                vec2 prevPixel = clamp(prevUV * vec2(size), vec2(0.5), vec2(size) - 0.5);
+                history = ubCameraMoved ? texture(uHistory, prevPixel / vec2(textureSize(uHistory, 0))).rgb : stored.rgb;
+            }
+        }
+
+        // keep the reprojected mean inside the spread of the current
+        // neighbourhood, wide enough to let the noisy estimates converge
+        if (ubCameraMoved && historyLength > 0.0)
+        {
+            vec3 m1 = vec3(0.0);
+            vec3 m2 = vec3(0.0);
+            for (int y = -1; y <= 1; y++)
+            for (int x = -1; x <= 1; x++)
+            {
+                vec3 c = texelFetch(uColor, clamp(texel + ivec2(x, y), ivec2(0), size - 1), 0).rgb;
+                m1 += c;
+                m2 += c * c;
+            }
+            m1 /= 9.0;
+            vec3 sigma = sqrt(max(m2 / 9.0 - m1 * m1, 0.0));
+            vec3 clamped = clamp(history, m1 - ClampGamma * sigma, m1 + ClampGamma * sigma);
+
+            // a clamped history no longer stands for its sample count
+            if (any(notEqual(clamped, history)))
+                historyLength = min(historyLength, 4.0);
+            history = clamped;
+        }
+    }
+
+    historyLength = min(historyLength + 1.0, uMaxHistory);
+    vec3 mean = mix(history, current, 1.0 / historyLength);
+
+    imageStore(uHistoryOut, texel, vec4(mean, viewDepth));
+    imageStore(uHistoryLengthOut, texel, vec4(historyLength));
+}
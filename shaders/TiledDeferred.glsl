@@ -0,0 +1,590 @@
+-- Vertex
+// IN
+layout (location = 0) in vec3 inPosition;
+layout (location = 1) in vec2 inNormal; // octahedral
+layout (location = 2) in vec2 inTexcoords;
+layout (location = 3) in uint inInstance; // per-instance record
+
+// Out
+out vec4 vPositionW;
+out vec3 vNormalW;
+out vec2 vTexcoords;
+flat out uint vMaterial;
+
+uniform mat4 uView;
+uniform mat4 uProjection;
+
+#include "VertexUtility.glsli"
+
+void main()
+{
+    mat4 world = InstanceWorld(inInstance);
+    mat4 worldViewProj = uProjection*uView*world;
+
+    vPositionW = world * vec4(inPosition, 1.0);
+    vNormalW = mat3(world) * OctDecode(inNormal);
+	vTexcoords = inTexcoords;
+	vMaterial = InstanceMaterial(inInstance);
+	gl_Position = worldViewProj * vec4(inPosition, 1.0);
+}
+
+-- Fragment
+
+// IN
+in vec4 vPositionW;
+in vec3 vNormalW;
+in vec2 vTexcoords;
+flat in uint vMaterial;
+
+// OUT
+layout(location = 0) out vec4 GBuffer0; // normal, roughness
+layout(location = 1) out vec4 GBuffer1; // base color, metalness
+
+#include "MaterialUtility.glsli"
+
+
+mat3 calcTbn(vec3 _normal, vec3 _worldPos, vec2 _texCoords)
+{
+    vec3 Q1  = dFdx(_worldPos);
+    vec3 Q2  = dFdy(_worldPos);
+    vec2 st1 = dFdx(_texCoords);
+    vec2 st2 = dFdy(_texCoords);
+
+    vec3 N  = _normal;
+    vec3 T  = normalize(Q1*st2.t - Q2*st1.t);
+    vec3 B  = -normalize(cross(N, T));
+    return mat3(T, B, N);
+}
+
+void main()
+{
+    // same remapping as Ltc.Fragment, a zero roughness marks the empty texels
+    const float minRoughness = 0.03;
+    Material material = getMaterial(vMaterial);
+    vec3 orm = sampleOrm(material, vTexcoords);
+    float metallic = orm.b;
+    float roughness = orm.g;
+    roughness = max(roughness*roughness, minRoughness);
+
+	vec3 normal = normalize(vec3(vNormalW));
+	mat3 tbn = calcTbn(normal, vPositionW.xyz, vTexcoords);
+	vec3 tangentNormal = sampleTangentNormal(material, vTexcoords);
+	normal = normalize(tbn * tangentNormal);
+
+    GBuffer0 = vec4(normal, roughness);
+    GBuffer1 = vec4(sampleAlbedo(material, vTexcoords), metallic);
+}
+
+-- Shading
+#define TILE_SIZE 16
+#define MAX_TILE_LIGHTS 64
+
+// the same program runs the reduced diffuse and the stochastic shadow
+// passes, then the tile shading
+#define PASS_DIFFUSE 0
+#define PASS_SHADING 1
+#define PASS_RATIO 2
+
+#define SHADOW_PCSS 0
+#define SHADOW_RATIO 1
+
+// light samples per light and steps per shadow ray of the ratio estimator
+#define RATIO_SAMPLES 4
+#define RATIO_STEPS 8
+
+layout(local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+#include "ShadowUtility.glsli"
+
+struct LightData
+{
+    vec4 Points[4];
+    vec4 Sphere;    // view space
+    vec4 Plane;     // view space, zero when two-sided
+    vec4 Params;    // intensity, two-sided, textured
+    ShadowData Shadow;
+};
+
+layout(std430, binding = 0) readonly buffer LightBuffer { LightData uLights[]; };
+// per tile sums of |upsampled - full| and full diffuse luminance
+layout(std430, binding = 1) writeonly buffer ErrorBuffer { vec2 uTileErrors[]; };
+// tiles reaching more than MAX_TILE_LIGHTS lights, shaded by the fallback loop
+layout(std430, binding = 3) buffer OverflowBuffer { uint uOverflowTiles; };
+
+uniform int uPass;
+uniform int uShadowMode;
+uniform int uLightCount;
+uniform int uDiffuseScale; // 1, 2 or 4
+uniform ivec2 uSize; // the viewport, the pooled targets can be larger
+uniform bool ubMeasureError;
+uniform bool ubCountOverflow;
+uniform sampler2D uDepth;
+uniform sampler2D uGBuffer0;
+uniform sampler2D uGBuffer1;
+uniform sampler2D uDiffuseLow;
+uniform sampler2D uRatio; // denoised shadowed, unshadowed luminance
+layout(rgba16f) uniform image2D uColor;
+layout(rgba16f) writeonly uniform image2D uDiffuse;
+layout(rgba16f) writeonly uniform image2D uRatioOut;
+
+uniform mat4 uViewProjInv;
+uniform mat4 uProjectionInv;
+uniform vec3 uViewPositionW;
+uniform float uF0; // frenel
+uniform vec4 uAlbedo2; // additional albedo
+uniform bool ubClipless;
+
+uniform sampler2D uLtc1;
+uniform sampler2D uLtc2;
+uniform sampler2DArray uFilteredMap;
+uniform sampler2D uShadowAtlas;
+uniform vec4 uSamples[RATIO_SAMPLES];
+
+const float pi = 3.14159265;
+
+// set per light before LTC_Evaluate
+bool ubTexturedLight = false;
+
+#include "LtcUtility.glsli"
+#include "SphQuadUtility.glsli"
+
+shared uint sDepthMin;
+shared uint sDepthMax;
+shared uint sLightCount;
+shared uint sLightIndices[MAX_TILE_LIGHTS];
+shared vec2 sErrors[TILE_SIZE * TILE_SIZE];
+
+vec3 ViewPosition(vec2 ndc, float depth)
+{
+    vec4 position = uProjectionInv * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+vec3 WorldPosition(ivec2 pixel, ivec2 size, float depth)
+{
+    vec2 ndc = (vec2(pixel) + 0.5) / vec2(size) * 2.0 - 1.0;
+    vec4 position = uViewProjInv * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+float Luminance(vec3 rgb)
+{
+    return dot(rgb, vec3(0.2126, 0.7152, 0.0722));
+}
+
+vec3 EvaluateDiffuse(LightData light, vec3 N, vec3 V, vec3 pos)
+{
+    vec4 points[4] = light.Points;
+    ubTexturedLight = light.Params.z > 0.5;
+    return light.Params.x * LTC_Evaluate(N, V, pos, mat3(1), points, light.Params.y > 0.5);
+}
+
+// full resolution texel a reduced diffuse texel is evaluated at
+ivec2 DiffuseSource(ivec2 texel, ivec2 size)
+{
+    return min(texel * uDiffuseScale + uDiffuseScale / 2, size - 1);
+}
+
+// Diffuse lighting without the albedo at 1 / uDiffuseScale of the resolution,
+// the linear depth is kept in alpha for the upsampling (negative when empty)
+void DiffuseMain()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = uSize;
+    if (any(greaterThanEqual(texel, (size + uDiffuseScale - 1) / uDiffuseScale)))
+        return;
+
+    ivec2 pixel = DiffuseSource(texel, size);
+    vec4 g0 = texelFetch(uGBuffer0, pixel, 0);
+    if (g0.w == 0.0)
+    {
+        imageStore(uDiffuse, texel, vec4(0.0, 0.0, 0.0, -1.0));
+        return;
+    }
+
+    float depth = texelFetch(uDepth, pixel, 0).r;
+    vec2 ndc = (vec2(pixel) + 0.5) / vec2(size) * 2.0 - 1.0;
+    vec3 posV = ViewPosition(ndc, depth);
+    vec3 pos = WorldPosition(pixel, size, depth);
+    vec3 N = normalize(g0.xyz);
+    vec3 V = normalize(uViewPositionW - pos);
+
+    float rotation = InterleavedGradientNoise(vec2(pixel));
+    vec3 diff = vec3(0.0);
+    for (int i = 0; i < uLightCount; i++)
+    {
+        vec4 sphere = uLights[i].Sphere;
+        vec3 d = posV - sphere.xyz;
+        if (dot(d, d) > sphere.w * sphere.w)
+            continue;
+        float visibility = uShadowMode == SHADOW_PCSS ? AreaShadow(uShadowAtlas, uLights[i].Shadow, pos, N, rotation) : 1.0;
+        if (visibility > 0.0)
+            diff += visibility * EvaluateDiffuse(uLights[i], N, V, pos);
+    }
+    imageStore(uDiffuse, texel, vec4(diff, -posV.z));
+}
+
+// Bilinear weights of the 4 closest reduced texels, damped by their depth
+// and normal differences so that lighting does not leak across edges
+vec3 UpsampleDiffuse(ivec2 pixel, ivec2 size, vec3 N, float viewDepth)
+{
+    ivec2 lowSize = (size + uDiffuseScale - 1) / uDiffuseScale;
+    vec2 p = (vec2(pixel) - float(uDiffuseScale / 2)) / float(uDiffuseScale);
+    ivec2 base = ivec2(floor(p));
+    vec2 f = p - vec2(base);
+
+    vec3 sum = vec3(0.0);
+    float weightSum = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), lowSize - 1);
+        vec4 s = texelFetch(uDiffuseLow, texel, 0);
+        if (s.w < 0.0)
+            continue;
+
+        vec3 n = normalize(texelFetch(uGBuffer0, DiffuseSource(texel, size), 0).xyz);
+        vec2 b = mix(1.0 - f, f, vec2(offset));
+        float depthWeight = 1.0 / (1e-3 + abs(s.w - viewDepth) / viewDepth * 50.0);
+        float normalWeight = pow(max(dot(N, n), 0.0), 16.0);
+        float weight = b.x * b.y * max(depthWeight * normalWeight, 1e-4);
+
+        sum += s.rgb * weight;
+        weightSum += weight;
+    }
+    return weightSum > 0.0 ? sum / weightSum : vec3(0.0);
+}
+
+// Marches the segment toward a light sample through the light's depth map,
+// a step behind the stored depth is taken as blocked
+float TraceShadow(ShadowData shadow, vec3 positionW, vec3 normalW, vec3 lightW, float jitter)
+{
+    if (shadow.Rect.z == 0.0)
+        return 1.0;
+
+    float near = shadow.Params.z;
+    float w = (shadow.ViewProj * vec4(positionW, 1.0)).w;
+    if (w <= near)
+        return 1.0;
+    vec4 c0 = shadow.ViewProj * vec4(positionW + normalW * shadow.Bias.x * w, 1.0);
+    vec4 c1 = shadow.ViewProj * vec4(lightW, 1.0);
+
+    // the light samples lie at w = 0, stop short of the near plane
+    float tEnd = clamp((c0.w - 2.0 * near) / max(c0.w - c1.w, 1e-5), 0.0, 1.0);
+    for (int k = 0; k < RATIO_STEPS; k++)
+    {
+        vec4 c = mix(c0, c1, (float(k) + 1.0 - jitter) / float(RATIO_STEPS) * tEnd);
+        vec3 ndc = c.xyz / c.w;
+        if (any(greaterThan(abs(ndc.xy), vec2(1.0))))
+            continue;
+        if (ShadowFetch(uShadowAtlas, shadow, ndc.xy * 0.5 + 0.5) < ndc.z * 0.5 + 0.5 - shadow.Bias.y)
+            return 0.0;
+    }
+    return 1.0;
+}
+
+// Stochastic estimates of the shadowed and unshadowed lighting luminance of
+// all the lights, both sampled with SphQuadSample and sharing their samples;
+// the view depth is kept in the third channel for the denoiser
+void RatioMain()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = uSize;
+    if (any(greaterThanEqual(pixel, size)))
+        return;
+
+    vec4 g0 = texelFetch(uGBuffer0, pixel, 0);
+    if (g0.w == 0.0)
+    {
+        imageStore(uRatioOut, pixel, vec4(0.0, 0.0, -1.0, 0.0));
+        return;
+    }
+
+    vec4 g1 = texelFetch(uGBuffer1, pixel, 0);
+    float depth = texelFetch(uDepth, pixel, 0).r;
+    vec2 ndc = (vec2(pixel) + 0.5) / vec2(size) * 2.0 - 1.0;
+    vec3 posV = ViewPosition(ndc, depth);
+    vec3 pos = WorldPosition(pixel, size, depth);
+    vec3 N = normalize(g0.xyz);
+    vec3 V = normalize(uViewPositionW - pos);
+
+    float alpha = g0.w * g0.w;
+    vec3 baseColor = toLinear(g1.rgb);
+    vec3 dcol = baseColor * (1.0 - g1.w) * toLinear(vec3(uAlbedo2));
+    vec3 scol = mix(vec3(uF0), baseColor, g1.w);
+
+    mat3 w2t = transpose(BasisFrisvad(N));
+    vec3 o = w2t * V;
+
+    vec2 jitter = vec2(InterleavedGradientNoise(vec2(pixel)), InterleavedGradientNoise(vec2(pixel.yx) + 17.0));
+    vec2 estimate = vec2(0.0);
+    for (int l = 0; l < uLightCount; l++)
+    {
+        vec4 sphere = uLights[l].Sphere;
+        vec3 d = posV - sphere.xyz;
+        if (dot(d, d) > sphere.w * sphere.w)
+            continue;
+
+        LightData light = uLights[l];
+        vec3 ex = light.Points[1].xyz - light.Points[0].xyz;
+        vec3 ey = light.Points[3].xyz - light.Points[0].xyz;
+        vec3 quadn = -normalize(cross(ex, ey));
+        bool bTwoSided = light.Params.y > 0.5;
+
+        SphQuad squad = SphQuadInit(light.Points[0].xyz, ex, ey, pos);
+        if (!(squad.S > 0.0))
+            continue;
+
+        for (int t = 0; t < RATIO_SAMPLES; t++)
+        {
+            vec2 u = fract(jitter + uSamples[t].xy);
+            vec3 lightPos = SphQuadSample(squad, u.x, u.y);
+            vec3 L = normalize(lightPos - pos);
+            vec3 i = w2t * L;
+            if (i.z <= 0.0 || (dot(L, quadn) >= 0.0 && !bTwoSided))
+                continue;
+
+            vec3 h = normalize(i + o);
+            vec3 F = scol + (1.0 - scol)*pow(1.0 - clamp(dot(h, o), 0, 1), 5.0);
+            float pdf;
+            vec3 brdf = dcol / pi + GGX(o, i, alpha, pdf) * F;
+
+            // solid angle sampling, the pdf is 1 / S
+            float weight = Luminance(brdf) * i.z * squad.S * light.Params.x;
+            estimate += weight * vec2(TraceShadow(light.Shadow, pos, N, lightPos, fract(u.x + u.y)), 1.0);
+        }
+    }
+    imageStore(uRatioOut, pixel, vec4(estimate / float(RATIO_SAMPLES), -posV.z, 0.0));
+}
+
+void main()
+{
+    if (uPass == PASS_DIFFUSE)
+    {
+        DiffuseMain();
+        return;
+    }
+    if (uPass == PASS_RATIO)
+    {
+        RatioMain();
+        return;
+    }
+
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = uSize;
+    bool bInside = all(lessThan(pixel, size));
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        sDepthMin = 0xFFFFFFFFu;
+        sDepthMax = 0u;
+        sLightCount = 0u;
+    }
+    barrier();
+
+    // depth bounds of the shaded texels, positive floats sort like their bits
+    float depth = 1.0;
+    vec4 g0 = vec4(0.0);
+    if (bInside)
+    {
+        depth = texelFetch(uDepth, pixel, 0).r;
+        g0 = texelFetch(uGBuffer0, pixel, 0);
+    }
+    bool bSurface = bInside && g0.w > 0.0;
+    if (bSurface)
+    {
+        atomicMin(sDepthMin, floatBitsToUint(depth));
+        atomicMax(sDepthMax, floatBitsToUint(depth));
+    }
+    barrier();
+
+    // nothing to shade in this tile
+    if (sDepthMin > sDepthMax)
+        return;
+
+    // view space box of the tile between its depth bounds
+    vec2 tileMin = vec2(gl_WorkGroupID.xy * TILE_SIZE) / vec2(size) * 2.0 - 1.0;
+    vec2 tileMax = vec2((gl_WorkGroupID.xy + 1) * TILE_SIZE) / vec2(size) * 2.0 - 1.0;
+    float depthMin = uintBitsToFloat(sDepthMin);
+    float depthMax = uintBitsToFloat(sDepthMax);
+
+    vec3 boxMin = vec3(1e30);
+    vec3 boxMax = vec3(-1e30);
+    for (int i = 0; i < 8; i++)
+    {
+        vec2 ndc = mix(tileMin, tileMax, vec2(i & 1, (i >> 1) & 1));
+        vec3 corner = ViewPosition(ndc, (i & 4) != 0 ? depthMax : depthMin);
+        boxMin = min(boxMin, corner);
+        boxMax = max(boxMax, corner);
+    }
+    vec3 boxCenter = (boxMin + boxMax) * 0.5;
+    vec3 boxExtent = (boxMax - boxMin) * 0.5;
+
+    // tile light list
+    for (uint i = gl_LocalInvocationIndex; i < uint(uLightCount); i += TILE_SIZE * TILE_SIZE)
+    {
+        vec4 sphere = uLights[i].Sphere;
+        vec3 d = max(abs(sphere.xyz - boxCenter) - boxExtent, 0.0);
+        if (dot(d, d) > sphere.w * sphere.w)
+            continue;
+
+        // whole box behind a one-sided emitter
+        vec4 plane = uLights[i].Plane;
+        if (dot(plane.xyz, boxCenter) + plane.w + dot(abs(plane.xyz), boxExtent) < 0.0)
+            continue;
+
+        uint index = atomicAdd(sLightCount, 1u);
+        if (index < MAX_TILE_LIGHTS)
+            sLightIndices[index] = i;
+    }
+    barrier();
+
+    // a full list lost lights, each texel tests all of them instead
+    bool bOverflow = sLightCount > uint(MAX_TILE_LIGHTS);
+    if (bOverflow && ubCountOverflow && gl_LocalInvocationIndex == 0)
+        atomicAdd(uOverflowTiles, 1u);
+
+    vec2 error = vec2(0.0);
+    if (bSurface)
+    {
+        vec4 g1 = texelFetch(uGBuffer1, pixel, 0);
+        vec3 N = normalize(g0.xyz);
+        float roughness = g0.w;
+        float metallic = g1.w;
+
+        vec3 albedo = toLinear(vec3(uAlbedo2));
+        vec3 baseColor = toLinear(g1.rgb);
+        vec3 dcol = baseColor*(1.0 - metallic);
+        vec3 scol = mix(vec3(uF0), baseColor, metallic);
+
+        vec3 pos = WorldPosition(pixel, size, depth);
+        vec3 V = normalize(uViewPositionW - pos);
+
+        float ndotv = clamp(dot(N, V), 0, 1);
+        vec2 uv = vec2(roughness, sqrt(1.0 - ndotv));
+        // if mtx data is loaded from image need to be flip
+        uv.y = 1 - uv.y;
+        // scale and bias coordinates, for correct filtered lookup
+        uv = uv*LUT_SCALE + LUT_BIAS;
+
+        vec4 t1 = texture(uLtc1, uv);
+        vec4 t2 = texture(uLtc2, uv);
+        mat3 Minv = mat3(
+            vec3(t1.x, 0, t1.y),
+            vec3(   0, 1, 0),
+            vec3(t1.z, 0, t1.w)
+        );
+
+        float rotation = InterleavedGradientNoise(vec2(pixel));
+        vec3 spec = vec3(0);
+        vec3 diff = vec3(0);
+        bool bFullDiffuse = uDiffuseScale == 1 || ubMeasureError;
+        vec3 posV = ViewPosition((vec2(pixel) + 0.5) / vec2(size) * 2.0 - 1.0, depth);
+        uint lightCount = bOverflow ? uint(uLightCount) : sLightCount;
+        for (uint i = 0u; i < lightCount; i++)
+        {
+            LightData light = uLights[bOverflow ? i : sLightIndices[i]];
+            if (bOverflow)
+            {
+                vec3 d = posV - light.Sphere.xyz;
+                if (dot(d, d) > light.Sphere.w * light.Sphere.w)
+                    continue;
+            }
+            float visibility = uShadowMode == SHADOW_PCSS ? AreaShadow(uShadowAtlas, light.Shadow, pos, N, rotation) : 1.0;
+            if (visibility == 0.0)
+                continue;
+
+            vec4 points[4] = light.Points;
+            ubTexturedLight = light.Params.z > 0.5;
+
+            vec3 s = LTC_Evaluate(N, V, pos, Minv, points, light.Params.y > 0.5);
+            spec += visibility * light.Params.x * s * (scol*t2.x + (1.0 - scol)*t2.y);
+            if (bFullDiffuse)
+                diff += visibility * EvaluateDiffuse(light, N, V, pos);
+        }
+
+        if (uDiffuseScale > 1)
+        {
+            vec3 reduced = UpsampleDiffuse(pixel, size, N, -posV.z);
+            error = vec2(abs(Luminance(reduced) - Luminance(diff)), Luminance(diff));
+            diff = reduced;
+        }
+
+        // the analytic lighting scaled by the denoised stochastic ratio
+        if (uShadowMode == SHADOW_RATIO)
+        {
+            vec2 ratio = texelFetch(uRatio, pixel, 0).xy;
+            float visibility = ratio.y > 1e-5 ? clamp(ratio.x / ratio.y, 0.0, 1.0) : 1.0;
+            spec *= visibility;
+            diff *= visibility;
+        }
+
+        // additive like the forward color pass
+        vec4 color = imageLoad(uColor, pixel);
+        imageStore(uColor, pixel, vec4(color.rgb + spec + dcol*diff*albedo, color.a));
+    }
+
+    if (ubMeasureError)
+    {
+        uint index = gl_LocalInvocationIndex;
+        sErrors[index] = error;
+        barrier();
+        for (uint stride = TILE_SIZE * TILE_SIZE / 2; stride > 0u; stride >>= 1)
+        {
+            if (index < stride)
+                sErrors[index] += sErrors[index + stride];
+            barrier();
+        }
+        if (index == 0u)
+            uTileErrors[gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x] = sErrors[0];
+    }
+}
+
+-- Denoise
+layout(local_size_x = 16, local_size_y = 16) in;
+
+// one direction of a separable cross bilateral blur of the ratio estimator
+// terms, guided by the view depth and the G-buffer normals
+uniform sampler2D uSource; // shadowed, unshadowed, view depth (negative when empty)
+uniform sampler2D uGBuffer0;
+uniform vec2 uDirection; // (1, 0) then (0, 1)
+uniform ivec2 uSize; // the viewport, the pooled targets can be larger
+layout(rgba16f) writeonly uniform image2D uDest;
+
+#define DENOISE_RADIUS 6
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = uSize;
+    if (any(greaterThanEqual(pixel, size)))
+        return;
+
+    vec4 center = texelFetch(uSource, pixel, 0);
+    if (center.z < 0.0)
+    {
+        imageStore(uDest, pixel, center);
+        return;
+    }
+    vec3 N = normalize(texelFetch(uGBuffer0, pixel, 0).xyz);
+
+    vec2 sum = vec2(0.0);
+    float weightSum = 0.0;
+    for (int i = -DENOISE_RADIUS; i <= DENOISE_RADIUS; i++)
+    {
+        ivec2 texel = clamp(pixel + ivec2(uDirection) * i, ivec2(0), size - 1);
+        vec4 s = texelFetch(uSource, texel, 0);
+        if (s.z < 0.0)
+            continue;
+
+        vec3 n = normalize(texelFetch(uGBuffer0, texel, 0).xyz);
+        float spatial = exp(-float(i * i) / (2.0 * 9.0));
+        float depthWeight = exp(-abs(s.z - center.z) / (0.02 * center.z));
+        float normalWeight = pow(max(dot(N, n), 0.0), 32.0);
+        float weight = spatial * depthWeight * normalWeight;
+
+        sum += s.xy * weight;
+        weightSum += weight;
+    }
+    imageStore(uDest, pixel, vec4(sum / max(weightSum, 1e-5), center.z, 0.0));
+}
@@ -0,0 +1,962 @@
+#include <AssetCooker.h>
+#include <GLType/TextureFile.h>
+#include <tools/FileUtility.h>
+#include <tools/stb_image.h>
+#include <zlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <thread>
+#include <sys/stat.h>
+
+#if _WIN32
+#   include <direct.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define COOKER_USE_SSE 1
+#   include <emmintrin.h>
+#else
+#   define COOKER_USE_SSE 0
+#endif
+
+namespace asset
+{
+    namespace
+    {
+        bool Contains(const std::string& name, const char* word)
+        {
+            return name.find(word) != std::string::npos;
+        }
+
+        bool FileExists(const std::string& fileName)
+        {
+            struct stat info;
+            return stat(fileName.c_str(), &info) == 0;
+        }
+
+        void MakeDirectory(const std::string& path)
+        {
+        #if _WIN32
+            _mkdir(path.c_str());
+        #else
+            mkdir(path.c_str(), 0755);
+        #endif
+        }
+
+        // TIFF LZW : MSB first codes of 9 to 12 bits, widened one code early
+        bool DecodeLzw(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+        {
+            const uint32_t ClearCode = 256;
+            const uint32_t EndCode = 257;
+            const uint32_t MaxCodes = 4096;
+
+            uint16_t prefix[MaxCodes];
+            uint16_t length[MaxCodes];
+            uint8_t suffix[MaxCodes];
+            uint8_t first[MaxCodes];
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                prefix[i] = 0;
+                length[i] = 1;
+                suffix[i] = uint8_t(i);
+                first[i] = uint8_t(i);
+            }
+
+            uint32_t bits = 0, bitCount = 0, width = 9, next = 258;
+            uint32_t previous = ClearCode;
+            size_t in = 0, out = 0;
+            while (out < dstSize)
+            {
+                while (bitCount < width)
+                {
+                    if (in >= srcSize)
+                        return false;
+                    bits = (bits << 8) | src[in++];
+                    bitCount += 8;
+                }
+                bitCount -= width;
+                const uint32_t code = (bits >> bitCount) & ((1u << width) - 1);
+
+                if (code == EndCode)
+                    break;
+                if (code == ClearCode)
+                {
+                    width = 9;
+                    next = 258;
+                    previous = ClearCode;
+                    continue;
+                }
+                if (previous == ClearCode)
+                {
+                    if (code > 255)
+                        return false;
+                    dst[out++] = uint8_t(code);
+                    previous = code;
+                    continue;
+                }
+                if (code > next)
+                    return false;
+
+                // a code not in the table yet is the previous string and its first byte
+                if (next < MaxCodes)
+                {
+                    prefix[next] = uint16_t(previous);
+                    length[next] = uint16_t(length[previous] + 1);
+                    suffix[next] = code == next ? first[previous] : first[code];
+                    first[next] = first[previous];
+                    next++;
+                    if (next >= (1u << width) - 1 && width < 12)
+                        width++;
+                }
+                else if (code == next)
+                    return false;
+
+                // the strings are stored backwards
+                size_t count = std::min(size_t(length[code]), dstSize - out);
+                uint32_t p = code;
+                for (size_t skip = length[code]; skip > count; skip--)
+                    p = prefix[p];
+                for (size_t i = count; i > 0; i--)
+                {
+                    dst[out + i - 1] = suffix[p];
+                    p = prefix[p];
+                }
+                out += count;
+                previous = code;
+            }
+            return out == dstSize;
+        }
+
+        class TiffReader
+        {
+        public:
+            TiffReader(const uint8_t* data, size_t size) : m_Data(data), m_Size(size), m_bBigEndian(false) {}
+
+            bool decode(SourceImage& image)
+            {
+                if (m_Size < 8)
+                    return false;
+                if (m_Data[0] == 'I' && m_Data[1] == 'I')
+                    m_bBigEndian = false;
+                else if (m_Data[0] == 'M' && m_Data[1] == 'M')
+                    m_bBigEndian = true;
+                else
+                    return false;
+                if (u16(2) != 42)
+                    return false;
+
+                // the first image only
+                const size_t ifd = u32(4);
+                if (ifd + 2 > m_Size)
+                    return false;
+                const uint32_t count = u16(ifd);
+                if (ifd + 2 + size_t(count) * 12 > m_Size)
+                    return false;
+
+                uint32_t width = 0, height = 0, channels = 1, compression = 1, photometric = 1;
+                uint32_t rowsPerStrip = ~0u, planar = 1, predictor = 1;
+                std::vector<uint32_t> bitsPerSample, offsets, byteCounts;
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    const size_t entry = ifd + 2 + i * 12;
+                    std::vector<uint32_t> values;
+                    if (!readValues(entry, values) || values.empty())
+                        continue;
+                    switch (u16(entry))
+                    {
+                    case 256: width = values[0]; break;
+                    case 257: height = values[0]; break;
+                    case 258: bitsPerSample = values; break;
+                    case 259: compression = values[0]; break;
+                    case 262: photometric = values[0]; break;
+                    case 273: offsets = values; break;
+                    case 277: channels = values[0]; break;
+                    case 278: rowsPerStrip = values[0]; break;
+                    case 279: byteCounts = values; break;
+                    case 284: planar = values[0]; break;
+                    case 317: predictor = values[0]; break;
+                    }
+                }
+
+                // 8 bits chunky strips, what the texture tools write
+                if (width == 0 || height == 0 || channels == 0 || channels > 4 || planar != 1 || photometric > 2)
+                    return false;
+                for (auto bits : bitsPerSample)
+                    if (bits != 8)
+                        return false;
+                if (offsets.empty() || offsets.size() != byteCounts.size())
+                    return false;
+
+                const size_t rowSize = size_t(width) * channels;
+                rowsPerStrip = std::min(std::max(rowsPerStrip, 1u), height);
+                if (offsets.size() < (height + rowsPerStrip - 1) / rowsPerStrip)
+                    return false;
+
+                image.Width = width;
+                image.Height = height;
+                image.Channels = channels;
+                image.Texels.resize(rowSize * height);
+                for (size_t strip = 0; strip * rowsPerStrip < height; strip++)
+                {
+                    const size_t row = strip * rowsPerStrip;
+                    const size_t rows = std::min(size_t(rowsPerStrip), height - row);
+                    if (size_t(offsets[strip]) + byteCounts[strip] > m_Size)
+                        return false;
+
+                    const uint8_t* src = m_Data + offsets[strip];
+                    uint8_t* dst = image.Texels.data() + row * rowSize;
+                    if (!decodeStrip(compression, src, byteCounts[strip], dst, rows * rowSize))
+                        return false;
+                }
+
+                // horizontal differencing, per channel
+                if (predictor == 2)
+                {
+                    for (uint32_t y = 0; y < height; y++)
+                    {
+                        uint8_t* row = image.Texels.data() + y * rowSize;
+                        for (size_t x = channels; x < rowSize; x++)
+                            row[x] = uint8_t(row[x] + row[x - channels]);
+                    }
+                }
+                if (photometric == 0)
+                {
+                    for (auto& texel : image.Texels)
+                        texel = uint8_t(255 - texel);
+                }
+                return true;
+            }
+
+        private:
+
+            uint16_t u16(size_t offset) const
+            {
+                const uint8_t* p = m_Data + offset;
+                return m_bBigEndian ? uint16_t(p[0] << 8 | p[1]) : uint16_t(p[1] << 8 | p[0]);
+            }
+
+            uint32_t u32(size_t offset) const
+            {
+                const uint8_t* p = m_Data + offset;
+                return m_bBigEndian ?
+                    uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3] :
+                    uint32_t(p[3]) << 24 | uint32_t(p[2]) << 16 | uint32_t(p[1]) << 8 | p[0];
+            }
+
+            // BYTE, SHORT or LONG values, inline when they fit in 4 bytes
+            bool readValues(size_t entry, std::vector<uint32_t>& values) const
+            {
+                const uint16_t type = u16(entry + 2);
+                const size_t count = u32(entry + 4);
+                const size_t typeSize = type == 1 ? 1 : type == 3 ? 2 : type == 4 ? 4 : 0;
+                if (typeSize == 0 || count > m_Size)
+                    return false;
+
+                size_t offset = entry + 8;
+                if (count * typeSize > 4)
+                    offset = u32(entry + 8);
+                if (offset + count * typeSize > m_Size)
+                    return false;
+
+                values.resize(count);
+                for (size_t i = 0; i < count; i++)
+                {
+                    const size_t p = offset + i * typeSize;
+                    values[i] = typeSize == 1 ? m_Data[p] : typeSize == 2 ? u16(p) : u32(p);
+                }
+                return true;
+            }
+
+            static bool decodeStrip(uint32_t compression, const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+            {
+                switch (compression)
+                {
+                case 1:
+                    if (srcSize < dstSize)
+                        return false;
+                    memcpy(dst, src, dstSize);
+                    return true;
+                case 5:
+                    return DecodeLzw(src, srcSize, dst, dstSize);
+                case 8:
+                case 32946:
+                {
+                    uLongf length = uLongf(dstSize);
+                    return uncompress(dst, &length, src, uLong(srcSize)) == Z_OK && length == dstSize;
+                }
+                default:
+                    return false;
+                }
+            }
+
+            const uint8_t* m_Data;
+            size_t m_Size;
+            bool m_bBigEndian;
+        };
+
+        bool IsGammaEncoded(TextureUsage usage)
+        {
+            return usage == TextureUsageColor || usage == TextureUsageAlbedo;
+        }
+
+        // 8 bits source to linear RGBA, what the mips are filtered from, the
+        // rows reversed since the cooked files are stored bottom-up
+        void Linearize(const SourceImage& image, TextureUsage usage, std::vector<glm::vec4>& texels)
+        {
+            float decode[256];
+            for (int i = 0; i < 256; i++)
+            {
+                const float v = i / 255.f;
+                if (IsGammaEncoded(usage))
+                    decode[i] = std::pow(v, 2.2f);
+                else if (usage == TextureUsageNormal)
+                    decode[i] = v * 2.f - 1.f;
+                else
+                    decode[i] = v;
+            }
+
+            const size_t count = size_t(image.Width) * image.Height;
+            const uint32_t channels = image.Channels;
+            texels.resize(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                const size_t row = image.Height - 1 - i / image.Width;
+                const uint8_t* src = &image.Texels[(row * image.Width + i % image.Width) * channels];
+                glm::vec4& texel = texels[i];
+                if (channels >= 3)
+                {
+                    texel = glm::vec4(decode[src[0]], decode[src[1]], decode[src[2]], 1.f);
+                    if (channels == 4)
+                        texel.w = src[3] / 255.f;
+                }
+                else
+                {
+                    texel = glm::vec4(decode[src[0]], decode[src[0]], decode[src[0]], 1.f);
+                    if (channels == 2)
+                        texel.w = src[1] / 255.f;
+                }
+
+                // two channel normal maps store x and y only
+                if (usage == TextureUsageNormal && channels == 2)
+                {
+                    texel = glm::vec4(decode[src[0]], decode[src[1]], 0.f, 1.f);
+                    texel.z = std::sqrt(std::max(1.f - texel.x * texel.x - texel.y * texel.y, 0.f));
+                }
+            }
+        }
+
+        // 2x2 box, the last row or column repeated for the odd extents
+        void Downsample(const glm::vec4* src, uint32_t width, uint32_t height, glm::vec4* dst)
+        {
+            const uint32_t dstWidth = std::max(width >> 1, 1u);
+            const uint32_t dstHeight = std::max(height >> 1, 1u);
+        #if COOKER_USE_SSE
+            const __m128 quarter = _mm_set1_ps(0.25f);
+        #endif
+            for (uint32_t y = 0; y < dstHeight; y++)
+            {
+                const glm::vec4* row0 = src + size_t(std::min(y * 2, height - 1)) * width;
+                const glm::vec4* row1 = src + size_t(std::min(y * 2 + 1, height - 1)) * width;
+                glm::vec4* out = dst + size_t(y) * dstWidth;
+                for (uint32_t x = 0; x < dstWidth; x++)
+                {
+                    const uint32_t x0 = std::min(x * 2, width - 1);
+                    const uint32_t x1 = std::min(x * 2 + 1, width - 1);
+                #if COOKER_USE_SSE
+                    __m128 sum = _mm_add_ps(_mm_loadu_ps(&row0[x0].x), _mm_loadu_ps(&row0[x1].x));
+                    sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(&row1[x0].x), _mm_loadu_ps(&row1[x1].x)));
+                    _mm_storeu_ps(&out[x].x, _mm_mul_ps(sum, quarter));
+                #else
+                    out[x] = (row0[x0] + row0[x1] + row1[x0] + row1[x1]) * 0.25f;
+                #endif
+                }
+            }
+        }
+
+        uint8_t Quantize(float v)
+        {
+            return uint8_t(glm::clamp(v, 0.f, 1.f) * 255.f + 0.5f);
+        }
+
+        // RGBA8 whatever the format, the block encoder reads the channels it keeps
+        void Quantize(const std::vector<glm::vec4>& texels, TextureUsage usage, uint8_t* dst)
+        {
+            const float invGamma = 1.f / 2.2f;
+            for (size_t i = 0; i < texels.size(); i++)
+            {
+                const glm::vec4& texel = texels[i];
+                switch (usage)
+                {
+                case TextureUsageColor:
+                case TextureUsageAlbedo:
+                    dst[i * 4 + 0] = Quantize(std::pow(texel.x, invGamma));
+                    dst[i * 4 + 1] = Quantize(std::pow(texel.y, invGamma));
+                    dst[i * 4 + 2] = Quantize(std::pow(texel.z, invGamma));
+                    dst[i * 4 + 3] = Quantize(texel.w);
+                    break;
+                case TextureUsageNormal:
+                {
+                    // the averaged normals are shorter where they diverge
+                    const float length = glm::length(glm::vec3(texel));
+                    const glm::vec3 n = length > 0.f ? glm::vec3(texel) / length : glm::vec3(0.f, 0.f, 1.f);
+                    dst[i * 4 + 0] = Quantize(n.x * 0.5f + 0.5f);
+                    dst[i * 4 + 1] = Quantize(n.y * 0.5f + 0.5f);
+                    dst[i * 4 + 2] = Quantize(n.z * 0.5f + 0.5f);
+                    dst[i * 4 + 3] = 255;
+                    break;
+                }
+                case TextureUsageOrm:
+                    dst[i * 4 + 0] = Quantize(texel.x);
+                    dst[i * 4 + 1] = Quantize(texel.y);
+                    dst[i * 4 + 2] = Quantize(texel.z);
+                    dst[i * 4 + 3] = 255;
+                    break;
+                default:
+                    dst[i * 4 + 0] = dst[i * 4 + 1] = dst[i * 4 + 2] = Quantize(texel.x);
+                    dst[i * 4 + 3] = 255;
+                    break;
+                }
+            }
+        }
+
+        bool GetBlockFormat(gli::format format, BlockFormat& block)
+        {
+            switch (format)
+            {
+            case gli::FORMAT_RGBA_DXT1_UNORM_BLOCK8: block = BlockFormatBC1; return true;
+            case gli::FORMAT_R_ATI1N_UNORM_BLOCK8: block = BlockFormatBC4; return true;
+            case gli::FORMAT_RG_ATI2N_UNORM_BLOCK16: block = BlockFormatBC5; return true;
+            case gli::FORMAT_RGBA_BP_UNORM_BLOCK16: block = BlockFormatBC7; return true;
+            default: return false;
+            }
+        }
+
+        // one cooked texture : a source image, or the occlusion, roughness and
+        // metalness maps of a material packed in the channels of one image
+        struct CookJob
+        {
+            std::string Source;         // "<directory>/orm" for the packed maps
+            TextureUsage Usage;
+            std::string Channels[3];    // empty for a missing map
+        };
+
+        // the maps are packed per directory, a directory holding one material
+        std::vector<CookJob> MakeJobs(const std::vector<std::string>& sources, bool bPackOrm)
+        {
+            std::vector<CookJob> jobs;
+            std::map<std::string, size_t> materials;
+            for (auto& source : sources)
+            {
+                const TextureUsage usage = GuessTextureUsage(source);
+                const int channel = usage == TextureUsageOcclusion ? 0 : usage == TextureUsageRoughness ? 1 : usage == TextureUsageMetalness ? 2 : -1;
+                if (!bPackOrm || channel < 0)
+                {
+                    CookJob job;
+                    job.Source = source;
+                    job.Usage = usage;
+                    jobs.push_back(job);
+                    continue;
+                }
+
+                const std::string material = source.substr(0, source.find_last_of("/\\") + 1) + "orm";
+                auto it = materials.find(material);
+                if (it == materials.end())
+                {
+                    it = materials.emplace(material, jobs.size()).first;
+                    CookJob job;
+                    job.Source = material;
+                    job.Usage = TextureUsageOrm;
+                    jobs.push_back(job);
+                }
+                jobs[it->second].Channels[channel] = source;
+            }
+            return jobs;
+        }
+
+        // the files of a job, the packed maps in channel order
+        bool MapJob(const CookJob& job, std::vector<util::MappedFilePtr>& files)
+        {
+            const size_t count = job.Usage == TextureUsageOrm ? 3 : 1;
+            files.resize(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                const std::string& name = job.Usage == TextureUsageOrm ? job.Channels[i] : job.Source;
+                if (name.empty())
+                    continue;
+                files[i] = util::MapFileSync(name);
+                if (!files[i])
+                {
+                    fprintf(stderr, "Error : failed to open %s\n", name.c_str());
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // identifies the cooked output, whatever the source paths
+        uint64_t HashJob(const CookJob& job, const std::vector<util::MappedFilePtr>& files, EncodePreset preset)
+        {
+            uint64_t hash = HashBytes(&kCookerVersion, sizeof(kCookerVersion));
+            hash = HashBytes(&job.Usage, sizeof(job.Usage), hash);
+            hash = HashBytes(&preset, sizeof(preset), hash);
+            for (uint32_t i = 0; i < files.size(); i++)
+            {
+                hash = HashBytes(&i, sizeof(i), hash);
+                if (files[i])
+                    hash = HashBytes(files[i]->data(), files[i]->size(), hash);
+            }
+            return hash;
+        }
+
+        // occlusion, roughness and metalness in r, g and b, a missing map
+        // unoccluded, rough and dielectric
+        bool PackOrm(const CookJob& job, const std::vector<util::MappedFilePtr>& files, SourceImage& image)
+        {
+            const uint8_t defaults[3] = { 255, 255, 0 };
+            SourceImage maps[3];
+            for (size_t i = 0; i < 3; i++)
+            {
+                if (!files[i])
+                    continue;
+                if (!DecodeImage(files[i]->data(), files[i]->size(), maps[i]))
+                {
+                    fprintf(stderr, "Error : failed to decode %s\n", job.Channels[i].c_str());
+                    return false;
+                }
+                if (image.Width == 0)
+                {
+                    image.Width = maps[i].Width;
+                    image.Height = maps[i].Height;
+                }
+                else if (maps[i].Width != image.Width || maps[i].Height != image.Height)
+                {
+                    fprintf(stderr, "Error : %s does not match the size of the other maps\n", job.Channels[i].c_str());
+                    return false;
+                }
+            }
+
+            image.Channels = 3;
+            image.Texels.resize(size_t(image.Width) * image.Height * 3);
+            for (size_t t = 0; t < size_t(image.Width) * image.Height; t++)
+            {
+                for (size_t i = 0; i < 3; i++)
+                    image.Texels[t * 3 + i] = files[i] ? maps[i].Texels[t * maps[i].Channels] : defaults[i];
+            }
+            return true;
+        }
+
+        // bottom-up, since the block compressed formats past BC3 can not be
+        // flipped on upload (the manifest entry says so), written aside then
+        // renamed so that a reader never sees a partial file
+        bool SaveCooked(const gli::texture& texture, const std::string& fileName)
+        {
+            util::BytesArray bytes = std::make_shared<util::FileContainer>();
+            if (!gli::save_dds(texture, *bytes))
+            {
+                fprintf(stderr, "Error : failed to encode %s\n", fileName.c_str());
+                return false;
+            }
+
+            const std::string temporary = fileName + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+            if (!util::WriteFileSync(temporary, bytes) || rename(temporary.c_str(), fileName.c_str()) != 0)
+            {
+                remove(temporary.c_str());
+                fprintf(stderr, "Error : failed to write %s\n", fileName.c_str());
+                return false;
+            }
+            return true;
+        }
+
+        enum CookResult
+        {
+            CookResultCooked,
+            CookResultUpToDate,
+            CookResultFailed,
+        };
+
+        struct CookStats
+        {
+            uint64_t UncompressedBytes = 0;
+            uint64_t CookedBytes = 0;
+            uint64_t EncodedTexels = 0;
+            double EncodeSeconds = 0.0;
+        };
+
+        CookResult CookSource(const CookJob& job, const Manifest& manifest, const CookOptions& options, uint32_t encodeThreads, ManifestEntry& entry, CookStats& stats)
+        {
+            std::vector<util::MappedFilePtr> files;
+            if (!MapJob(job, files))
+                return CookResultFailed;
+
+            const std::string& source = job.Source;
+            const TextureUsage usage = job.Usage;
+            char name[32];
+            entry.Hash = HashJob(job, files, options.Preset);
+            entry.Usage = GetTextureUsageName(usage);
+            entry.bBottomUp = true;
+            snprintf(name, sizeof(name), "/%016" PRIx64 ".dds", entry.Hash);
+            entry.Cooked = options.OutputDirectory + name;
+
+            // the output is named after the hash, an existing one is current
+            const ManifestEntry* previous = manifest.find(source);
+            if (!options.bForce && FileExists(entry.Cooked))
+                return previous && previous->Hash == entry.Hash ? CookResultUpToDate : CookResultCooked;
+
+            SourceImage image;
+            if (usage == TextureUsageOrm)
+            {
+                if (!PackOrm(job, files, image))
+                    return CookResultFailed;
+            }
+            else if (!DecodeImage(files[0]->data(), files[0]->size(), image))
+            {
+                fprintf(stderr, "Error : failed to decode %s\n", source.c_str());
+                return CookResultFailed;
+            }
+
+            gli::texture2d texture = CookTexture(image, usage, options.Preset, encodeThreads, &stats.EncodeSeconds);
+            if (!SaveCooked(texture, entry.Cooked))
+                return CookResultFailed;
+
+            const gli::texture2d uncompressed(GetTextureUsageFormat(usage, EncodePresetUncompressed), texture.extent(), texture.levels());
+            stats.UncompressedBytes = uncompressed.size();
+            stats.CookedBytes = texture.size();
+            if (gli::is_compressed(texture.format()))
+            {
+                for (size_t level = 0; level < texture.levels(); level++)
+                    stats.EncodedTexels += uint64_t(texture.extent(level).x) * texture.extent(level).y;
+            }
+            if (options.bVerbose)
+                printf("%s -> %s (%s, %ux%u, %zu levels)\n", source.c_str(), entry.Cooked.c_str(), entry.Usage.c_str(), image.Width, image.Height, texture.levels());
+            return CookResultCooked;
+        }
+
+        int GetMaterialSlot(TextureUsage usage)
+        {
+            switch (usage)
+            {
+            case TextureUsageAlbedo: return MaterialSlotAlbedo;
+            case TextureUsageNormal: return MaterialSlotNormal;
+            case TextureUsageOrm: return MaterialSlotOrm;
+            default: return -1;
+            }
+        }
+
+        // a cooked map of a material directory
+        struct MaterialMap
+        {
+            std::string Directory;
+            std::string Cooked;
+            uint64_t Hash;
+            TextureFile File;
+            size_t SkipLevels;  // finer than the array
+        };
+
+        // the maps of a slot as the layers of one texture array, sorted by
+        // directory. The array takes the extent of the smallest map, the
+        // larger ones drop their finer levels; a map of another format or
+        // aspect ratio is left out. Returns the number of layers.
+        int32_t CookMaterialArray(MaterialSlot slot, std::vector<MaterialMap>& maps, Manifest& manifest, const CookOptions& options)
+        {
+            gli::extent3d extent(0);
+            for (auto& map : maps)
+            {
+                if (!MapTextureFile(map.Cooked, map.File))
+                    fprintf(stderr, "Error : failed to open %s\n", map.Cooked.c_str());
+                else if (extent.x == 0 || map.File.Extent.x < extent.x)
+                    extent = map.File.Extent;
+            }
+
+            const MaterialMap* first = nullptr;
+            size_t levels = 0;
+            uint64_t hash = HashBytes(&kCookerVersion, sizeof(kCookerVersion));
+            hash = HashBytes(&slot, sizeof(slot), hash);
+            for (auto& map : maps)
+            {
+                if (map.File.empty())
+                    continue;
+                map.SkipLevels = 0;
+                while (map.SkipLevels < map.File.Levels && map.File.extent(map.SkipLevels).x > extent.x)
+                    map.SkipLevels++;
+                if (map.SkipLevels == map.File.Levels || map.File.extent(map.SkipLevels) != extent || (first && map.File.Format != first->File.Format))
+                {
+                    fprintf(stderr, "Warning : %s does not fit the %s array\n", map.Directory.c_str(), GetMaterialSlotName(slot));
+                    map.File = TextureFile();
+                    continue;
+                }
+                if (!first)
+                    first = &map;
+                levels = levels ? std::min(levels, map.File.Levels - map.SkipLevels) : map.File.Levels - map.SkipLevels;
+                hash = HashBytes(map.Directory.data(), map.Directory.size(), hash);
+                hash = HashBytes(&map.Hash, sizeof(map.Hash), hash);
+            }
+            if (!first)
+                return 0;
+
+            int32_t layers = 0;
+            for (auto& map : maps)
+                layers += map.File.empty() ? 0 : 1;
+
+            ManifestEntry entry;
+            char name[32];
+            entry.Hash = hash;
+            entry.Usage = GetMaterialSlotName(slot);
+            entry.bBottomUp = true;
+            snprintf(name, sizeof(name), "/%016" PRIx64 ".dds", hash);
+            entry.Cooked = options.OutputDirectory + name;
+            if (options.bForce || !FileExists(entry.Cooked))
+            {
+                gli::texture2d_array array(first->File.Format, gli::extent2d(extent.x, extent.y), size_t(layers), levels);
+                size_t layer = 0;
+                for (auto& map : maps)
+                {
+                    if (map.File.empty())
+                        continue;
+                    for (size_t level = 0; level < levels; level++)
+                        memcpy(array.data(layer, 0, level), map.File.data(0, 0, level + map.SkipLevels), array.size(level));
+                    layer++;
+                }
+                if (!SaveCooked(array, entry.Cooked))
+                    return 0;
+                if (options.bVerbose)
+                    printf("%s -> %s (%d layers, %ux%u, %zu levels)\n", GetMaterialArraySource(slot).c_str(), entry.Cooked.c_str(), layers, extent.x, extent.y, levels);
+            }
+            manifest.set(GetMaterialArraySource(slot), entry);
+            return layers;
+        }
+
+        // every directory with a cooked albedo, normal or packed map is a material
+        void CookMaterials(const std::vector<CookJob>& jobs, const std::vector<CookResult>& results, Manifest& manifest, const CookOptions& options)
+        {
+            std::map<std::string, MaterialEntry> materials;
+            std::vector<MaterialMap> maps[MaterialSlotCount];
+            for (size_t i = 0; i < jobs.size(); i++)
+            {
+                const int slot = GetMaterialSlot(jobs[i].Usage);
+                const ManifestEntry* cooked = manifest.find(jobs[i].Source);
+                if (slot < 0 || results[i] == CookResultFailed || !cooked)
+                    continue;
+
+                MaterialMap map;
+                map.Directory = jobs[i].Source.substr(0, jobs[i].Source.find_last_of("/\\"));
+                map.Cooked = cooked->Cooked;
+                map.Hash = cooked->Hash;
+                map.SkipLevels = 0;
+                auto it = materials.find(map.Directory);
+                if (it == materials.end())
+                {
+                    MaterialEntry material;
+                    material.Directory = map.Directory;
+                    std::fill(material.Layers, material.Layers + MaterialSlotCount, -1);
+                    it = materials.emplace(map.Directory, material).first;
+                }
+                if (it->second.Layers[slot] >= 0)
+                {
+                    fprintf(stderr, "Warning : %s has several %s maps, %s is left out\n", map.Directory.c_str(), GetMaterialSlotName(MaterialSlot(slot)), jobs[i].Source.c_str());
+                    continue;
+                }
+                it->second.Layers[slot] = 0;
+                maps[slot].push_back(map);
+            }
+
+            for (int slot = 0; slot < MaterialSlotCount; slot++)
+            {
+                auto& slotMaps = maps[slot];
+                std::sort(slotMaps.begin(), slotMaps.end(), [](const MaterialMap& a, const MaterialMap& b) { return a.Directory < b.Directory; });
+                const bool bCooked = CookMaterialArray(MaterialSlot(slot), slotMaps, manifest, options) > 0;
+
+                int32_t layer = 0;
+                for (auto& map : slotMaps)
+                    materials[map.Directory].Layers[slot] = !bCooked || map.File.empty() ? -1 : layer++;
+            }
+
+            std::vector<MaterialEntry> entries;
+            for (auto& it : materials)
+                entries.push_back(it.second);
+            if (!SaveMaterials(options.MaterialFile, entries))
+                fprintf(stderr, "Error : failed to write %s\n", options.MaterialFile.c_str());
+        }
+    }
+
+    TextureUsage GuessTextureUsage(const std::string& fileName)
+    {
+        std::string name = fileName.substr(fileName.find_last_of("/\\") + 1);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (Contains(name, "albedo") || Contains(name, "basecolor") || Contains(name, "diffuse"))
+            return TextureUsageAlbedo;
+        if (Contains(name, "normal"))
+            return TextureUsageNormal;
+        if (name.compare(0, 4, "orm.") == 0 || Contains(name, "_orm."))
+            return TextureUsageOrm;
+        if (Contains(name, "rough"))
+            return TextureUsageRoughness;
+        if (Contains(name, "metal"))
+            return TextureUsageMetalness;
+        if (Contains(name, "ao") || Contains(name, "occlusion"))
+            return TextureUsageOcclusion;
+        return TextureUsageColor;
+    }
+
+    const char* GetTextureUsageName(TextureUsage usage)
+    {
+        switch (usage)
+        {
+        case TextureUsageAlbedo: return "albedo";
+        case TextureUsageNormal: return "normal";
+        case TextureUsageRoughness: return "roughness";
+        case TextureUsageMetalness: return "metalness";
+        case TextureUsageOcclusion: return "ao";
+        case TextureUsageOrm: return "orm";
+        default: return "color";
+        }
+    }
+
+    gli::format GetTextureUsageFormat(TextureUsage usage, EncodePreset preset)
+    {
+        const bool bCompressed = preset != EncodePresetUncompressed;
+        switch (usage)
+        {
+        case TextureUsageRoughness:
+        case TextureUsageMetalness:
+        case TextureUsageOcclusion:
+            return bCompressed ? gli::FORMAT_R_ATI1N_UNORM_BLOCK8 : gli::FORMAT_R8_UNORM_PACK8;
+        case TextureUsageNormal:
+            // the shaders rebuild z from x and y
+            return bCompressed ? gli::FORMAT_RG_ATI2N_UNORM_BLOCK16 : gli::FORMAT_RGBA8_UNORM_PACK8;
+        case TextureUsageOrm:
+            // the channels are unrelated, too much for the 4 colors of BC1;
+            // the fast preset targets the devices without BPTC, left as is
+            if (!bCompressed || preset != EncodePresetQuality)
+                return gli::FORMAT_RGBA8_UNORM_PACK8;
+            return gli::FORMAT_RGBA_BP_UNORM_BLOCK16;
+        default:
+            // the shaders linearize the albedo themselves
+            if (!bCompressed)
+                return gli::FORMAT_RGBA8_UNORM_PACK8;
+            return preset == EncodePresetQuality ? gli::FORMAT_RGBA_BP_UNORM_BLOCK16 : gli::FORMAT_RGBA_DXT1_UNORM_BLOCK8;
+        }
+    }
+
+    bool DecodeImage(const uint8_t* data, size_t size, SourceImage& image)
+    {
+        if (TiffReader(data, size).decode(image))
+            return true;
+
+        int width = 0, height = 0, channels = 0;
+        stbi_uc* texels = stbi_load_from_memory(data, int(size), &width, &height, &channels, 0);
+        if (!texels)
+            return false;
+        image.Width = uint32_t(width);
+        image.Height = uint32_t(height);
+        image.Channels = uint32_t(channels);
+        image.Texels.assign(texels, texels + size_t(width) * height * channels);
+        stbi_image_free(texels);
+        return true;
+    }
+
+    gli::texture2d CookTexture(const SourceImage& image, TextureUsage usage, EncodePreset preset, uint32_t threadCount, double* encodeSeconds)
+    {
+        const gli::extent2d extent(image.Width, image.Height);
+        const gli::format format = GetTextureUsageFormat(usage, preset);
+        gli::texture2d texture(format, extent, gli::levels(extent));
+
+        BlockFormat blockFormat = BlockFormatBC1;
+        const bool bCompressed = GetBlockFormat(format, blockFormat);
+        std::chrono::steady_clock::duration encodeTime(0);
+
+        std::vector<glm::vec4> texels, coarser;
+        std::vector<uint8_t> rgba;
+        Linearize(image, usage, texels);
+        uint32_t width = image.Width, height = image.Height;
+        for (size_t level = 0; level < texture.levels(); level++)
+        {
+            if (level > 0)
+            {
+                coarser.resize(size_t(std::max(width >> 1, 1u)) * std::max(height >> 1, 1u));
+                Downsample(texels.data(), width, height, coarser.data());
+                texels.swap(coarser);
+                width = std::max(width >> 1, 1u);
+                height = std::max(height >> 1, 1u);
+            }
+            rgba.resize(texels.size() * 4);
+            Quantize(texels, usage, rgba.data());
+
+            uint8_t* dst = texture[level].data<uint8_t>();
+            if (bCompressed)
+            {
+                auto start = std::chrono::steady_clock::now();
+                EncodeBlocks(blockFormat, preset, rgba.data(), width, height, dst, threadCount);
+                encodeTime += std::chrono::steady_clock::now() - start;
+            }
+            else if (format == gli::FORMAT_R8_UNORM_PACK8)
+            {
+                for (size_t i = 0; i < texels.size(); i++)
+                    dst[i] = rgba[i * 4];
+            }
+            else
+                memcpy(dst, rgba.data(), rgba.size());
+        }
+        if (encodeSeconds)
+            *encodeSeconds += std::chrono::duration<double>(encodeTime).count();
+        return texture;
+    }
+
+    CookReport CookAssets(const std::vector<std::string>& sources, const CookOptions& options)
+    {
+        Manifest manifest;
+        manifest.load(options.ManifestFile);
+        MakeDirectory(options.OutputDirectory);
+
+        const std::vector<CookJob> jobs = MakeJobs(sources, options.bPackOrm);
+        const uint32_t hardwareThreads = options.ThreadCount ? options.ThreadCount : std::max(std::thread::hardware_concurrency(), 1u);
+        const uint32_t threadCount = std::max(std::min(hardwareThreads, uint32_t(jobs.size())), 1u);
+
+        // the threads left over by the jobs compress the blocks
+        const uint32_t encodeThreads = std::max(hardwareThreads / threadCount, 1u);
+
+        // the manifest is only read by the workers
+        std::vector<ManifestEntry> entries(jobs.size());
+        std::vector<CookResult> results(jobs.size(), CookResultFailed);
+        std::vector<CookStats> stats(jobs.size());
+        std::atomic<size_t> next(0);
+        auto worker = [&]() {
+            for (size_t i = next++; i < jobs.size(); i = next++)
+                results[i] = CookSource(jobs[i], manifest, options, encodeThreads, entries[i], stats[i]);
+        };
+
+        std::vector<std::thread> threads;
+        for (uint32_t i = 1; i < threadCount; i++)
+            threads.emplace_back(worker);
+        worker();
+        for (auto& thread : threads)
+            thread.join();
+
+        CookReport report;
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            switch (results[i])
+            {
+            case CookResultCooked: report.Cooked++; break;
+            case CookResultUpToDate: report.UpToDate++; break;
+            default: report.Failed++; continue;
+            }
+            manifest.set(jobs[i].Source, entries[i]);
+            report.UncompressedBytes += stats[i].UncompressedBytes;
+            report.CookedBytes += stats[i].CookedBytes;
+            report.EncodedTexels += stats[i].EncodedTexels;
+            report.EncodeSeconds += stats[i].EncodeSeconds;
+        }
+        CookMaterials(jobs, results, manifest, options);
+        if (!manifest.save(options.ManifestFile))
+            fprintf(stderr, "Error : failed to write %s\n", options.ManifestFile.c_str());
+        return report;
+    }
+}
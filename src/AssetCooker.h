@@ -0,0 +1,84 @@
+#pragma once
+
+#include <AssetManifest.h>
+#include <BlockCompression.h>
+#include <GraphicsTypes.h>
+#include <string>
+#include <vector>
+
+// Offline conversion of the source images (TIFF, PNG, JPG...) to DDS files
+// the runtime maps and uploads as they are : the whole mip chain, bottom-up,
+// block compressed in the format of the usage of the texture.
+namespace asset
+{
+    // bumped whenever the cooked output of a same source changes
+    const uint32_t kCookerVersion = 3;
+
+    enum TextureUsage
+    {
+        TextureUsageColor,      // BC7 or BC1, gamma 2.2
+        TextureUsageAlbedo,     // BC7 or BC1, gamma 2.2
+        TextureUsageNormal,     // BC5, tangent space xy * 0.5 + 0.5, renormalized
+        TextureUsageRoughness,  // BC4
+        TextureUsageMetalness,  // BC4
+        TextureUsageOcclusion,  // BC4
+        TextureUsageOrm,        // BC7 (RGBA8 when fast), occlusion, roughness and metalness in r, g and b
+    };
+
+    // from the file name ("albedo", "basecolor", "normal", "ao", "orm"...)
+    TextureUsage GuessTextureUsage(const std::string& fileName);
+    const char* GetTextureUsageName(TextureUsage usage);
+
+    // RGBA8 or R8 when uncompressed
+    gli::format GetTextureUsageFormat(TextureUsage usage, EncodePreset preset);
+
+    // 8 bits per channel, 1 to 4 channels, rows top-down
+    struct SourceImage
+    {
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        uint32_t Channels = 0;
+        std::vector<uint8_t> Texels;
+    };
+
+    // TIFF (strips, uncompressed, LZW or deflate, horizontal predictor) or
+    // any format stb_image reads
+    bool DecodeImage(const uint8_t* data, size_t size, SourceImage& image);
+
+    // full mip chain, filtered in linear space for the gamma encoded usages;
+    // the time spent compressing the blocks is added to 'encodeSeconds'
+    gli::texture2d CookTexture(const SourceImage& image, TextureUsage usage, EncodePreset preset, uint32_t threadCount = 1, double* encodeSeconds = nullptr);
+
+    struct CookOptions
+    {
+        std::string OutputDirectory = kCookedDirectory;
+        std::string ManifestFile = kManifestFile;
+        std::string MaterialFile = kMaterialFile;
+        EncodePreset Preset = EncodePresetQuality;
+        uint32_t ThreadCount = 0;   // hardware concurrency when 0
+        bool bPackOrm = true;       // the ao, roughness and metalness maps of a directory in one texture
+        bool bForce = false;        // ignores the manifest
+        bool bVerbose = false;
+    };
+
+    struct CookReport
+    {
+        uint32_t Cooked = 0;
+        uint32_t UpToDate = 0;
+        uint32_t Failed = 0;
+
+        // of the textures cooked by this run
+        uint64_t UncompressedBytes = 0;
+        uint64_t CookedBytes = 0;
+        uint64_t EncodedTexels = 0;
+        double EncodeSeconds = 0.0;     // summed over the textures encoded side by side
+    };
+
+    // cooks the sources whose contents changed since the manifest was
+    // written, one source per worker thread, then rewrites the manifest; the
+    // packed maps are listed under "<directory>/orm". The albedo, normal and
+    // packed maps of the directories are then gathered in one texture array
+    // per slot, listed under "materials/<slot>", and their layers written
+    // to the material file.
+    CookReport CookAssets(const std::vector<std::string>& sources, const CookOptions& options);
+}
@@ -0,0 +1,134 @@
+#include <AssetManifest.h>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace asset
+{
+    bool Manifest::load(const std::string& fileName)
+    {
+        std::ifstream stream(fileName);
+        if (!stream)
+            return false;
+
+        m_Entries.clear();
+        std::string line, tag;
+        uint32_t version = 0;
+        if (!std::getline(stream, line) || !(std::istringstream(line) >> tag >> version) || tag != "manifest" || version != kManifestVersion)
+            return false;
+        while (std::getline(stream, line))
+        {
+            std::istringstream fields(line);
+            std::string hash, orientation, source;
+            ManifestEntry entry;
+            if (!(fields >> hash >> entry.Usage >> orientation >> entry.Cooked))
+                continue;
+            std::getline(fields >> std::ws, source);
+            if (source.empty())
+                continue;
+            entry.Hash = strtoull(hash.c_str(), nullptr, 16);
+            entry.bBottomUp = orientation == "bottom-up";
+            m_Entries[source] = entry;
+        }
+        return true;
+    }
+
+    bool Manifest::save(const std::string& fileName) const
+    {
+        FILE* file = fopen(fileName.c_str(), "w");
+        if (!file)
+            return false;
+        fprintf(file, "manifest %u\n", kManifestVersion);
+        for (auto& it : m_Entries)
+        {
+            const ManifestEntry& entry = it.second;
+            fprintf(file, "%016" PRIx64 " %s %s %s %s\n", entry.Hash, entry.Usage.c_str(),
+                entry.bBottomUp ? "bottom-up" : "top-down", entry.Cooked.c_str(), it.first.c_str());
+        }
+        return fclose(file) == 0;
+    }
+
+    const ManifestEntry* Manifest::find(const std::string& source) const
+    {
+        auto it = m_Entries.find(source);
+        return it != m_Entries.end() ? &it->second : nullptr;
+    }
+
+    void Manifest::set(const std::string& source, const ManifestEntry& entry)
+    {
+        m_Entries[source] = entry;
+    }
+
+    const char* GetMaterialSlotName(MaterialSlot slot)
+    {
+        switch (slot)
+        {
+        case MaterialSlotAlbedo: return "albedo";
+        case MaterialSlotNormal: return "normal";
+        default: return "orm";
+        }
+    }
+
+    std::string GetMaterialArraySource(MaterialSlot slot)
+    {
+        return std::string("materials/") + GetMaterialSlotName(slot);
+    }
+
+    bool LoadMaterials(const std::string& fileName, std::vector<MaterialEntry>& materials)
+    {
+        std::ifstream stream(fileName);
+        if (!stream)
+            return false;
+
+        materials.clear();
+        std::string line;
+        while (std::getline(stream, line))
+        {
+            std::istringstream fields(line);
+            MaterialEntry entry;
+            if (!(fields >> entry.Layers[MaterialSlotAlbedo] >> entry.Layers[MaterialSlotNormal] >> entry.Layers[MaterialSlotOrm]))
+                continue;
+            std::getline(fields >> std::ws, entry.Directory);
+            if (!entry.Directory.empty())
+                materials.push_back(entry);
+        }
+        return true;
+    }
+
+    bool SaveMaterials(const std::string& fileName, const std::vector<MaterialEntry>& materials)
+    {
+        FILE* file = fopen(fileName.c_str(), "w");
+        if (!file)
+            return false;
+        for (auto& entry : materials)
+        {
+            fprintf(file, "%d %d %d %s\n", entry.Layers[MaterialSlotAlbedo], entry.Layers[MaterialSlotNormal],
+                entry.Layers[MaterialSlotOrm], entry.Directory.c_str());
+        }
+        return fclose(file) == 0;
+    }
+
+    uint64_t HashBytes(const void* data, size_t size, uint64_t seed)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        uint64_t hash = seed;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    CookedFile ResolveCooked(const std::string& source)
+    {
+        static Manifest manifest;
+        static bool bLoaded = manifest.load(kManifestFile);
+
+        const ManifestEntry* entry = bLoaded ? manifest.find(source) : nullptr;
+        return entry ? CookedFile { entry->Cooked, entry->bBottomUp } : CookedFile { source, false };
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Index of the cooked assets written by the AssetCooker. A cooked file is
+// named after the hash of its source contents (and of the cooking settings),
+// so that an unchanged source is never cooked twice and identical sources
+// share one file. The build cooks into its own tree and defines
+// ASSET_COOKED_DIRECTORY, without it the files are next to the sources.
+#ifndef ASSET_COOKED_DIRECTORY
+#define ASSET_COOKED_DIRECTORY "resources/cooked"
+#endif
+
+namespace asset
+{
+    const char* const kCookedDirectory = ASSET_COOKED_DIRECTORY;
+    const char* const kManifestFile = ASSET_COOKED_DIRECTORY "/manifest.txt";
+    const char* const kMaterialFile = ASSET_COOKED_DIRECTORY "/materials.txt";
+    const uint32_t kManifestVersion = 2;
+
+    struct ManifestEntry
+    {
+        uint64_t Hash;
+        std::string Usage;
+        std::string Cooked;
+        bool bBottomUp;     // rows of the cooked file, see GraphicsTextureDesc::setBottomUp
+    };
+
+    // a "manifest <version>" line, then one "hash usage orientation cooked
+    // source" line per source, the source path last since it may contain
+    // spaces; a manifest of another version loads empty
+    class Manifest
+    {
+    public:
+        bool load(const std::string& fileName);
+        bool save(const std::string& fileName) const;
+
+        const ManifestEntry* find(const std::string& source) const;
+        void set(const std::string& source, const ManifestEntry& entry);
+
+        size_t size() const { return m_Entries.size(); }
+
+    private:
+        std::map<std::string, ManifestEntry> m_Entries;
+    };
+
+    // the maps of a material, each slot cooked into one texture array
+    enum MaterialSlot
+    {
+        MaterialSlotAlbedo,
+        MaterialSlotNormal,
+        MaterialSlotOrm,
+        MaterialSlotCount
+    };
+
+    // a directory of maps, a layer in the array of each slot or -1 when the
+    // directory has no map for the slot
+    struct MaterialEntry
+    {
+        std::string Directory;
+        int32_t Layers[MaterialSlotCount];
+    };
+
+    const char* GetMaterialSlotName(MaterialSlot slot);
+
+    // the manifest source of the array of 'slot' : "materials/<slot>"
+    std::string GetMaterialArraySource(MaterialSlot slot);
+
+    // one "albedo normal orm directory" line per material
+    bool LoadMaterials(const std::string& fileName, std::vector<MaterialEntry>& materials);
+    bool SaveMaterials(const std::string& fileName, const std::vector<MaterialEntry>& materials);
+
+    // FNV-1a 64, chained through 'seed'
+    uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+
+    struct CookedFile
+    {
+        std::string Filename;
+        bool bBottomUp;
+    };
+
+    // The cooked file of 'source' from the manifest (read once), the source
+    // itself when it was never cooked
+    CookedFile ResolveCooked(const std::string& source);
+}
@@ -1,7 +1,11 @@
 #include "BaseMaterial.h"
-#include <tools/gltools.hpp>
+#include <algorithm>
 
-void BaseMaterial::destroy()
+BaseMaterial::BaseMaterial()
+	: m_BaseColor(1.f)
+	, m_Occlusion(1.f)
+	, m_Roughness(1.f)
+	, m_Metalness(1.f)
 {
+	std::fill(m_Layers, m_Layers + asset::MaterialSlotCount, -1);
 }
-
@@ -1,19 +1,30 @@
 #pragma once
-#include <Types.h>
 
+#include <AssetManifest.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+
+typedef std::shared_ptr<class BaseMaterial> BaseMaterialPtr;
+
+// The maps of a material are layers of the texture arrays cooked by the
+// AssetCooker, one array per slot (see MaterialLibrary). The factors scale
+// what the maps hold, or stand for a missing map.
 class BaseMaterial
 {
 public:
-	BaseMaterial()
-	{
-	}
+	BaseMaterial();
 
 	virtual ~BaseMaterial()
 	{
-		destroy();
 	}
 
-	void initialize();
-	void destroy();
-};
+	bool hasMap(asset::MaterialSlot slot) const { return m_Layers[slot] >= 0; }
 
+	std::string m_Name;
+	int32_t m_Layers[asset::MaterialSlotCount];	// -1 without a map
+	glm::vec4 m_BaseColor;	// gamma encoded like the albedo maps
+	float m_Occlusion;
+	float m_Roughness;
+	float m_Metalness;
+};
@@ -0,0 +1,912 @@
+#include <BlockCompression.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define COMPRESSION_USE_SSE 1
+#   include <emmintrin.h>
+#else
+#   define COMPRESSION_USE_SSE 0
+#endif
+
+namespace asset
+{
+    namespace
+    {
+        // one array per channel, 0 to 255
+        struct BlockTexels
+        {
+            alignas(16) float R[16];
+            alignas(16) float G[16];
+            alignas(16) float B[16];
+            alignas(16) float A[16];
+
+            glm::vec4 texel(int t) const { return glm::vec4(R[t], G[t], B[t], A[t]); }
+        };
+
+        void LoadBlock(const uint8_t* texels, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t rgba[16][4])
+        {
+            for (uint32_t y = 0; y < 4; y++)
+            {
+                const size_t row = std::min(by * 4 + y, height - 1);
+                for (uint32_t x = 0; x < 4; x++)
+                {
+                    const size_t column = std::min(bx * 4 + x, width - 1);
+                    memcpy(rgba[y * 4 + x], texels + (row * width + column) * 4, 4);
+                }
+            }
+        }
+
+        void MinMax(const uint8_t values[16], uint8_t& minimum, uint8_t& maximum)
+        {
+        #if COMPRESSION_USE_SSE
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+            __m128i lo = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+            __m128i hi = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+            lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+            hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+            lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 2));
+            hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 2));
+            lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 1));
+            hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 1));
+            minimum = uint8_t(_mm_cvtsi128_si32(lo));
+            maximum = uint8_t(_mm_cvtsi128_si32(hi));
+        #else
+            minimum = maximum = values[0];
+            for (int t = 1; t < 16; t++)
+            {
+                minimum = std::min(minimum, values[t]);
+                maximum = std::max(maximum, values[t]);
+            }
+        #endif
+        }
+
+        // 8 values when r0 > r1, else 6 values and the 0 and 255 extremes
+        void MakeBC4Palette(int r0, int r1, uint8_t palette[8])
+        {
+            palette[0] = uint8_t(r0);
+            palette[1] = uint8_t(r1);
+            if (r0 > r1)
+            {
+                for (int i = 2; i < 8; i++)
+                    palette[i] = uint8_t(((8 - i) * r0 + (i - 1) * r1 + 3) / 7);
+            }
+            else
+            {
+                for (int i = 2; i < 6; i++)
+                    palette[i] = uint8_t(((6 - i) * r0 + (i - 1) * r1 + 2) / 5);
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+        }
+
+        // nearest palette entries of the 16 values, returns the squared error
+        uint32_t FitBC4(const uint8_t values[16], const uint8_t palette[8], uint8_t indices[16])
+        {
+        #if COMPRESSION_USE_SSE
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+            __m128i best = _mm_set1_epi8(char(0xFF));
+            __m128i bestIndex = _mm_setzero_si128();
+            for (int i = 0; i < 8; i++)
+            {
+                const __m128i p = _mm_set1_epi8(char(palette[i]));
+                const __m128i distance = _mm_or_si128(_mm_subs_epu8(v, p), _mm_subs_epu8(p, v));
+                // the first nearest entry is kept
+                const __m128i keep = _mm_cmpeq_epi8(_mm_min_epu8(distance, best), best);
+                bestIndex = _mm_or_si128(_mm_and_si128(keep, bestIndex), _mm_andnot_si128(keep, _mm_set1_epi8(char(i))));
+                best = _mm_min_epu8(distance, best);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(indices), bestIndex);
+
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i lo = _mm_unpacklo_epi8(best, zero);
+            const __m128i hi = _mm_unpackhi_epi8(best, zero);
+            __m128i sum = _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+            return uint32_t(_mm_cvtsi128_si32(sum));
+        #else
+            uint32_t error = 0;
+            for (int t = 0; t < 16; t++)
+            {
+                int best = 256;
+                for (int i = 0; i < 8; i++)
+                {
+                    const int distance = std::abs(int(values[t]) - int(palette[i]));
+                    if (distance < best)
+                    {
+                        best = distance;
+                        indices[t] = uint8_t(i);
+                    }
+                }
+                error += uint32_t(best * best);
+            }
+            return error;
+        #endif
+        }
+
+        void EncodeBC4(const uint8_t values[16], EncodePreset preset, uint8_t* block)
+        {
+            uint8_t minimum, maximum;
+            MinMax(values, minimum, maximum);
+
+            uint8_t palette[8], indices[16], bestIndices[16];
+            int best0 = maximum, best1 = minimum;
+            MakeBC4Palette(best0, best1, palette);
+            uint32_t bestError = FitBC4(values, palette, bestIndices);
+
+            if (preset == EncodePresetQuality && bestError > 0)
+            {
+                auto tryEndpoints = [&](int r0, int r1) {
+                    MakeBC4Palette(r0, r1, palette);
+                    const uint32_t error = FitBC4(values, palette, indices);
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        best0 = r0;
+                        best1 = r1;
+                        memcpy(bestIndices, indices, sizeof(indices));
+                    }
+                };
+
+                // the extremes pulled inwards let the interpolated values land closer
+                for (int d0 = 0; d0 <= 3; d0++)
+                for (int d1 = 0; d1 <= 3; d1++)
+                {
+                    if (maximum - d0 > minimum + d1)
+                        tryEndpoints(maximum - d0, minimum + d1);
+                }
+
+                // the 6 values mode spends its range on the values between 0 and 255
+                int lo = 255, hi = 0;
+                for (int t = 0; t < 16; t++)
+                {
+                    if (values[t] > 0 && values[t] < 255)
+                    {
+                        lo = std::min(lo, int(values[t]));
+                        hi = std::max(hi, int(values[t]));
+                    }
+                }
+                if (lo <= hi)
+                    tryEndpoints(lo, hi);
+            }
+
+            block[0] = uint8_t(best0);
+            block[1] = uint8_t(best1);
+            uint64_t bits = 0;
+            for (int t = 0; t < 16; t++)
+                bits |= uint64_t(bestIndices[t]) << (3 * t);
+            for (int i = 0; i < 6; i++)
+                block[2 + i] = uint8_t(bits >> (8 * i));
+        }
+
+        // nearest palette entries of the 16 texels, returns the weighted squared error
+        float FitPalette(const BlockTexels& block, const glm::vec4* palette, int count, const glm::vec4& weights, uint8_t indices[16])
+        {
+            float error = 0.f;
+        #if COMPRESSION_USE_SSE
+            const __m128 wr = _mm_set1_ps(weights.x);
+            const __m128 wg = _mm_set1_ps(weights.y);
+            const __m128 wb = _mm_set1_ps(weights.z);
+            const __m128 wa = _mm_set1_ps(weights.w);
+            for (int g = 0; g < 16; g += 4)
+            {
+                const __m128 r = _mm_load_ps(block.R + g);
+                const __m128 gr = _mm_load_ps(block.G + g);
+                const __m128 b = _mm_load_ps(block.B + g);
+                const __m128 a = _mm_load_ps(block.A + g);
+                __m128 best = _mm_set1_ps(FLT_MAX);
+                __m128i bestIndex = _mm_setzero_si128();
+                for (int i = 0; i < count; i++)
+                {
+                    const __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[i].x));
+                    const __m128 dg = _mm_sub_ps(gr, _mm_set1_ps(palette[i].y));
+                    const __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[i].z));
+                    const __m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[i].w));
+                    __m128 distance = _mm_mul_ps(_mm_mul_ps(dr, dr), wr);
+                    distance = _mm_add_ps(distance, _mm_mul_ps(_mm_mul_ps(dg, dg), wg));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(_mm_mul_ps(db, db), wb));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(_mm_mul_ps(da, da), wa));
+
+                    const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+                    bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32(i)));
+                    best = _mm_min_ps(distance, best);
+                }
+
+                alignas(16) int32_t lanes[4];
+                alignas(16) float errors[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(lanes), bestIndex);
+                _mm_store_ps(errors, best);
+                for (int k = 0; k < 4; k++)
+                {
+                    indices[g + k] = uint8_t(lanes[k]);
+                    error += errors[k];
+                }
+            }
+        #else
+            for (int t = 0; t < 16; t++)
+            {
+                const glm::vec4 texel = block.texel(t);
+                float best = FLT_MAX;
+                for (int i = 0; i < count; i++)
+                {
+                    const glm::vec4 d = texel - palette[i];
+                    const float distance = glm::dot(d * d, weights);
+                    if (distance < best)
+                    {
+                        best = distance;
+                        indices[t] = uint8_t(i);
+                    }
+                }
+                error += best;
+            }
+        #endif
+            return error;
+        }
+
+        // endpoints along the principal axis of the texels, from a few power iterations
+        void PrincipalEndpoints(const BlockTexels& block, glm::vec4& e0, glm::vec4& e1)
+        {
+            glm::vec4 mean(0.f), minimum(FLT_MAX), maximum(-FLT_MAX);
+            for (int t = 0; t < 16; t++)
+            {
+                const glm::vec4 texel = block.texel(t);
+                mean += texel;
+                minimum = glm::min(minimum, texel);
+                maximum = glm::max(maximum, texel);
+            }
+            mean /= 16.f;
+
+            glm::mat4 covariance(0.f);
+            for (int t = 0; t < 16; t++)
+            {
+                const glm::vec4 d = block.texel(t) - mean;
+                covariance += glm::outerProduct(d, d);
+            }
+
+            glm::vec4 axis = maximum - minimum;
+            for (int i = 0; i < 8; i++)
+            {
+                const glm::vec4 next = covariance * axis;
+                const float length = glm::length(next);
+                if (length < 1e-6f)
+                    break;
+                axis = next / length;
+            }
+            const float length = glm::length(axis);
+            if (length < 1e-6f)
+            {
+                e0 = e1 = mean;
+                return;
+            }
+            axis /= length;
+
+            float lo = FLT_MAX, hi = -FLT_MAX;
+            for (int t = 0; t < 16; t++)
+            {
+                const float projection = glm::dot(block.texel(t) - mean, axis);
+                lo = std::min(lo, projection);
+                hi = std::max(hi, projection);
+            }
+            e0 = mean + axis * lo;
+            e1 = mean + axis * hi;
+        }
+
+        // endpoints minimizing the squared error of the texels interpolated at
+        // the 'factors' of their indices, false when the indices are degenerate
+        bool RefineEndpoints(const BlockTexels& block, const uint8_t indices[16], const float* factors, glm::vec4& e0, glm::vec4& e1)
+        {
+            float aa = 0.f, bb = 0.f, ab = 0.f;
+            glm::vec4 ax(0.f), bx(0.f);
+            for (int t = 0; t < 16; t++)
+            {
+                const float b = factors[indices[t]];
+                const float a = 1.f - b;
+                const glm::vec4 x = block.texel(t);
+                aa += a * a;
+                bb += b * b;
+                ab += a * b;
+                ax += a * x;
+                bx += b * x;
+            }
+            const float det = aa * bb - ab * ab;
+            if (std::abs(det) < 1e-6f)
+                return false;
+            e0 = glm::clamp((ax * bb - bx * ab) / det, 0.f, 255.f);
+            e1 = glm::clamp((bx * aa - ax * ab) / det, 0.f, 255.f);
+            return true;
+        }
+
+        uint16_t To565(const glm::vec4& color)
+        {
+            const glm::vec4 c = glm::clamp(color, 0.f, 255.f);
+            const uint32_t r = uint32_t(c.x * 31.f / 255.f + 0.5f);
+            const uint32_t g = uint32_t(c.y * 63.f / 255.f + 0.5f);
+            const uint32_t b = uint32_t(c.z * 31.f / 255.f + 0.5f);
+            return uint16_t(r << 11 | g << 5 | b);
+        }
+
+        glm::vec4 From565(uint16_t color)
+        {
+            const uint32_t r = (color >> 11) & 31;
+            const uint32_t g = (color >> 5) & 63;
+            const uint32_t b = color & 31;
+            return glm::vec4((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 0.f);
+        }
+
+        struct BC1Candidate
+        {
+            uint16_t Color0;
+            uint16_t Color1;
+            uint8_t Indices[16];
+            float Error;
+        };
+
+        // interpolation factors of the indices, toward the second endpoint
+        const float kBC1Factors[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+
+        // the 4 colors mode, where the first endpoint is the larger
+        void FitBC1(const BlockTexels& block, const glm::vec4& e0, const glm::vec4& e1, BC1Candidate& candidate)
+        {
+            uint16_t c0 = To565(e0), c1 = To565(e1);
+            if (c0 < c1)
+                std::swap(c0, c1);
+            candidate.Color0 = c0;
+            candidate.Color1 = c1;
+
+            const glm::vec4 p0 = From565(c0), p1 = From565(c1);
+            const glm::vec4 palette[4] = { p0, p1, (2.f * p0 + p1) / 3.f, (p0 + 2.f * p1) / 3.f };
+            const int count = c0 == c1 ? 1 : 4;
+            candidate.Error = FitPalette(block, palette, count, glm::vec4(1.f, 1.f, 1.f, 0.f), candidate.Indices);
+        }
+
+        void EncodeBC1(const BlockTexels& block, EncodePreset preset, uint8_t* out)
+        {
+            glm::vec4 e0, e1;
+            if (preset == EncodePresetQuality)
+                PrincipalEndpoints(block, e0, e1);
+            else
+            {
+                // the bounding box diagonal following the sign of the covariances
+                glm::vec4 minimum(FLT_MAX), maximum(-FLT_MAX), mean(0.f);
+                for (int t = 0; t < 16; t++)
+                {
+                    minimum = glm::min(minimum, block.texel(t));
+                    maximum = glm::max(maximum, block.texel(t));
+                    mean += block.texel(t);
+                }
+                mean /= 16.f;
+                float covarianceRG = 0.f, covarianceRB = 0.f;
+                for (int t = 0; t < 16; t++)
+                {
+                    const glm::vec4 d = block.texel(t) - mean;
+                    covarianceRG += d.x * d.y;
+                    covarianceRB += d.x * d.z;
+                }
+                if (covarianceRG < 0.f)
+                    std::swap(minimum.y, maximum.y);
+                if (covarianceRB < 0.f)
+                    std::swap(minimum.z, maximum.z);
+
+                // inset, the extremes are rarely hit
+                const glm::vec4 inset = (maximum - minimum) / 16.f;
+                e0 = maximum - inset;
+                e1 = minimum + inset;
+            }
+
+            BC1Candidate best, candidate;
+            FitBC1(block, e0, e1, best);
+            if (preset == EncodePresetQuality)
+            {
+                for (int i = 0; i < 2 && best.Error > 0.f; i++)
+                {
+                    glm::vec4 r0, r1;
+                    if (!RefineEndpoints(block, best.Indices, kBC1Factors, r0, r1))
+                        break;
+                    FitBC1(block, r0, r1, candidate);
+                    if (candidate.Error >= best.Error)
+                        break;
+                    best = candidate;
+                }
+            }
+
+            out[0] = uint8_t(best.Color0);
+            out[1] = uint8_t(best.Color0 >> 8);
+            out[2] = uint8_t(best.Color1);
+            out[3] = uint8_t(best.Color1 >> 8);
+            uint32_t bits = 0;
+            for (int t = 0; t < 16; t++)
+                bits |= uint32_t(best.Indices[t]) << (2 * t);
+            for (int i = 0; i < 4; i++)
+                out[4 + i] = uint8_t(bits >> (8 * i));
+        }
+
+        const uint32_t kBC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        struct BC7Candidate
+        {
+            uint8_t Endpoints[2][4];    // 7 bits
+            uint8_t PBits[2];
+            uint8_t Indices[16];
+            float Error;
+        };
+
+        // 7 bits per channel and a shared lsb, the lsb giving the smaller error
+        void QuantizeBC7(const glm::vec4& endpoint, uint8_t quantized[4], uint8_t& pbit)
+        {
+            const glm::vec4 e = glm::clamp(endpoint, 0.f, 255.f);
+            float bestError = FLT_MAX;
+            for (int p = 0; p < 2; p++)
+            {
+                uint8_t q[4];
+                float error = 0.f;
+                for (int c = 0; c < 4; c++)
+                {
+                    const int value = glm::clamp(int((e[c] - p) * 0.5f + 0.5f), 0, 127);
+                    const float d = float(value * 2 + p) - e[c];
+                    error += d * d;
+                    q[c] = uint8_t(value);
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    memcpy(quantized, q, 4);
+                    pbit = uint8_t(p);
+                }
+            }
+        }
+
+        // mode 6 : one subset, RGBA 7.7.7.7 with a lsb per endpoint, 4 bits indices
+        void FitBC7(const BlockTexels& block, const glm::vec4& e0, const glm::vec4& e1, BC7Candidate& candidate)
+        {
+            QuantizeBC7(e0, candidate.Endpoints[0], candidate.PBits[0]);
+            QuantizeBC7(e1, candidate.Endpoints[1], candidate.PBits[1]);
+
+            uint32_t c0[4], c1[4];
+            for (int c = 0; c < 4; c++)
+            {
+                c0[c] = candidate.Endpoints[0][c] * 2u + candidate.PBits[0];
+                c1[c] = candidate.Endpoints[1][c] * 2u + candidate.PBits[1];
+            }
+
+            glm::vec4 palette[16];
+            for (int i = 0; i < 16; i++)
+            {
+                const uint32_t w = kBC7Weights[i];
+                for (int c = 0; c < 4; c++)
+                    palette[i][c] = float(((64 - w) * c0[c] + w * c1[c] + 32) >> 6);
+            }
+            candidate.Error = FitPalette(block, palette, 16, glm::vec4(1.f), candidate.Indices);
+        }
+
+        struct BitWriter
+        {
+            uint8_t* Data;
+            uint32_t Position;
+
+            void write(uint32_t value, uint32_t count)
+            {
+                for (uint32_t i = 0; i < count; i++, Position++)
+                {
+                    if ((value >> i) & 1)
+                        Data[Position >> 3] |= uint8_t(1 << (Position & 7));
+                }
+            }
+        };
+
+        const uint32_t kBC7Weights2[4] = { 0, 21, 43, 64 };
+        const uint32_t kBC7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+
+        struct BC7Mode5Candidate
+        {
+            uint8_t Rotation;
+            uint8_t Color[2][3];    // 7 bits
+            uint8_t Alpha[2];
+            uint8_t ColorIndices[16];
+            uint8_t AlphaIndices[16];
+            float Error;
+        };
+
+        void FitBC7Color(const BlockTexels& block, const glm::vec4& e0, const glm::vec4& e1, BC7Mode5Candidate& candidate)
+        {
+            uint32_t c0[3], c1[3];
+            for (int c = 0; c < 3; c++)
+            {
+                candidate.Color[0][c] = uint8_t(glm::clamp(int(e0[c] * 127.f / 255.f + 0.5f), 0, 127));
+                candidate.Color[1][c] = uint8_t(glm::clamp(int(e1[c] * 127.f / 255.f + 0.5f), 0, 127));
+                c0[c] = (candidate.Color[0][c] << 1) | (candidate.Color[0][c] >> 6);
+                c1[c] = (candidate.Color[1][c] << 1) | (candidate.Color[1][c] >> 6);
+            }
+
+            glm::vec4 palette[4];
+            for (int i = 0; i < 4; i++)
+            {
+                const uint32_t w = kBC7Weights2[i];
+                for (int c = 0; c < 3; c++)
+                    palette[i][c] = float(((64 - w) * c0[c] + w * c1[c] + 32) >> 6);
+                palette[i].w = 0.f;
+            }
+            candidate.Error = FitPalette(block, palette, 4, glm::vec4(1.f, 1.f, 1.f, 0.f), candidate.ColorIndices);
+        }
+
+        float FitBC7Alpha(const float values[16], int a0, int a1, uint8_t indices[16])
+        {
+            float palette[4];
+            for (int i = 0; i < 4; i++)
+                palette[i] = float(((64 - kBC7Weights2[i]) * a0 + kBC7Weights2[i] * a1 + 32) >> 6);
+
+            float error = 0.f;
+            for (int t = 0; t < 16; t++)
+            {
+                float best = FLT_MAX;
+                for (int i = 0; i < 4; i++)
+                {
+                    const float d = (values[t] - palette[i]) * (values[t] - palette[i]);
+                    if (d < best)
+                    {
+                        best = d;
+                        indices[t] = uint8_t(i);
+                    }
+                }
+                error += best;
+            }
+            return error;
+        }
+
+        // mode 5 : RGB 7.7.7 and a scalar 8 bits channel with their own 2 bits
+        // indices, the rotation swapping the scalar channel with r, g or b, for
+        // the blocks whose channels do not lie on one line
+        void FitBC7Mode5(const BlockTexels& block, uint32_t rotation, EncodePreset preset, BC7Mode5Candidate& candidate)
+        {
+            BlockTexels color = block;
+            float scalar[16];
+            float* channel = rotation == 1 ? color.R : rotation == 2 ? color.G : rotation == 3 ? color.B : color.A;
+            memcpy(scalar, channel, sizeof(scalar));
+            if (rotation > 0)
+                memcpy(channel, block.A, sizeof(scalar));
+            std::fill(color.A, color.A + 16, 0.f);
+
+            glm::vec4 e0, e1;
+            PrincipalEndpoints(color, e0, e1);
+            FitBC7Color(color, e0, e1, candidate);
+            if (preset == EncodePresetQuality && candidate.Error > 0.f)
+            {
+                float factors[4];
+                for (int i = 0; i < 4; i++)
+                    factors[i] = kBC7Weights2[i] / 64.f;
+
+                BC7Mode5Candidate refined = candidate;
+                if (RefineEndpoints(color, candidate.ColorIndices, factors, e0, e1))
+                {
+                    FitBC7Color(color, e0, e1, refined);
+                    if (refined.Error < candidate.Error)
+                        candidate = refined;
+                }
+            }
+
+            float minimum = scalar[0], maximum = scalar[0];
+            for (int t = 1; t < 16; t++)
+            {
+                minimum = std::min(minimum, scalar[t]);
+                maximum = std::max(maximum, scalar[t]);
+            }
+
+            // the extremes pulled inwards, as for BC4
+            uint8_t indices[16];
+            float bestAlpha = FLT_MAX;
+            const int range = preset == EncodePresetQuality ? 3 : 0;
+            for (int d0 = 0; d0 <= range; d0++)
+            for (int d1 = 0; d1 <= range; d1++)
+            {
+                const int a0 = int(minimum) + d0, a1 = int(maximum) - d1;
+                if (a0 > a1)
+                    continue;
+                const float error = FitBC7Alpha(scalar, a0, a1, indices);
+                if (error < bestAlpha)
+                {
+                    bestAlpha = error;
+                    candidate.Alpha[0] = uint8_t(a0);
+                    candidate.Alpha[1] = uint8_t(a1);
+                    memcpy(candidate.AlphaIndices, indices, sizeof(indices));
+                }
+            }
+            candidate.Rotation = uint8_t(rotation);
+            candidate.Error += bestAlpha;
+        }
+
+        void WriteBC7Mode5(BC7Mode5Candidate& best, uint8_t* out)
+        {
+            // the msb of the first index of each set is implied zero
+            if (best.ColorIndices[0] >= 2)
+            {
+                for (int c = 0; c < 3; c++)
+                    std::swap(best.Color[0][c], best.Color[1][c]);
+                for (int t = 0; t < 16; t++)
+                    best.ColorIndices[t] = uint8_t(3 - best.ColorIndices[t]);
+            }
+            if (best.AlphaIndices[0] >= 2)
+            {
+                std::swap(best.Alpha[0], best.Alpha[1]);
+                for (int t = 0; t < 16; t++)
+                    best.AlphaIndices[t] = uint8_t(3 - best.AlphaIndices[t]);
+            }
+
+            memset(out, 0, 16);
+            BitWriter writer = { out, 0 };
+            writer.write(1 << 5, 6);
+            writer.write(best.Rotation, 2);
+            for (int c = 0; c < 3; c++)
+            {
+                writer.write(best.Color[0][c], 7);
+                writer.write(best.Color[1][c], 7);
+            }
+            writer.write(best.Alpha[0], 8);
+            writer.write(best.Alpha[1], 8);
+            for (int t = 0; t < 16; t++)
+                writer.write(best.ColorIndices[t], t == 0 ? 1 : 2);
+            for (int t = 0; t < 16; t++)
+                writer.write(best.AlphaIndices[t], t == 0 ? 1 : 2);
+        }
+
+        void EncodeBC7(const BlockTexels& block, EncodePreset preset, uint8_t* out)
+        {
+            float factors[16];
+            for (int i = 0; i < 16; i++)
+                factors[i] = kBC7Weights[i] / 64.f;
+
+            glm::vec4 e0, e1;
+            PrincipalEndpoints(block, e0, e1);
+
+            BC7Candidate best, candidate;
+            FitBC7(block, e0, e1, best);
+            if (preset == EncodePresetQuality)
+            {
+                for (int i = 0; i < 2 && best.Error > 0.f; i++)
+                {
+                    if (!RefineEndpoints(block, best.Indices, factors, e0, e1))
+                        break;
+                    FitBC7(block, e0, e1, candidate);
+                    if (candidate.Error >= best.Error)
+                        break;
+                    best = candidate;
+                }
+
+                // the 4 rotations of mode 5 for the blocks mode 6 fits poorly
+                BC7Mode5Candidate best5, candidate5;
+                best5.Error = FLT_MAX;
+                for (uint32_t rotation = 0; rotation < 4 && best.Error > 0.f; rotation++)
+                {
+                    FitBC7Mode5(block, rotation, preset, candidate5);
+                    if (candidate5.Error < best5.Error)
+                        best5 = candidate5;
+                }
+                if (best5.Error < best.Error)
+                {
+                    WriteBC7Mode5(best5, out);
+                    return;
+                }
+            }
+
+            // the msb of the first index is implied zero
+            if (best.Indices[0] >= 8)
+            {
+                std::swap(best.PBits[0], best.PBits[1]);
+                for (int c = 0; c < 4; c++)
+                    std::swap(best.Endpoints[0][c], best.Endpoints[1][c]);
+                for (int t = 0; t < 16; t++)
+                    best.Indices[t] = uint8_t(15 - best.Indices[t]);
+            }
+
+            memset(out, 0, 16);
+            BitWriter writer = { out, 0 };
+            writer.write(1 << 6, 7);
+            for (int c = 0; c < 4; c++)
+            {
+                writer.write(best.Endpoints[0][c], 7);
+                writer.write(best.Endpoints[1][c], 7);
+            }
+            writer.write(best.PBits[0], 1);
+            writer.write(best.PBits[1], 1);
+            for (int t = 0; t < 16; t++)
+                writer.write(best.Indices[t], t == 0 ? 3 : 4);
+        }
+
+        struct BitReader
+        {
+            const uint8_t* Data;
+            uint32_t Position;
+
+            uint32_t read(uint32_t count)
+            {
+                uint32_t value = 0;
+                for (uint32_t i = 0; i < count; i++, Position++)
+                    value |= uint32_t((Data[Position >> 3] >> (Position & 7)) & 1) << i;
+                return value;
+            }
+        };
+
+        // bits replicated down to 8 bits
+        uint32_t UnquantizeBC7(uint32_t value, uint32_t bits)
+        {
+            value <<= 8 - bits;
+            return value | (value >> bits);
+        }
+
+        uint32_t InterpolateBC7(uint32_t e0, uint32_t e1, uint32_t weight)
+        {
+            return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+        }
+
+        bool DecodeBC7Block(const uint8_t* in, uint8_t rgba[16][4])
+        {
+            memset(rgba, 0, 16 * 4);
+            uint32_t mode = 0;
+            while (mode < 8 && !((in[0] >> mode) & 1))
+                mode++;
+            if (mode < 4 || mode > 6)
+                return false;
+
+            BitReader reader = { in, mode + 1 };
+            const uint32_t rotation = mode != 6 ? reader.read(2) : 0;
+            const uint32_t indexMode = mode == 4 ? reader.read(1) : 0;
+
+            // mode 4 : RGB 5 bits, A 6 bits; mode 5 : RGB 7 bits, A 8 bits;
+            // mode 6 : RGBA 7 bits and a lsb per endpoint
+            const uint32_t colorBits = mode == 4 ? 5 : 7;
+            const uint32_t alphaBits = mode == 4 ? 6 : mode == 5 ? 8 : 7;
+            uint32_t endpoints[2][4];
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                for (uint32_t e = 0; e < 2; e++)
+                    endpoints[e][c] = reader.read(c < 3 ? colorBits : alphaBits);
+            }
+            if (mode == 6)
+            {
+                for (uint32_t e = 0; e < 2; e++)
+                {
+                    const uint32_t pbit = reader.read(1);
+                    for (uint32_t c = 0; c < 4; c++)
+                        endpoints[e][c] = endpoints[e][c] << 1 | pbit;
+                }
+            }
+            else
+            {
+                for (uint32_t e = 0; e < 2; e++)
+                {
+                    for (uint32_t c = 0; c < 4; c++)
+                        endpoints[e][c] = UnquantizeBC7(endpoints[e][c], c < 3 ? colorBits : alphaBits);
+                }
+            }
+
+            // the first index of each set has its msb implied zero; mode 4
+            // reads 2 then 3 bits indices, the index mode tells which are color
+            const uint32_t bits0 = mode == 6 ? 4 : 2;
+            const uint32_t bits1 = mode == 4 ? 3 : 2;
+            uint32_t indices[2][16] = {};
+            for (uint32_t t = 0; t < 16; t++)
+                indices[0][t] = reader.read(t == 0 ? bits0 - 1 : bits0);
+            if (mode != 6)
+            {
+                for (uint32_t t = 0; t < 16; t++)
+                    indices[1][t] = reader.read(t == 0 ? bits1 - 1 : bits1);
+            }
+
+            const uint32_t* colorIndices = indices[indexMode];
+            const uint32_t* alphaIndices = mode == 6 ? indices[0] : indices[1 - indexMode];
+            const uint32_t colorIndexBits = indexMode ? bits1 : bits0;
+            const uint32_t alphaIndexBits = mode == 6 ? bits0 : indexMode ? bits0 : bits1;
+            auto weight = [](uint32_t index, uint32_t bits) {
+                return bits == 4 ? kBC7Weights[index] : bits == 3 ? kBC7Weights3[index] : kBC7Weights2[index];
+            };
+            for (uint32_t t = 0; t < 16; t++)
+            {
+                const uint32_t wc = weight(colorIndices[t], colorIndexBits);
+                const uint32_t wa = weight(alphaIndices[t], alphaIndexBits);
+                for (uint32_t c = 0; c < 3; c++)
+                    rgba[t][c] = uint8_t(InterpolateBC7(endpoints[0][c], endpoints[1][c], wc));
+                rgba[t][3] = uint8_t(InterpolateBC7(endpoints[0][3], endpoints[1][3], wa));
+                if (rotation > 0)
+                    std::swap(rgba[t][3], rgba[t][rotation - 1]);
+            }
+            return true;
+        }
+
+        void EncodeBlock(BlockFormat format, EncodePreset preset, const uint8_t rgba[16][4], uint8_t* out)
+        {
+            uint8_t values[16];
+            switch (format)
+            {
+            case BlockFormatBC4:
+                for (int t = 0; t < 16; t++)
+                    values[t] = rgba[t][0];
+                EncodeBC4(values, preset, out);
+                break;
+            case BlockFormatBC5:
+                for (int t = 0; t < 16; t++)
+                    values[t] = rgba[t][0];
+                EncodeBC4(values, preset, out);
+                for (int t = 0; t < 16; t++)
+                    values[t] = rgba[t][1];
+                EncodeBC4(values, preset, out + 8);
+                break;
+            case BlockFormatBC1:
+            case BlockFormatBC7:
+            {
+                BlockTexels block;
+                for (int t = 0; t < 16; t++)
+                {
+                    block.R[t] = rgba[t][0];
+                    block.G[t] = rgba[t][1];
+                    block.B[t] = rgba[t][2];
+                    block.A[t] = format == BlockFormatBC1 ? 0.f : rgba[t][3];
+                }
+                if (format == BlockFormatBC1)
+                    EncodeBC1(block, preset, out);
+                else
+                    EncodeBC7(block, preset, out);
+                break;
+            }
+            }
+        }
+    }
+
+    size_t GetBlockSize(BlockFormat format)
+    {
+        return format == BlockFormatBC1 || format == BlockFormatBC4 ? 8 : 16;
+    }
+
+    void EncodeBlocks(BlockFormat format, EncodePreset preset, const uint8_t* texels, uint32_t width, uint32_t height, uint8_t* blocks, uint32_t threadCount)
+    {
+        const uint32_t blocksX = (width + 3) / 4;
+        const uint32_t blocksY = (height + 3) / 4;
+        const size_t blockSize = GetBlockSize(format);
+
+        std::atomic<uint32_t> next(0);
+        auto worker = [&]() {
+            uint8_t rgba[16][4];
+            for (uint32_t by = next++; by < blocksY; by = next++)
+            {
+                for (uint32_t bx = 0; bx < blocksX; bx++)
+                {
+                    LoadBlock(texels, width, height, bx, by, rgba);
+                    EncodeBlock(format, preset, rgba, blocks + (size_t(by) * blocksX + bx) * blockSize);
+                }
+            }
+        };
+
+        threadCount = std::max(std::min(threadCount, blocksY), 1u);
+        std::vector<std::thread> threads;
+        for (uint32_t i = 1; i < threadCount; i++)
+            threads.emplace_back(worker);
+        worker();
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    bool DecodeBC7(const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* texels)
+    {
+        const uint32_t blocksX = (width + 3) / 4;
+        const uint32_t blocksY = (height + 3) / 4;
+        bool bDecoded = true;
+        uint8_t rgba[16][4];
+        for (uint32_t by = 0; by < blocksY; by++)
+        {
+            for (uint32_t bx = 0; bx < blocksX; bx++)
+            {
+                bDecoded &= DecodeBC7Block(blocks + (size_t(by) * blocksX + bx) * 16, rgba);
+                for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+                {
+                    for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+                        memcpy(texels + ((size_t(by) * 4 + y) * width + bx * 4 + x) * 4, rgba[y * 4 + x], 4);
+                }
+            }
+        }
+        return bDecoded;
+    }
+}
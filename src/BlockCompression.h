@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// CPU block compression of the cooked textures, no GPU involved. The block
+// searches run on 16 texels at once with SSE2 when available.
+namespace asset
+{
+    enum BlockFormat
+    {
+        BlockFormatBC1,     // RGB, 4 bits per texel
+        BlockFormatBC4,     // R, 4 bits per texel
+        BlockFormatBC5,     // RG, 8 bits per texel
+        BlockFormatBC7,     // RGBA (modes 5 and 6), 8 bits per texel
+    };
+
+    enum EncodePreset
+    {
+        EncodePresetUncompressed,
+        EncodePresetFast,       // bounding box endpoints, BC1 for colors
+        EncodePresetQuality,    // principal axis and least squares refined endpoints, BC7 for colors
+    };
+
+    size_t GetBlockSize(BlockFormat format);
+
+    // 'texels' are RGBA8 rows whatever the format, the partial blocks of the
+    // edges repeat the last row and column; the rows of blocks are shared by
+    // 'threadCount' threads
+    void EncodeBlocks(BlockFormat format, EncodePreset preset, const uint8_t* texels, uint32_t width, uint32_t height, uint8_t* blocks, uint32_t threadCount = 1);
+
+    // RGBA8 rows of BC7 'blocks', for the devices without BPTC. Only the modes
+    // without partitions (4 to 6, the encoder writes 5 and 6) are decoded,
+    // the other blocks are zero as invalid ones; returns false if any is met
+    bool DecodeBC7(const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* texels);
+}
@@ -0,0 +1,118 @@
+#include <BvhBenchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+namespace bvh
+{
+    namespace
+    {
+        typedef std::chrono::high_resolution_clock Clock;
+        typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+        // rays are handed out by blocks, the cost per ray varies a lot
+        const uint32_t kRayBlock = 1024;
+
+        template <typename Function>
+        double TraceAll(uint32_t rayCount, uint32_t threadCount, const Function& trace)
+        {
+            std::atomic<uint32_t> next(0);
+            auto worker = [&]()
+            {
+                for (;;)
+                {
+                    uint32_t first = next.fetch_add(kRayBlock);
+                    if (first >= rayCount)
+                        break;
+                    for (uint32_t i = first; i < std::min(first + kRayBlock, rayCount); i++)
+                        trace(i);
+                }
+            };
+
+            auto start = Clock::now();
+            std::vector<std::thread> threads;
+            for (uint32_t i = 1; i < threadCount; i++)
+                threads.emplace_back(worker);
+            worker();
+            for (auto& thread : threads)
+                thread.join();
+            return Milliseconds(Clock::now() - start).count();
+        }
+    }
+
+    void GeneratePrimaryRays(const glm::mat4& invViewProj, const glm::vec3& eye, uint32_t width, uint32_t height, std::vector<Math::Ray>& rays)
+    {
+        rays.resize(width * height);
+        for (uint32_t y = 0; y < height; y++)
+        for (uint32_t x = 0; x < width; x++)
+        {
+            glm::vec2 ndc = (glm::vec2(x, y) + 0.5f) / glm::vec2(width, height) * 2.f - 1.f;
+            glm::vec4 target = invViewProj * glm::vec4(ndc, 1.f, 1.f);
+            glm::vec3 dir = glm::normalize(glm::vec3(target) / target.w - eye);
+            rays[y * width + x] = Math::Ray { eye, dir, 1e30f };
+        }
+    }
+
+    BenchmarkReport Run(const std::vector<glm::vec3>& vertices, const std::vector<Math::Ray>& rays, const glm::vec3& lightPosition, uint32_t threadCount)
+    {
+        BenchmarkReport report = {};
+        report.ThreadCount = threadCount > 0 ? threadCount : std::max(std::thread::hardware_concurrency(), 1u);
+        report.TriangleCount = uint32_t(vertices.size() / 3);
+
+        Math::TriangleBvh tree;
+        auto start = Clock::now();
+        tree.build(vertices, 1);
+        report.BuildTimeSingle = Milliseconds(Clock::now() - start).count();
+
+        start = Clock::now();
+        tree.build(vertices, report.ThreadCount);
+        report.BuildTime = Milliseconds(Clock::now() - start).count();
+
+        report.NodeCount = uint32_t(tree.getNodes().size());
+        report.LeafCount = tree.getLeafCount();
+        report.Depth = tree.getDepth();
+
+        const uint32_t rayCount = uint32_t(rays.size());
+        if (rayCount == 0)
+            return report;
+
+        std::vector<Math::RayHit> hits(rayCount);
+        double time = TraceAll(rayCount, report.ThreadCount, [&](uint32_t i) { tree.intersect(rays[i], hits[i]); });
+        report.ClosestRate = rayCount / (time * 1e3);
+
+        // the shadow rays leave the surface a bit, relative to the hit distance
+        std::vector<Math::Ray> shadowRays;
+        for (uint32_t i = 0; i < rayCount; i++)
+        {
+            if (hits[i].Triangle == Math::TriangleBvh::InvalidTriangle)
+                continue;
+            glm::vec3 position = rays[i].Origin + rays[i].Direction * hits[i].T;
+            glm::vec3 toLight = lightPosition - position;
+            float distance = glm::length(toLight);
+            float bias = 1e-4f * (1.f + hits[i].T);
+            if (distance > bias * 2.f)
+                shadowRays.push_back(Math::Ray { position + toLight / distance * bias, toLight / distance, distance - bias * 2.f });
+        }
+        report.HitRatio = float(shadowRays.size()) / rayCount;
+
+        const uint32_t shadowCount = uint32_t(shadowRays.size());
+        if (shadowCount > 0)
+        {
+            time = TraceAll(shadowCount, report.ThreadCount, [&](uint32_t i) { tree.occluded(shadowRays[i]); });
+            report.ShadowRate = shadowCount / (time * 1e3);
+        }
+        return report;
+    }
+
+    void Print(const char* name, const BenchmarkReport& report)
+    {
+        printf("BVH %s : %u triangles, %u nodes, %u leaves, depth %u\n", name,
+            report.TriangleCount, report.NodeCount, report.LeafCount, report.Depth);
+        printf("  build %.2f ms (1 thread), %.2f ms (%u threads)\n",
+            report.BuildTimeSingle, report.BuildTime, report.ThreadCount);
+        printf("  primary %.2f Mrays/s (%.0f%% hits), shadow %.2f Mrays/s\n",
+            report.ClosestRate, report.HitRatio * 100.f, report.ShadowRate);
+    }
+}
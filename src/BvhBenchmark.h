@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Math/TriangleBvh.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+// Build and trace timings of Math::TriangleBvh, shared by the HUD and the
+// BvhBenchmark tool for the larger scenes. CPU only, no GL call.
+namespace bvh
+{
+    struct BenchmarkReport
+    {
+        uint32_t TriangleCount;
+        uint32_t NodeCount;
+        uint32_t LeafCount;
+        uint32_t Depth;
+        uint32_t ThreadCount;
+        double BuildTimeSingle;     // ms on one thread
+        double BuildTime;           // ms on every thread
+        double ClosestRate;         // Mrays/s, primary rays
+        double ShadowRate;          // Mrays/s, any hit toward the light
+        float HitRatio;             // primary rays hitting the scene
+    };
+
+    // one ray per pixel center of a width x height view
+    void GeneratePrimaryRays(const glm::mat4& invViewProj, const glm::vec3& eye, uint32_t width, uint32_t height, std::vector<Math::Ray>& rays);
+
+    // 'vertices' as for TriangleBvh::build(), the shadow rays start on the
+    // primary hits; 0 threads uses every core
+    BenchmarkReport Run(const std::vector<glm::vec3>& vertices, const std::vector<Math::Ray>& rays, const glm::vec3& lightPosition, uint32_t threadCount = 0);
+
+    void Print(const char* name, const BenchmarkReport& report);
+}
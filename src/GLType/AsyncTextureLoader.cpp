@@ -0,0 +1,292 @@
+#include <GLType/AsyncTextureLoader.h>
+#include <GLType/OGLCoreTexture.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // keeps every image at an offset valid for any pixel format
+    const GLsizeiptr kUploadAlignment = 256;
+}
+
+AsyncTextureLoader::AsyncTextureLoader() noexcept
+    : m_bQuit(false)
+    , m_Buffer(0)
+    , m_Mapped(nullptr)
+    , m_SectionSize(0)
+    , m_Section(0)
+    , m_PendingCount(0)
+    , m_UploadedBytes(0)
+{
+    std::fill(m_Fences, m_Fences + RingSize, nullptr);
+}
+
+AsyncTextureLoader::~AsyncTextureLoader() noexcept
+{
+    destroy();
+}
+
+bool AsyncTextureLoader::create(uint32_t threadCount, GLsizeiptr sectionSize) noexcept
+{
+    assert(m_Workers.empty());
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    m_SectionSize = sectionSize;
+    glCreateBuffers(1, &m_Buffer);
+    glNamedBufferStorage(m_Buffer, m_SectionSize * RingSize, nullptr, flags);
+    m_Mapped = static_cast<uint8_t*>(glMapNamedBufferRange(m_Buffer, 0, m_SectionSize * RingSize, flags));
+    if (!m_Mapped)
+    {
+        destroy();
+        return false;
+    }
+
+    if (threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    m_bQuit = false;
+    for (uint32_t i = 0; i < threadCount; i++)
+        m_Workers.emplace_back([this]() { runWorker(); });
+    return true;
+}
+
+void AsyncTextureLoader::destroy() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bQuit = true;
+        m_Requests.clear();
+    }
+    m_Condition.notify_all();
+    for (auto& worker : m_Workers)
+        worker.join();
+    m_Workers.clear();
+    m_Decoded.clear();
+    m_Uploads.clear();
+    m_Streamed.clear();
+    m_PendingCount = 0;
+
+    for (auto& fence : m_Fences)
+    {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (m_Buffer)
+    {
+        if (m_Mapped) glUnmapNamedBuffer(m_Buffer);
+        glDeleteBuffers(1, &m_Buffer);
+    }
+    m_Buffer = 0;
+    m_Mapped = nullptr;
+}
+
+void AsyncTextureLoader::load(const OGLCoreTexturePtr& texture, const std::string& filename) noexcept
+{
+    assert(texture);
+
+    auto job = std::make_shared<Job>();
+    job->Texture = texture;
+    job->FileName = filename;
+    job->NextImage = 0;
+    job->BaseLevel = 0;
+    job->CopyLevel = 0;
+    job->StreamID = InvalidStream;
+    m_PendingCount++;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Requests.push_back(std::move(job));
+    }
+    m_Condition.notify_one();
+}
+
+void AsyncTextureLoader::stream(const OGLCoreTexturePtr& texture, const TextureFile& file, size_t baseLevel, size_t copyLevel, uint32_t id) noexcept
+{
+    assert(texture && !file.empty());
+    assert(baseLevel <= copyLevel && baseLevel < file.Levels);
+
+    auto job = std::make_shared<Job>();
+    job->Texture = texture;
+    job->Image = file;
+    job->NextImage = 0;
+    job->BaseLevel = baseLevel;
+    job->CopyLevel = std::min(copyLevel, file.Levels);
+    job->StreamID = id;
+
+    // nothing to read when the storage only shrinks
+    if (job->CopyLevel == baseLevel)
+    {
+        m_Uploads.push_back(std::move(job));
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Requests.push_back(std::move(job));
+    }
+    m_Condition.notify_one();
+}
+
+void AsyncTextureLoader::getStreamed(std::vector<Streamed>& streamed) noexcept
+{
+    streamed.clear();
+    std::swap(streamed, m_Streamed);
+}
+
+void AsyncTextureLoader::runWorker() noexcept
+{
+    for (;;)
+    {
+        JobPtr job;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this]() { return m_bQuit || !m_Requests.empty(); });
+            if (m_bQuit)
+                return;
+            job = std::move(m_Requests.front());
+            m_Requests.pop_front();
+        }
+
+        // dropped handles are not worth decoding; the streamed levels are
+        // read from the mapping the streamer already holds
+        if (!job->Texture.expired())
+        {
+            if (job->Image.empty())
+            {
+                job->Image = OGLCoreTexture::decode(job->FileName);
+                job->CopyLevel = job->Image.Levels;
+            }
+            else
+                PrefetchTextureLevels(job->Image, job->BaseLevel, job->CopyLevel);
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Decoded.push_back(std::move(job));
+    }
+}
+
+uint32_t AsyncTextureLoader::flush() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Uploads.insert(m_Uploads.end(), m_Decoded.begin(), m_Decoded.end());
+        m_Decoded.clear();
+    }
+    if (m_Uploads.empty())
+        return 0;
+
+    // the section written three frames ago may still be read by the GPU
+    GLsync& fence = m_Fences[m_Section];
+    if (fence)
+    {
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            return 0;
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    uint32_t completed = 0;
+    GLsizeiptr used = 0;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_Buffer);
+    while (!m_Uploads.empty())
+    {
+        Job& job = *m_Uploads.front();
+        auto texture = job.Texture.lock();
+        if (texture && job.Image.empty())
+            fprintf(stderr, "Error : failed to load %s\n", job.FileName.c_str());
+
+        bool bSwapped = false;
+        if (texture && !job.Image.empty())
+        {
+            if (!upload(job, used))
+                break;
+
+            // an unsupported target keeps the placeholder
+            if (job.Staging->m_TextureID != 0)
+            {
+                texture->swap(*job.Staging);
+                completed++;
+                bSwapped = true;
+            }
+        }
+        if (job.StreamID != InvalidStream)
+            m_Streamed.push_back({ job.StreamID, bSwapped });
+        else
+            m_PendingCount--;
+        m_Uploads.pop_front();
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (used > 0)
+    {
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_Section = (m_Section + 1) % RingSize;
+    }
+    return completed;
+}
+
+bool AsyncTextureLoader::upload(Job& job, GLsizeiptr& used) noexcept
+{
+    const TextureFile& image = job.Image;
+    if (!job.Staging)
+    {
+        auto texture = job.Texture.lock();
+        job.Staging = std::make_shared<OGLCoreTexture>();
+        job.Staging->m_TextureDesc = texture->m_TextureDesc;
+        if (!job.Staging->createStorage(image, job.BaseLevel))
+            return true;
+        if (job.CopyLevel < image.Levels)
+            job.Staging->copyLevels(*texture, image, job.CopyLevel);
+    }
+
+    const size_t levels = image.Levels;
+    const size_t imageCount = image.count();
+    const GLsizeiptr base = m_Section * m_SectionSize;
+    for (; job.NextImage < imageCount; job.NextImage++)
+    {
+        const size_t level = job.NextImage % levels;
+        const size_t face = (job.NextImage / levels) % image.Faces;
+        const size_t layer = job.NextImage / (levels * image.Faces);
+        const GLsizeiptr size = static_cast<GLsizeiptr>(image.size(level));
+        if (level < job.BaseLevel || level >= job.CopyLevel)
+            continue;
+
+        // larger than a whole section, straight from the file memory unless
+        // it still has to be flipped
+        if (size > m_SectionSize)
+        {
+            std::vector<uint8_t> flipped;
+            const uint8_t* data = image.data(layer, face, level);
+            if (!image.bFlipped)
+            {
+                flipped.resize(size);
+                CopyTextureImage(image, layer, face, level, flipped.data());
+                data = flipped.data();
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            job.Staging->uploadImage(image, layer, face, level, data);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_Buffer);
+            m_UploadedBytes += size;
+            continue;
+        }
+
+        GLsizeiptr offset = (used + kUploadAlignment - 1) / kUploadAlignment * kUploadAlignment;
+        if (offset + size > m_SectionSize)
+            return false;
+
+        CopyTextureImage(image, layer, face, level, m_Mapped + base + offset);
+        job.Staging->uploadImage(image, layer, face, level, reinterpret_cast<const void*>(base + offset));
+        used = offset + size;
+        m_UploadedBytes += size;
+    }
+    return true;
+}
+
+uint32_t AsyncTextureLoader::getPendingCount() const noexcept
+{
+    return m_PendingCount;
+}
+
+uint64_t AsyncTextureLoader::getUploadedBytes() const noexcept
+{
+    return m_UploadedBytes;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <GraphicsTypes.h>
+#include <GLType/TextureFile.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Texture files are mapped (DDS, KTX) or decoded by a pool of worker threads;
+// the GL thread then copies the images into a persistently mapped ring of
+// pixel unpack buffers and uploads from there, a section of the ring per frame.
+// Each texture keeps its 1x1 placeholder until all its images are uploaded,
+// then the loaded storage is swapped in behind the same handle.
+class AsyncTextureLoader final
+{
+public:
+
+    static const uint32_t RingSize = 3;
+    static const uint32_t InvalidStream = 0xFFFFFFFF;
+
+    struct Streamed
+    {
+        uint32_t ID;
+        bool bSwapped;      // false when the storage could not be built
+    };
+
+    AsyncTextureLoader() noexcept;
+    ~AsyncTextureLoader() noexcept;
+
+    // 0 threads leaves a core to the GL thread
+    bool create(uint32_t threadCount, GLsizeiptr sectionSize) noexcept;
+    void destroy() noexcept;
+
+    // 'texture' already holds its placeholder and its description
+    void load(const OGLCoreTexturePtr& texture, const std::string& filename) noexcept;
+
+    // rebuilds the storage of 'texture' with the levels of a mapped 'file'
+    // from 'baseLevel' : the levels from 'copyLevel' are copied on the GPU
+    // from the current storage, the others uploaded. 'id' is reported by
+    // getStreamed() once the storage is swapped in or dropped
+    void stream(const OGLCoreTexturePtr& texture, const TextureFile& file, size_t baseLevel, size_t copyLevel, uint32_t id) noexcept;
+
+    // the stream requests completed since the last call
+    void getStreamed(std::vector<Streamed>& streamed) noexcept;
+
+    // uploads as much as the next section of the ring allows, never waits
+    // for the GPU; returns the number of textures swapped in
+    uint32_t flush() noexcept;
+
+    // requested by load() and not swapped in yet
+    uint32_t getPendingCount() const noexcept;
+
+    // total of the image bytes uploaded, for the bandwidth
+    uint64_t getUploadedBytes() const noexcept;
+
+private:
+
+    struct Job
+    {
+        std::weak_ptr<OGLCoreTexture> Texture;
+        std::string FileName;
+        TextureFile Image;
+        OGLCoreTexturePtr Staging;  // storage being filled
+        size_t NextImage;           // in layer, face, level order
+        size_t BaseLevel;           // first level of the storage
+        size_t CopyLevel;           // first level copied instead of uploaded
+        uint32_t StreamID;
+    };
+    typedef std::shared_ptr<Job> JobPtr;
+
+    void runWorker() noexcept;
+
+    // true when the job is complete
+    bool upload(Job& job, GLsizeiptr& used) noexcept;
+
+    std::vector<std::thread> m_Workers;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    std::deque<JobPtr> m_Requests;
+    std::vector<JobPtr> m_Decoded;
+    bool m_bQuit;
+
+    // GL thread
+    std::deque<JobPtr> m_Uploads;
+    std::vector<Streamed> m_Streamed;
+    GLuint m_Buffer;
+    uint8_t* m_Mapped;
+    GLsizeiptr m_SectionSize;
+    GLsync m_Fences[RingSize];
+    uint32_t m_Section;
+    uint32_t m_PendingCount;
+    uint64_t m_UploadedBytes;
+};
@@ -2,6 +2,9 @@
 
 #include <GraphicsTypes.h>
 
+class ResourceCache;
+class RenderTargetPool;
+
 class GraphicsDeviceDesc final
 {
 public:
@@ -17,6 +20,18 @@ private:
     GraphicsDeviceType m_DeviceType;
 };
 
+struct TextureStreamingStats
+{
+    uint32_t TextureCount;
+    uint32_t PendingCount;      // storages being rebuilt
+    uint64_t ResidentBytes;
+    uint64_t WantedBytes;       // resident if every request was met
+    uint64_t FullBytes;         // every level of every streamed texture
+    uint64_t BudgetBytes;
+    uint64_t EvictedLevels;     // since the start
+    float UploadRate;           // bytes per second, every texture upload
+};
+
 class GraphicsDevice : public rtti::Interface
 {
 	__DeclareSubInterface(GraphicsDevice, rtti::Interface)
@@ -26,11 +41,50 @@ public:
     virtual ~GraphicsDevice() noexcept;
 
 	virtual GraphicsDataPtr createGraphicsData(const GraphicsDataDesc& desc) noexcept = 0;
+    // the textures of a same file and description are shared while one of
+    // their users holds them, see getResourceCache()
     virtual GraphicsTexturePtr createTexture(const GraphicsTextureDesc& desc) noexcept = 0;
+
+    // equal descriptions share one sampler, the textures take theirs from
+    // here and bind it with them
+    virtual GraphicsSamplerPtr createSampler(const GraphicsSamplerDesc& desc) noexcept = 0;
+
+    // clamps the anisotropy of every sampler, present and future, 1 turns
+    // the anisotropic filtering off
+    virtual void setMaxAnisotropy(float level) noexcept = 0;
+    virtual float getMaxAnisotropy() const noexcept = 0;
+
+    // returns at once with a 1x1 'placeholder' (RGBA8, R in the low byte),
+    // in each of the 'depth' layers of a 2D array target;
+    // the file is decoded on a worker thread and swapped in by a later
+    // flushTextureUploads(). Loads synchronously where not supported.
+    virtual GraphicsTexturePtr createTextureAsync(const GraphicsTextureDesc& desc, uint32_t placeholder = 0xFF808080) noexcept = 0;
+
+    // DDS and KTX : the coarse levels are loaded first as with createTextureAsync(),
+    // the finer ones follow the requests within the budget. Loads every level
+    // where not supported.
+    virtual GraphicsTexturePtr createTextureStreamed(const GraphicsTextureDesc& desc, uint32_t placeholder = 0xFF808080) noexcept = 0;
+
+    // the smallest texture coordinates footprint of a pixel sampling 'texture'
+    // this frame; the finest level needed follows from the texture size
+    virtual void requestTextureDensity(const GraphicsTexturePtr& texture, float uvPerPixel) noexcept = 0;
+    virtual void setTextureBudget(uint64_t bytes) noexcept = 0;
+    virtual TextureStreamingStats getTextureStreamingStats() const noexcept = 0;
+
+    // once per frame on the GL thread, returns the number of textures swapped in
+    virtual uint32_t flushTextureUploads() noexcept = 0;
+    virtual uint32_t getPendingTextureCount() const noexcept = 0;
     virtual GraphicsFramebufferPtr createFramebuffer(const GraphicsFramebufferDesc& desc) noexcept = 0;
 
     virtual void setFramebuffer(const GraphicsFramebufferPtr& framebuffer) noexcept = 0;
 
+    // the shared textures, programs and meshes of the device
+    virtual ResourceCache& getResourceCache() noexcept = 0;
+
+    // the render targets of the passes, reused across resizes and aliased
+    // between the passes
+    virtual RenderTargetPool& getRenderTargetPool() noexcept = 0;
+
 	virtual const GraphicsDeviceDesc& getGraphicsDeviceDesc() const noexcept = 0;
 
 private:
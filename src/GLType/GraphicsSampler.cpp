@@ -0,0 +1,99 @@
+#include <GLType/GraphicsSampler.h>
+#include <GL/glew.h>
+#include <tuple>
+
+__ImplementSubInterface(GraphicsSampler, rtti::Interface)
+
+GraphicsSamplerDesc::GraphicsSamplerDesc() noexcept
+    : m_WrapS(GL_REPEAT)
+    , m_WrapT(GL_REPEAT)
+    , m_WrapR(GL_REPEAT)
+    , m_MinFilter(GL_NEAREST_MIPMAP_LINEAR)
+    , m_MagFilter(GL_LINEAR)
+    , m_AnisotropyLevel(0)
+{
+}
+
+GraphicsSamplerDesc::~GraphicsSamplerDesc() noexcept
+{
+}
+
+uint32_t GraphicsSamplerDesc::getWrapS() const noexcept
+{
+    return m_WrapS;
+}
+
+void GraphicsSamplerDesc::setWrapS(uint32_t wrap) noexcept
+{
+    m_WrapS = wrap;
+}
+
+uint32_t GraphicsSamplerDesc::getWrapT() const noexcept
+{
+    return m_WrapT;
+}
+
+void GraphicsSamplerDesc::setWrapT(uint32_t wrap) noexcept
+{
+    m_WrapT = wrap;
+}
+
+uint32_t GraphicsSamplerDesc::getWrapR() const noexcept
+{
+    return m_WrapR;
+}
+
+void GraphicsSamplerDesc::setWrapR(uint32_t wrap) noexcept
+{
+    m_WrapR = wrap;
+}
+
+uint32_t GraphicsSamplerDesc::getMinFilter() const noexcept
+{
+    return m_MinFilter;
+}
+
+void GraphicsSamplerDesc::setMinFilter(uint32_t filter) noexcept
+{
+    m_MinFilter = filter;
+}
+
+uint32_t GraphicsSamplerDesc::getMagFilter() const noexcept
+{
+    return m_MagFilter;
+}
+
+void GraphicsSamplerDesc::setMagFilter(uint32_t filter) noexcept
+{
+    m_MagFilter = filter;
+}
+
+float GraphicsSamplerDesc::getAnisotropyLevel() const noexcept
+{
+    return m_AnisotropyLevel;
+}
+
+void GraphicsSamplerDesc::setAnisotropyLevel(float anisoLevel) noexcept
+{
+    m_AnisotropyLevel = anisoLevel;
+}
+
+bool GraphicsSamplerDesc::operator<(const GraphicsSamplerDesc& other) const noexcept
+{
+    return std::tie(m_WrapS, m_WrapT, m_WrapR, m_MinFilter, m_MagFilter, m_AnisotropyLevel)
+        < std::tie(other.m_WrapS, other.m_WrapT, other.m_WrapR, other.m_MinFilter, other.m_MagFilter, other.m_AnisotropyLevel);
+}
+
+bool GraphicsSamplerDesc::operator==(const GraphicsSamplerDesc& other) const noexcept
+{
+    return std::tie(m_WrapS, m_WrapT, m_WrapR, m_MinFilter, m_MagFilter, m_AnisotropyLevel)
+        == std::tie(other.m_WrapS, other.m_WrapT, other.m_WrapR, other.m_MinFilter, other.m_MagFilter, other.m_AnisotropyLevel);
+}
+
+GraphicsSampler::GraphicsSampler() noexcept
+{
+}
+
+GraphicsSampler::~GraphicsSampler() noexcept
+{
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <GraphicsTypes.h>
+#include <tools/Rtti.h>
+
+class GraphicsSamplerDesc final
+{
+public:
+
+    GraphicsSamplerDesc() noexcept;
+    ~GraphicsSamplerDesc() noexcept;
+
+    uint32_t getWrapS() const noexcept;
+    void setWrapS(uint32_t wrap) noexcept;
+
+    uint32_t getWrapT() const noexcept;
+    void setWrapT(uint32_t wrap) noexcept;
+
+    uint32_t getWrapR() const noexcept;
+    void setWrapR(uint32_t wrap) noexcept;
+
+    uint32_t getMinFilter() const noexcept;
+    void setMinFilter(uint32_t filter) noexcept;
+
+    uint32_t getMagFilter() const noexcept;
+    void setMagFilter(uint32_t filter) noexcept;
+
+    // 0 or 1 for none
+    float getAnisotropyLevel() const noexcept;
+    void setAnisotropyLevel(float anisoLevel) noexcept;
+
+    // the key of the sampler cache of the device
+    bool operator<(const GraphicsSamplerDesc& other) const noexcept;
+    bool operator==(const GraphicsSamplerDesc& other) const noexcept;
+
+private:
+
+    uint32_t m_WrapS;
+    uint32_t m_WrapT;
+    uint32_t m_WrapR;
+    uint32_t m_MinFilter;
+    uint32_t m_MagFilter;
+    float m_AnisotropyLevel;
+};
+
+// the filtering and addressing of the texture units, shared by every
+// texture of a same description (see GraphicsDevice::createSampler)
+class GraphicsSampler : public rtti::Interface
+{
+    __DeclareSubInterface(GraphicsSampler, rtti::Interface)
+public:
+
+    GraphicsSampler() noexcept;
+    virtual ~GraphicsSampler() noexcept;
+
+    virtual const GraphicsSamplerDesc& getGraphicsSamplerDesc() const noexcept = 0;
+
+private:
+
+    GraphicsSampler(const GraphicsSampler&) = delete;
+    GraphicsSampler& operator=(const GraphicsSampler&) = delete;
+};
@@ -4,16 +4,11 @@
 __ImplementSubInterface(GraphicsTexture, rtti::Interface)
 
 GraphicsTextureDesc::GraphicsTextureDesc() noexcept
-    : m_Width(1)
+    : m_bBottomUp(false)
+    , m_Width(1)
     , m_Height(1)
     , m_Depth(1)
     , m_Levels(1)
-    , m_WrapS(GL_REPEAT)
-    , m_WrapT(GL_REPEAT)
-    , m_WrapR(GL_REPEAT)
-    , m_MinFilter(GL_NEAREST_MIPMAP_LINEAR)
-    , m_MagFilter(GL_LINEAR)
-    , m_AnisotropyLevel(0)
     , m_Target(gli::TARGET_2D)
     , m_Format(gli::FORMAT_UNDEFINED)
     , m_Data(nullptr)
@@ -45,6 +40,16 @@ void GraphicsTextureDesc::setFilename(const std::string& filename) noexcept
     m_Filename = filename;
 }
 
+bool GraphicsTextureDesc::isBottomUp() const noexcept
+{
+    return m_bBottomUp;
+}
+
+void GraphicsTextureDesc::setBottomUp(bool bBottomUp) noexcept
+{
+    m_bBottomUp = bBottomUp;
+}
+
 int32_t GraphicsTextureDesc::getWidth() const noexcept
 {
     return m_Width;
@@ -125,64 +130,74 @@ void GraphicsTextureDesc::setFormat(GraphicsFormat format) noexcept
     m_Format = format;
 }
 
+const GraphicsSamplerDesc& GraphicsTextureDesc::getSamplerDesc() const noexcept
+{
+    return m_SamplerDesc;
+}
+
+void GraphicsTextureDesc::setSamplerDesc(const GraphicsSamplerDesc& desc) noexcept
+{
+    m_SamplerDesc = desc;
+}
+
 uint32_t GraphicsTextureDesc::getWrapS() const noexcept
 {
-    return m_WrapS;
+    return m_SamplerDesc.getWrapS();
 }
 
 void GraphicsTextureDesc::setWrapS(uint32_t wrap) noexcept
 {
-    m_WrapS = wrap;
+    m_SamplerDesc.setWrapS(wrap);
 }
 
 uint32_t GraphicsTextureDesc::getWrapT() const noexcept
 {
-    return m_WrapT;
+    return m_SamplerDesc.getWrapT();
 }
 
 void GraphicsTextureDesc::setWrapT(uint32_t wrap) noexcept
 {
-    m_WrapT = wrap;
+    m_SamplerDesc.setWrapT(wrap);
 }
 
 uint32_t GraphicsTextureDesc::getWrapR() const noexcept
 {
-    return m_WrapT;
+    return m_SamplerDesc.getWrapR();
 }
 
 void GraphicsTextureDesc::setWrapR(uint32_t wrap) noexcept
 {
-    m_WrapR = wrap;
+    m_SamplerDesc.setWrapR(wrap);
 }
 
 uint32_t GraphicsTextureDesc::getMinFilter() const noexcept
 {
-    return m_MinFilter;
+    return m_SamplerDesc.getMinFilter();
 }
 
 void GraphicsTextureDesc::setMinFilter(uint32_t filter) noexcept
 {
-    m_MinFilter = filter;
+    m_SamplerDesc.setMinFilter(filter);
 }
 
 uint32_t GraphicsTextureDesc::getMagFilter() const noexcept
 {
-    return m_MagFilter;
+    return m_SamplerDesc.getMagFilter();
 }
 
 void GraphicsTextureDesc::setMagFilter(uint32_t filter) noexcept
 {
-    m_MagFilter = filter;
+    m_SamplerDesc.setMagFilter(filter);
 }
 
 float GraphicsTextureDesc::getAnisotropyLevel() const noexcept
 {
-    return m_AnisotropyLevel;
+    return m_SamplerDesc.getAnisotropyLevel();
 }
 
 void GraphicsTextureDesc::setAnisotropyLevel(float anisoLevel) noexcept
 {
-    m_AnisotropyLevel = anisoLevel;
+    m_SamplerDesc.setAnisotropyLevel(anisoLevel);
 }
 
 GraphicsTexture::GraphicsTexture() noexcept
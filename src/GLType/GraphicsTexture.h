@@ -3,6 +3,7 @@
 #include <tools/Rtti.h>
 #include <string>
 #include <GraphicsTypes.h>
+#include <GLType/GraphicsSampler.h>
 
 class GraphicsTextureDesc final
 {
@@ -17,6 +18,11 @@ public:
     std::string getFileName() const noexcept;
     void setFilename(const std::string& filename) noexcept;
 
+    // the rows of the file are stored bottom-up, as the AssetCooker writes
+    // them, and are uploaded without flipping
+    bool isBottomUp() const noexcept;
+    void setBottomUp(bool bBottomUp) noexcept;
+
     int32_t getWidth() const noexcept;
     void setWidth(int32_t width) noexcept;
 
@@ -41,6 +47,11 @@ public:
     GraphicsFormat getFormat() const noexcept;
     void setFormat(GraphicsFormat format) noexcept;
 
+    // the texture is bound with the sampler of this description, shared
+    // with every texture of the same one; the setters below edit it
+    const GraphicsSamplerDesc& getSamplerDesc() const noexcept;
+    void setSamplerDesc(const GraphicsSamplerDesc& desc) noexcept;
+
     uint32_t getWrapS() const noexcept;
     void setWrapS(uint32_t wrap) noexcept;
 
@@ -63,18 +74,13 @@ private:
 
     std::string m_Name;
     std::string m_Filename;
+    bool m_bBottomUp;
     int32_t m_Width;
     int32_t m_Height;
     int32_t m_Depth;
     int32_t m_Levels;
 
-    // TODO: Move to sampler
-    uint32_t m_WrapS;
-    uint32_t m_WrapT;
-    uint32_t m_WrapR;
-    uint32_t m_MinFilter;
-    uint32_t m_MagFilter;
-    float m_AnisotropyLevel;
+    GraphicsSamplerDesc m_SamplerDesc;
 
     GraphicsTarget m_Target;
     GraphicsFormat m_Format;
@@ -4,6 +4,9 @@
 #include <tools/FileUtility.h>
 #include <GLType/OGLTypes.h>
 #include <GLType/OGLCoreTexture.h>
+#include <GLType/TextureFile.h>
+#include <GLType/OGLSampler.h>
+#include <GLType/GraphicsDevice.h>
 
 __ImplementSubInterface(OGLCoreTexture, GraphicsTexture)
 
@@ -11,6 +14,7 @@ OGLCoreTexture::OGLCoreTexture()
     : m_TextureID(0)
     , m_Target(GL_INVALID_ENUM)
     , m_Format(GL_INVALID_ENUM)
+    , m_BaseLevel(0)
 {
 }
 
@@ -19,7 +23,7 @@ OGLCoreTexture::~OGLCoreTexture()
 	destroy();
 }
 
-bool OGLCoreTexture::create(GLint width, GLint height, GLenum target, GraphicsFormat format, GLuint levels, const uint8_t* data, uint32_t size) noexcept
+bool OGLCoreTexture::create(GLint width, GLint height, GLenum target, GraphicsFormat format, GLuint levels, const uint8_t* data, uint32_t size, GLint layers) noexcept
 {
     using namespace gli;
 
@@ -29,14 +33,28 @@ bool OGLCoreTexture::create(GLint width, GLint height, GLenum target, GraphicsFo
 
 	GLuint TextureID = 0;
 	glCreateTextures(target, 1, &TextureID);
-	glTextureStorage2D(TextureID, levels, Format.Internal, width, height);
-    if (data != nullptr && size != 0)
-    {
-        if (gli::is_compressed(format))
-            glCompressedTextureSubImage2D(TextureID, 0, 0, 0, width, height, Format.Internal, size, data);
-        else
-            glTextureSubImage2D(TextureID, 0, 0, 0, width, height, Format.External, Format.Type, data);
-    }
+	if (target == GL_TEXTURE_2D_ARRAY)
+	{
+		glTextureStorage3D(TextureID, levels, Format.Internal, width, height, layers);
+		if (data != nullptr && size != 0)
+		{
+			if (gli::is_compressed(format))
+				glCompressedTextureSubImage3D(TextureID, 0, 0, 0, 0, width, height, layers, Format.Internal, size, data);
+			else
+				glTextureSubImage3D(TextureID, 0, 0, 0, 0, width, height, layers, Format.External, Format.Type, data);
+		}
+	}
+	else
+	{
+		glTextureStorage2D(TextureID, levels, Format.Internal, width, height);
+		if (data != nullptr && size != 0)
+		{
+			if (gli::is_compressed(format))
+				glCompressedTextureSubImage2D(TextureID, 0, 0, 0, width, height, Format.Internal, size, data);
+			else
+				glTextureSubImage2D(TextureID, 0, 0, 0, width, height, Format.External, Format.Type, data);
+		}
+	}
 
 	m_Target = target;
 	m_TextureID = TextureID;
@@ -52,7 +70,7 @@ bool OGLCoreTexture::create(const GraphicsTextureDesc& desc) noexcept
     bool bSuccess = false;
     auto filename = desc.getFileName();
     if (!filename.empty())
-        bSuccess = create(filename);
+        bSuccess = create(filename, desc.isBottomUp());
     else
     {
         auto width = desc.getWidth();
@@ -62,28 +80,36 @@ bool OGLCoreTexture::create(const GraphicsTextureDesc& desc) noexcept
         auto data = desc.getStream();
         auto size = desc.getStreamSize();
         auto target = OGLTypes::translate(desc.getTarget());
-        bSuccess = create(width, height, target, format, levels, data, size);
+        bSuccess = create(width, height, target, format, levels, data, size, desc.getDepth());
     }
-    if (bSuccess) applyParameters(desc);
+    if (bSuccess) applySampler(desc.getSamplerDesc());
     return bSuccess;
 }
 
-bool OGLCoreTexture::create(const std::string& filename) noexcept
+bool OGLCoreTexture::create(const std::string& filename, bool bBottomUp) noexcept
 {
     static_assert(std::is_same<char, std::istream::char_type>::value, "Compatible type needed");
 
     if (filename.empty()) 
         return false;
 
+    // the images are read from the mapped pages, never from a heap copy
+    const std::string ext = util::getFileExtension(filename);
+    if (util::stricmp(ext, "DDS") || util::stricmp(ext, "KTX"))
+    {
+        TextureFile file;
+        if (!MapTextureFile(filename, file))
+            return false;
+        file.bFlipped = bBottomUp;
+        return createFromFile(file);
+    }
+
     auto data = util::ReadFileSync(filename);
     if (data == util::NullFile)
         return false;
 
-    const std::string ext = util::getFileExtension(filename);
     if (util::stricmp(ext, "zlib"))
         return createFromMemoryZIP(data->data(), data->size());
-    else if (util::stricmp(ext, "DDS") || util::stricmp(ext, "KTX"))
-        return createFromMemoryDDS(data->data(), data->size());
     else if (util::stricmp(ext, "HDR"))
         return createFromMemoryHDR(data->data(), data->size());
     return createFromMemoryLDR(data->data(), data->size());
@@ -153,7 +179,7 @@ GraphicsDevicePtr OGLCoreTexture::getDevice() noexcept
 
 void OGLCoreTexture::destroy() noexcept
 {
-	if (!m_TextureID)
+	if (m_TextureID)
 	{
 		glDeleteTextures(1, &m_TextureID);
 		m_TextureID = 0;
@@ -167,11 +193,13 @@ void OGLCoreTexture::bind(GLuint unit) const
 {
 	assert( 0u != m_TextureID );  
     glBindTextureUnit(unit, m_TextureID);
+    glBindSampler(unit, m_Sampler ? m_Sampler->getSamplerID() : GL_NONE);
 }
 
 void OGLCoreTexture::unbind(GLuint unit) const
 {
     glBindTextureUnit(unit, 0);
+    glBindSampler(unit, GL_NONE);
 }
 
 void OGLCoreTexture::generateMipmap()
@@ -182,50 +210,12 @@ void OGLCoreTexture::generateMipmap()
 	glGenerateTextureMipmap(m_TextureID);
 }
 
-void OGLCoreTexture::applyParameters(const GraphicsTextureDesc& desc)
-{
-    auto wrapS = desc.getWrapS();
-    auto wrapT = desc.getWrapT();
-    auto wrapR = desc.getWrapR();
-    auto defaultWrap = GL_REPEAT;
-
-    if (wrapS != defaultWrap)
-        parameteri(GL_TEXTURE_WRAP_S, wrapS);
-    if (wrapT != defaultWrap)
-        parameteri(GL_TEXTURE_WRAP_T, wrapS);
-    if (wrapR != defaultWrap)
-        parameteri(GL_TEXTURE_WRAP_R, wrapR);
-
-    auto minFilter = desc.getMinFilter();
-    auto magFilter = desc.getMagFilter();
-    auto defaultMinFilter = GL_LINEAR_MIPMAP_LINEAR;
-    auto defaultMagFilter = GL_LINEAR;
-    assert(magFilter == GL_NEAREST || magFilter == GL_LINEAR);
-    if (minFilter != defaultMinFilter)
-        parameteri(GL_TEXTURE_MIN_FILTER, minFilter);
-    if (magFilter != defaultMagFilter)
-        parameteri(GL_TEXTURE_MAG_FILTER, magFilter);
-
-    GLfloat defaultAnisoLevel = 0;
-    auto anisoLevel = desc.getAnisotropyLevel();
-    if (anisoLevel > defaultAnisoLevel)
-        parameterf(GL_TEXTURE_MAX_ANISOTROPY_EXT, anisoLevel);
-}
-
-void OGLCoreTexture::parameteri(GLenum pname, GLint param)
+void OGLCoreTexture::applySampler(const GraphicsSamplerDesc& desc) noexcept
 {
-	assert(m_Target != GL_INVALID_ENUM);
-	assert(m_TextureID != 0);
-
-    glTextureParameteri(m_TextureID, pname, param);
-}
-
-void OGLCoreTexture::parameterf(GLenum pname, GLfloat param)
-{
-	assert(m_Target != GL_INVALID_ENUM);
-	assert(m_TextureID != 0);
-
-    glTextureParameterf(m_TextureID, pname, param);
+    auto device = getDevice();
+    auto sampler = device ? device->createSampler(desc) : nullptr;
+    if (sampler)
+        m_Sampler = sampler->downcast_pointer<OGLSampler>();
 }
 
 bool OGLCoreTexture::createFromMemory(const char* data, size_t dataSize) noexcept
@@ -240,137 +230,301 @@ bool OGLCoreTexture::createFromMemory(const char* data, size_t dataSize) noexcep
 
 bool OGLCoreTexture::createFromMemoryDDS(const char* data, size_t dataSize) noexcept
 {
-	gli::texture Texture = gli::load(data, dataSize);
-	if (Texture.empty())
+	TextureFile file;
+	if (!ParseTextureFile(reinterpret_cast<const uint8_t*>(data), dataSize, file))
 		return false;
+	return createFromFile(file);
+}
+
+bool OGLCoreTexture::createFromFile(const TextureFile& file) noexcept
+{
+	if (!createStorage(file))
+		return false;
+
+	// keeps every image at an offset valid for any pixel format
+	const size_t alignment = 256;
+	std::vector<size_t> offsets(file.count());
+	size_t bufferSize = 0;
+	for (size_t i = 0; i < file.count(); i++)
+	{
+		offsets[i] = bufferSize;
+		bufferSize += (file.size(i % file.Levels) + alignment - 1) / alignment * alignment;
+	}
+
+	GLuint buffer = 0;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, bufferSize, nullptr, GL_MAP_WRITE_BIT);
+	auto mapped = static_cast<uint8_t*>(glMapNamedBufferRange(buffer, 0, bufferSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+	if (mapped)
+	{
+		for (size_t i = 0; i < file.count(); i++)
+		{
+			const size_t level = i % file.Levels;
+			const size_t face = (i / file.Levels) % file.Faces;
+			const size_t layer = i / (file.Levels * file.Faces);
+			CopyTextureImage(file, layer, face, level, mapped + offsets[i]);
+		}
+		glUnmapNamedBuffer(buffer);
+	}
 
-    Texture = gli::flip(Texture);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mapped ? buffer : 0);
+	std::vector<uint8_t> image;
+	for (size_t i = 0; i < file.count(); i++)
+	{
+		const size_t level = i % file.Levels;
+		const size_t face = (i / file.Levels) % file.Faces;
+		const size_t layer = i / (file.Levels * file.Faces);
+		if (mapped)
+			uploadImage(file, layer, face, level, reinterpret_cast<const void*>(offsets[i]));
+		else
+		{
+			image.resize(file.size(level));
+			CopyTextureImage(file, layer, face, level, image.data());
+			uploadImage(file, layer, face, level, image.data());
+		}
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(1, &buffer);
+	return true;
+}
+
+bool OGLCoreTexture::createStorage(const TextureFile& file, size_t baseLevel) noexcept
+{
+	assert(baseLevel < file.Levels);
 
 	gli::gl GL(gli::gl::PROFILE_GL33);
-	gli::gl::format const Format = GL.translate(Texture.format(), Texture.swizzles());
-	GLenum Target = GL.translate(Texture.target());
+	gli::gl::format const Format = GL.translate(file.Format, file.Swizzles);
+	GLenum Target = GL.translate(file.Target);
+	GLsizei const Levels = static_cast<GLsizei>(file.Levels - baseLevel);
 
 	GLuint TextureID = 0;
 	glCreateTextures(Target, 1, &TextureID);
 	glTextureParameteri(TextureID, GL_TEXTURE_BASE_LEVEL, 0);
-	glTextureParameteri(TextureID, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(Texture.levels() - 1));
+	glTextureParameteri(TextureID, GL_TEXTURE_MAX_LEVEL, Levels - 1);
 	glTextureParameteri(TextureID, GL_TEXTURE_SWIZZLE_R, Format.Swizzles[0]);
 	glTextureParameteri(TextureID, GL_TEXTURE_SWIZZLE_G, Format.Swizzles[1]);
 	glTextureParameteri(TextureID, GL_TEXTURE_SWIZZLE_B, Format.Swizzles[2]);
 	glTextureParameteri(TextureID, GL_TEXTURE_SWIZZLE_A, Format.Swizzles[3]);
 
-	glm::tvec3<GLsizei> const Extent(Texture.extent());
-	GLsizei const FaceTotal = static_cast<GLsizei>(Texture.layers() * Texture.faces());
+	glm::tvec3<GLsizei> const Extent(file.extent(baseLevel));
+	GLsizei const FaceTotal = static_cast<GLsizei>(file.Layers * file.Faces);
 
-	switch(Texture.target())
+	switch(file.Target)
 	{
 	case gli::TARGET_1D:
 		glTextureStorage1D(
-			TextureID, static_cast<GLint>(Texture.levels()), Format.Internal, Extent.x);
+			TextureID, Levels, Format.Internal, Extent.x);
 		break;
 	case gli::TARGET_1D_ARRAY:
 	case gli::TARGET_2D:
 	case gli::TARGET_CUBE:
 		glTextureStorage2D(
-			TextureID, static_cast<GLint>(Texture.levels()), Format.Internal,
+			TextureID, Levels, Format.Internal,
 			Extent.x, Extent.y);
 		break;
 	case gli::TARGET_2D_ARRAY:
 	case gli::TARGET_3D:
 	case gli::TARGET_CUBE_ARRAY:
 		glTextureStorage3D(
-			TextureID, static_cast<GLint>(Texture.levels()), Format.Internal,
+			TextureID, Levels, Format.Internal,
 			Extent.x, Extent.y,
-			Texture.target() == gli::TARGET_3D ? Extent.z : FaceTotal);
+			file.Target == gli::TARGET_3D ? Extent.z : FaceTotal);
 		break;
 	default:
 		assert(0);
-		break;
+		glDeleteTextures(1, &TextureID);
+		return false;
 	}
 
-	for(std::size_t Layer = 0; Layer < Texture.layers(); ++Layer)
-	for(std::size_t Face = 0; Face < Texture.faces(); ++Face)
-	for(std::size_t Level = 0; Level < Texture.levels(); ++Level)
-	{
-		GLsizei const LayerGL = static_cast<GLsizei>(Layer);
-		glm::tvec3<GLsizei> Extent(Texture.extent(Level));
-		GLenum _Target = gli::is_target_cube(Texture.target())
-			? static_cast<GLenum>(GL_TEXTURE_CUBE_MAP_POSITIVE_X + Face)
-			: Target;
-
-		switch(Texture.target())
-		{
-		case gli::TARGET_1D:
-			if(gli::is_compressed(Texture.format()))
-				glCompressedTextureSubImage1D(
-					TextureID, static_cast<GLint>(Level), 0, Extent.x,
-					Format.Internal, static_cast<GLsizei>(Texture.size(Level)),
-					Texture.data(Layer, Face, Level));
-			else
-				glTextureSubImage1D(
-					TextureID, static_cast<GLint>(Level), 0, Extent.x,
-					Format.External, Format.Type,
-					Texture.data(Layer, Face, Level));
-			break;
-		case gli::TARGET_1D_ARRAY:
-		case gli::TARGET_2D:
-		case gli::TARGET_CUBE:
-			if(gli::is_compressed(Texture.format()))
-				glCompressedTextureSubImage2D(
-					TextureID, static_cast<GLint>(Level),
-					0, 0,
-					Extent.x,
-					Texture.target() == gli::TARGET_1D_ARRAY ? LayerGL : Extent.y,
-					Format.Internal, static_cast<GLsizei>(Texture.size(Level)),
-					Texture.data(Layer, Face, Level));
-			else
-				glTextureSubImage2D(
-					TextureID, static_cast<GLint>(Level),
-					0, 0,
-					Extent.x,
-					Texture.target() == gli::TARGET_1D_ARRAY ? LayerGL : Extent.y,
-					Format.External, Format.Type,
-					Texture.data(Layer, Face, Level));
-			break;
-		case gli::TARGET_2D_ARRAY:
-		case gli::TARGET_3D:
-		case gli::TARGET_CUBE_ARRAY:
-			if(gli::is_compressed(Texture.format()))
-				glCompressedTextureSubImage3D(
-					TextureID, static_cast<GLint>(Level),
-					0, 0, Texture.target() == gli::TARGET_3D ? 0 : LayerGL,
-					Extent.x, Extent.y,
-					Texture.target() == gli::TARGET_3D ? Extent.z : 1,
-					Format.Internal, static_cast<GLsizei>(Texture.size(Level)),
-					Texture.data(Layer, Face, Level));
-			else
-				glTextureSubImage3D(
-					TextureID, static_cast<GLint>(Level),
-                    0, 0, Texture.target() == gli::TARGET_3D ? 0 : (GLint)(LayerGL * Texture.faces() + Face),
-                    Extent.x, Extent.y,
-                    Texture.target() == gli::TARGET_3D ? Extent.z : 1,
-					Format.External, Format.Type,
-					Texture.data(Layer, Face, Level));
-			break;
-		default: 
-			assert(0); 
-			break;
-		}
-	}
 	m_Target = Target;
 	m_TextureID = TextureID;
 	m_Format = Format.Type;
+	m_BaseLevel = baseLevel;
 
-    m_TextureDesc.setTarget(Texture.target());
-    m_TextureDesc.setFormat(Texture.format());
+    m_TextureDesc.setTarget(file.Target);
+    m_TextureDesc.setFormat(file.Format);
     m_TextureDesc.setWidth(Extent.x);
     m_TextureDesc.setHeight(Extent.y);
-	m_TextureDesc.setDepth(Texture.target() == gli::TARGET_3D ? Extent.z : FaceTotal);
-    m_TextureDesc.setLevels((GLint)Texture.levels());
+	m_TextureDesc.setDepth(file.Target == gli::TARGET_3D ? Extent.z : FaceTotal);
+    m_TextureDesc.setLevels(Levels);
 
 	return true;
 }
 
+void OGLCoreTexture::uploadImage(const TextureFile& file, size_t Layer, size_t Face, size_t Level, const void* Data) noexcept
+{
+	assert(m_TextureID != 0);
+	assert(Level >= m_BaseLevel);
+
+	gli::gl GL(gli::gl::PROFILE_GL33);
+	gli::gl::format const Format = GL.translate(file.Format, file.Swizzles);
+
+	GLuint const TextureID = m_TextureID;
+	GLsizei const LayerGL = static_cast<GLsizei>(Layer);
+	GLsizei const Size = static_cast<GLsizei>(file.size(Level));
+	GLint const LevelGL = static_cast<GLint>(Level - m_BaseLevel);
+	glm::tvec3<GLsizei> Extent(file.extent(Level));
+
+	switch(file.Target)
+	{
+	case gli::TARGET_1D:
+		if(gli::is_compressed(file.Format))
+			glCompressedTextureSubImage1D(
+				TextureID, LevelGL, 0, Extent.x,
+				Format.Internal, Size,
+				Data);
+		else
+			glTextureSubImage1D(
+				TextureID, LevelGL, 0, Extent.x,
+				Format.External, Format.Type,
+				Data);
+		break;
+	case gli::TARGET_1D_ARRAY:
+	case gli::TARGET_2D:
+	case gli::TARGET_CUBE:
+		if(gli::is_compressed(file.Format))
+			glCompressedTextureSubImage2D(
+				TextureID, LevelGL,
+				0, 0,
+				Extent.x,
+				file.Target == gli::TARGET_1D_ARRAY ? LayerGL : Extent.y,
+				Format.Internal, Size,
+				Data);
+		else
+			glTextureSubImage2D(
+				TextureID, LevelGL,
+				0, 0,
+				Extent.x,
+				file.Target == gli::TARGET_1D_ARRAY ? LayerGL : Extent.y,
+				Format.External, Format.Type,
+				Data);
+		break;
+	case gli::TARGET_2D_ARRAY:
+	case gli::TARGET_3D:
+	case gli::TARGET_CUBE_ARRAY:
+		if(gli::is_compressed(file.Format))
+			glCompressedTextureSubImage3D(
+				TextureID, LevelGL,
+				0, 0, file.Target == gli::TARGET_3D ? 0 : LayerGL,
+				Extent.x, Extent.y,
+				file.Target == gli::TARGET_3D ? Extent.z : 1,
+				Format.Internal, Size,
+				Data);
+		else
+			glTextureSubImage3D(
+				TextureID, LevelGL,
+                0, 0, file.Target == gli::TARGET_3D ? 0 : (GLint)(LayerGL * file.Faces + Face),
+                Extent.x, Extent.y,
+                file.Target == gli::TARGET_3D ? Extent.z : 1,
+				Format.External, Format.Type,
+				Data);
+		break;
+	default: 
+		assert(0); 
+		break;
+	}
+}
+
+void OGLCoreTexture::copyLevels(const OGLCoreTexture& source, const TextureFile& file, size_t firstLevel) noexcept
+{
+	assert(firstLevel >= m_BaseLevel && firstLevel >= source.m_BaseLevel);
+
+	// cube faces and array layers are copied as the slices of a 3D image
+	for (size_t Level = firstLevel; Level < file.Levels; ++Level)
+	{
+		glm::tvec3<GLsizei> Extent(file.extent(Level));
+		if (file.Target == gli::TARGET_1D_ARRAY)
+			Extent.y = static_cast<GLsizei>(file.Layers);
+		else if (file.Target != gli::TARGET_3D)
+			Extent.z = static_cast<GLsizei>(file.Layers * file.Faces);
+
+		glCopyImageSubData(
+			source.m_TextureID, source.m_Target, static_cast<GLint>(Level - source.m_BaseLevel), 0, 0, 0,
+			m_TextureID, m_Target, static_cast<GLint>(Level - m_BaseLevel), 0, 0, 0,
+			Extent.x, Extent.y, Extent.z);
+	}
+}
+
+void OGLCoreTexture::swap(OGLCoreTexture& other) noexcept
+{
+    // the sampler stays with the handle, the descriptions share it
+    std::swap(m_TextureDesc, other.m_TextureDesc);
+    std::swap(m_TextureID, other.m_TextureID);
+    std::swap(m_Target, other.m_Target);
+    std::swap(m_Format, other.m_Format);
+    std::swap(m_BaseLevel, other.m_BaseLevel);
+}
+
+namespace
+{
+    // same conventions as the synchronous paths : DDS and KTX images are
+    // flipped while uploaded, stb_image ones are loaded flipped
+    bool DecodeMemory(const char* data, size_t size, const std::shared_ptr<const void>& storage, TextureFile& file) noexcept
+    {
+        if (ParseTextureFile(reinterpret_cast<const uint8_t*>(data), size, file))
+        {
+            file.Storage = storage;
+            return true;
+        }
+
+        stbi_set_flip_vertically_on_load(true);
+
+        const bool bHDR = stbi_is_hdr_from_memory((const stbi_uc*)data, (int)size) != 0;
+        int width = 0, height = 0, nrComponents = 0;
+        void* imagedata = nullptr;
+        if (bHDR)
+            imagedata = stbi_loadf_from_memory((const stbi_uc*)data, (int)size, &width, &height, &nrComponents, 0);
+        else
+            imagedata = stbi_load_from_memory((const stbi_uc*)data, (int)size, &width, &height, &nrComponents, 0);
+        if (!imagedata) return false;
+
+        GLenum type = bHDR ? GL_FLOAT : GL_UNSIGNED_BYTE;
+        GLenum Format = OGLTypes::getComponent(nrComponents);
+        GLenum InternalFormat = OGLTypes::getInternalComponent(nrComponents, bHDR);
+
+        gli::gl GL(gli::gl::PROFILE_GL33);
+        gli::format format = GL.find(
+            static_cast<gli::gl::internal_format>(InternalFormat),
+            static_cast<gli::gl::external_format>(Format),
+            static_cast<gli::gl::type_format>(type));
+
+        gli::texture2d image(format, gli::extent2d(width, height), 1);
+        memcpy(image.data(), imagedata, image.size());
+        stbi_image_free(imagedata);
+        MakeTextureFile(std::move(image), file);
+        return true;
+    }
+}
+
+TextureFile OGLCoreTexture::decode(const std::string& filename) noexcept
+{
+    TextureFile file;
+    const std::string ext = util::getFileExtension(filename);
+    if (util::stricmp(ext, "DDS") || util::stricmp(ext, "KTX"))
+    {
+        MapTextureFile(filename, file, true);
+        return file;
+    }
+
+    auto data = util::ReadFileSync(filename);
+    if (data == util::NullFile)
+        return file;
+
+    if (!util::stricmp(ext, "zlib"))
+    {
+        DecodeMemory(data->data(), data->size(), data, file);
+        return file;
+    }
+
+    int decodesize = 0;
+    char* decodedata = stbi_zlib_decode_malloc(data->data(), (int)data->size(), &decodesize);
+    if (decodedata == nullptr)
+        return file;
+    std::shared_ptr<const void> storage(decodedata, free);
+    DecodeMemory(decodedata, decodesize, storage, file);
+    return file;
+}
+
 // TODO: stbi_is_hdr_from_memory etc
 bool OGLCoreTexture::createFromMemoryHDR(const char* data, size_t size) noexcept
 {
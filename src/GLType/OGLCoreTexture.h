@@ -6,6 +6,8 @@
 #include <tools/Rtti.h>
 #include <GLType/GraphicsTexture.h>
 
+struct TextureFile;
+
 class OGLCoreTexture final : public GraphicsTexture
 {
 	__DeclareSubInterface(OGLCoreTexture, GraphicsTexture)
@@ -15,13 +17,17 @@ public:
     virtual ~OGLCoreTexture();
 
     bool create(const GraphicsTextureDesc& desc) noexcept;
-	bool create(const std::string& filename) noexcept;
-	bool create(GLint width, GLint height, GLenum target, GraphicsFormat format, GLuint levels, const uint8_t* data, uint32_t size) noexcept;
+	bool create(const std::string& filename, bool bBottomUp = false) noexcept;
+	// 'layers' of a 2D array, 'data' then holds the first level of each layer
+	bool create(GLint width, GLint height, GLenum target, GraphicsFormat format, GLuint levels, const uint8_t* data, uint32_t size, GLint layers = 1) noexcept;
 	void destroy() noexcept;
 	void bind(GLuint unit) const;
 	void unbind(GLuint unit) const;
 	void generateMipmap();
 
+	// maps or decodes a texture file without any GL call, from any thread
+	static TextureFile decode(const std::string& filename) noexcept;
+
     GLuint getTextureID() const noexcept;
     GLenum getFormat() const noexcept;
 
@@ -29,9 +35,9 @@ public:
 
 private:
 
-    void applyParameters(const GraphicsTextureDesc& desc);
-	void parameteri(GLenum pname, GLint param);
-	void parameterf(GLenum pname, GLfloat param);
+    // the sampler of 'desc' from the cache of the device, the texture
+    // parameters are left alone without a device
+    void applySampler(const GraphicsSamplerDesc& desc) noexcept;
 
     bool createFromMemory(const char* data, size_t dataSize) noexcept;
     bool createFromMemoryDDS(const char* data, size_t dataSize) noexcept; // DDS, KTX
@@ -39,9 +45,28 @@ private:
     bool createFromMemoryLDR(const char* data, size_t dataSize) noexcept; // JPG, PNG, TGA, BMP, PSD, GIF, HDR, PIC files
     bool createFromMemoryZIP(const char* data, size_t dataSize) noexcept; // ZLIB
 
+    // copies the images into a temporary pixel unpack buffer, flipping them
+    // on the way, and uploads from there
+    bool createFromFile(const TextureFile& file) noexcept;
+
+    // immutable storage for the levels of 'file' from 'baseLevel', the
+    // images are left to uploadImage(); 'data' is an offset when a pixel
+    // unpack buffer is bound
+    bool createStorage(const TextureFile& file, size_t baseLevel = 0) noexcept;
+    void uploadImage(const TextureFile& file, size_t layer, size_t face, size_t level, const void* data) noexcept;
+
+    // GPU copy of the levels of 'file' from 'firstLevel', both storages hold them
+    void copyLevels(const OGLCoreTexture& source, const TextureFile& file, size_t firstLevel) noexcept;
+
+    // exchanges the GL objects and descriptions, the loaded texture takes
+    // the place of the placeholder behind the same handle
+    void swap(OGLCoreTexture& other) noexcept;
+
 private:
 
 	friend class OGLDevice;
+	friend class AsyncTextureLoader;
+	friend class TextureStreamer;
 	void setDevice(const GraphicsDevicePtr& device) noexcept;
 	GraphicsDevicePtr getDevice() noexcept;
 
@@ -57,6 +82,8 @@ private:
 	GLuint m_TextureID;
 	GLenum m_Target;
 	GLenum m_Format;
+	OGLSamplerPtr m_Sampler;
+	size_t m_BaseLevel;     // level of the file stored as level 0
 	GraphicsDeviceWeakPtr m_Device;
 };
 
@@ -5,10 +5,41 @@
 #include <GLType/OGLCoreTexture.h>
 #include <GLType/OGLFramebuffer.h>
 #include <GLType/OGLCoreFramebuffer.h>
+#include <GLType/OGLSampler.h>
+#include <tools/string.h>
+#include <algorithm>
+#include <cstdio>
 
 __ImplementSubInterface(OGLDevice, GraphicsDevice)
 
+namespace
+{
+    // per frame upload budget, three sections are in flight
+    const GLsizeiptr kUploadSectionSize = 8 << 20;
+
+    // the file and everything that changes the texture made of it
+    std::string MakeTextureKey(const char* mode, const GraphicsTextureDesc& desc)
+    {
+        auto& sampler = desc.getSamplerDesc();
+        char params[128];
+        snprintf(params, sizeof(params), "%s %d %d %d %d %x %x %x %x %x %g", mode,
+            int(desc.getTarget()), int(desc.getFormat()), desc.getDepth(), int(desc.isBottomUp()),
+            sampler.getWrapS(), sampler.getWrapT(), sampler.getWrapR(),
+            sampler.getMinFilter(), sampler.getMagFilter(), sampler.getAnisotropyLevel());
+        return std::string(params) + " " + desc.getFileName();
+    }
+
+    // only the files are shared, the streams belong to their caller
+    bool IsShared(const GraphicsTextureDesc& desc)
+    {
+        return !desc.getFileName().empty() && desc.getStream() == nullptr;
+    }
+}
+
 OGLDevice::OGLDevice() noexcept
+    : m_bTextureLoader(false)
+    , m_MaxAnisotropy(16.f)
+    , m_RenderTargetPool(*this)
 {
 }
 
@@ -24,6 +55,12 @@ bool OGLDevice::create(const GraphicsDeviceDesc& desc) noexcept
 
 void OGLDevice::destoy() noexcept
 {
+    m_TextureStreamer.clear();
+    m_TextureLoader.destroy();
+    m_bTextureLoader = false;
+    m_ResourceCache.clear();
+    m_RenderTargetPool.clear();
+    m_Samplers.clear();
 }
 
 GraphicsDataPtr OGLDevice::createGraphicsData(const GraphicsDataDesc& desc) noexcept
@@ -50,6 +87,30 @@ GraphicsDataPtr OGLDevice::createGraphicsData(const GraphicsDataDesc& desc) noex
 }
 
 GraphicsTexturePtr OGLDevice::createTexture(const GraphicsTextureDesc& desc) noexcept
+{
+    if (!IsShared(desc))
+        return loadTexture(desc);
+    return m_ResourceCache.findOrCreate<GraphicsTexture>(MakeTextureKey("sync", desc),
+        [&]() { return loadTexture(desc); });
+}
+
+GraphicsTexturePtr OGLDevice::createTextureAsync(const GraphicsTextureDesc& desc, uint32_t placeholder) noexcept
+{
+    if (!IsShared(desc))
+        return loadTextureAsync(desc, placeholder);
+    return m_ResourceCache.findOrCreate<GraphicsTexture>(MakeTextureKey("async", desc),
+        [&]() { return loadTextureAsync(desc, placeholder); });
+}
+
+GraphicsTexturePtr OGLDevice::createTextureStreamed(const GraphicsTextureDesc& desc, uint32_t placeholder) noexcept
+{
+    if (!IsShared(desc))
+        return loadTextureStreamed(desc, placeholder);
+    return m_ResourceCache.findOrCreate<GraphicsTexture>(MakeTextureKey("streamed", desc),
+        [&]() { return loadTextureStreamed(desc, placeholder); });
+}
+
+GraphicsTexturePtr OGLDevice::loadTexture(const GraphicsTextureDesc& desc) noexcept
 {
     if (m_Desc.getDeviceType() == GraphicsDeviceType::GraphicsDeviceTypeOpenGLCore)
     {
@@ -72,6 +133,122 @@ GraphicsTexturePtr OGLDevice::createTexture(const GraphicsTextureDesc& desc) noe
     return nullptr;
 }
 
+GraphicsSamplerPtr OGLDevice::createSampler(const GraphicsSamplerDesc& desc) noexcept
+{
+    auto it = m_Samplers.find(desc);
+    if (it != m_Samplers.end())
+        return it->second;
+
+    auto sampler = std::make_shared<OGLSampler>();
+    if (!sampler) return nullptr;
+    if (!sampler->create(desc, m_MaxAnisotropy))
+        return nullptr;
+    m_Samplers.emplace(desc, sampler);
+    return sampler;
+}
+
+void OGLDevice::setMaxAnisotropy(float level) noexcept
+{
+    if (m_MaxAnisotropy == level)
+        return;
+    m_MaxAnisotropy = level;
+    for (auto& it : m_Samplers)
+        it.second->setMaxAnisotropy(level);
+}
+
+float OGLDevice::getMaxAnisotropy() const noexcept
+{
+    return m_MaxAnisotropy;
+}
+
+bool OGLDevice::createTextureLoader() noexcept
+{
+    if (!m_bTextureLoader)
+        m_bTextureLoader = m_TextureLoader.create(0, kUploadSectionSize);
+    return m_bTextureLoader;
+}
+
+OGLCoreTexturePtr OGLDevice::createPlaceholder(const GraphicsTextureDesc& desc, uint32_t placeholder) noexcept
+{
+    auto texture = std::make_shared<OGLCoreTexture>();
+    if (!texture) return nullptr;
+    texture->setDevice(this->downcast_pointer<OGLDevice>());
+
+    // a 2D array keeps its target, every layer holds the placeholder
+    const bool bArray = desc.getTarget() == gli::TARGET_2D_ARRAY;
+    std::vector<uint32_t> texels(bArray ? std::max(desc.getDepth(), 1) : 1, placeholder);
+
+    GraphicsTextureDesc placeholderDesc = desc;
+    placeholderDesc.setFilename("");
+    placeholderDesc.setTarget(bArray ? gli::TARGET_2D_ARRAY : gli::TARGET_2D);
+    placeholderDesc.setFormat(gli::FORMAT_RGBA8_UNORM_PACK8);
+    placeholderDesc.setWidth(1);
+    placeholderDesc.setHeight(1);
+    placeholderDesc.setDepth(int32_t(texels.size()));
+    placeholderDesc.setLevels(1);
+    placeholderDesc.setStream(reinterpret_cast<uint8_t*>(texels.data()));
+    placeholderDesc.setStreamSize(uint32_t(texels.size() * sizeof(uint32_t)));
+    if (!texture->create(placeholderDesc))
+        return nullptr;
+
+    // the loaded storage fills in the rest of the description
+    texture->m_TextureDesc = desc;
+    texture->m_TextureDesc.setStream(nullptr);
+    texture->m_TextureDesc.setStreamSize(0);
+    return texture;
+}
+
+GraphicsTexturePtr OGLDevice::loadTextureAsync(const GraphicsTextureDesc& desc, uint32_t placeholder) noexcept
+{
+    // the 4.1 path has no persistent mapping, streams are already in memory
+    if (m_Desc.getDeviceType() != GraphicsDeviceType::GraphicsDeviceTypeOpenGLCore || desc.getFileName().empty())
+        return loadTexture(desc);
+    if (!createTextureLoader())
+        return loadTexture(desc);
+
+    auto texture = createPlaceholder(desc, placeholder);
+    if (!texture) return nullptr;
+    m_TextureLoader.load(texture, desc.getFileName());
+    return texture;
+}
+
+GraphicsTexturePtr OGLDevice::loadTextureStreamed(const GraphicsTextureDesc& desc, uint32_t placeholder) noexcept
+{
+    // only the mapped files can be read a level at a time
+    const std::string ext = util::getFileExtension(desc.getFileName());
+    if (!util::stricmp(ext, "DDS") && !util::stricmp(ext, "KTX"))
+        return loadTextureAsync(desc, placeholder);
+    if (m_Desc.getDeviceType() != GraphicsDeviceType::GraphicsDeviceTypeOpenGLCore || !createTextureLoader())
+        return loadTexture(desc);
+
+    auto texture = createPlaceholder(desc, placeholder);
+    if (!texture) return nullptr;
+
+    // without levels finer than the tail, loaded whole
+    if (!m_TextureStreamer.add(texture, desc.getFileName(), desc.isBottomUp(), m_TextureLoader))
+        m_TextureLoader.load(texture, desc.getFileName());
+    return texture;
+}
+
+void OGLDevice::requestTextureDensity(const GraphicsTexturePtr& texture, float uvPerPixel) noexcept
+{
+    if (!texture || m_Desc.getDeviceType() != GraphicsDeviceType::GraphicsDeviceTypeOpenGLCore)
+        return;
+    auto coreTexture = texture->downcast_pointer<OGLCoreTexture>();
+    if (coreTexture)
+        m_TextureStreamer.request(coreTexture.get(), uvPerPixel);
+}
+
+void OGLDevice::setTextureBudget(uint64_t bytes) noexcept
+{
+    m_TextureStreamer.setBudget(bytes);
+}
+
+TextureStreamingStats OGLDevice::getTextureStreamingStats() const noexcept
+{
+    return m_TextureStreamer.getStats();
+}
+
 GraphicsFramebufferPtr OGLDevice::createFramebuffer(const GraphicsFramebufferDesc& desc) noexcept
 {
     if (m_Desc.getDeviceType() == GraphicsDeviceType::GraphicsDeviceTypeOpenGLCore)
@@ -111,6 +288,32 @@ void OGLDevice::setFramebuffer(const GraphicsFramebufferPtr& framebuffer) noexce
     }
 }
 
+uint32_t OGLDevice::flushTextureUploads() noexcept
+{
+    if (!m_bTextureLoader)
+        return 0;
+
+    m_TextureStreamer.update(m_TextureLoader);
+    uint32_t count = m_TextureLoader.flush();
+    m_TextureStreamer.collect(m_TextureLoader);
+    return count;
+}
+
+uint32_t OGLDevice::getPendingTextureCount() const noexcept
+{
+    return m_TextureLoader.getPendingCount();
+}
+
+ResourceCache& OGLDevice::getResourceCache() noexcept
+{
+    return m_ResourceCache;
+}
+
+RenderTargetPool& OGLDevice::getRenderTargetPool() noexcept
+{
+    return m_RenderTargetPool;
+}
+
 const GraphicsDeviceDesc& OGLDevice::getGraphicsDeviceDesc() const noexcept
 {
     return m_Desc;
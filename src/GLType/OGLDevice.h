@@ -1,6 +1,12 @@
 #pragma once
 
 #include <GLType/GraphicsDevice.h>
+#include <GLType/AsyncTextureLoader.h>
+#include <GLType/TextureStreamer.h>
+#include <GLType/GraphicsSampler.h>
+#include <GLType/ResourceCache.h>
+#include <GLType/RenderTargetPool.h>
+#include <map>
 
 class OGLDevice final : public GraphicsDevice
 {
@@ -15,13 +21,47 @@ public:
 
     GraphicsDataPtr createGraphicsData(const GraphicsDataDesc& desc) noexcept override;
     GraphicsTexturePtr createTexture(const GraphicsTextureDesc& desc) noexcept override;
+    GraphicsSamplerPtr createSampler(const GraphicsSamplerDesc& desc) noexcept override;
+    GraphicsTexturePtr createTextureAsync(const GraphicsTextureDesc& desc, uint32_t placeholder) noexcept override;
+    GraphicsTexturePtr createTextureStreamed(const GraphicsTextureDesc& desc, uint32_t placeholder) noexcept override;
     GraphicsFramebufferPtr createFramebuffer(const GraphicsFramebufferDesc& desc) noexcept override;
 
     void setFramebuffer(const GraphicsFramebufferPtr& framebuffer) noexcept override;
 
+    void setMaxAnisotropy(float level) noexcept override;
+    float getMaxAnisotropy() const noexcept override;
+
+    void requestTextureDensity(const GraphicsTexturePtr& texture, float uvPerPixel) noexcept override;
+    void setTextureBudget(uint64_t bytes) noexcept override;
+    TextureStreamingStats getTextureStreamingStats() const noexcept override;
+
+    uint32_t flushTextureUploads() noexcept override;
+    uint32_t getPendingTextureCount() const noexcept override;
+
+    ResourceCache& getResourceCache() noexcept override;
+    RenderTargetPool& getRenderTargetPool() noexcept override;
+
 	const GraphicsDeviceDesc& getGraphicsDeviceDesc() const noexcept override;
 
 private:
 
+    // the creations behind the cache
+    GraphicsTexturePtr loadTexture(const GraphicsTextureDesc& desc) noexcept;
+    GraphicsTexturePtr loadTextureAsync(const GraphicsTextureDesc& desc, uint32_t placeholder) noexcept;
+    GraphicsTexturePtr loadTextureStreamed(const GraphicsTextureDesc& desc, uint32_t placeholder) noexcept;
+
+    // a 1x1 texture holding the description of the file it waits for
+    OGLCoreTexturePtr createPlaceholder(const GraphicsTextureDesc& desc, uint32_t placeholder) noexcept;
+    bool createTextureLoader() noexcept;
+
     GraphicsDeviceDesc m_Desc;
+    AsyncTextureLoader m_TextureLoader;
+    TextureStreamer m_TextureStreamer;
+    bool m_bTextureLoader;
+
+    // kept for the lifetime of the device, there are few descriptions
+    std::map<GraphicsSamplerDesc, OGLSamplerPtr> m_Samplers;
+    float m_MaxAnisotropy;
+    ResourceCache m_ResourceCache;
+    RenderTargetPool m_RenderTargetPool;
 };
@@ -0,0 +1,73 @@
+#include <GLType/OGLSampler.h>
+#include <algorithm>
+#include <cassert>
+
+__ImplementSubInterface(OGLSampler, GraphicsSampler)
+
+OGLSampler::OGLSampler() noexcept
+    : m_SamplerID(GL_NONE)
+{
+}
+
+OGLSampler::~OGLSampler() noexcept
+{
+    destroy();
+}
+
+bool OGLSampler::create(const GraphicsSamplerDesc& desc, float maxAnisotropy) noexcept
+{
+    assert(m_SamplerID == GL_NONE);
+    assert(desc.getMagFilter() == GL_NEAREST || desc.getMagFilter() == GL_LINEAR);
+
+    glGenSamplers(1, &m_SamplerID);
+    if (m_SamplerID == GL_NONE)
+        return false;
+
+    m_SamplerDesc = desc;
+    glSamplerParameteri(m_SamplerID, GL_TEXTURE_WRAP_S, desc.getWrapS());
+    glSamplerParameteri(m_SamplerID, GL_TEXTURE_WRAP_T, desc.getWrapT());
+    glSamplerParameteri(m_SamplerID, GL_TEXTURE_WRAP_R, desc.getWrapR());
+    glSamplerParameteri(m_SamplerID, GL_TEXTURE_MIN_FILTER, desc.getMinFilter());
+    glSamplerParameteri(m_SamplerID, GL_TEXTURE_MAG_FILTER, desc.getMagFilter());
+    setMaxAnisotropy(maxAnisotropy);
+    return true;
+}
+
+void OGLSampler::destroy() noexcept
+{
+    if (m_SamplerID != GL_NONE)
+        glDeleteSamplers(1, &m_SamplerID);
+    m_SamplerID = GL_NONE;
+}
+
+void OGLSampler::bind(GLuint unit) const noexcept
+{
+    assert(m_SamplerID != GL_NONE);
+    glBindSampler(unit, m_SamplerID);
+}
+
+void OGLSampler::unbind(GLuint unit) const noexcept
+{
+    glBindSampler(unit, GL_NONE);
+}
+
+void OGLSampler::setMaxAnisotropy(float maxAnisotropy) noexcept
+{
+    assert(m_SamplerID != GL_NONE);
+    if (!GLEW_EXT_texture_filter_anisotropic)
+        return;
+
+    // 1 turns the anisotropic filtering off
+    const float level = std::max(std::min(m_SamplerDesc.getAnisotropyLevel(), maxAnisotropy), 1.f);
+    glSamplerParameterf(m_SamplerID, GL_TEXTURE_MAX_ANISOTROPY_EXT, level);
+}
+
+GLuint OGLSampler::getSamplerID() const noexcept
+{
+    return m_SamplerID;
+}
+
+const GraphicsSamplerDesc& OGLSampler::getGraphicsSamplerDesc() const noexcept
+{
+    return m_SamplerDesc;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <GLType/GraphicsSampler.h>
+
+// sampler objects are set without binding them on both the 4.1 and 4.5
+// paths, one class serves the two devices
+class OGLSampler final : public GraphicsSampler
+{
+    __DeclareSubInterface(OGLSampler, GraphicsSampler)
+public:
+
+    OGLSampler() noexcept;
+    ~OGLSampler() noexcept;
+
+    // the anisotropy is clamped to 'maxAnisotropy'
+    bool create(const GraphicsSamplerDesc& desc, float maxAnisotropy) noexcept;
+    void destroy() noexcept;
+
+    void bind(GLuint unit) const noexcept;
+    void unbind(GLuint unit) const noexcept;
+
+    // see GraphicsDevice::setMaxAnisotropy
+    void setMaxAnisotropy(float maxAnisotropy) noexcept;
+
+    GLuint getSamplerID() const noexcept;
+
+    const GraphicsSamplerDesc& getGraphicsSamplerDesc() const noexcept override;
+
+private:
+
+    OGLSampler(const OGLSampler&) noexcept = delete;
+    OGLSampler& operator=(const OGLSampler&) noexcept = delete;
+
+private:
+
+    GraphicsSamplerDesc m_SamplerDesc;
+    GLuint m_SamplerID;
+};
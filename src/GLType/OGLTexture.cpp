@@ -1,12 +1,47 @@
 #include <gli/gli.hpp>
+#include <BlockCompression.h>
 #include <tools/stb_image.h>
 #include <tools/string.h>
 #include <tools/FileUtility.h>
 #include <GLType/OGLTypes.h>
 #include <GLType/OGLTexture.h>
+#include <GLType/OGLSampler.h>
+#include <GLType/GraphicsDevice.h>
 
 __ImplementSubInterface(OGLTexture, GraphicsTexture)
 
+namespace
+{
+    bool IsBPTC(gli::format format)
+    {
+        return format == gli::FORMAT_RGBA_BP_UNORM_BLOCK16 || format == gli::FORMAT_RGBA_BP_SRGB_BLOCK16;
+    }
+
+    // BPTC is core since GL 4.2 only, the 4.1 contexts may lack it; the BC7
+    // images are then uploaded as RGBA8
+    gli::texture DecodeBPTC(const gli::texture& texture)
+    {
+        const gli::format format = texture.format() == gli::FORMAT_RGBA_BP_SRGB_BLOCK16 ? gli::FORMAT_RGBA8_SRGB_PACK8 : gli::FORMAT_RGBA8_UNORM_PACK8;
+        gli::texture decoded(texture.target(), format, texture.extent(), texture.layers(), texture.faces(), texture.levels());
+        for (size_t layer = 0; layer < texture.layers(); layer++)
+        for (size_t face = 0; face < texture.faces(); face++)
+        for (size_t level = 0; level < texture.levels(); level++)
+        {
+            const glm::ivec3 extent(texture.extent(level));
+            const size_t blockSlice = size_t((extent.x + 3) / 4) * ((extent.y + 3) / 4) * 16;
+            const size_t texelSlice = size_t(extent.x) * extent.y * 4;
+            auto blocks = static_cast<const uint8_t*>(texture.data(layer, face, level));
+            auto texels = static_cast<uint8_t*>(decoded.data(layer, face, level));
+            for (int z = 0; z < extent.z; z++)
+            {
+                if (!asset::DecodeBC7(blocks + z * blockSlice, extent.x, extent.y, texels + z * texelSlice))
+                    fprintf(stderr, "BC7 blocks with partitions are not decoded\n");
+            }
+        }
+        return decoded;
+    }
+}
+
 OGLTexture::OGLTexture()
     : m_TextureID(0)
     , m_Target(GL_INVALID_ENUM)
@@ -19,7 +54,7 @@ OGLTexture::~OGLTexture()
 	destroy();
 }
 
-bool OGLTexture::create(GLint width, GLint height, GLenum target, GraphicsFormat format, GLuint levels, const uint8_t* data, uint32_t size) noexcept
+bool OGLTexture::create(GLint width, GLint height, GLenum target, GraphicsFormat format, GLuint levels, const uint8_t* data, uint32_t size, GLint layers) noexcept
 {
     using namespace gli;
 
@@ -30,13 +65,27 @@ bool OGLTexture::create(GLint width, GLint height, GLenum target, GraphicsFormat
 	GLuint TextureID = 0;
 	glGenTextures(1, &TextureID);
 	glBindTexture(target, TextureID);
-    glTexStorage2D(target, levels, Format.Internal, width, height);
-    if (data != nullptr && size != 0)
-    {
-        if (gli::is_compressed(format))
-            glCompressedTexSubImage2D(target, 0, 0, 0, width, height, Format.External, size, data);
-        else
-            glTexSubImage2D(target, 0, 0, 0, width, height, Format.External, Format.Type, data);
+	if (target == GL_TEXTURE_2D_ARRAY)
+	{
+		glTexStorage3D(target, levels, Format.Internal, width, height, layers);
+		if (data != nullptr && size != 0)
+		{
+			if (gli::is_compressed(format))
+				glCompressedTexSubImage3D(target, 0, 0, 0, 0, width, height, layers, Format.External, size, data);
+			else
+				glTexSubImage3D(target, 0, 0, 0, 0, width, height, layers, Format.External, Format.Type, data);
+		}
+	}
+	else
+	{
+		glTexStorage2D(target, levels, Format.Internal, width, height);
+		if (data != nullptr && size != 0)
+		{
+			if (gli::is_compressed(format))
+				glCompressedTexSubImage2D(target, 0, 0, 0, width, height, Format.External, size, data);
+			else
+				glTexSubImage2D(target, 0, 0, 0, width, height, Format.External, Format.Type, data);
+		}
 	}
 
 	m_Target = target;
@@ -53,7 +102,7 @@ bool OGLTexture::create(const GraphicsTextureDesc& desc) noexcept
     bool bSuccess = false;
     auto filename = desc.getFileName();
     if (!filename.empty())
-        bSuccess = create(filename);
+        bSuccess = create(filename, desc.isBottomUp());
     else
     {
         auto width = desc.getWidth();
@@ -63,13 +112,13 @@ bool OGLTexture::create(const GraphicsTextureDesc& desc) noexcept
         auto data = desc.getStream();
         auto size = desc.getStreamSize();
         auto target = OGLTypes::translate(desc.getTarget());
-        bSuccess = create(width, height, target, format, levels, data, size);
+        bSuccess = create(width, height, target, format, levels, data, size, desc.getDepth());
     }
-    if (bSuccess) applyParameters(desc);
+    if (bSuccess) applySampler(desc.getSamplerDesc());
     return bSuccess;
 }
 
-bool OGLTexture::create(const std::string& filename) noexcept
+bool OGLTexture::create(const std::string& filename, bool bBottomUp) noexcept
 {
     static_assert(std::is_same<char, std::istream::char_type>::value, "Compatible type needed");
 
@@ -84,7 +133,7 @@ bool OGLTexture::create(const std::string& filename) noexcept
     if (util::stricmp(ext, "zlib"))
         return createFromMemoryZIP(data->data(), data->size());
     else if (util::stricmp(ext, "DDS") || util::stricmp(ext, "KTX"))
-        return createFromMemoryDDS(data->data(), data->size());
+        return createFromMemoryDDS(data->data(), data->size(), bBottomUp);
     else if (util::stricmp(ext, "HDR"))
         return createFromMemoryHDR(data->data(), data->size());
     return createFromMemoryLDR(data->data(), data->size());
@@ -169,12 +218,14 @@ void OGLTexture::bind(GLuint unit) const
 	assert( 0u != m_TextureID );  
 	glActiveTexture(GL_TEXTURE0 + unit);
 	glBindTexture(m_Target, m_TextureID);
+	glBindSampler(unit, m_Sampler ? m_Sampler->getSamplerID() : GL_NONE);
 }
 
 void OGLTexture::unbind(GLuint unit) const
 {
 	glActiveTexture(GL_TEXTURE0 + unit);
 	glBindTexture(m_Target, 0u);
+	glBindSampler(unit, GL_NONE);
 }
 
 void OGLTexture::generateMipmap()
@@ -186,53 +237,12 @@ void OGLTexture::generateMipmap()
 	glGenerateMipmap(m_Target);
 }
 
-void OGLTexture::applyParameters(const GraphicsTextureDesc& desc)
-{
-    auto wrapS = desc.getWrapS();
-    auto wrapT = desc.getWrapT();
-    auto wrapR = desc.getWrapR();
-    auto defaultWrap = GL_REPEAT;
-
-    if (wrapS != defaultWrap)
-        parameteri(GL_TEXTURE_WRAP_S, wrapS);
-    if (wrapT != defaultWrap)
-        parameteri(GL_TEXTURE_WRAP_T, wrapS);
-    if (wrapR != defaultWrap)
-        parameteri(GL_TEXTURE_WRAP_R, wrapR);
-
-    auto minFilter = desc.getMinFilter();
-    auto magFilter = desc.getMagFilter();
-    auto defaultMinFilter = GL_LINEAR_MIPMAP_LINEAR;
-    auto defaultMagFilter = GL_LINEAR;
-    assert(magFilter == GL_NEAREST || magFilter == GL_LINEAR);
-    if (minFilter != defaultMinFilter)
-        parameteri(GL_TEXTURE_MIN_FILTER, minFilter);
-    if (magFilter != defaultMagFilter)
-        parameteri(GL_TEXTURE_MAG_FILTER, magFilter);
-
-    GLfloat defaultAnisoLevel = 0;
-    auto anisoLevel = desc.getAnisotropyLevel();
-    if (anisoLevel > defaultAnisoLevel)
-        parameterf(GL_TEXTURE_MAX_ANISOTROPY_EXT, anisoLevel);
-}
-
-
-void OGLTexture::parameteri(GLenum pname, GLint param)
-{
-	assert(m_Target != GL_INVALID_ENUM);
-	assert(m_TextureID != 0);
-
-	glBindTexture(m_Target, m_TextureID);
-    glTexParameteri(m_Target, pname, param);
-}
-
-void OGLTexture::parameterf(GLenum pname, GLfloat param)
+void OGLTexture::applySampler(const GraphicsSamplerDesc& desc) noexcept
 {
-	assert(m_Target != GL_INVALID_ENUM);
-	assert(m_TextureID != 0);
-
-	glBindTexture(m_Target, m_TextureID);
-    glTexParameterf(m_Target, pname, param);
+    auto device = getDevice();
+    auto sampler = device ? device->createSampler(desc) : nullptr;
+    if (sampler)
+        m_Sampler = sampler->downcast_pointer<OGLSampler>();
 }
 
 bool OGLTexture::createFromMemory(const char* data, size_t dataSize) noexcept
@@ -245,13 +255,16 @@ bool OGLTexture::createFromMemory(const char* data, size_t dataSize) noexcept
     return false;
 }
 
-bool OGLTexture::createFromMemoryDDS(const char* data, size_t dataSize) noexcept
+bool OGLTexture::createFromMemoryDDS(const char* data, size_t dataSize, bool bBottomUp) noexcept
 {
 	gli::texture Texture = gli::load(data, dataSize);
 	if (Texture.empty())
 		return false;
 
-    Texture = gli::flip(Texture);
+	if (IsBPTC(Texture.format()) && !GLEW_ARB_texture_compression_bptc)
+		Texture = DecodeBPTC(Texture);
+	if (!bBottomUp)
+		Texture = gli::flip(Texture);
 
 	gli::gl GL(gli::gl::PROFILE_GL33);
 	gli::gl::format const Format = GL.translate(Texture.format(), Texture.swizzles());
@@ -15,8 +15,10 @@ public:
     virtual ~OGLTexture();
 
     bool create(const GraphicsTextureDesc& desc) noexcept;
-	bool create(const std::string& filename) noexcept;
-	bool create(GLint width, GLint height, GLenum target, GraphicsFormat format, GLuint levels, const uint8_t* data, uint32_t size) noexcept;
+	// 'bBottomUp' DDS files are already in the GL row order, the others are flipped
+	bool create(const std::string& filename, bool bBottomUp = false) noexcept;
+	// 'layers' of a 2D array, 'data' then holds the first level of each layer
+	bool create(GLint width, GLint height, GLenum target, GraphicsFormat format, GLuint levels, const uint8_t* data, uint32_t size, GLint layers = 1) noexcept;
 	void destroy() noexcept;
 	void bind(GLuint unit) const;
 	void unbind(GLuint unit) const;
@@ -29,12 +31,12 @@ public:
 
 private:
 
-    void applyParameters(const GraphicsTextureDesc& desc);
-	void parameteri(GLenum pname, GLint param);
-	void parameterf(GLenum pname, GLfloat param);
+    // the sampler of 'desc' from the cache of the device, the texture
+    // parameters are left alone without a device
+    void applySampler(const GraphicsSamplerDesc& desc) noexcept;
 
     bool createFromMemory(const char* data, size_t dataSize) noexcept;
-    bool createFromMemoryDDS(const char* data, size_t dataSize) noexcept; // DDS, KTX
+    bool createFromMemoryDDS(const char* data, size_t dataSize, bool bBottomUp = false) noexcept; // DDS, KTX
     bool createFromMemoryHDR(const char* data, size_t dataSize) noexcept; // HDR
     bool createFromMemoryLDR(const char* data, size_t dataSize) noexcept; // JPG, PNG, TGA, BMP, PSD, GIF, HDR, PIC files
     bool createFromMemoryZIP(const char* data, size_t dataSize) noexcept; // ZLIB
@@ -57,6 +59,7 @@ private:
 	GLuint m_TextureID;
 	GLenum m_Target;
 	GLenum m_Format;
+	OGLSamplerPtr m_Sampler;
 	GraphicsDeviceWeakPtr m_Device;
 };
 
@@ -20,6 +20,8 @@
 #include <GLType/OGLCoreGraphicsData.h>
 #include <GLType/OGLTexture.h>
 #include <GLType/OGLCoreTexture.h>
+#include <GLType/OGLTypes.h>
+#include <GLType/ResourceCache.h>
 
 #include "ProgramShader.h"
 
@@ -36,6 +38,24 @@ ProgramShader::~ProgramShader() noexcept
     destroy(); 
 }
 
+ShaderPtr ProgramShader::create(const GraphicsDevicePtr& device, const ProgramStages& stages) noexcept
+{
+    assert(device);
+    std::string key;
+    for (auto& stage : stages)
+        key += std::to_string(stage.first) + " " + stage.second + ";";
+
+    return device->getResourceCache().findOrCreate<ProgramShader>(key, [&]() {
+        auto program = std::make_shared<ProgramShader>();
+        program->setDevice(device);
+        program->initialize();
+        for (auto& stage : stages)
+            program->addShader(stage.first, stage.second);
+        program->link();
+        return program;
+    });
+}
+
 bool ProgramShader::initialize() noexcept
 {
     assert(m_ShaderID == GL_NONE);
@@ -189,6 +209,20 @@ bool ProgramShader::setUniform(const std::string& name, const glm::vec2& v) cons
     return true;
 }
 
+bool ProgramShader::setUniform(const std::string& name, const glm::ivec2& v) const
+{
+    GLint loc = glGetUniformLocation(m_ShaderID, name.c_str());
+
+    if(-1 == loc)
+    {
+        printf("ProgramShader : can't find uniform \"%s\".\n", name.c_str());
+        return false;
+    }
+
+    glUniform2iv(loc, 1, glm::value_ptr(v));
+    return true;
+}
+
 bool ProgramShader::setUniform(const std::string &name, const glm::vec3 &v) const
 {
     GLint loc = glGetUniformLocation(m_ShaderID, name.c_str());
@@ -342,8 +376,10 @@ bool ProgramShader::bindImage(const std::string &name, const OGLCoreTexturePtr &
     // Bind the buffer object to the uniform block
     if (type == GraphicsDeviceType::GraphicsDeviceTypeOpenGLCore)
     {
+        // the texture keeps the gli format, the image unit wants the internal one
         auto tex = texture->downcast_pointer<OGLCoreTexture>();
-        glBindImageTexture(unit, tex->getTextureID(), level, layered, layer, access, tex->getFormat());
+        auto format = OGLTypes::translate(GraphicsFormat(tex->getFormat()));
+        glBindImageTexture(unit, tex->getTextureID(), level, layered, layer, access, format);
         glUniform1i(loc, unit);
         return true;
     }
@@ -7,10 +7,21 @@
 #include <GraphicsTypes.h>
 #include <vector>
 #include <map>
+#include <utility>
+
+typedef std::shared_ptr<class ProgramShader> ShaderPtr;
+
+// the stage and glsw tag ("File.Section") of each shader of a program
+typedef std::vector<std::pair<GLenum, std::string>> ProgramStages;
 
 class ProgramShader
 {
 public:
+
+    // initialized, compiled and linked; the programs of the same stages are
+    // shared through the resource cache of the device
+    static ShaderPtr create(const GraphicsDevicePtr& device, const ProgramStages& stages) noexcept;
+
     ProgramShader() noexcept;
     virtual ~ProgramShader() noexcept;
     
@@ -40,6 +51,7 @@ public:
     bool setUniform(const std::string& name, GLint v) const;
     bool setUniform(const std::string& name, GLfloat v) const;
     bool setUniform(const std::string& name, const glm::vec2& v) const;
+    bool setUniform(const std::string& name, const glm::ivec2& v) const;
     bool setUniform(const std::string& name, const glm::vec3& v) const;
     bool setUniform(const std::string& name, const glm::vec4& v) const;
     bool setUniform(const std::string& name, const glm::vec4* v, size_t count) const;
@@ -0,0 +1,118 @@
+#include <GLType/RenderTargetPool.h>
+#include <GLType/GraphicsDevice.h>
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+    bool IsCompatible(const GraphicsTextureDesc& a, const GraphicsTextureDesc& b)
+    {
+        return a.getWidth() == b.getWidth()
+            && a.getHeight() == b.getHeight()
+            && a.getDepth() == b.getDepth()
+            && a.getLevels() == b.getLevels()
+            && a.getTarget() == b.getTarget()
+            && a.getFormat() == b.getFormat()
+            && a.getSamplerDesc() == b.getSamplerDesc();
+    }
+
+    uint64_t GetTextureBytes(const GraphicsTextureDesc& desc)
+    {
+        const auto extent = gli::block_extent(desc.getFormat());
+        const uint64_t blockSize = gli::block_size(desc.getFormat());
+        uint64_t bytes = 0;
+        for (int32_t level = 0; level < desc.getLevels(); level++)
+        {
+            const uint64_t width = std::max(desc.getWidth() >> level, 1);
+            const uint64_t height = std::max(desc.getHeight() >> level, 1);
+            bytes += ((width + extent.x - 1) / extent.x) * ((height + extent.y - 1) / extent.y) * blockSize;
+        }
+        return bytes * std::max(desc.getDepth(), 1);
+    }
+}
+
+RenderTargetPool::RenderTargetPool(GraphicsDevice& device) noexcept
+    : m_Device(device)
+    , m_Frame(0)
+{
+}
+
+RenderTargetPool::~RenderTargetPool() noexcept
+{
+}
+
+GraphicsTexturePtr RenderTargetPool::acquire(const GraphicsTextureDesc& desc) noexcept
+{
+    assert(desc.getFileName().empty() && desc.getStream() == nullptr);
+
+    GraphicsTextureDesc bucketDesc = desc;
+    bucketDesc.setWidth(getBucketSize(desc.getWidth()));
+    bucketDesc.setHeight(getBucketSize(desc.getHeight()));
+
+    for (auto& entry : m_Entries)
+    {
+        if (entry.Texture.use_count() == 1 && IsCompatible(entry.Texture->getGraphicsTextureDesc(), bucketDesc))
+        {
+            entry.LastFrame = m_Frame;
+            return entry.Texture;
+        }
+    }
+
+    auto texture = m_Device.createTexture(bucketDesc);
+    if (!texture)
+        return nullptr;
+    m_Entries.push_back({ texture, GetTextureBytes(bucketDesc), m_Frame });
+    return texture;
+}
+
+GraphicsTexturePtr RenderTargetPool::acquire(const GraphicsTextureDesc& desc, const GraphicsTexturePtr& current) noexcept
+{
+    if (current)
+    {
+        GraphicsTextureDesc bucketDesc = desc;
+        bucketDesc.setWidth(getBucketSize(desc.getWidth()));
+        bucketDesc.setHeight(getBucketSize(desc.getHeight()));
+        if (IsCompatible(current->getGraphicsTextureDesc(), bucketDesc))
+            return current;
+    }
+    return acquire(desc);
+}
+
+void RenderTargetPool::update() noexcept
+{
+    m_Frame++;
+
+    // the held textures are in use, the others wait for a while in case
+    // the size comes back
+    for (auto& entry : m_Entries)
+    {
+        if (entry.Texture.use_count() > 1)
+            entry.LastFrame = m_Frame;
+    }
+    m_Entries.erase(std::remove_if(m_Entries.begin(), m_Entries.end(),
+        [this](const Entry& entry) { return m_Frame - entry.LastFrame > MaxIdleFrames; }),
+        m_Entries.end());
+}
+
+void RenderTargetPool::clear() noexcept
+{
+    m_Entries.clear();
+}
+
+int32_t RenderTargetPool::getBucketSize(int32_t size) noexcept
+{
+    return std::max((size + SizeBucket - 1) / SizeBucket, 1) * SizeBucket;
+}
+
+uint32_t RenderTargetPool::getTextureCount() const noexcept
+{
+    return uint32_t(m_Entries.size());
+}
+
+uint64_t RenderTargetPool::getTextureBytes() const noexcept
+{
+    uint64_t bytes = 0;
+    for (auto& entry : m_Entries)
+        bytes += entry.Bytes;
+    return bytes;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <GraphicsTypes.h>
+#include <GLType/GraphicsTexture.h>
+#include <vector>
+
+class GraphicsDevice;
+
+// Render targets shared by size, format and usage (target, levels and
+// sampler). The sizes are rounded up to buckets so that a window resize
+// within a bucket keeps the textures: the passes render and read the
+// requested size, a viewport in the corner of the texture. A texture is
+// free once the pool holds its last reference, so the transient targets a
+// pass drops at its end are taken by the next pass asking for the same
+// description in the frame. GL thread only.
+class RenderTargetPool final
+{
+public:
+
+    static const int32_t SizeBucket = 128;
+
+    // the textures free for that many updates are released
+    static const uint32_t MaxIdleFrames = 60;
+
+    explicit RenderTargetPool(GraphicsDevice& device) noexcept;
+    ~RenderTargetPool() noexcept;
+
+    // the width and height of 'desc' are the viewport, the texture is at
+    // least that large; the content is undefined
+    GraphicsTexturePtr acquire(const GraphicsTextureDesc& desc) noexcept;
+
+    // 'current' when it still fits 'desc', for the targets kept across
+    // resizes : a held texture is never free for the first overload
+    GraphicsTexturePtr acquire(const GraphicsTextureDesc& desc, const GraphicsTexturePtr& current) noexcept;
+
+    // once per frame
+    void update() noexcept;
+    void clear() noexcept;
+
+    static int32_t getBucketSize(int32_t size) noexcept;
+
+    uint32_t getTextureCount() const noexcept;
+    uint64_t getTextureBytes() const noexcept;
+
+private:
+
+    struct Entry
+    {
+        GraphicsTexturePtr Texture;
+        uint64_t Bytes;
+        uint64_t LastFrame;     // of the last acquire or use
+    };
+
+    GraphicsDevice& m_Device;
+    std::vector<Entry> m_Entries;
+    uint64_t m_Frame;
+};
@@ -0,0 +1,33 @@
+#include <GLType/ResourceCache.h>
+
+ResourceCache::ResourceCache() noexcept
+{
+}
+
+ResourceCache::~ResourceCache() noexcept
+{
+}
+
+void ResourceCache::clear() noexcept
+{
+    m_Resources.clear();
+}
+
+size_t ResourceCache::getResourceCount() const noexcept
+{
+    size_t count = 0;
+    for (auto& it : m_Resources)
+        count += it.second.expired() ? 0 : 1;
+    return count;
+}
+
+void ResourceCache::purge() noexcept
+{
+    for (auto it = m_Resources.begin(); it != m_Resources.end();)
+    {
+        if (it->second.expired())
+            it = m_Resources.erase(it);
+        else
+            ++it;
+    }
+}
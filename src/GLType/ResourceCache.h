@@ -0,0 +1,58 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <utility>
+
+// Weak references to the resources of the device by type and key (a path
+// and the description it was created with). A resource is shared by every
+// caller asking for the same key and lives as long as one of them holds it,
+// then the next request creates it again. GL thread only.
+class ResourceCache final
+{
+public:
+
+    ResourceCache() noexcept;
+    ~ResourceCache() noexcept;
+
+    // 'create' returns a std::shared_ptr<T>, called when no live resource
+    // matches; a null result is not cached
+    template <typename T, typename Create>
+    std::shared_ptr<T> findOrCreate(const std::string& key, Create&& create);
+
+    void clear() noexcept;
+
+    // of the live resources
+    size_t getResourceCount() const noexcept;
+
+private:
+
+    // drops the entries of the released resources
+    void purge() noexcept;
+
+    typedef std::pair<std::type_index, std::string> Key;
+    std::map<Key, std::weak_ptr<void>> m_Resources;
+};
+
+template <typename T, typename Create>
+std::shared_ptr<T> ResourceCache::findOrCreate(const std::string& key, Create&& create)
+{
+    const Key cacheKey(std::type_index(typeid(T)), key);
+    auto it = m_Resources.find(cacheKey);
+    if (it != m_Resources.end())
+    {
+        auto resource = it->second.lock();
+        if (resource)
+            return std::static_pointer_cast<T>(resource);
+    }
+
+    std::shared_ptr<T> resource = create();
+    if (resource)
+    {
+        purge();
+        m_Resources[cacheKey] = resource;
+    }
+    return resource;
+}
@@ -0,0 +1,298 @@
+#include <GLType/TextureFile.h>
+#include <tools/FileUtility.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+TextureFile::TextureFile() noexcept
+    : Target(gli::TARGET_2D)
+    , Format(gli::FORMAT_UNDEFINED)
+    , Swizzles(gli::SWIZZLE_RED, gli::SWIZZLE_GREEN, gli::SWIZZLE_BLUE, gli::SWIZZLE_ALPHA)
+    , Extent(0)
+    , Layers(0)
+    , Faces(0)
+    , Levels(0)
+    , bFlipped(false)
+{
+}
+
+gli::extent3d TextureFile::extent(size_t level) const noexcept
+{
+    return glm::max(Extent >> gli::extent3d(static_cast<int>(level)), gli::extent3d(1));
+}
+
+size_t TextureFile::size(size_t level) const noexcept
+{
+    const gli::extent3d blockExtent = gli::block_extent(Format);
+    const gli::extent3d blocks = (extent(level) + blockExtent - 1) / blockExtent;
+    return gli::block_size(Format) * blocks.x * blocks.y * blocks.z;
+}
+
+const uint8_t* TextureFile::data(size_t layer, size_t face, size_t level) const noexcept
+{
+    assert(layer < Layers && face < Faces && level < Levels);
+    return Images[(layer * Faces + face) * Levels + level];
+}
+
+namespace
+{
+    // legacy uncompressed DDS, the candidates in the order gli::load_dds tries them
+    gli::format FindMaskFormat(uint32_t bpp, const glm::u32vec4& mask) noexcept
+    {
+        static const gli::format formats8[] = {
+            gli::FORMAT_RG4_UNORM_PACK8, gli::FORMAT_L8_UNORM_PACK8, gli::FORMAT_A8_UNORM_PACK8,
+            gli::FORMAT_R8_UNORM_PACK8, gli::FORMAT_RG3B2_UNORM_PACK8 };
+        static const gli::format formats16[] = {
+            gli::FORMAT_RGBA4_UNORM_PACK16, gli::FORMAT_BGRA4_UNORM_PACK16, gli::FORMAT_R5G6B5_UNORM_PACK16,
+            gli::FORMAT_B5G6R5_UNORM_PACK16, gli::FORMAT_RGB5A1_UNORM_PACK16, gli::FORMAT_BGR5A1_UNORM_PACK16,
+            gli::FORMAT_LA8_UNORM_PACK8, gli::FORMAT_RG8_UNORM_PACK8, gli::FORMAT_L16_UNORM_PACK16,
+            gli::FORMAT_A16_UNORM_PACK16, gli::FORMAT_R16_UNORM_PACK16 };
+        static const gli::format formats24[] = {
+            gli::FORMAT_RGB8_UNORM_PACK8, gli::FORMAT_BGR8_UNORM_PACK8 };
+        static const gli::format formats32[] = {
+            gli::FORMAT_BGR8_UNORM_PACK32, gli::FORMAT_BGRA8_UNORM_PACK8, gli::FORMAT_RGBA8_UNORM_PACK8,
+            gli::FORMAT_RGB10A2_UNORM_PACK32, gli::FORMAT_LA16_UNORM_PACK16, gli::FORMAT_RG16_UNORM_PACK16,
+            gli::FORMAT_R32_SFLOAT_PACK32 };
+
+        const gli::format* begin = nullptr;
+        const gli::format* end = nullptr;
+        switch (bpp)
+        {
+        case 8: begin = std::begin(formats8); end = std::end(formats8); break;
+        case 16: begin = std::begin(formats16); end = std::end(formats16); break;
+        case 24: begin = std::begin(formats24); end = std::end(formats24); break;
+        case 32: begin = std::begin(formats32); end = std::end(formats32); break;
+        default: return gli::FORMAT_UNDEFINED;
+        }
+
+        gli::dx DX;
+        for (auto it = begin; it != end; ++it)
+        {
+            if (glm::all(glm::equal(mask, DX.translate(*it).Mask)))
+                return *it;
+        }
+        return gli::FORMAT_UNDEFINED;
+    }
+
+    // images stored back to back from 'offset', false when the file is too short
+    bool SetImages(TextureFile& file, const uint8_t* data, size_t size, size_t offset) noexcept
+    {
+        file.Images.resize(file.Layers * file.Faces * file.Levels);
+        for (size_t layer = 0; layer < file.Layers; layer++)
+        for (size_t face = 0; face < file.Faces; face++)
+        for (size_t level = 0; level < file.Levels; level++)
+        {
+            const size_t imageSize = file.size(level);
+            if (offset + imageSize > size)
+            {
+                file.Images.clear();
+                return false;
+            }
+            file.Images[(layer * file.Faces + face) * file.Levels + level] = data + offset;
+            offset += imageSize;
+        }
+        return true;
+    }
+
+    bool ParseDDS(const uint8_t* data, size_t size, TextureFile& file) noexcept
+    {
+        using namespace gli;
+
+        size_t offset = sizeof(gli::detail::FOURCC_DDS);
+        if (size < offset + sizeof(gli::detail::dds_header))
+            return false;
+
+        gli::detail::dds_header header;
+        std::memcpy(&header, data + offset, sizeof(header));
+        offset += sizeof(header);
+
+        const bool bDX10 = (header.Format.flags & dx::DDPF_FOURCC)
+            && (header.Format.fourCC == dx::D3DFMT_DX10 || header.Format.fourCC == dx::D3DFMT_GLI1);
+        gli::detail::dds_header10 header10;
+        if (bDX10)
+        {
+            if (size < offset + sizeof(header10))
+                return false;
+            std::memcpy(&header10, data + offset, sizeof(header10));
+            offset += sizeof(header10);
+        }
+
+        dx DX;
+        format Format = FORMAT_UNDEFINED;
+        if ((header.Format.flags & (dx::DDPF_RGB | dx::DDPF_ALPHAPIXELS | dx::DDPF_ALPHA | dx::DDPF_YUV | dx::DDPF_LUMINANCE)) && header.Format.bpp != 0)
+            Format = FindMaskFormat(header.Format.bpp, header.Format.Mask);
+        else if (bDX10)
+            Format = DX.find(header.Format.fourCC, header10.Format);
+        else if (header.Format.flags & dx::DDPF_FOURCC)
+            Format = DX.find(gli::detail::remap_four_cc(header.Format.fourCC));
+        if (!is_valid(Format))
+            return false;
+
+        file.Target = gli::detail::get_target(header, header10);
+        file.Format = Format;
+        file.Extent = extent3d(header.Width, header.Height,
+            (header.CubemapFlags & gli::detail::DDSCAPS2_VOLUME) ? header.Depth : 1);
+        file.Extent = glm::max(file.Extent, extent3d(1));
+        file.Layers = std::max<size_t>(header10.ArraySize, 1);
+        file.Faces = (header.CubemapFlags & gli::detail::DDSCAPS2_CUBEMAP)
+            ? glm::bitCount(header.CubemapFlags & gli::detail::DDSCAPS2_CUBEMAP_ALLFACES) : 1;
+        file.Levels = (header.Flags & gli::detail::DDSD_MIPMAPCOUNT) ? std::max<size_t>(header.MipMapLevels, 1) : 1;
+        file.bFlipped = false;
+
+        // the images follow each other in the file as in a gli::texture
+        return SetImages(file, data, size, offset);
+    }
+
+    bool ParseKTX(const uint8_t* data, size_t size, TextureFile& file) noexcept
+    {
+        using namespace gli;
+
+        size_t offset = sizeof(gli::detail::FOURCC_KTX10);
+        if (size < offset + sizeof(gli::detail::ktx_header10))
+            return false;
+
+        gli::detail::ktx_header10 header;
+        std::memcpy(&header, data + offset, sizeof(header));
+        offset += sizeof(header) + header.BytesOfKeyValueData;
+
+        gl GL(gl::PROFILE_KTX);
+        const format Format = GL.find(
+            static_cast<gl::internal_format>(header.GLInternalFormat),
+            static_cast<gl::external_format>(header.GLFormat),
+            static_cast<gl::type_format>(header.GLType));
+        if (!is_valid(Format))
+            return false;
+
+        file.Target = gli::detail::get_target(header);
+        file.Format = Format;
+        file.Extent = extent3d(header.PixelWidth,
+            std::max<uint32_t>(header.PixelHeight, 1),
+            std::max<uint32_t>(header.PixelDepth, 1));
+        file.Layers = std::max<size_t>(header.NumberOfArrayElements, 1);
+        file.Faces = std::max<size_t>(header.NumberOfFaces, 1);
+        file.Levels = std::max<size_t>(header.NumberOfMipmapLevels, 1);
+        file.bFlipped = false;
+
+        // level major, each level starts with its image size and every image
+        // is padded to 4 bytes
+        const size_t blockSize = block_size(Format);
+        file.Images.resize(file.Layers * file.Faces * file.Levels);
+        for (size_t level = 0; level < file.Levels; level++)
+        {
+            offset += sizeof(uint32_t);
+            const size_t imageSize = file.size(level);
+            for (size_t layer = 0; layer < file.Layers; layer++)
+            for (size_t face = 0; face < file.Faces; face++)
+            {
+                if (offset + imageSize > size)
+                {
+                    file.Images.clear();
+                    return false;
+                }
+                file.Images[(layer * file.Faces + face) * file.Levels + level] = data + offset;
+                offset += std::max(blockSize, (imageSize + 3) / 4 * 4);
+            }
+        }
+        return true;
+    }
+}
+
+bool ParseTextureFile(const uint8_t* data, size_t size, TextureFile& file) noexcept
+{
+    file.Images.clear();
+    if (data == nullptr)
+        return false;
+    if (size >= sizeof(gli::detail::FOURCC_DDS) && std::memcmp(data, gli::detail::FOURCC_DDS, sizeof(gli::detail::FOURCC_DDS)) == 0)
+        return ParseDDS(data, size, file);
+    if (size >= sizeof(gli::detail::FOURCC_KTX10) && std::memcmp(data, gli::detail::FOURCC_KTX10, sizeof(gli::detail::FOURCC_KTX10)) == 0)
+        return ParseKTX(data, size, file);
+    return false;
+}
+
+bool MapTextureFile(const std::string& filename, TextureFile& file, bool bPrefetch) noexcept
+{
+    auto mapping = util::MapFileSync(filename);
+    if (!mapping || !ParseTextureFile(mapping->data(), mapping->size(), file))
+        return false;
+    if (bPrefetch)
+        mapping->prefetch();
+    file.Storage = mapping;
+    return true;
+}
+
+void PrefetchTextureLevels(const TextureFile& file, size_t first, size_t last) noexcept
+{
+    const size_t pageSize = 4096;
+    volatile uint8_t sum = 0;
+    for (size_t layer = 0; layer < file.Layers; layer++)
+    for (size_t face = 0; face < file.Faces; face++)
+    for (size_t level = first; level < last; level++)
+    {
+        const uint8_t* data = file.data(layer, face, level);
+        const size_t size = file.size(level);
+        for (size_t offset = 0; offset < size; offset += pageSize)
+            sum += data[offset];
+        sum += data[size - 1];
+    }
+    (void)sum;
+}
+
+void MakeTextureFile(gli::texture&& texture, TextureFile& file) noexcept
+{
+    auto storage = std::make_shared<gli::texture>(std::move(texture));
+    file.Target = storage->target();
+    file.Format = storage->format();
+    file.Swizzles = storage->swizzles();
+    file.Extent = storage->extent();
+    file.Layers = storage->layers();
+    file.Faces = storage->faces();
+    file.Levels = storage->levels();
+    file.bFlipped = true;
+    file.Images.clear();
+    for (size_t layer = 0; layer < file.Layers; layer++)
+    for (size_t face = 0; face < file.Faces; face++)
+    for (size_t level = 0; level < file.Levels; level++)
+        file.Images.push_back(static_cast<const uint8_t*>(storage->data(layer, face, level)));
+    file.Storage = storage;
+}
+
+void CopyTextureImage(const TextureFile& file, size_t layer, size_t face, size_t level, uint8_t* dst) noexcept
+{
+    const uint8_t* src = file.data(layer, face, level);
+    const size_t size = file.size(level);
+    const gli::extent3d extent = file.extent(level);
+
+    // gli::flip only handles these, the others are uploaded as stored
+    const bool bFlip = !file.bFlipped && extent.y > 1
+        && (file.Target == gli::TARGET_2D || file.Target == gli::TARGET_2D_ARRAY
+            || file.Target == gli::TARGET_CUBE || file.Target == gli::TARGET_CUBE_ARRAY)
+        && (!gli::is_compressed(file.Format) || gli::is_s3tc_compressed(file.Format));
+    if (!bFlip)
+    {
+        std::memcpy(dst, src, size);
+        return;
+    }
+
+    const size_t blockSize = gli::block_size(file.Format);
+    if (!gli::is_compressed(file.Format))
+    {
+        const size_t rowSize = blockSize * extent.x;
+        for (int y = 0; y < extent.y; y++)
+            std::memcpy(dst + rowSize * y, src + rowSize * (extent.y - y - 1), rowSize);
+        return;
+    }
+
+    // whole blocks rows are swapped and the rows inside each block reversed,
+    // a 2 texels high image only has its two first rows swapped
+    const size_t blocksX = (extent.x + 3) / 4;
+    const size_t blocksY = (extent.y + 3) / 4;
+    const size_t rowSize = blockSize * blocksX;
+    const bool bHeightTwo = extent.y == 2;
+    for (size_t y = 0; y < blocksY; y++)
+    {
+        uint8_t* rowDst = dst + rowSize * (blocksY - y - 1);
+        uint8_t* rowSrc = const_cast<uint8_t*>(src) + rowSize * y;
+        for (size_t x = 0; x < blocksX; x++)
+            gli::detail::flip_block_s3tc(rowDst + blockSize * x, rowSrc + blockSize * x, file.Format, bHeightTwo);
+    }
+}
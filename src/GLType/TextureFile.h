@@ -0,0 +1,50 @@
+#pragma once
+
+#include <GraphicsTypes.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// View of the images of a DDS or KTX file, parsed in place : the pointers
+// are into the file memory (usually a mapping) which 'Storage' keeps alive,
+// nothing is copied until the images are written to the upload memory.
+// Decoded images (stb_image, zlib) are wrapped the same way.
+struct TextureFile
+{
+    gli::target Target;
+    gli::format Format;
+    gli::swizzles Swizzles;
+    gli::extent3d Extent;
+    size_t Layers;
+    size_t Faces;
+    size_t Levels;
+    bool bFlipped;                          // rows already bottom-up, set by the loader
+    std::vector<const uint8_t*> Images;     // layer, face, level order
+    std::shared_ptr<const void> Storage;
+
+    TextureFile() noexcept;
+
+    bool empty() const noexcept { return Images.empty(); }
+    size_t count() const noexcept { return Images.size(); }
+
+    gli::extent3d extent(size_t level) const noexcept;
+    size_t size(size_t level) const noexcept;
+    const uint8_t* data(size_t layer, size_t face, size_t level) const noexcept;
+};
+
+// DDS (FourCC, DX10, legacy masks) or KTX 1.1, false when unknown or truncated
+bool ParseTextureFile(const uint8_t* data, size_t size, TextureFile& file) noexcept;
+
+// maps the file and parses it, the mapping is owned by 'file'; a loader
+// thread prefetches the pages so that the GL thread does not fault them in
+bool MapTextureFile(const std::string& filename, TextureFile& file, bool bPrefetch = false) noexcept;
+
+// faults in the pages of the levels [first, last) of a mapped file
+void PrefetchTextureLevels(const TextureFile& file, size_t first, size_t last) noexcept;
+
+// takes the ownership of an already flipped decoded texture
+void MakeTextureFile(gli::texture&& texture, TextureFile& file) noexcept;
+
+// copies an image to the upload memory, flipping it bottom-up on the way
+// when the file is top-down (the same conventions as gli::flip)
+void CopyTextureImage(const TextureFile& file, size_t layer, size_t face, size_t level, uint8_t* dst) noexcept;
@@ -0,0 +1,246 @@
+#include <GLType/TextureStreamer.h>
+#include <GLType/OGLCoreTexture.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+TextureStreamer::TextureStreamer() noexcept
+    : m_NextID(0)
+    , m_PendingCount(0)
+    , m_Frame(0)
+    , m_Budget(256ull << 20)
+    , m_EvictedLevels(0)
+    , m_RateTime(std::chrono::steady_clock::now())
+    , m_RateBytes(0)
+    , m_UploadRate(0.f)
+{
+}
+
+TextureStreamer::~TextureStreamer() noexcept
+{
+}
+
+void TextureStreamer::setBudget(uint64_t bytes) noexcept
+{
+    m_Budget = bytes;
+}
+
+bool TextureStreamer::add(const OGLCoreTexturePtr& texture, const std::string& filename, bool bBottomUp, AsyncTextureLoader& loader) noexcept
+{
+    assert(texture);
+
+    Entry entry;
+    if (!MapTextureFile(filename, entry.File))
+        return false;
+    entry.File.bFlipped = bBottomUp;
+
+    const TextureFile& file = entry.File;
+    size_t tailLevel = 0;
+    while (tailLevel + 1 < file.Levels)
+    {
+        const gli::extent3d extent = file.extent(tailLevel);
+        if (uint32_t(std::max(extent.x, extent.y)) <= TailSize)
+            break;
+        tailLevel++;
+    }
+    if (tailLevel == 0)
+        return false;
+
+    entry.Texture = texture;
+    entry.Key = texture.get();
+    entry.TailLevel = tailLevel;
+    entry.ResidentLevel = file.Levels;
+    entry.WantedLevel = tailLevel;
+    entry.PendingLevel = InvalidLevel;
+    entry.RequestFrame = 0;
+    entry.bFailed = false;
+    entry.LevelBytes.resize(file.Levels);
+    for (size_t level = 0; level < file.Levels; level++)
+        entry.LevelBytes[level] = uint64_t(file.size(level)) * file.Layers * file.Faces;
+
+    // the tail is always resident, whatever the budget
+    const uint32_t id = m_NextID++;
+    m_Lookup[entry.Key] = id;
+    Entry& added = m_Entries.emplace(id, std::move(entry)).first->second;
+    stream(added, id, tailLevel, loader);
+    return true;
+}
+
+void TextureStreamer::request(const OGLCoreTexture* texture, float uvPerPixel) noexcept
+{
+    auto it = m_Lookup.find(texture);
+    if (it == m_Lookup.end())
+        return;
+
+    Entry& entry = m_Entries[it->second];
+    const gli::extent3d extent = entry.File.Extent;
+    const float texelsPerPixel = uvPerPixel * float(std::max(extent.x, extent.y));
+    const float level = texelsPerPixel > 1.f ? std::floor(std::log2(texelsPerPixel)) : 0.f;
+    const size_t wanted = std::min(size_t(level), entry.TailLevel);
+
+    if (entry.RequestFrame != m_Frame)
+        entry.WantedLevel = wanted;
+    else
+        entry.WantedLevel = std::min(entry.WantedLevel, wanted);
+    entry.RequestFrame = m_Frame;
+}
+
+void TextureStreamer::clear() noexcept
+{
+    m_Entries.clear();
+    m_Lookup.clear();
+    m_Streamed.clear();
+    m_PendingCount = 0;
+}
+
+uint64_t TextureStreamer::residentBytes(const Entry& entry, size_t level) noexcept
+{
+    uint64_t bytes = 0;
+    for (size_t i = level; i < entry.LevelBytes.size(); i++)
+        bytes += entry.LevelBytes[i];
+    return bytes;
+}
+
+void TextureStreamer::stream(Entry& entry, uint32_t id, size_t level, AsyncTextureLoader& loader) noexcept
+{
+    auto texture = entry.Texture.lock();
+    assert(texture && entry.PendingLevel == InvalidLevel);
+
+    // the levels already resident are copied instead of read again
+    entry.PendingLevel = level;
+    m_PendingCount++;
+    loader.stream(texture, entry.File, level, std::max(level, entry.ResidentLevel), id);
+}
+
+void TextureStreamer::update(AsyncTextureLoader& loader) noexcept
+{
+    // the storages being rebuilt count with their finest levels
+    uint64_t total = 0;
+    std::vector<uint32_t> candidates;
+    for (auto it = m_Entries.begin(); it != m_Entries.end();)
+    {
+        Entry& entry = it->second;
+        if (entry.Texture.expired() && entry.PendingLevel == InvalidLevel)
+        {
+            // the address may already be reused by a newer texture
+            auto lookup = m_Lookup.find(entry.Key);
+            if (lookup != m_Lookup.end() && lookup->second == it->first)
+                m_Lookup.erase(lookup);
+            it = m_Entries.erase(it);
+            continue;
+        }
+        total += residentBytes(entry, std::min(entry.ResidentLevel, entry.PendingLevel));
+        if (!entry.Texture.expired() && !entry.bFailed && entry.PendingLevel == InvalidLevel && entry.ResidentLevel <= entry.TailLevel)
+            candidates.push_back(it->first);
+        ++it;
+    }
+
+    auto isIdle = [this](const Entry& entry) {
+        return entry.RequestFrame + IdleFrames < m_Frame;
+    };
+
+    // the levels nobody asked for first, then the least recently requested
+    if (total > m_Budget)
+    {
+        auto evictOrder = [&](uint32_t a, uint32_t b) {
+            const Entry& ea = m_Entries[a];
+            const Entry& eb = m_Entries[b];
+            const bool bNeededA = !isIdle(ea) && ea.ResidentLevel >= ea.WantedLevel;
+            const bool bNeededB = !isIdle(eb) && eb.ResidentLevel >= eb.WantedLevel;
+            if (bNeededA != bNeededB)
+                return bNeededB;
+            if (ea.RequestFrame != eb.RequestFrame)
+                return ea.RequestFrame < eb.RequestFrame;
+            return ea.ResidentLevel < eb.ResidentLevel;
+        };
+        std::sort(candidates.begin(), candidates.end(), evictOrder);
+
+        for (uint32_t id : candidates)
+        {
+            if (total <= m_Budget || m_PendingCount >= MaxPendingCount)
+                break;
+            Entry& entry = m_Entries[id];
+            if (entry.ResidentLevel >= entry.TailLevel)
+                continue;
+            total -= entry.LevelBytes[entry.ResidentLevel];
+            stream(entry, id, entry.ResidentLevel + 1, loader);
+            m_EvictedLevels++;
+        }
+    }
+    else
+    {
+        // the most recently requested first, then the furthest from their request
+        auto growOrder = [&](uint32_t a, uint32_t b) {
+            const Entry& ea = m_Entries[a];
+            const Entry& eb = m_Entries[b];
+            if (ea.RequestFrame != eb.RequestFrame)
+                return ea.RequestFrame > eb.RequestFrame;
+            return int64_t(ea.ResidentLevel) - int64_t(ea.WantedLevel) > int64_t(eb.ResidentLevel) - int64_t(eb.WantedLevel);
+        };
+        std::sort(candidates.begin(), candidates.end(), growOrder);
+
+        for (uint32_t id : candidates)
+        {
+            if (m_PendingCount >= MaxPendingCount)
+                break;
+            Entry& entry = m_Entries[id];
+            if (isIdle(entry) || entry.WantedLevel >= entry.ResidentLevel)
+                continue;
+            const uint64_t bytes = entry.LevelBytes[entry.ResidentLevel - 1];
+            if (total + bytes > m_Budget)
+                continue;
+            total += bytes;
+            stream(entry, id, entry.ResidentLevel - 1, loader);
+        }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    const float elapsed = std::chrono::duration<float>(now - m_RateTime).count();
+    if (elapsed >= 0.5f)
+    {
+        const uint64_t bytes = loader.getUploadedBytes();
+        m_UploadRate = float(bytes - m_RateBytes) / elapsed;
+        m_RateBytes = bytes;
+        m_RateTime = now;
+    }
+    m_Frame++;
+}
+
+void TextureStreamer::collect(AsyncTextureLoader& loader) noexcept
+{
+    loader.getStreamed(m_Streamed);
+    for (auto& streamed : m_Streamed)
+    {
+        auto it = m_Entries.find(streamed.ID);
+        if (it == m_Entries.end())
+            continue;
+
+        Entry& entry = it->second;
+        assert(entry.PendingLevel != InvalidLevel);
+        if (streamed.bSwapped)
+            entry.ResidentLevel = entry.PendingLevel;
+        else
+            entry.bFailed = true;
+        entry.PendingLevel = InvalidLevel;
+        m_PendingCount--;
+    }
+}
+
+TextureStreamingStats TextureStreamer::getStats() const noexcept
+{
+    TextureStreamingStats stats = {};
+    stats.TextureCount = static_cast<uint32_t>(m_Entries.size());
+    stats.PendingCount = m_PendingCount;
+    stats.BudgetBytes = m_Budget;
+    stats.EvictedLevels = m_EvictedLevels;
+    stats.UploadRate = m_UploadRate;
+    for (auto& it : m_Entries)
+    {
+        const Entry& entry = it.second;
+        const bool bIdle = entry.RequestFrame + IdleFrames < m_Frame;
+        stats.ResidentBytes += residentBytes(entry, entry.ResidentLevel);
+        stats.WantedBytes += residentBytes(entry, bIdle ? entry.TailLevel : entry.WantedLevel);
+        stats.FullBytes += residentBytes(entry, 0);
+    }
+    return stats;
+}
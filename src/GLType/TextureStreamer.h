@@ -0,0 +1,82 @@
+#pragma once
+
+#include <GraphicsTypes.h>
+#include <GLType/AsyncTextureLoader.h>
+#include <GLType/GraphicsDevice.h>
+#include <GLType/TextureFile.h>
+#include <chrono>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// Mip residency of the mapped DDS/KTX textures within a memory budget. A
+// texture starts with its levels up to TailSize texels and its storage is
+// rebuilt one level at a time by the AsyncTextureLoader : a finer level when
+// the requested density needs it and the budget allows, a coarser one when
+// the budget is exceeded, from the least recently requested textures and the
+// levels finer than requested first. The tail is never evicted.
+class TextureStreamer final
+{
+public:
+
+    static const uint32_t TailSize = 128;
+    static const uint32_t MaxPendingCount = 4;
+
+    // stops growing the textures not requested since
+    static const uint64_t IdleFrames = 60;
+
+    TextureStreamer() noexcept;
+    ~TextureStreamer() noexcept;
+
+    void setBudget(uint64_t bytes) noexcept;
+
+    // 'texture' holds its placeholder, false when the file can not be mapped
+    // or has no finer level than the tail to stream
+    bool add(const OGLCoreTexturePtr& texture, const std::string& filename, bool bBottomUp, AsyncTextureLoader& loader) noexcept;
+    void request(const OGLCoreTexture* texture, float uvPerPixel) noexcept;
+    void clear() noexcept;
+
+    // before and after AsyncTextureLoader::flush()
+    void update(AsyncTextureLoader& loader) noexcept;
+    void collect(AsyncTextureLoader& loader) noexcept;
+
+    TextureStreamingStats getStats() const noexcept;
+
+private:
+
+    static const size_t InvalidLevel = ~size_t(0);
+
+    struct Entry
+    {
+        std::weak_ptr<OGLCoreTexture> Texture;
+        const OGLCoreTexture* Key;
+        TextureFile File;
+        size_t TailLevel;
+        size_t ResidentLevel;   // file.Levels until the tail is in
+        size_t WantedLevel;
+        size_t PendingLevel;    // base of the storage being built
+        uint64_t RequestFrame;
+        bool bFailed;
+        std::vector<uint64_t> LevelBytes;
+    };
+
+    // bytes of the levels from 'level'
+    static uint64_t residentBytes(const Entry& entry, size_t level) noexcept;
+
+    // rebuilds the storage from 'level'
+    void stream(Entry& entry, uint32_t id, size_t level, AsyncTextureLoader& loader) noexcept;
+
+    std::map<uint32_t, Entry> m_Entries;
+    std::unordered_map<const OGLCoreTexture*, uint32_t> m_Lookup;
+    std::vector<AsyncTextureLoader::Streamed> m_Streamed;
+    uint32_t m_NextID;
+    uint32_t m_PendingCount;
+    uint64_t m_Frame;
+    uint64_t m_Budget;
+    uint64_t m_EvictedLevels;
+
+    // bandwidth, sampled every half second
+    std::chrono::steady_clock::time_point m_RateTime;
+    uint64_t m_RateBytes;
+    float m_UploadRate;
+};
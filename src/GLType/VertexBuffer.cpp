@@ -1,18 +1,50 @@
 /**
- * 
- *    \file VertexBuffer.cpp  
- * 
+ *
+ *    \file VertexBuffer.cpp
+ *
  */
- 
+
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include <vector>
+#include <cassert>
+#include <cstring>
+#include <cfloat>
+#include <cstddef>
 
 #include "VertexBuffer.h"
 
 
-    
+namespace {
+
+  // "A Survey of Efficient Representations for Independent Unit Vectors"
+  glm::vec2 octEncode(glm::vec3 n)
+  {
+    n /= (glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z));
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.0f)
+    {
+      glm::vec2 s(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+      e = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * s;
+    }
+    return e;
+  }
+
+  // half float keeps 10 bits of mantissa, outside this range the step
+  // is coarser than a texel of a 1k texture
+  const float kHalfTexcoordRange = 2.0f;
+
+  template <typename T>
+  void store(uint8_t* dst, const T& value)
+  {
+    memcpy(dst, &value, sizeof(T));
+  }
+}
+
+
 void VertexBuffer::initialize()
 {
   if (!m_vao) glGenVertexArrays( 1, &m_vao);
@@ -23,10 +55,13 @@ void VertexBuffer::destroy()
 {
   if (m_vao) glDeleteVertexArrays( 1, &m_vao);
   if (m_vbo) glDeleteBuffers( 1, &m_vbo);
-  
+  if (m_ibo) glDeleteBuffers( 1, &m_ibo);
+
   cleanData();
   m_vao = 0;
   m_vbo = 0;
+  m_ibo = 0;
+  m_instanceVbo = 0;
 }
 
 void VertexBuffer::cleanData()
@@ -34,51 +69,355 @@ void VertexBuffer::cleanData()
   m_position.clear();
   m_normal.clear();
   m_texcoord.clear();
+  m_indices.clear();
+}
+
+namespace {
+
+  struct AttribFormat
+  {
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    GLsizei bytes;
+  };
+
+  AttribFormat getPositionFormat(uint32_t quantization)
+  {
+    if (quantization & VertexQuantizePositionBit)
+      return { 4, GL_SHORT, GL_TRUE, 4*sizeof(int16_t) };
+    return { 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3) };
+  }
+
+  AttribFormat getNormalFormat(uint32_t quantization)
+  {
+    if (quantization & VertexQuantizeNormalBit)
+      return { 2, GL_SHORT, GL_TRUE, 2*sizeof(int16_t) };
+    return { 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2) };
+  }
+
+  AttribFormat getTexcoordFormat(uint32_t quantization)
+  {
+    if (quantization & VertexQuantizeTexcoordBit)
+      return { 2, GL_HALF_FLOAT, GL_FALSE, sizeof(uint32_t) };
+    return { 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2) };
+  }
+}
+
+
+uint32_t VertexBufferLayout::getIndexSize() const
+{
+  switch (indexType)
+  {
+    case GL_UNSIGNED_SHORT: return indexCount * sizeof(uint16_t);
+    case GL_UNSIGNED_INT: return indexCount * sizeof(uint32_t);
+    default: return 0u;
+  }
 }
 
 void VertexBuffer::complete(GLenum usage)
 {
   assert( m_vao && m_vbo );
-  
-  
-  m_positionSize = m_normalSize = m_texcoordSize = 0;  
-  if (!m_position.empty()) m_positionSize = m_position.size() * sizeof(glm::vec3);
-  if (!m_normal.empty()) m_normalSize = m_normal.size() * sizeof(glm::vec3);
-  if (!m_texcoord.empty()) m_texcoordSize  = m_texcoord.size() * sizeof(glm::vec2);  
-  
-  GLsizeiptr bufferSize = m_positionSize + m_normalSize + m_texcoordSize;
-    
-  
-  bind();
-  {    
-    glBufferData( GL_ARRAY_BUFFER, bufferSize, 0, usage);
-      
-    m_offset = 0;
-    
-    if (!m_position.empty())
+
+  std::vector<uint8_t> vertices, indices;
+  pack(vertices, indices);
+  upload(m_layout, vertices.data(), indices.data(), usage);
+}
+
+void VertexBuffer::pack(std::vector<uint8_t>& vertices, std::vector<uint8_t>& indices)
+{
+  assert( m_normal.empty() || m_normal.size() == m_position.size() );
+  assert( m_texcoord.empty() || m_texcoord.size() == m_position.size() );
+
+  VertexBufferLayout& layout = m_layout;
+  layout.vertexCount = (uint32_t)m_position.size();
+
+  if (!m_indices.empty())
+  {
+    m_cacheStats[0] = util::AnalyzeVertexCache(m_indices, layout.vertexCount);
+    if (m_bOptimize)
+      optimize();
+    m_cacheStats[1] = util::AnalyzeVertexCache(m_indices, layout.vertexCount);
+  }
+
+  layout.lodCount = 0;
+  if (!m_indices.empty())
+  {
+    layout.lods[0] = { 0u, (uint32_t)m_indices.size(), 0.f };
+    layout.lodCount = 1;
+    if (m_lodRequest > 1)
+      buildLods();
+  }
+
+  layout.boundMin = layout.boundMax = glm::vec3(0.f);
+  if (!m_position.empty())
+  {
+    layout.boundMin = layout.boundMax = m_position[0];
+    for (auto& p : m_position)
     {
-      glBufferSubData( GL_ARRAY_BUFFER, m_offset, m_positionSize, &m_position[0]);
-      glVertexAttribPointer( VATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 0, (void*)(m_offset));
-      m_offset += m_positionSize;
+      layout.boundMin = glm::min(layout.boundMin, p);
+      layout.boundMax = glm::max(layout.boundMax, p);
     }
-    
+  }
+
+  layout.quantization = m_quantization;
+  for (auto& uv : m_texcoord)
+  {
+    if (glm::abs(uv.x) > kHalfTexcoordRange || glm::abs(uv.y) > kHalfTexcoordRange)
+    {
+      layout.quantization &= ~VertexQuantizeTexcoordBit;
+      break;
+    }
+  }
+  const bool bQuantPosition = (layout.quantization & VertexQuantizePositionBit) != 0;
+  const bool bQuantNormal = (layout.quantization & VertexQuantizeNormalBit) != 0;
+  const bool bQuantTexcoord = (layout.quantization & VertexQuantizeTexcoordBit) != 0;
+
+  // uniform scale keeps the normals valid once folded in the world matrix
+  glm::vec3 center = (layout.boundMin + layout.boundMax) * 0.5f;
+  glm::vec3 extent = (layout.boundMax - layout.boundMin) * 0.5f;
+  float scale = glm::max(glm::max(extent.x, extent.y), glm::max(extent.z, 1e-6f));
+
+  layout.dequant = glm::mat4(1.f);
+  if (bQuantPosition)
+    layout.dequant = glm::scale(glm::translate(glm::mat4(1.f), center), glm::vec3(scale));
+
+  layout.attribMask = 0u;
+  if (!m_position.empty()) layout.attribMask |= 1u << VATTRIB_POSITION;
+  if (!m_normal.empty()) layout.attribMask |= 1u << VATTRIB_NORMAL;
+  if (!m_texcoord.empty()) layout.attribMask |= 1u << VATTRIB_TEXCOORD;
+
+  GLsizei positionOffset = 0;
+  GLsizei normalOffset = positionOffset + (m_position.empty() ? 0 : getPositionFormat(layout.quantization).bytes);
+  GLsizei texcoordOffset = normalOffset + (m_normal.empty() ? 0 : getNormalFormat(layout.quantization).bytes);
+  layout.stride = texcoordOffset + (m_texcoord.empty() ? 0 : getTexcoordFormat(layout.quantization).bytes);
+
+  vertices.resize(layout.getVertexSize());
+  for (uint32_t i = 0; i < layout.vertexCount; ++i)
+  {
+    uint8_t* v = vertices.data() + i * layout.stride;
+
+    if (bQuantPosition)
+    {
+      glm::vec3 p = (m_position[i] - center) / scale;
+      store(v + positionOffset, glm::packSnorm2x16(glm::vec2(p.x, p.y)));
+      store(v + positionOffset + 4, glm::packSnorm2x16(glm::vec2(p.z, 0.f)));
+    }
+    else
+      store(v + positionOffset, m_position[i]);
+
     if (!m_normal.empty())
     {
-      glBufferSubData( GL_ARRAY_BUFFER, m_offset, m_normalSize, &m_normal[0]);
-      glVertexAttribPointer( VATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, 0, (void*)(m_offset));
-      m_offset += m_normalSize;
+      glm::vec2 e = octEncode(m_normal[i]);
+      if (bQuantNormal)
+        store(v + normalOffset, glm::packSnorm2x16(e));
+      else
+        store(v + normalOffset, e);
     }
-    
+
     if (!m_texcoord.empty())
     {
-      glBufferSubData( GL_ARRAY_BUFFER, m_offset, m_texcoordSize, &m_texcoord[0]);
-      glVertexAttribPointer( VATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, (void*)(m_offset));  
-      m_offset += m_texcoordSize;
+      if (bQuantTexcoord)
+        store(v + texcoordOffset, glm::packHalf2x16(m_texcoord[i]));
+      else
+        store(v + texcoordOffset, m_texcoord[i]);
+    }
+  }
+
+  layout.indexCount = (uint32_t)m_indices.size();
+  layout.indexType = GL_NONE;
+  if (!m_indices.empty())
+    layout.indexType = (layout.vertexCount <= 0xFFFF) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+  indices.resize(layout.getIndexSize());
+  if (layout.indexType == GL_UNSIGNED_SHORT)
+  {
+    uint16_t* dst = reinterpret_cast<uint16_t*>(indices.data());
+    for (auto index : m_indices)
+      *dst++ = (uint16_t)index;
+  }
+  else if (layout.indexType == GL_UNSIGNED_INT)
+    memcpy(indices.data(), m_indices.data(), indices.size());
+}
+
+void VertexBuffer::upload(const VertexBufferLayout& layout, const void* vertices, const void* indices, GLenum usage)
+{
+  assert( m_vao && m_vbo );
+
+  m_layout = layout;
+
+  GLsizei positionOffset = 0;
+  GLsizei normalOffset = positionOffset;
+  if (layout.attribMask & (1u << VATTRIB_POSITION))
+    normalOffset += getPositionFormat(layout.quantization).bytes;
+  GLsizei texcoordOffset = normalOffset;
+  if (layout.attribMask & (1u << VATTRIB_NORMAL))
+    texcoordOffset += getNormalFormat(layout.quantization).bytes;
+
+  bind();
+  {
+    glBufferData( GL_ARRAY_BUFFER, layout.getVertexSize(), vertices, usage);
+
+    if (layout.attribMask & (1u << VATTRIB_POSITION))
+    {
+      AttribFormat format = getPositionFormat(layout.quantization);
+      glVertexAttribPointer( VATTRIB_POSITION, format.size, format.type, format.normalized, layout.stride, (void*)(intptr_t)positionOffset);
+    }
+
+    if (layout.attribMask & (1u << VATTRIB_NORMAL))
+    {
+      AttribFormat format = getNormalFormat(layout.quantization);
+      glVertexAttribPointer( VATTRIB_NORMAL, format.size, format.type, format.normalized, layout.stride, (void*)(intptr_t)normalOffset);
+    }
+
+    if (layout.attribMask & (1u << VATTRIB_TEXCOORD))
+    {
+      AttribFormat format = getTexcoordFormat(layout.quantization);
+      glVertexAttribPointer( VATTRIB_TEXCOORD, format.size, format.type, format.normalized, layout.stride, (void*)(intptr_t)texcoordOffset);
     }
+
+    if (layout.indexType != GL_NONE)
+    {
+      // the element array binding is recorded in the VAO
+      if (!m_ibo) glGenBuffers( 1, &m_ibo);
+      glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+      glBufferData( GL_ELEMENT_ARRAY_BUFFER, layout.getIndexSize(), indices, usage);
+    }
+  }
+  unbind();
+  glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0u);
+}
+
+void VertexBuffer::unpackTriangles(const VertexBufferLayout& layout, const void* vertices, const void* indices, std::vector<glm::vec3>& triangles)
+{
+  triangles.clear();
+  if (!(layout.attribMask & (1u << VATTRIB_POSITION)))
+    return;
+
+  const uint8_t* src = static_cast<const uint8_t*>(vertices);
+  const bool bQuantPosition = (layout.quantization & VertexQuantizePositionBit) != 0;
+  auto position = [&](uint32_t index)
+  {
+    const uint8_t* v = src + index * layout.stride;
+    if (!bQuantPosition)
+    {
+      glm::vec3 p;
+      memcpy(&p, v, sizeof(p));
+      return p;
+    }
+    uint32_t packed[2];
+    memcpy(packed, v, sizeof(packed));
+    glm::vec2 xy = glm::unpackSnorm2x16(packed[0]);
+    glm::vec2 zw = glm::unpackSnorm2x16(packed[1]);
+    return glm::vec3(layout.dequant * glm::vec4(xy.x, xy.y, zw.x, 1.f));
+  };
+
+  if (layout.indexType == GL_NONE)
+  {
+    triangles.resize(layout.vertexCount - layout.vertexCount % 3);
+    for (uint32_t i = 0; i < triangles.size(); ++i)
+      triangles[i] = position(i);
+    return;
+  }
+
+  const VertexBufferLod& range = layout.lods[0];
+  triangles.resize(range.indexCount);
+  for (uint32_t i = 0; i < range.indexCount; ++i)
+  {
+    uint32_t index;
+    if (layout.indexType == GL_UNSIGNED_SHORT)
+      index = static_cast<const uint16_t*>(indices)[range.firstIndex + i];
+    else
+      index = static_cast<const uint32_t*>(indices)[range.firstIndex + i];
+    triangles[i] = position(index);
+  }
+}
+
+void VertexBuffer::readTriangles(std::vector<glm::vec3>& triangles) const
+{
+  assert( m_vbo );
+
+  std::vector<uint8_t> vertices(m_layout.getVertexSize());
+  std::vector<uint8_t> indices(m_layout.getIndexSize());
+
+  glBindBuffer( GL_COPY_READ_BUFFER, m_vbo);
+  glGetBufferSubData( GL_COPY_READ_BUFFER, 0, vertices.size(), vertices.data());
+  if (!indices.empty())
+  {
+    glBindBuffer( GL_COPY_READ_BUFFER, m_ibo);
+    glGetBufferSubData( GL_COPY_READ_BUFFER, 0, indices.size(), indices.data());
+  }
+  glBindBuffer( GL_COPY_READ_BUFFER, 0u);
+
+  unpackTriangles(m_layout, vertices.data(), indices.data(), triangles);
+}
+
+void VertexBuffer::optimize()
+{
+  assert( m_indices.size() % 3 == 0 );
+
+  std::vector<uint32_t> clusters;
+  util::OptimizeVertexCache(m_indices, m_position.size(), clusters);
+  util::OptimizeOverdraw(m_indices, m_position, clusters);
+
+  std::vector<uint32_t> remap;
+  size_t vertexCount = util::OptimizeVertexFetch(m_indices, m_position.size(), remap);
+  util::RemapVertices(m_position, remap, vertexCount);
+  util::RemapVertices(m_normal, remap, vertexCount);
+  util::RemapVertices(m_texcoord, remap, vertexCount);
+  m_layout.vertexCount = (uint32_t)vertexCount;
+}
+
+void VertexBuffer::buildLods()
+{
+  VertexBufferLod* lods = m_layout.lods;
+  const uint32_t lodCount = glm::min(m_lodRequest, kMaxVertexBufferLods);
+
+  std::vector<uint32_t> indices(m_indices);
+  std::vector<uint32_t> clusters;
+  for (uint32_t lod = 1; lod < lodCount; ++lod)
+  {
+    const size_t previous = indices.size();
+    float error = util::SimplifyMesh(indices, m_position, previous / 2, FLT_MAX);
+
+    // not worth a level when the simplification stalls
+    if (indices.empty() || indices.size() > previous * 4 / 5)
+      break;
+
+    util::OptimizeVertexCache(indices, m_position.size(), clusters);
+
+    lods[lod].firstIndex = (uint32_t)m_indices.size();
+    lods[lod].indexCount = (uint32_t)indices.size();
+    // each step is measured against the previous level, sum for a bound to the full mesh
+    lods[lod].error = lods[lod - 1].error + error;
+    m_indices.insert(m_indices.end(), indices.begin(), indices.end());
+    m_layout.lodCount = lod + 1;
   }
+}
+
+void VertexBuffer::setInstanceBuffer(GLuint buffer)
+{
+  assert( m_vao );
+
+  // the buffer is owned by the caller (ModelBatch), the VAO only records it
+  m_instanceVbo = buffer;
+
+  glBindVertexArray( m_vao );
+  bindInstanceAttribs(0u);
+  glVertexAttribDivisor( VATTRIB_INSTANCE, 1);
   unbind();
 }
 
+void VertexBuffer::bindInstanceAttribs(GLuint baseInstance) const
+{
+  m_instanceBase = baseInstance;
+
+  glBindBuffer( GL_ARRAY_BUFFER, m_instanceVbo);
+  const size_t offset = sizeof(uint32_t) * baseInstance;
+  glVertexAttribIPointer( VATTRIB_INSTANCE, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)offset);
+  glBindBuffer( GL_ARRAY_BUFFER, m_vbo);
+}
+
 
 void VertexBuffer::bind() const
 {
@@ -93,19 +432,70 @@ void VertexBuffer::unbind()
 }
 
 void VertexBuffer::enable() const
-{  
+{
   bind();
-  
-  if (m_positionSize != 0)  glEnableVertexAttribArray( VATTRIB_POSITION );
-  if (m_normalSize != 0)    glEnableVertexAttribArray( VATTRIB_NORMAL );
-  if (m_texcoordSize != 0)  glEnableVertexAttribArray( VATTRIB_TEXCOORD );
+
+  if (m_layout.attribMask & (1u << VATTRIB_POSITION))  glEnableVertexAttribArray( VATTRIB_POSITION );
+  if (m_layout.attribMask & (1u << VATTRIB_NORMAL))    glEnableVertexAttribArray( VATTRIB_NORMAL );
+  if (m_layout.attribMask & (1u << VATTRIB_TEXCOORD))  glEnableVertexAttribArray( VATTRIB_TEXCOORD );
+  if (m_instanceVbo != 0)
+    glEnableVertexAttribArray( VATTRIB_INSTANCE );
 }
 
 void VertexBuffer::disable()
-{    
- 	glDisableVertexAttribArray( VATTRIB_POSITION );
+{
+  glDisableVertexAttribArray( VATTRIB_POSITION );
   glDisableVertexAttribArray( VATTRIB_NORMAL );
   glDisableVertexAttribArray( VATTRIB_TEXCOORD );
-  
+  glDisableVertexAttribArray( VATTRIB_INSTANCE );
+
   unbind();
 }
+
+VertexBufferDrawCommand VertexBuffer::getDrawCommand(uint32_t lod, GLuint baseInstance) const
+{
+  if (m_layout.lodCount == 0)
+    return { m_layout.vertexCount, 0u, 0u, GLint(baseInstance), baseInstance };
+
+  assert( lod < m_layout.lodCount );
+  const VertexBufferLod& range = m_layout.lods[lod];
+  return { range.indexCount, 0u, range.firstIndex, 0, baseInstance };
+}
+
+void VertexBuffer::drawIndirect(GLenum mode, GLintptr offset) const
+{
+  if (m_instanceVbo != 0 && m_instanceBase != 0)
+    bindInstanceAttribs(0u);
+
+  if (m_layout.lodCount > 0)
+    glDrawElementsIndirect( mode, m_layout.indexType, (void*)offset);
+  else
+    glDrawArraysIndirect( mode, (void*)offset);
+}
+
+void VertexBuffer::draw(GLenum mode, GLsizei instanceCount, uint32_t lod, GLuint baseInstance) const
+{
+  if (m_instanceVbo != 0 && m_instanceBase != baseInstance)
+    bindInstanceAttribs(baseInstance);
+
+  const GLsizei vertexCount = m_layout.vertexCount;
+  if (m_layout.lodCount > 0)
+  {
+    assert( lod < m_layout.lodCount );
+    const VertexBufferLod& range = m_layout.lods[lod];
+    const GLsizei indexCount = range.indexCount;
+    const size_t indexSize = (m_layout.indexType == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(uint32_t);
+    const void* offset = (void*)(range.firstIndex * indexSize);
+    if (instanceCount != 1)
+      glDrawElementsInstanced( mode, indexCount, m_layout.indexType, offset, instanceCount);
+    else
+      glDrawElements( mode, indexCount, m_layout.indexType, offset);
+  }
+  else
+  {
+    if (instanceCount != 1)
+      glDrawArraysInstanced( mode, 0, vertexCount, instanceCount);
+    else
+      glDrawArrays( mode, 0, vertexCount);
+  }
+}
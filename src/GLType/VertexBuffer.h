@@ -1,12 +1,21 @@
 /**
- * 
- *    \file VertexBuffer.hpp  
- * 
- *    \todo # allow index buffer
- *          # allow interleaving
- *          # add tangent ?
+ *
+ *    \file VertexBuffer.hpp
+ *
+ *    Attributes are filled as separate arrays on the CPU, complete() packs
+ *    them in a single interleaved stream, optionally quantized, and uploads
+ *    the (16 or 32 bits) index buffer when indices are given.
+ *
+ *    Indexed triangle lists are reordered for the post-transform cache and
+ *    the overdraw, then their vertices for the fetch, unless disabled with
+ *    setOptimization(false) (eg. strips, or when the order matters).
+ *
+ *    Normals are always stored octahedral encoded, shaders decode them with
+ *    OctDecode() from VertexUtility.glsli.
+ *
+ *    \todo # add tangent ?
  */
- 
+
 
 #pragma once
 
@@ -16,67 +25,197 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <vector>
+#include <cstdint>
+#include <tools/MeshOptimizer.h>
 
 
 enum VertexAttribLocation
 {
   VATTRIB_POSITION = 0,
   VATTRIB_NORMAL,
-  VATTRIB_TEXCOORD
+  VATTRIB_TEXCOORD,
+  VATTRIB_INSTANCE      // per-instance uint, record of the instance data, see ModelBatch
+};
+
+enum VertexQuantizeFlagBits
+{
+  VertexQuantizeNone = 0,
+  VertexQuantizePositionBit = 0x1,  // snorm16 in the mesh bounds, see getDequantMatrix()
+  VertexQuantizeNormalBit = 0x2,    // octahedral snorm16x2 instead of float2
+  VertexQuantizeTexcoordBit = 0x4,  // half float, only when the range allows it
+  VertexQuantizeAll = 0x7
+};
+
+typedef uint32_t VertexQuantizeFlags;
+
+const uint32_t kMaxVertexBufferLods = 6;
+
+/** Index range of a level of detail, all levels share the vertices */
+struct VertexBufferLod
+{
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  float error;              // object space deviation from the full mesh
+};
+
+/** DrawElementsIndirectCommand; a non-indexed buffer reads it as a
+    DrawArraysIndirectCommand, 'baseVertex' then holds the base instance */
+struct VertexBufferDrawCommand
+{
+  uint32_t count;
+  uint32_t instanceCount;
+  uint32_t firstIndex;
+  int32_t baseVertex;
+  uint32_t baseInstance;
+};
+
+/** Describes the packed GPU buffers, written as is in the cooked mesh files */
+struct VertexBufferLayout
+{
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t stride;
+  uint32_t attribMask;      // 1 << VertexAttribLocation
+  uint32_t quantization;    // applied VertexQuantizeFlags, may differ from the requested ones
+  uint32_t indexType;       // GL_NONE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+  glm::vec3 boundMin;
+  glm::vec3 boundMax;
+  glm::mat4 dequant;
+  uint32_t lodCount;        // 0 when not indexed
+  VertexBufferLod lods[kMaxVertexBufferLods];
+
+  uint32_t getVertexSize() const { return vertexCount * stride; }
+  uint32_t getIndexSize() const;
 };
 
 class VertexBuffer
 {
   protected:
     GLuint m_vao;
-    GLuint m_vbo;    
+    GLuint m_vbo;
+    GLuint m_ibo;
+    GLuint m_instanceVbo;
 
     std::vector<glm::vec3> m_position;
     std::vector<glm::vec3> m_normal;
     std::vector<glm::vec2> m_texcoord;
-        
-    GLsizeiptr m_positionSize;
-    GLsizeiptr m_normalSize;
-    GLsizeiptr m_texcoordSize;
-    
-    GLintptr m_offset;
-    
+    std::vector<uint32_t> m_indices;
+
+    VertexQuantizeFlags m_quantization;
+    bool m_bOptimize;
+    uint32_t m_lodRequest;
+    mutable GLuint m_instanceBase;
+    util::VertexCacheStats m_cacheStats[2]; // before, after optimization
+    VertexBufferLayout m_layout;
+
+    /** Cache, overdraw and fetch reordering of the client side arrays */
+    void optimize();
+
+    /** Appends the simplified index ranges after the full mesh */
+    void buildLods();
+
+    /** Points the per-instance attribs at 'baseInstance' in the instance buffer */
+    void bindInstanceAttribs(GLuint baseInstance) const;
 
   public:
-    VertexBuffer() 
-      : m_vao(0u), m_vbo(0u),
-        m_positionSize(0), m_normalSize(0), m_texcoordSize(0),
-        m_offset(0)
-    {}
-                     
+    VertexBuffer()
+      : m_vao(0u), m_vbo(0u), m_ibo(0u), m_instanceVbo(0u),
+        m_quantization(VertexQuantizeNone), m_bOptimize(true),
+        m_lodRequest(1u), m_instanceBase(0u)
+    {
+      m_cacheStats[0] = m_cacheStats[1] = { 0.f, 0.f };
+      m_layout = { 0u, 0u, 0u, 0u, VertexQuantizeNone, GL_NONE, glm::vec3(0.f), glm::vec3(0.f), glm::mat4(1.f), 0u };
+    }
+
     virtual ~VertexBuffer() { destroy(); }
-    
+
     void initialize();
     void destroy();
 
     /** Destroy the client side memory (CPU) */
     void cleanData();
 
-    /** Set the VAO parameters & send data to the GPU */
+    /** Set the VAO parameters & send data to the GPU, same as pack() + upload() */
     void complete(GLenum usage);
-    
-    void bind() const;        
+
+    /** Optimize and interleave the client side arrays, no GL call */
+    void pack(std::vector<uint8_t>& vertices, std::vector<uint8_t>& indices);
+
+    /** Set the VAO parameters & send already packed data to the GPU */
+    void upload(const VertexBufferLayout& layout, const void* vertices, const void* indices, GLenum usage);
+
+    /** Object space triangles of the first level of detail in packed buffers,
+        3 vertices per triangle, no GL call */
+    static void unpackTriangles(const VertexBufferLayout& layout, const void* vertices, const void* indices, std::vector<glm::vec3>& triangles);
+
+    /** Reads the uploaded buffers back and unpacks their triangles, the client
+        side arrays are gone after complete() (stalls, not for every frame) */
+    void readTriangles(std::vector<glm::vec3>& triangles) const;
+
+    /** Source the per-instance record index (VATTRIB_INSTANCE) from
+        'buffer', one uint per instance */
+    void setInstanceBuffer(GLuint buffer);
+
+    void bind() const;
     static void unbind();
-    
+
     /** Enable vertex attribs arrays (for rendering) */
     void enable() const;
-    
+
     /** Disable vertex attribs arrays */
-    static void disable();    
-    
-    
+    static void disable();
+
+    /** Issue the draw call, indexed when an index buffer was uploaded.
+        'baseInstance' offsets the instance buffer (no ARB_base_instance on 4.1) */
+    void draw(GLenum mode, GLsizei instanceCount = 1, uint32_t lod = 0, GLuint baseInstance = 0) const;
+
+    /** Command of 'lod' without instance, see drawIndirect */
+    VertexBufferDrawCommand getDrawCommand(uint32_t lod, GLuint baseInstance) const;
+
+    /** Issue the command at 'offset' in the bound GL_DRAW_INDIRECT_BUFFER,
+        its base instance offsets the instance buffer (4.2 and later) */
+    void drawIndirect(GLenum mode, GLintptr offset) const;
+
+
     GLuint getVBO() const {return m_vbo;}
-    
+    GLuint getIBO() const {return m_ibo;}
+    GLuint getInstanceVBO() const {return m_instanceVbo;}
+
     std::vector<glm::vec3>& getPosition() {return m_position;}
     std::vector<glm::vec3>& getNormal() {return m_normal;}
     std::vector<glm::vec2>& getTexcoord() {return m_texcoord;}
-    
-    GLintptr getOffset() const { return m_offset; }
+    std::vector<uint32_t>& getIndices() {return m_indices;}
+
+    /** Must be set before complete() */
+    void setQuantization(VertexQuantizeFlags flags) { m_quantization = flags; }
+    VertexQuantizeFlags getQuantization() const { return m_quantization; }
+
+    /** Must be set before complete() */
+    void setOptimization(bool bOptimize) { m_bOptimize = bOptimize; }
+    bool getOptimization() const { return m_bOptimize; }
+
+    /** Number of levels of detail to build, must be set before complete() */
+    void setLodCount(uint32_t count) { m_lodRequest = count; }
+    uint32_t getLodRequest() const { return m_lodRequest; }
+    uint32_t getLodCount() const { return m_layout.lodCount; }
+    const VertexBufferLod& getLod(uint32_t lod) const { return m_layout.lods[lod]; }
+
+    /** Simulated cache efficiency of the index buffer, valid after complete() */
+    const util::VertexCacheStats& getCacheStatsBefore() const { return m_cacheStats[0]; }
+    const util::VertexCacheStats& getCacheStatsAfter() const { return m_cacheStats[1]; }
+
+    const VertexBufferLayout& getLayout() const { return m_layout; }
+    GLsizei getStride() const { return m_layout.stride; }
+    GLsizei getVertexCount() const { return m_layout.vertexCount; }
+    GLsizei getIndexCount() const { return m_layout.indexCount; }
+    GLenum getIndexType() const { return m_layout.indexType; }
+
+    /** Object space bounds, valid after complete() */
+    const glm::vec3& getBoundMin() const { return m_layout.boundMin; }
+    const glm::vec3& getBoundMax() const { return m_layout.boundMax; }
+
+    /** Maps the stored positions back to object space (identity when not quantized) */
+    const glm::mat4& getDequantMatrix() const { return m_layout.dequant; }
 };
 
 
@@ -89,12 +228,16 @@ class VertexBuffer
   std::vector<glm::vec3> &pos = vertexBuffer.getPosition();
   std::vector<glm::vec3> &nor = vertexBuffer.getNormal();
   std::vector<glm::vec2> &tex = vertexBuffer.getTexcoord();
+  std::vector<uint32_t> &idx = vertexBuffer.getIndices();
 
-  // Update pos, nor, tex
+  // Update pos, nor, tex, (optional) idx
   // ..
 
   // Generate buffer's id
-  m_vertexBuffer.initialize();  
+  m_vertexBuffer.initialize();
+
+  // [optional] pack in 16 bits / half float
+  m_vertexBuffer.setQuantization( VertexQuantizeAll );
 
   // Send data to the GPU
   m_vertexBuffer.complete( GL_STATIC_DRAW );
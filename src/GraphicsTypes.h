@@ -8,6 +8,7 @@
 class GraphicsDeviceDesc;
 class GraphicsDataDesc;
 class GraphicsTextureDesc;
+class GraphicsSamplerDesc;
 class GraphicsFramebufferDesc;
 
 typedef std::shared_ptr<class GraphicsDevice> GraphicsDevicePtr;
@@ -15,6 +16,8 @@ typedef std::shared_ptr<class GraphicsData> GraphicsDataPtr;
 typedef std::shared_ptr<class GraphicsTexture> GraphicsTexturePtr;
 typedef std::shared_ptr<class OGLTexture> OGLTexturePtr;
 typedef std::shared_ptr<class OGLCoreTexture> OGLCoreTexturePtr;
+typedef std::shared_ptr<class GraphicsSampler> GraphicsSamplerPtr;
+typedef std::shared_ptr<class OGLSampler> OGLSamplerPtr;
 typedef std::shared_ptr<class GraphicsFramebuffer> GraphicsFramebufferPtr;
 typedef std::shared_ptr<class OGLCoreFramebuffer> OGLCoreFramebufferPtr;
 typedef std::shared_ptr<class OGLFramebuffer> OGLFramebufferPtr;
@@ -0,0 +1,271 @@
+#include <HiZBuffer.h>
+#include <GLType/GraphicsDevice.h>
+#include <GLType/GraphicsTexture.h>
+#include <GLType/OGLCoreTexture.h>
+#include <GLType/RenderTargetPool.h>
+#include <tools/gltools.hpp>
+#include <algorithm>
+#include <cassert>
+
+HiZBuffer::HiZBuffer() noexcept
+    : m_BoundsBuffer(GL_NONE)
+    , m_BufferCapacity(0)
+    , m_VisibilityBuffer(GL_NONE)
+    , m_VisibilityCapacity(0)
+    , m_NextReadback(0)
+    , m_LevelCount(0)
+    , m_Width(0)
+    , m_Height(0)
+    , m_bValid(false)
+{
+    for (auto& readback : m_Readbacks)
+        readback = { GL_NONE, 0, nullptr, nullptr, {}, 0 };
+}
+
+HiZBuffer::~HiZBuffer() noexcept
+{
+    destroy();
+}
+
+bool HiZBuffer::create(const GraphicsDevicePtr& device) noexcept
+{
+    assert(device);
+    if (device->getGraphicsDeviceDesc().getDeviceType() != GraphicsDeviceTypeOpenGLCore)
+        return false;
+
+    m_Device = device;
+
+    m_DownsampleShader.setDevice(device);
+    m_DownsampleShader.initialize();
+    m_DownsampleShader.addShader(GL_COMPUTE_SHADER, "HiZ.Downsample");
+    m_DownsampleShader.link();
+
+    m_CullShader.setDevice(device);
+    m_CullShader.initialize();
+    m_CullShader.addShader(GL_COMPUTE_SHADER, "HiZ.Cull");
+    m_CullShader.link();
+
+    glCreateBuffers(1, &m_BoundsBuffer);
+    glCreateBuffers(1, &m_VisibilityBuffer);
+
+    CHECKGLERROR();
+    return true;
+}
+
+void HiZBuffer::destroy() noexcept
+{
+    for (auto& readback : m_Readbacks)
+    {
+        if (readback.Fence)
+            glDeleteSync(readback.Fence);
+        if (readback.Buffer != GL_NONE)
+            glDeleteBuffers(1, &readback.Buffer);
+        readback = { GL_NONE, 0, nullptr, nullptr, {}, 0 };
+    }
+    m_NextReadback = 0;
+    if (m_BoundsBuffer != GL_NONE)
+        glDeleteBuffers(1, &m_BoundsBuffer);
+    m_BoundsBuffer = GL_NONE;
+    m_BufferCapacity = 0;
+    if (m_VisibilityBuffer != GL_NONE)
+        glDeleteBuffers(1, &m_VisibilityBuffer);
+    m_VisibilityBuffer = GL_NONE;
+    m_VisibilityCapacity = 0;
+
+    m_DownsampleShader.destroy();
+    m_CullShader.destroy();
+    m_Pyramid.reset();
+    m_LevelCount = 0;
+    m_bValid = false;
+}
+
+void HiZBuffer::resize(int32_t width, int32_t height) noexcept
+{
+    auto device = m_Device.lock();
+    if (!device)
+        return;
+
+    // full chain of the pooled texture down to 1x1, the texels past the
+    // viewport hold the far plane cleared in the depth buffer
+    const int32_t size = std::max(RenderTargetPool::getBucketSize(width), RenderTargetPool::getBucketSize(height));
+    uint32_t levels = 1;
+    while ((size >> levels) > 0)
+        levels++;
+
+    GraphicsTextureDesc desc;
+    desc.setWidth(width);
+    desc.setHeight(height);
+    desc.setLevels(levels);
+    desc.setFormat(gli::FORMAT_R32_SFLOAT_PACK32);
+    desc.setMinFilter(GL_NEAREST_MIPMAP_NEAREST);
+    desc.setMagFilter(GL_NEAREST);
+    m_Pyramid = device->getRenderTargetPool().acquire(desc, m_Pyramid);
+    m_LevelCount = levels;
+    m_Width = width;
+    m_Height = height;
+
+    // the content is from another size, wait for the next build
+    m_bValid = false;
+}
+
+void HiZBuffer::build(const GraphicsTexturePtr& depth) noexcept
+{
+    assert(m_Pyramid);
+    auto pyramid = m_Pyramid->downcast_pointer<OGLCoreTexture>();
+    auto& desc = m_Pyramid->getGraphicsTextureDesc();
+
+    m_DownsampleShader.bind();
+    for (uint32_t level = 0; level < m_LevelCount; level++)
+    {
+        if (level == 0)
+        {
+            m_DownsampleShader.bindTexture("uSource", depth, 0);
+            m_DownsampleShader.setUniform("uSourceLevel", 0);
+        }
+        else
+        {
+            m_DownsampleShader.bindTexture("uSource", m_Pyramid, 0);
+            m_DownsampleShader.setUniform("uSourceLevel", GLint(level - 1));
+        }
+        m_DownsampleShader.bindImage("uDest", pyramid, 0, level, GL_FALSE, 0, GL_WRITE_ONLY);
+
+        GLuint width = std::max(desc.getWidth() >> level, 1);
+        GLuint height = std::max(desc.getHeight() >> level, 1);
+        m_DownsampleShader.Dispatch2D(width, height, 8, 8);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+    m_DownsampleShader.unbind();
+    m_bValid = true;
+
+    CHECKGLERROR();
+}
+
+void HiZBuffer::test(const std::vector<Math::BoundingBox>& bounds, const glm::mat4& viewProj, const VisibilityMask& visible) noexcept
+{
+    assert(bounds.size() == visible.size());
+    if (!m_bValid)
+        return;
+
+    // the oldest slot of the ring, its flags are rewritten after the GPU is
+    // done with its previous test
+    Readback& readback = m_Readbacks[m_NextReadback];
+    if (readback.Fence)
+        glDeleteSync(readback.Fence);
+    readback.Fence = nullptr;
+
+    readback.Candidates.clear();
+    m_Upload.clear();
+    for (uint32_t i = 0; i < visible.size(); i++)
+    {
+        if (!visible[i])
+            continue;
+        // the model index in the spare component, for the per model flags
+        readback.Candidates.push_back(i);
+        m_Upload.push_back(glm::vec4(bounds[i].Min, glm::uintBitsToFloat(i)));
+        m_Upload.push_back(glm::vec4(bounds[i].Max, 0.f));
+    }
+    const uint32_t count = (uint32_t)readback.Candidates.size();
+    readback.ModelCount = (uint32_t)visible.size();
+    if (count == 0)
+        return;
+
+    GLsizeiptr boundsSize = m_Upload.size() * sizeof(glm::vec4);
+    if (boundsSize > m_BufferCapacity)
+    {
+        m_BufferCapacity = boundsSize;
+        glNamedBufferData(m_BoundsBuffer, boundsSize, nullptr, GL_STREAM_DRAW);
+    }
+    const GLsizeiptr visibilitySize = visible.size() * sizeof(uint32_t);
+    if (visibilitySize > m_VisibilityCapacity)
+    {
+        m_VisibilityCapacity = visibilitySize;
+        glNamedBufferData(m_VisibilityBuffer, visibilitySize, nullptr, GL_DYNAMIC_COPY);
+    }
+    const GLsizeiptr flagsSize = count * sizeof(uint32_t);
+    if (flagsSize > readback.Capacity)
+    {
+        // immutable storage, a larger one replaces it
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        if (readback.Buffer != GL_NONE)
+            glDeleteBuffers(1, &readback.Buffer);
+        readback.Capacity = flagsSize;
+        glCreateBuffers(1, &readback.Buffer);
+        glNamedBufferStorage(readback.Buffer, flagsSize, nullptr, flags);
+        readback.Mapped = static_cast<const uint32_t*>(glMapNamedBufferRange(readback.Buffer, 0, flagsSize, flags));
+    }
+    glNamedBufferSubData(m_BoundsBuffer, 0, boundsSize, m_Upload.data());
+
+    m_CullShader.bind();
+    m_CullShader.bindTexture("uHiZ", m_Pyramid, 0);
+    m_CullShader.setUniform("uViewProj", viewProj);
+    m_CullShader.setUniform("uLevelCount", GLint(m_LevelCount));
+    m_CullShader.setUniform("uSize", glm::ivec2(m_Width, m_Height));
+    m_CullShader.setUniform("uCount", GLint(count));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_BoundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, readback.Buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_VisibilityBuffer);
+    m_CullShader.Dispatch1D(count, 64);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+    m_CullShader.unbind();
+
+    // the flags are visible to the mapping once the fence has passed
+    glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+    if (readback.Mapped)
+    {
+        readback.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_NextReadback = (m_NextReadback + 1) % ReadbackCount;
+    }
+
+    CHECKGLERROR();
+}
+
+uint32_t HiZBuffer::readOccluded(uint32_t modelCount, VisibilityMask& occluded) noexcept
+{
+    occluded.clear();
+
+    // newest first, never waits; the tests older than a finished one are
+    // stale and dropped with it
+    Readback* latest = nullptr;
+    for (uint32_t age = 1; age <= ReadbackCount; age++)
+    {
+        Readback& readback = m_Readbacks[(m_NextReadback + ReadbackCount - age) % ReadbackCount];
+        if (!readback.Fence)
+            continue;
+        if (!latest && glClientWaitSync(readback.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+            continue;
+        if (!latest)
+            latest = &readback;
+        glDeleteSync(readback.Fence);
+        readback.Fence = nullptr;
+    }
+    if (!latest || latest->ModelCount != modelCount)
+        return 0;
+
+    uint32_t count = 0;
+    occluded.assign(modelCount, 0);
+    for (size_t i = 0; i < latest->Candidates.size(); i++)
+    {
+        if (latest->Mapped[i])
+            continue;
+        occluded[latest->Candidates[i]] = 1;
+        count++;
+    }
+    return count;
+}
+
+GLuint HiZBuffer::getVisibilityBuffer() const noexcept
+{
+    return m_VisibilityBuffer;
+}
+
+bool HiZBuffer::isValid() const noexcept
+{
+    return m_bValid;
+}
+
+uint32_t HiZBuffer::getLevelCount() const noexcept
+{
+    return m_LevelCount;
+}
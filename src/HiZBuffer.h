@@ -0,0 +1,82 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <GraphicsTypes.h>
+#include <GLType/ProgramShader.h>
+#include <Math/Culling.h>
+#include <Model.h>
+#include <vector>
+
+// Max depth pyramid of the depth pre-pass, built with compute shaders.
+// Bounds are tested on the GPU against the level where their screen
+// rectangle spans 2x2 texels. The flags stay on the GPU, per model, for
+// ModelBatch::drawIndirect in the same frame; they also land in a ring of
+// persistently mapped buffers, read a frame or two later from the latest
+// test whose fence has passed, so that the CPU never waits on the pre-pass.
+class HiZBuffer final
+{
+public:
+
+    HiZBuffer() noexcept;
+    ~HiZBuffer() noexcept;
+
+    // requires compute shaders, i.e. the OpenGL core device
+    bool create(const GraphicsDevicePtr& device) noexcept;
+    void destroy() noexcept;
+
+    // the pyramid comes from the render target pool, level 0 is as large as
+    // the depth buffer of the same size
+    void resize(int32_t width, int32_t height) noexcept;
+
+    // level 0 matches 'depth', each following level keeps the farthest depth
+    void build(const GraphicsTexturePtr& depth) noexcept;
+
+    // tests the bounds of the flagged models against the pyramid seen
+    // through 'viewProj', the result is read by the next readOccluded
+    void test(const std::vector<Math::BoundingBox>& bounds, const glm::mat4& viewProj, const VisibilityMask& visible) noexcept;
+
+    // a uint per model, set when the model passed the last test; only the
+    // models flagged in the 'visible' mask of that test are written
+    GLuint getVisibilityBuffer() const noexcept;
+
+    // sets occluded[i] for the models the latest finished test found behind
+    // the pyramid and returns their number; empty when no test is done yet
+    // or the test was made for another batch than one of 'modelCount' models
+    uint32_t readOccluded(uint32_t modelCount, VisibilityMask& occluded) noexcept;
+
+    bool isValid() const noexcept;
+    uint32_t getLevelCount() const noexcept;
+
+    static const uint32_t ReadbackCount = 3;
+
+private:
+
+    struct Readback
+    {
+        GLuint Buffer;
+        GLsizeiptr Capacity;
+        const uint32_t* Mapped;             // the visibility flags
+        GLsync Fence;                       // null once read or dropped
+        std::vector<uint32_t> Candidates;   // model of each flag
+        uint32_t ModelCount;
+    };
+
+    GraphicsDeviceWeakPtr m_Device;
+    GraphicsTexturePtr m_Pyramid;
+    ProgramShader m_DownsampleShader;
+    ProgramShader m_CullShader;
+    GLuint m_BoundsBuffer;
+    GLsizeiptr m_BufferCapacity;
+    GLuint m_VisibilityBuffer;
+    GLsizeiptr m_VisibilityCapacity;
+    Readback m_Readbacks[ReadbackCount];
+    uint32_t m_NextReadback;
+    uint32_t m_LevelCount;
+    int32_t m_Width;    // the viewport in level 0
+    int32_t m_Height;
+    bool m_bValid;
+
+    // per test scratch
+    std::vector<glm::vec4> m_Upload;
+};
@@ -26,50 +26,35 @@ namespace light
 
     void initialize(const GraphicsDevicePtr& device)
     {
-        m_ShaderLight = std::make_shared<ProgramShader>();
-        m_ShaderLight->setDevice(device);
-        m_ShaderLight->initialize();
-        m_ShaderLight->addShader(GL_VERTEX_SHADER, "TexturedLight.Vertex");
-        m_ShaderLight->addShader(GL_FRAGMENT_SHADER, "TexturedLight.Fragment");
-        m_ShaderLight->link();
-
-        m_ShaderDepthLight = std::make_shared<ProgramShader>();
-        m_ShaderDepthLight->setDevice(device);
-        m_ShaderDepthLight->initialize();
-        m_ShaderDepthLight->addShader(GL_VERTEX_SHADER, "DepthLight.Vertex");
+        m_ShaderLight = ProgramShader::create(device, {
+            { GL_VERTEX_SHADER, "TexturedLight.Vertex" },
+            { GL_FRAGMENT_SHADER, "TexturedLight.Fragment" } });
+
+        ProgramStages depthLight = { { GL_VERTEX_SHADER, "DepthLight.Vertex" } };
 	#if __APPLE__
-        m_ShaderDepthLight->addShader(GL_FRAGMENT_SHADER, "DepthLight.Fragment");
+        depthLight.emplace_back(GL_FRAGMENT_SHADER, "DepthLight.Fragment");
 	#endif
-        m_ShaderDepthLight->link();
-
-        m_ShaderLTC = std::make_shared<ProgramShader>();
-        m_ShaderLTC->setDevice(device);
-        m_ShaderLTC->initialize();
-        m_ShaderLTC->addShader(GL_VERTEX_SHADER, "Ltc.Vertex");
-        m_ShaderLTC->addShader(GL_FRAGMENT_SHADER, "Ltc.Fragment");
-        m_ShaderLTC->link();
-
-        m_ShaderDepthLTC = std::make_shared<ProgramShader>();
-        m_ShaderDepthLTC->setDevice(device);
-        m_ShaderDepthLTC->initialize();
-        m_ShaderDepthLTC->addShader(GL_VERTEX_SHADER, "DepthLtc.Vertex");
+        m_ShaderDepthLight = ProgramShader::create(device, depthLight);
+
+        m_ShaderLTC = ProgramShader::create(device, {
+            { GL_VERTEX_SHADER, "Ltc.Vertex" },
+            { GL_FRAGMENT_SHADER, "Ltc.Fragment" } });
+
+        ProgramStages depthLtc = { { GL_VERTEX_SHADER, "DepthLtc.Vertex" } };
 	#if __APPLE__
-        m_ShaderDepthLTC->addShader(GL_FRAGMENT_SHADER, "DepthLtc.Fragment");
+        depthLtc.emplace_back(GL_FRAGMENT_SHADER, "DepthLtc.Fragment");
 	#endif
-        m_ShaderDepthLTC->link();
+        m_ShaderDepthLTC = ProgramShader::create(device, depthLtc);
 
-        m_ShaderGroudTruth  = std::make_shared<ProgramShader>();
-        m_ShaderGroudTruth->setDevice(device);
-        m_ShaderGroudTruth->initialize();
-        m_ShaderGroudTruth->addShader(GL_VERTEX_SHADER, "GroundTruth.Vertex");
-        m_ShaderGroudTruth->addShader(GL_FRAGMENT_SHADER, "GroundTruth.Fragment");
-        m_ShaderGroudTruth->link();
+        m_ShaderGroudTruth = ProgramShader::create(device, {
+            { GL_VERTEX_SHADER, "GroundTruth.Vertex" },
+            { GL_FRAGMENT_SHADER, "GroundTruth.Fragment" } });
 
         m_LightMesh.create();
 
         GraphicsTextureDesc source;
         source.setFilename("resources/white.png");
-        m_WhiteTex = device->createTexture(source);
+        m_WhiteTex = device->createTextureAsync(source, 0xFFFFFFFF);
 
         GraphicsTextureDesc ltcMatDesc;
         ltcMatDesc.setFilename("resources/ltc_1.dds");
@@ -92,6 +77,16 @@ namespace light
     {
         m_LightMesh.destroy();
     }
+
+    const GraphicsTexturePtr& getLtc1Texture()
+    {
+        return m_Ltc1Tex;
+    }
+
+    const GraphicsTexturePtr& getLtc2Texture()
+    {
+        return m_Ltc2Tex;
+    }
 }
 
 using namespace light;
@@ -155,21 +150,8 @@ ShaderPtr Light::submit(ShaderPtr& shader, bool bDepth)
 
 ShaderPtr Light::submitPerLightUniforms(const RenderingData& data, ShaderPtr& shader)
 {
-    // local
-    glm::mat4 model = getWorld();
-    // area light rect poinsts in world space
-    glm::vec4 points[] = 
-    {
-        { -1.f, 0.f, -1.f, 1.f },
-        { +1.f, 0.f, -1.f, 1.f },
-        { +1.f, 0.f, +1.f, 1.f },
-        { -1.f, 0.f, +1.f, 1.f },
-    };
-
-    points[0] = model * points[0];
-    points[1] = model * points[1];
-    points[2] = model * points[2];
-    points[3] = model * points[3];
+    glm::vec4 points[4];
+    getQuadPoints(points);
 
     shader->setUniform("ubTwoSided", m_bTwoSided);
     if (!data.bGroudTruth)
@@ -198,6 +180,59 @@ glm::mat4 Light::getWorld() const
     return translate*rotateX*rotateY*rotateZ*scale;
 }
 
+void Light::getQuadPoints(glm::vec4 points[4]) const
+{
+    // local
+    glm::mat4 model = getWorld();
+    // area light rect poinsts in world space
+    points[0] = model * glm::vec4(-1.f, 0.f, -1.f, 1.f);
+    points[1] = model * glm::vec4(+1.f, 0.f, -1.f, 1.f);
+    points[2] = model * glm::vec4(+1.f, 0.f, +1.f, 1.f);
+    points[3] = model * glm::vec4(-1.f, 0.f, +1.f, 1.f);
+}
+
+float Light::getInfluenceRadius(float threshold) const
+{
+    // E ~ intensity * area / d^2, the quad spans [-1, 1] scaled by width / height
+    float area = 4.f * m_Width * m_Height;
+    float halfDiagonal = glm::sqrt(m_Width * m_Width + m_Height * m_Height);
+    return glm::sqrt(m_Intensity * area / glm::max(threshold, 1e-6f)) + halfDiagonal;
+}
+
+LightData Light::getLightData(const glm::mat4& view, float threshold) const
+{
+    LightData data;
+    getQuadPoints(data.Points);
+
+    glm::vec3 center = glm::vec3(view * glm::vec4(m_Position, 1.f));
+    data.Sphere = glm::vec4(center, getInfluenceRadius(threshold));
+
+    data.Plane = glm::vec4(0.f);
+    if (!m_bTwoSided)
+    {
+        glm::vec3 normal = glm::normalize(glm::vec3(view * getWorld() * glm::vec4(0.f, 1.f, 0.f, 0.f)));
+        data.Plane = glm::vec4(normal, -glm::dot(normal, center));
+    }
+    data.Params = glm::vec4(m_Intensity, m_bTwoSided ? 1.f : 0.f, m_bTexturedLight ? 1.f : 0.f, 0.f);
+
+    // unshadowed, see ShadowAtlas::getShadowData
+    data.Shadow.ViewProj = glm::mat4(1.f);
+    data.Shadow.Rect = data.Shadow.Params = data.Shadow.Bias = glm::vec4(0.f);
+    return data;
+}
+
+Math::CullVolume Light::getInfluenceVolume(float threshold) const
+{
+    auto volume = Math::CullVolume::fromSphere(m_Position, getInfluenceRadius(threshold));
+    if (!m_bTwoSided)
+    {
+        // emits toward local +y, see the 'behind' test in LTC_Evaluate
+        glm::vec3 normal = glm::normalize(glm::vec3(getWorld() * glm::vec4(0.f, 1.f, 0.f, 0.f)));
+        volume.addPlane(glm::vec4(normal, -glm::dot(normal, m_Position)));
+    }
+    return volume;
+}
+
 const glm::vec3& Light::getPosition() noexcept
 {
     return m_Position;
@@ -4,6 +4,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp> 
 #include <GraphicsTypes.h>
+#include <Math/Culling.h>
 
 typedef std::shared_ptr<class ProgramShader> ShaderPtr;
 
@@ -16,10 +17,33 @@ struct RenderingData
     std::vector<glm::vec4> Samples;
 };
 
+// shadow map tile of a light, see ShadowUtility.glsli
+struct ShadowData
+{
+    glm::mat4 ViewProj;     // world to light clip space
+    glm::vec4 Rect;         // atlas uv offset and scale; zero when the light has no tile
+    glm::vec4 Params;       // light half size in tile uv at unit distance, near, far
+    glm::vec4 Bias;         // normal offset per unit of depth, depth bias
+};
+
+// std430 layout of a light in the deferred shading pass
+struct LightData
+{
+    glm::vec4 Points[4];    // quad corners, world space
+    glm::vec4 Sphere;       // influence sphere, view space
+    glm::vec4 Plane;        // emitting half-space, view space; zero when two-sided
+    glm::vec4 Params;       // intensity, two-sided, textured
+    ShadowData Shadow;
+};
+
 namespace light
 {
     void initialize(const GraphicsDevicePtr& device);
     void shutdown();
+
+    // LTC lookup tables, inverse matrix and magnitude / fresnel
+    const GraphicsTexturePtr& getLtc1Texture();
+    const GraphicsTexturePtr& getLtc2Texture();
 }
 
 class Light
@@ -36,6 +60,14 @@ public:
 
     glm::mat4 getWorld() const;
 
+    // region where the irradiance from the light stays above 'threshold'
+    // (point light approximation of the quad), front side only when one-sided
+    Math::CullVolume getInfluenceVolume(float threshold) const;
+    float getInfluenceRadius(float threshold) const;
+
+    void getQuadPoints(glm::vec4 points[4]) const;
+    LightData getLightData(const glm::mat4& view, float threshold) const;
+
     const glm::vec3& getPosition() noexcept;
     void setPosition(const glm::vec3& position) noexcept;
     const glm::vec3& getRotation() noexcept;
@@ -0,0 +1,290 @@
+#include <LightBvh.h>
+#include <GLType/GraphicsDevice.h>
+#include <GLType/ProgramShader.h>
+#include <tools/gltools.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+LightBvh::LightBvh() noexcept
+    : m_NodeBuffer(GL_NONE)
+    , m_LightBuffer(GL_NONE)
+    , m_NodeCapacity(0)
+    , m_LightCapacity(0)
+    , m_Depth(0)
+{
+}
+
+LightBvh::~LightBvh() noexcept
+{
+    destroy();
+}
+
+bool LightBvh::create(const GraphicsDevicePtr& device) noexcept
+{
+    assert(device);
+    if (device->getGraphicsDeviceDesc().getDeviceType() != GraphicsDeviceTypeOpenGLCore)
+        return false;
+
+    m_Shader = ProgramShader::create(device, {
+        { GL_VERTEX_SHADER, "GroundTruth.Vertex" },
+        { GL_FRAGMENT_SHADER, "GroundTruth.FragmentLightBvh" } });
+
+    glCreateBuffers(1, &m_NodeBuffer);
+    glCreateBuffers(1, &m_LightBuffer);
+
+    CHECKGLERROR();
+    return true;
+}
+
+void LightBvh::destroy() noexcept
+{
+    if (m_NodeBuffer != GL_NONE)
+        glDeleteBuffers(1, &m_NodeBuffer);
+    if (m_LightBuffer != GL_NONE)
+        glDeleteBuffers(1, &m_LightBuffer);
+    m_NodeBuffer = m_LightBuffer = GL_NONE;
+    m_NodeCapacity = m_LightCapacity = 0;
+
+    m_Shader.reset();
+    m_Primitives.clear();
+    m_Nodes.clear();
+    m_Quads.clear();
+    m_Depth = 0;
+}
+
+LightBvh::Cone LightBvh::merge(const Cone& a, const Cone& b) noexcept
+{
+    // "Importance Sampling of Many Lights With Adaptive Tree Splitting"
+    if (b.ThetaO > a.ThetaO)
+        return merge(b, a);
+
+    const float pi = glm::pi<float>();
+    float thetaD = glm::acos(glm::clamp(glm::dot(a.Axis, b.Axis), -1.f, 1.f));
+    float thetaE = glm::max(a.ThetaE, b.ThetaE);
+    if (glm::min(thetaD + b.ThetaO, pi) <= a.ThetaO)
+        return Cone { a.Axis, a.ThetaO, thetaE };
+
+    float thetaO = (a.ThetaO + thetaD + b.ThetaO) * 0.5f;
+    glm::vec3 rotation = glm::cross(a.Axis, b.Axis);
+    if (thetaO >= pi || glm::dot(rotation, rotation) < 1e-12f)
+        return Cone { a.Axis, pi, thetaE };
+
+    // rotates the wider axis toward the other one
+    glm::vec3 axis = glm::angleAxis(thetaO - a.ThetaO, glm::normalize(rotation)) * a.Axis;
+    return Cone { glm::normalize(axis), thetaO, thetaE };
+}
+
+float LightBvh::orientationMeasure(const Cone& cone) noexcept
+{
+    const float pi = glm::pi<float>();
+    float thetaW = glm::min(cone.ThetaO + cone.ThetaE, pi);
+    float sinO = glm::sin(cone.ThetaO);
+    float cosO = glm::cos(cone.ThetaO);
+    return 2.f * pi * (1.f - cosO) +
+        pi * 0.5f * (2.f * thetaW * sinO - glm::cos(cone.ThetaO - 2.f * thetaW) - 2.f * cone.ThetaO * sinO + cosO);
+}
+
+void LightBvh::build(const std::vector<std::shared_ptr<Light>>& lights) noexcept
+{
+    const float pi = glm::pi<float>();
+
+    m_Primitives.clear();
+    m_Quads.clear();
+    for (uint32_t i = 0; i < lights.size(); i++)
+    {
+        auto& light = lights[i];
+        Quad quad;
+        light->getQuadPoints(quad.Points);
+        quad.Params = glm::vec4(light->m_Intensity, light->m_bTwoSided ? 1.f : 0.f, light->m_bTexturedLight ? 1.f : 0.f, 0.f);
+
+        Primitive prim;
+        prim.Box.Min = prim.Box.Max = glm::vec3(quad.Points[0]);
+        for (uint32_t k = 1; k < 4; k++)
+        {
+            prim.Box.Min = glm::min(prim.Box.Min, glm::vec3(quad.Points[k]));
+            prim.Box.Max = glm::max(prim.Box.Max, glm::vec3(quad.Points[k]));
+        }
+        prim.Centroid = prim.Box.getCenter();
+
+        // emits toward local +y in a hemisphere, both ways when two-sided
+        glm::vec3 normal = glm::normalize(glm::vec3(light->getWorld() * glm::vec4(0.f, 1.f, 0.f, 0.f)));
+        prim.Bounds = Cone { normal, light->m_bTwoSided ? pi : 0.f, pi * 0.5f };
+
+        float area = 4.f * light->m_Width * light->m_Height;
+        prim.Power = light->m_Intensity * area * (light->m_bTwoSided ? 2.f : 1.f);
+        prim.Light = i;
+
+        m_Primitives.push_back(prim);
+        m_Quads.push_back(quad);
+    }
+
+    m_Nodes.clear();
+    m_Depth = 0;
+    if (!m_Primitives.empty())
+        buildNode(0, (uint32_t)m_Primitives.size(), 1);
+
+    GLsizeiptr nodeSize = m_Nodes.size() * sizeof(Node);
+    if (nodeSize > m_NodeCapacity)
+    {
+        m_NodeCapacity = nodeSize;
+        glNamedBufferData(m_NodeBuffer, nodeSize, nullptr, GL_DYNAMIC_DRAW);
+    }
+    if (nodeSize > 0)
+        glNamedBufferSubData(m_NodeBuffer, 0, nodeSize, m_Nodes.data());
+
+    GLsizeiptr lightSize = m_Quads.size() * sizeof(Quad);
+    if (lightSize > m_LightCapacity)
+    {
+        m_LightCapacity = lightSize;
+        glNamedBufferData(m_LightBuffer, lightSize, nullptr, GL_DYNAMIC_DRAW);
+    }
+    if (lightSize > 0)
+        glNamedBufferSubData(m_LightBuffer, 0, lightSize, m_Quads.data());
+
+    CHECKGLERROR();
+}
+
+int32_t LightBvh::buildNode(uint32_t begin, uint32_t end, uint32_t depth) noexcept
+{
+    assert(begin < end);
+    m_Depth = std::max(m_Depth, depth);
+
+    Math::BoundingBox box = m_Primitives[begin].Box;
+    Math::BoundingBox centroids = { m_Primitives[begin].Centroid, m_Primitives[begin].Centroid };
+    Cone cone = m_Primitives[begin].Bounds;
+    float power = m_Primitives[begin].Power;
+    for (uint32_t i = begin + 1; i < end; i++)
+    {
+        auto& prim = m_Primitives[i];
+        box = box.merge(prim.Box);
+        centroids.Min = glm::min(centroids.Min, prim.Centroid);
+        centroids.Max = glm::max(centroids.Max, prim.Centroid);
+        cone = merge(cone, prim.Bounds);
+        power += prim.Power;
+    }
+
+    const int32_t index = (int32_t)m_Nodes.size();
+    Node node;
+    node.Min = glm::vec4(box.Min, power);
+    node.Max = glm::vec4(box.Max, glm::cos(cone.ThetaO));
+    node.Axis = glm::vec4(cone.Axis, glm::cos(cone.ThetaE));
+    node.Child = glm::ivec4(m_Primitives[begin].Light, -1, 0, 0);
+    m_Nodes.push_back(node);
+    if (end - begin == 1)
+        return index;
+
+    // binned SAOH, the cost of a split along a thin axis is raised so that
+    // the nodes stay close to cubes
+    struct Bin
+    {
+        Math::BoundingBox Box;
+        Cone Bounds;
+        float Power;
+        uint32_t Count;
+    };
+
+    const glm::vec3 extent = box.Max - box.Min;
+    const float maxExtent = glm::max(extent.x, glm::max(extent.y, extent.z));
+    float bestCost = FLT_MAX;
+    int32_t bestAxis = -1;
+    uint32_t bestSplit = 0;
+    for (int32_t axis = 0; axis < 3; axis++)
+    {
+        float lo = centroids.Min[axis];
+        float hi = centroids.Max[axis];
+        if (hi - lo <= 1e-6f)
+            continue;
+
+        Bin bins[BinCount];
+        for (auto& bin : bins)
+            bin.Count = 0;
+        for (uint32_t i = begin; i < end; i++)
+        {
+            auto& prim = m_Primitives[i];
+            uint32_t b = std::min(uint32_t((prim.Centroid[axis] - lo) / (hi - lo) * BinCount), BinCount - 1);
+            Bin& bin = bins[b];
+            bin.Box = bin.Count ? bin.Box.merge(prim.Box) : prim.Box;
+            bin.Bounds = bin.Count ? merge(bin.Bounds, prim.Bounds) : prim.Bounds;
+            bin.Power = bin.Count ? bin.Power + prim.Power : prim.Power;
+            bin.Count++;
+        }
+
+        const float regularization = maxExtent / glm::max(extent[axis], 1e-6f);
+        for (uint32_t split = 1; split < BinCount; split++)
+        {
+            Bin side[2];
+            side[0].Count = side[1].Count = 0;
+            for (uint32_t b = 0; b < BinCount; b++)
+            {
+                if (bins[b].Count == 0)
+                    continue;
+                Bin& s = side[b < split ? 0 : 1];
+                s.Box = s.Count ? s.Box.merge(bins[b].Box) : bins[b].Box;
+                s.Bounds = s.Count ? merge(s.Bounds, bins[b].Bounds) : bins[b].Bounds;
+                s.Power = s.Count ? s.Power + bins[b].Power : bins[b].Power;
+                s.Count += bins[b].Count;
+            }
+            if (side[0].Count == 0 || side[1].Count == 0)
+                continue;
+
+            float cost = regularization *
+                (side[0].Power * side[0].Box.getSurfaceArea() * orientationMeasure(side[0].Bounds) +
+                 side[1].Power * side[1].Box.getSurfaceArea() * orientationMeasure(side[1].Bounds));
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    uint32_t middle;
+    if (bestAxis < 0)
+    {
+        // coincident centroids, any halving does
+        middle = (begin + end) / 2;
+    }
+    else
+    {
+        const float lo = centroids.Min[bestAxis];
+        const float hi = centroids.Max[bestAxis];
+        auto it = std::partition(m_Primitives.begin() + begin, m_Primitives.begin() + end, [&](const Primitive& prim)
+        {
+            uint32_t b = std::min(uint32_t((prim.Centroid[bestAxis] - lo) / (hi - lo) * BinCount), BinCount - 1);
+            return b < bestSplit;
+        });
+        middle = (uint32_t)(it - m_Primitives.begin());
+    }
+
+    int32_t left = buildNode(begin, middle, depth + 1);
+    int32_t right = buildNode(middle, end, depth + 1);
+    m_Nodes[index].Child = glm::ivec4(left, right, 0, 0);
+    return index;
+}
+
+ShaderPtr LightBvh::bindProgram(const RenderingData& data) noexcept
+{
+    auto& program = m_Shader;
+    program->bind();
+    program->setUniform("uView", data.View);
+    program->setUniform("uProjection", data.Projection);
+    program->setUniform("uViewPositionW", data.Position);
+    program->setUniform("uSamples", data.Samples.data(), data.Samples.size());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_NodeBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_LightBuffer);
+    return program;
+}
+
+uint32_t LightBvh::getNodeCount() const noexcept
+{
+    return (uint32_t)m_Nodes.size();
+}
+
+uint32_t LightBvh::getDepth() const noexcept
+{
+    return m_Depth;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <GraphicsTypes.h>
+#include <Light.h>
+#include <Math/Culling.h>
+#include <memory>
+#include <vector>
+
+// Bounding volume hierarchy over the area lights for the stochastic light
+// selection of the ground truth. Each node bounds the positions, the total
+// power and the emission directions (normals cone and emission angle) of
+// its lights; it is built top-down with the binned surface area orientation
+// heuristic and walked by GroundTruth.FragmentLightBvh, so a single pass
+// integrates all the lights instead of one additive pass per light.
+class LightBvh final
+{
+public:
+
+    // std430 layouts, see GroundTruth.glsl
+    struct Node
+    {
+        glm::vec4 Min;      // bounds, power
+        glm::vec4 Max;      // bounds, cos of the normals cone angle
+        glm::vec4 Axis;     // normals cone axis, cos of the emission angle
+        glm::ivec4 Child;   // children, or the light and -1 for a leaf
+    };
+
+    struct Quad
+    {
+        glm::vec4 Points[4];
+        glm::vec4 Params;   // intensity, two-sided, textured
+    };
+
+    static const uint32_t BinCount = 12;
+
+    LightBvh() noexcept;
+    ~LightBvh() noexcept;
+
+    // requires shader storage buffers, i.e. the OpenGL core device
+    bool create(const GraphicsDevicePtr& device) noexcept;
+    void destroy() noexcept;
+
+    // rebuilds the tree and uploads it, a few hundred lights take well under
+    // a millisecond so it is done whenever the lights may have changed
+    void build(const std::vector<std::shared_ptr<Light>>& lights) noexcept;
+
+    // binds the single pass ground truth program and the tree; the material
+    // and light textures and the draws are left to the caller
+    ShaderPtr bindProgram(const RenderingData& data) noexcept;
+
+    uint32_t getNodeCount() const noexcept;
+    uint32_t getDepth() const noexcept;
+
+private:
+
+    // normals cone, angles in radians
+    struct Cone
+    {
+        glm::vec3 Axis;
+        float ThetaO;
+        float ThetaE;
+    };
+
+    struct Primitive
+    {
+        Math::BoundingBox Box;
+        glm::vec3 Centroid;
+        Cone Bounds;
+        float Power;
+        uint32_t Light;
+    };
+
+    static Cone merge(const Cone& a, const Cone& b) noexcept;
+    static float orientationMeasure(const Cone& cone) noexcept;
+
+    int32_t buildNode(uint32_t begin, uint32_t end, uint32_t depth) noexcept;
+
+    ShaderPtr m_Shader;
+    GLuint m_NodeBuffer;
+    GLuint m_LightBuffer;
+    GLsizeiptr m_NodeCapacity;
+    GLsizeiptr m_LightCapacity;
+    std::vector<Primitive> m_Primitives;
+    std::vector<Node> m_Nodes;
+    std::vector<Quad> m_Quads;
+    uint32_t m_Depth;
+};
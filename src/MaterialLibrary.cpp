@@ -0,0 +1,206 @@
+#include <MaterialLibrary.h>
+#include <GLType/GraphicsDevice.h>
+#include <GLType/GraphicsTexture.h>
+#include <GLType/ProgramShader.h>
+#include <tools/gltools.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+    // white albedo, flat normal, unoccluded rough dielectric
+    const uint32_t kPlaceholders[asset::MaterialSlotCount] = { 0xFFFFFFFF, 0xFFFF8080, 0xFF00FFFF };
+
+    const char* const kArrayNames[asset::MaterialSlotCount] = { "uAlbedoArray", "uNormalArray", "uOrmArray" };
+}
+
+MaterialLibrary::MaterialLibrary() noexcept
+    : m_Buffer(GL_NONE)
+    , m_BufferTexture(GL_NONE)
+    , m_BufferCapacity(0)
+{
+}
+
+MaterialLibrary::~MaterialLibrary() noexcept
+{
+    destroy();
+}
+
+bool MaterialLibrary::create(const GraphicsDevicePtr& device) noexcept
+{
+    assert(device);
+    m_Device = device;
+
+    // without the cooked table every slot is a placeholder layer
+    if (!asset::LoadMaterials(asset::kMaterialFile, m_Cooked))
+        printf("MaterialLibrary : %s not found, run the AssetCooker\n", asset::kMaterialFile);
+
+    for (int slot = 0; slot < asset::MaterialSlotCount; slot++)
+    {
+        int32_t layers = 0;
+        for (auto& entry : m_Cooked)
+            layers = std::max(layers, entry.Layers[slot] + 1);
+
+        // trilinear and anisotropic, the floor is seen at grazing angles
+        GraphicsTextureDesc desc;
+        desc.setTarget(gli::TARGET_2D_ARRAY);
+        desc.setMinFilter(GL_LINEAR_MIPMAP_LINEAR);
+        desc.setAnisotropyLevel(16);
+        desc.setDepth(std::max(layers, 1));
+        if (layers > 0)
+        {
+            const asset::CookedFile cooked = asset::ResolveCooked(asset::GetMaterialArraySource(asset::MaterialSlot(slot)));
+            desc.setFilename(cooked.Filename);
+            desc.setBottomUp(cooked.bBottomUp);
+            m_Arrays[slot] = device->createTextureStreamed(desc, kPlaceholders[slot]);
+        }
+        else
+        {
+            desc.setWidth(1);
+            desc.setHeight(1);
+            desc.setLevels(1);
+            desc.setFormat(gli::FORMAT_RGBA8_UNORM_PACK8);
+            desc.setStream(reinterpret_cast<uint8_t*>(const_cast<uint32_t*>(&kPlaceholders[slot])));
+            desc.setStreamSize(sizeof(uint32_t));
+            m_Arrays[slot] = device->createTexture(desc);
+        }
+        if (!m_Arrays[slot])
+            return false;
+    }
+
+    if (device->getGraphicsDeviceDesc().getDeviceType() == GraphicsDeviceTypeOpenGLCore)
+        glCreateBuffers(1, &m_Buffer);
+    else
+    {
+        glGenBuffers(1, &m_Buffer);
+        glGenTextures(1, &m_BufferTexture);
+    }
+
+    CHECKGLERROR();
+    return true;
+}
+
+void MaterialLibrary::destroy() noexcept
+{
+    if (m_BufferTexture != GL_NONE)
+        glDeleteTextures(1, &m_BufferTexture);
+    if (m_Buffer != GL_NONE)
+        glDeleteBuffers(1, &m_Buffer);
+    m_Buffer = GL_NONE;
+    m_BufferTexture = GL_NONE;
+    m_BufferCapacity = 0;
+
+    for (auto& array : m_Arrays)
+        array.reset();
+    m_Cooked.clear();
+    m_Materials.clear();
+    m_Packed.clear();
+    m_Uploaded.clear();
+}
+
+BaseMaterialPtr MaterialLibrary::createMaterial(const std::string& directory) const noexcept
+{
+    auto material = std::make_shared<BaseMaterial>();
+    material->m_Name = directory;
+    auto it = std::find_if(m_Cooked.begin(), m_Cooked.end(),
+        [&directory](const asset::MaterialEntry& entry) { return entry.Directory == directory; });
+    if (it != m_Cooked.end())
+        std::copy(it->Layers, it->Layers + asset::MaterialSlotCount, material->m_Layers);
+    else
+        printf("MaterialLibrary : no cooked maps for \"%s\".\n", directory.c_str());
+    return material;
+}
+
+uint32_t MaterialLibrary::add(const BaseMaterialPtr& material) noexcept
+{
+    assert(material);
+    m_Materials.push_back(material);
+    return uint32_t(m_Materials.size() - 1);
+}
+
+void MaterialLibrary::requestDensity(float uvPerPixel) noexcept
+{
+    auto device = m_Device.lock();
+    if (!device)
+        return;
+    for (auto& array : m_Arrays)
+        device->requestTextureDensity(array, uvPerPixel);
+}
+
+void MaterialLibrary::update() noexcept
+{
+    if (m_Buffer == GL_NONE)
+        return;
+
+    m_Packed.resize(std::max<size_t>(m_Materials.size(), 1));
+    for (size_t i = 0; i < m_Materials.size(); i++)
+    {
+        auto& material = *m_Materials[i];
+        auto& packed = m_Packed[i];
+        packed.BaseColor = material.m_BaseColor;
+        packed.Params = glm::vec4(material.m_Occlusion, material.m_Roughness, material.m_Metalness, 0.f);
+        packed.Layers = glm::ivec4(material.m_Layers[asset::MaterialSlotAlbedo], material.m_Layers[asset::MaterialSlotNormal], material.m_Layers[asset::MaterialSlotOrm], 0);
+    }
+
+    // an instance of an unknown material reads the first record
+    if (m_Materials.empty())
+        m_Packed[0] = { glm::vec4(1.f), glm::vec4(1.f), glm::ivec4(-1) };
+
+    const GLsizeiptr size = m_Packed.size() * sizeof(Material);
+    if (m_Packed.size() == m_Uploaded.size() && memcmp(m_Packed.data(), m_Uploaded.data(), size) == 0)
+        return;
+    if (m_BufferTexture != GL_NONE)
+    {
+        // integer texels, the float bits are fetched as they are
+        glBindBuffer(GL_TEXTURE_BUFFER, m_Buffer);
+        if (size > m_BufferCapacity)
+        {
+            m_BufferCapacity = size;
+            glBufferData(GL_TEXTURE_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, m_BufferTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32I, m_Buffer);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+        }
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, m_Packed.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+    else
+    {
+        if (size > m_BufferCapacity)
+        {
+            m_BufferCapacity = size;
+            glNamedBufferData(m_Buffer, size, nullptr, GL_DYNAMIC_DRAW);
+        }
+        glNamedBufferSubData(m_Buffer, 0, size, m_Packed.data());
+    }
+    m_Uploaded = m_Packed;
+
+    CHECKGLERROR();
+}
+
+void MaterialLibrary::bind(const ShaderPtr& program, GLint unit) const noexcept
+{
+    for (int slot = 0; slot < asset::MaterialSlotCount; slot++)
+        program->bindTexture(kArrayNames[slot], m_Arrays[slot], unit + slot);
+    if (m_BufferTexture != GL_NONE)
+    {
+        program->setUniform("uMaterialData", unit + asset::MaterialSlotCount);
+        glActiveTexture(GL_TEXTURE0 + unit + asset::MaterialSlotCount);
+        glBindTexture(GL_TEXTURE_BUFFER, m_BufferTexture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    else if (m_Buffer != GL_NONE)
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MaterialBinding, m_Buffer);
+}
+
+uint32_t MaterialLibrary::getMaterialCount() const noexcept
+{
+    return uint32_t(m_Materials.size());
+}
+
+const BaseMaterialPtr& MaterialLibrary::getMaterial(uint32_t index) const noexcept
+{
+    assert(index < m_Materials.size());
+    return m_Materials[index];
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <AssetManifest.h>
+#include <BaseMaterial.h>
+#include <GraphicsTypes.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+typedef std::shared_ptr<class ProgramShader> ShaderPtr;
+
+// The materials of the scene in one storage buffer (a texture buffer on 4.1),
+// indexed by the material of each instance (see ModelBatch). Their maps are the layers of one texture
+// array per slot, cooked by the AssetCooker, so that the models of every
+// material are drawn with the same bindings and the batches are not split
+// by material. The arrays are streamed like any other texture.
+class MaterialLibrary final
+{
+public:
+
+    // std430 layout, see MaterialUtility.glsli
+    struct Material
+    {
+        glm::vec4 BaseColor;
+        glm::vec4 Params;   // occlusion, roughness, metalness
+        glm::ivec4 Layers;  // albedo, normal, orm, -1 without a map
+    };
+
+    static const GLuint MaterialBinding = 2;
+
+    MaterialLibrary() noexcept;
+    ~MaterialLibrary() noexcept;
+
+    // maps the cooked arrays; the 4.1 device has no storage buffers, the
+    // shaders fetch the same records from an RGBA32I texture buffer
+    bool create(const GraphicsDevicePtr& device) noexcept;
+    void destroy() noexcept;
+
+    // the layers of the maps cooked from 'directory', none when the
+    // directory was not cooked
+    BaseMaterialPtr createMaterial(const std::string& directory) const noexcept;
+
+    // returns the index given to Model::appendMesh
+    uint32_t add(const BaseMaterialPtr& material) noexcept;
+
+    // the finest level of the arrays, see GraphicsDevice::requestTextureDensity
+    void requestDensity(float uvPerPixel) noexcept;
+
+    // uploads the materials when one of them changed
+    void update() noexcept;
+
+    // the albedo, normal and orm arrays on 'unit' to 'unit + 2', and the
+    // material buffer (its texture on 'unit + 3' on 4.1)
+    void bind(const ShaderPtr& program, GLint unit) const noexcept;
+
+    uint32_t getMaterialCount() const noexcept;
+    const BaseMaterialPtr& getMaterial(uint32_t index) const noexcept;
+
+private:
+
+    GraphicsDeviceWeakPtr m_Device;
+    GraphicsTexturePtr m_Arrays[asset::MaterialSlotCount];
+    std::vector<asset::MaterialEntry> m_Cooked;
+    std::vector<BaseMaterialPtr> m_Materials;
+    GLuint m_Buffer;
+    GLuint m_BufferTexture;
+    GLsizeiptr m_BufferCapacity;
+
+    // packed by update(), and as last uploaded
+    std::vector<Material> m_Packed;
+    std::vector<Material> m_Uploaded;
+};
@@ -0,0 +1,284 @@
+#include <Math/AabbTree.h>
+#include <algorithm>
+#include <cassert>
+
+namespace Math
+{
+    AabbTree::AabbTree() noexcept
+        : m_Root(NullNode)
+        , m_FreeList(NullNode)
+        , m_NodeCount(0)
+        , m_Margin(0.1f)
+    {
+    }
+
+    void AabbTree::clear() noexcept
+    {
+        m_Nodes.clear();
+        m_Root = NullNode;
+        m_FreeList = NullNode;
+        m_NodeCount = 0;
+    }
+
+    int32_t AabbTree::allocateNode() noexcept
+    {
+        int32_t node = m_FreeList;
+        if (node == NullNode)
+        {
+            node = (int32_t)m_Nodes.size();
+            m_Nodes.emplace_back();
+        }
+        else
+            m_FreeList = m_Nodes[node].Parent;
+
+        Node& n = m_Nodes[node];
+        n.Parent = NullNode;
+        n.Child[0] = n.Child[1] = NullNode;
+        n.Height = 0;
+        n.UserData = 0;
+        m_NodeCount++;
+        return node;
+    }
+
+    void AabbTree::freeNode(int32_t node) noexcept
+    {
+        m_Nodes[node].Parent = m_FreeList;
+        m_Nodes[node].Child[0] = m_Nodes[node].Child[1] = NullNode;
+        m_Nodes[node].Height = -1;
+        m_FreeList = node;
+        m_NodeCount--;
+    }
+
+    int32_t AabbTree::insert(const BoundingBox& box, uint32_t userData) noexcept
+    {
+        int32_t leaf = allocateNode();
+        m_Nodes[leaf].Box = box.expand(m_Margin);
+        m_Nodes[leaf].UserData = userData;
+        insertLeaf(leaf);
+        return leaf;
+    }
+
+    void AabbTree::remove(int32_t proxy) noexcept
+    {
+        assert(m_Nodes[proxy].isLeaf());
+        removeLeaf(proxy);
+        freeNode(proxy);
+    }
+
+    bool AabbTree::update(int32_t proxy, const BoundingBox& box) noexcept
+    {
+        assert(m_Nodes[proxy].isLeaf());
+        if (m_Nodes[proxy].Box.contains(box))
+            return false;
+
+        removeLeaf(proxy);
+        m_Nodes[proxy].Box = box.expand(m_Margin);
+        insertLeaf(proxy);
+        return true;
+    }
+
+    void AabbTree::insertLeaf(int32_t leaf) noexcept
+    {
+        if (m_Root == NullNode)
+        {
+            m_Root = leaf;
+            m_Nodes[leaf].Parent = NullNode;
+            return;
+        }
+
+        // descend toward the child with the cheapest surface area increase
+        const BoundingBox leafBox = m_Nodes[leaf].Box;
+        int32_t index = m_Root;
+        while (!m_Nodes[index].isLeaf())
+        {
+            const Node& node = m_Nodes[index];
+            float area = node.Box.getSurfaceArea();
+            float combinedArea = node.Box.merge(leafBox).getSurfaceArea();
+
+            // cost of a new parent here, and the inheritance pushed on the children
+            float cost = 2.f * combinedArea;
+            float inheritance = 2.f * (combinedArea - area);
+
+            float childCost[2];
+            for (int k = 0; k < 2; k++)
+            {
+                const Node& child = m_Nodes[node.Child[k]];
+                float merged = child.Box.merge(leafBox).getSurfaceArea();
+                childCost[k] = child.isLeaf() ? merged + inheritance : merged - child.Box.getSurfaceArea() + inheritance;
+            }
+
+            if (cost < childCost[0] && cost < childCost[1])
+                break;
+            index = childCost[0] < childCost[1] ? node.Child[0] : node.Child[1];
+        }
+
+        int32_t sibling = index;
+        int32_t oldParent = m_Nodes[sibling].Parent;
+        int32_t newParent = allocateNode();
+        m_Nodes[newParent].Parent = oldParent;
+        m_Nodes[newParent].Box = leafBox.merge(m_Nodes[sibling].Box);
+        m_Nodes[newParent].Child[0] = sibling;
+        m_Nodes[newParent].Child[1] = leaf;
+        m_Nodes[newParent].Height = m_Nodes[sibling].Height + 1;
+        m_Nodes[sibling].Parent = newParent;
+        m_Nodes[leaf].Parent = newParent;
+
+        if (oldParent == NullNode)
+            m_Root = newParent;
+        else
+        {
+            Node& parent = m_Nodes[oldParent];
+            parent.Child[parent.Child[0] == sibling ? 0 : 1] = newParent;
+        }
+
+        // from the new parent, which may need a rotation of its own
+        refit(newParent);
+    }
+
+    void AabbTree::removeLeaf(int32_t leaf) noexcept
+    {
+        if (leaf == m_Root)
+        {
+            m_Root = NullNode;
+            return;
+        }
+
+        int32_t parent = m_Nodes[leaf].Parent;
+        int32_t grandParent = m_Nodes[parent].Parent;
+        int32_t sibling = m_Nodes[parent].Child[m_Nodes[parent].Child[0] == leaf ? 1 : 0];
+
+        if (grandParent == NullNode)
+        {
+            m_Root = sibling;
+            m_Nodes[sibling].Parent = NullNode;
+        }
+        else
+        {
+            Node& node = m_Nodes[grandParent];
+            node.Child[node.Child[0] == parent ? 0 : 1] = sibling;
+            m_Nodes[sibling].Parent = grandParent;
+        }
+        freeNode(parent);
+        refit(grandParent);
+    }
+
+    void AabbTree::refit(int32_t node) noexcept
+    {
+        while (node != NullNode)
+        {
+            node = balance(node);
+            Node& n = m_Nodes[node];
+            const Node& child0 = m_Nodes[n.Child[0]];
+            const Node& child1 = m_Nodes[n.Child[1]];
+            n.Box = child0.Box.merge(child1.Box);
+            n.Height = 1 + std::max(child0.Height, child1.Height);
+            node = n.Parent;
+        }
+    }
+
+    int32_t AabbTree::balance(int32_t iA) noexcept
+    {
+        Node& A = m_Nodes[iA];
+        if (A.isLeaf() || A.Height < 2)
+            return iA;
+
+        // the taller child takes the place of 'A', which adopts the shorter
+        // grandchild of that side
+        const int32_t side = m_Nodes[A.Child[1]].Height > m_Nodes[A.Child[0]].Height ? 1 : 0;
+        const int32_t iB = A.Child[side];
+        const int32_t iC = A.Child[side ^ 1];
+        Node& B = m_Nodes[iB];
+        Node& C = m_Nodes[iC];
+        if (B.Height - C.Height < 2)
+            return iA;
+
+        const int32_t iD = B.Child[0];
+        const int32_t iE = B.Child[1];
+        Node& D = m_Nodes[iD];
+        Node& E = m_Nodes[iE];
+
+        B.Child[0] = iA;
+        B.Parent = A.Parent;
+        A.Parent = iB;
+        if (B.Parent == NullNode)
+            m_Root = iB;
+        else
+        {
+            Node& parent = m_Nodes[B.Parent];
+            parent.Child[parent.Child[0] == iA ? 0 : 1] = iB;
+        }
+
+        const bool bKeepD = D.Height > E.Height;
+        const int32_t iTall = bKeepD ? iD : iE;
+        const int32_t iShort = bKeepD ? iE : iD;
+        Node& tall = m_Nodes[iTall];
+        Node& shorter = m_Nodes[iShort];
+        B.Child[1] = iTall;
+        A.Child[side] = iShort;
+        shorter.Parent = iA;
+
+        A.Box = C.Box.merge(shorter.Box);
+        A.Height = 1 + std::max(C.Height, shorter.Height);
+        B.Box = A.Box.merge(tall.Box);
+        B.Height = 1 + std::max(A.Height, tall.Height);
+        return iB;
+    }
+
+    void AabbTree::collectLeaves(int32_t root, std::vector<uint32_t>& result) const noexcept
+    {
+        // depth first through the parent links, no stack however deep the tree
+        int32_t node = root;
+        while (true)
+        {
+            while (!m_Nodes[node].isLeaf())
+                node = m_Nodes[node].Child[0];
+            result.push_back(m_Nodes[node].UserData);
+
+            // up to the first left child, then over to its sibling
+            while (true)
+            {
+                if (node == root)
+                    return;
+                const int32_t parent = m_Nodes[node].Parent;
+                if (m_Nodes[parent].Child[0] == node)
+                {
+                    node = m_Nodes[parent].Child[1];
+                    break;
+                }
+                node = parent;
+            }
+        }
+    }
+
+    void AabbTree::query(const CullVolume& volume, std::vector<uint32_t>& result) const noexcept
+    {
+        if (m_Root == NullNode)
+            return;
+
+        int32_t stack[64];
+        int32_t count = 0;
+        stack[count++] = m_Root;
+        while (count > 0)
+        {
+            int32_t node = stack[--count];
+            const Node& n = m_Nodes[node];
+
+            CullResult cull = volume.test(n.Box);
+            if (cull == CullOutside)
+                continue;
+            // no need to test further down
+            if (cull == CullInside || n.isLeaf())
+            {
+                collectLeaves(node, result);
+                continue;
+            }
+            if (count + 2 > 64)
+            {
+                collectLeaves(node, result);
+                continue;
+            }
+            stack[count++] = n.Child[0];
+            stack[count++] = n.Child[1];
+        }
+    }
+}
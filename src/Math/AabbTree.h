@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Math/Culling.h>
+#include <vector>
+#include <cstdint>
+
+namespace Math
+{
+    // Dynamic bounding volume hierarchy (Box2D b2DynamicTree like). Leaves keep
+    // a fattened box so that small moves only refit, larger ones reinsert.
+    // The refits rotate the unbalanced nodes, so that inserting the models in
+    // scan order still gives a tree of logarithmic height.
+    class AabbTree
+    {
+    public:
+
+        static const int32_t NullNode = -1;
+
+        AabbTree() noexcept;
+
+        int32_t insert(const BoundingBox& box, uint32_t userData) noexcept;
+        void remove(int32_t proxy) noexcept;
+
+        // returns true when the leaf had to be moved
+        bool update(int32_t proxy, const BoundingBox& box) noexcept;
+
+        void clear() noexcept;
+
+        // appends the user data of the leaves intersecting 'volume'
+        void query(const CullVolume& volume, std::vector<uint32_t>& result) const noexcept;
+
+        uint32_t getNodeCount() const noexcept { return m_NodeCount; }
+        int32_t getHeight() const noexcept { return m_Root == NullNode ? 0 : m_Nodes[m_Root].Height; }
+
+    private:
+
+        struct Node
+        {
+            BoundingBox Box;
+            int32_t Parent; // next free node when unused
+            int32_t Child[2];
+            int32_t Height; // 0 for the leaves
+            uint32_t UserData;
+
+            bool isLeaf() const { return Child[0] == NullNode; }
+        };
+
+        int32_t allocateNode() noexcept;
+        void freeNode(int32_t node) noexcept;
+        void insertLeaf(int32_t leaf) noexcept;
+        void removeLeaf(int32_t leaf) noexcept;
+        void refit(int32_t node) noexcept;
+        int32_t balance(int32_t node) noexcept;
+        void collectLeaves(int32_t root, std::vector<uint32_t>& result) const noexcept;
+
+        std::vector<Node> m_Nodes;
+        int32_t m_Root;
+        int32_t m_FreeList;
+        uint32_t m_NodeCount;
+        float m_Margin;
+    };
+}
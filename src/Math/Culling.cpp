@@ -0,0 +1,137 @@
+#include <Math/Culling.h>
+#include <cassert>
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define CULLING_USE_SSE 1
+#   include <emmintrin.h>
+#else
+#   define CULLING_USE_SSE 0
+#endif
+
+namespace Math
+{
+    float BoundingBox::getSurfaceArea() const
+    {
+        glm::vec3 d = Max - Min;
+        return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    bool BoundingBox::contains(const BoundingBox& box) const
+    {
+        return glm::all(glm::lessThanEqual(Min, box.Min)) && glm::all(glm::lessThanEqual(box.Max, Max));
+    }
+
+    BoundingBox BoundingBox::merge(const BoundingBox& box) const
+    {
+        return { glm::min(Min, box.Min), glm::max(Max, box.Max) };
+    }
+
+    BoundingBox BoundingBox::expand(float margin) const
+    {
+        return { Min - glm::vec3(margin), Max + glm::vec3(margin) };
+    }
+
+    BoundingBox BoundingBox::transform(const BoundingBox& box, const glm::mat4& world)
+    {
+        glm::vec3 center = glm::vec3(world * glm::vec4(box.getCenter(), 1.f));
+        glm::vec3 extent = box.getExtent();
+        glm::mat3 absWorld = glm::mat3(glm::abs(glm::vec3(world[0])), glm::abs(glm::vec3(world[1])), glm::abs(glm::vec3(world[2])));
+        glm::vec3 worldExtent = absWorld * extent;
+        return { center - worldExtent, center + worldExtent };
+    }
+
+    CullVolume::CullVolume() noexcept
+        : m_Count(0)
+    {
+        // padding planes never reject
+        for (uint32_t i = 0; i < MaxPlanes; i++)
+        {
+            m_X[i] = m_Y[i] = m_Z[i] = 0.f;
+            m_D[i] = FLT_MAX;
+        }
+    }
+
+    CullVolume CullVolume::fromViewProjection(const glm::mat4& m) noexcept
+    {
+        // Gribb & Hartmann, rows of the column major matrix
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        CullVolume volume;
+        volume.addPlane(row3 + row0);
+        volume.addPlane(row3 - row0);
+        volume.addPlane(row3 + row1);
+        volume.addPlane(row3 - row1);
+        volume.addPlane(row3 + row2);
+        volume.addPlane(row3 - row2);
+        return volume;
+    }
+
+    CullVolume CullVolume::fromSphere(const glm::vec3& center, float radius) noexcept
+    {
+        CullVolume volume;
+        volume.addPlane(glm::vec4(+1.f, 0.f, 0.f, radius - center.x));
+        volume.addPlane(glm::vec4(-1.f, 0.f, 0.f, radius + center.x));
+        volume.addPlane(glm::vec4(0.f, +1.f, 0.f, radius - center.y));
+        volume.addPlane(glm::vec4(0.f, -1.f, 0.f, radius + center.y));
+        volume.addPlane(glm::vec4(0.f, 0.f, +1.f, radius - center.z));
+        volume.addPlane(glm::vec4(0.f, 0.f, -1.f, radius + center.z));
+        return volume;
+    }
+
+    void CullVolume::addPlane(const glm::vec4& plane) noexcept
+    {
+        assert(m_Count < MaxPlanes);
+        float len = glm::length(glm::vec3(plane));
+        m_X[m_Count] = plane.x / len;
+        m_Y[m_Count] = plane.y / len;
+        m_Z[m_Count] = plane.z / len;
+        m_D[m_Count] = plane.w / len;
+        m_Count++;
+    }
+
+    CullResult CullVolume::test(const BoundingBox& box) const noexcept
+    {
+        const glm::vec3 c = box.getCenter();
+        const glm::vec3 e = box.getExtent();
+
+#if CULLING_USE_SSE
+        const __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+        const __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+        const __m128 signMask = _mm_set1_ps(-0.f);
+        const __m128 zero = _mm_setzero_ps();
+
+        int outside = 0, intersect = 0;
+        for (uint32_t i = 0; i < m_Count; i += 4)
+        {
+            __m128 nx = _mm_load_ps(m_X + i), ny = _mm_load_ps(m_Y + i), nz = _mm_load_ps(m_Z + i);
+            __m128 d = _mm_load_ps(m_D + i);
+
+            // signed distance of the center and projected radius of the box
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), d));
+            __m128 radius = _mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(_mm_andnot_ps(signMask, nx), ex),
+                _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+                _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+
+            outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, radius), zero));
+            intersect |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(dist, radius), zero));
+        }
+#else
+        int outside = 0, intersect = 0;
+        for (uint32_t i = 0; i < m_Count; i++)
+        {
+            float dist = m_X[i] * c.x + m_Y[i] * c.y + m_Z[i] * c.z + m_D[i];
+            float radius = glm::abs(m_X[i]) * e.x + glm::abs(m_Y[i]) * e.y + glm::abs(m_Z[i]) * e.z;
+            outside |= (dist + radius < 0.f);
+            intersect |= (dist - radius < 0.f);
+        }
+#endif
+        if (outside)
+            return CullOutside;
+        return intersect ? CullIntersect : CullInside;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+namespace Math
+{
+    struct BoundingBox
+    {
+        glm::vec3 Min;
+        glm::vec3 Max;
+
+        glm::vec3 getCenter() const { return (Min + Max) * 0.5f; }
+        glm::vec3 getExtent() const { return (Max - Min) * 0.5f; }
+        float getSurfaceArea() const;
+
+        bool contains(const BoundingBox& box) const;
+        BoundingBox merge(const BoundingBox& box) const;
+        BoundingBox expand(float margin) const;
+
+        // conservative box of 'box' transformed by 'world' (Arvo)
+        static BoundingBox transform(const BoundingBox& box, const glm::mat4& world);
+    };
+
+    enum CullResult
+    {
+        CullOutside = 0,
+        CullIntersect,
+        CullInside
+    };
+
+    // Convex volume as up to 8 inward facing planes, stored by 4 in SoA
+    // so that a box is tested against 4 planes at once
+    class CullVolume
+    {
+    public:
+
+        static const uint32_t MaxPlanes = 8;
+
+        CullVolume() noexcept;
+
+        // 6 planes of a (jittered) view projection, GL clip space
+        static CullVolume fromViewProjection(const glm::mat4& viewProj) noexcept;
+
+        // box around a sphere, addPlane() can clip it further (one-sided emitter)
+        static CullVolume fromSphere(const glm::vec3& center, float radius) noexcept;
+
+        // plane : dot(n, p) + d >= 0 is inside
+        void addPlane(const glm::vec4& plane) noexcept;
+
+        CullResult test(const BoundingBox& box) const noexcept;
+
+    private:
+
+        uint32_t m_Count;
+        alignas(16) float m_X[MaxPlanes];
+        alignas(16) float m_Y[MaxPlanes];
+        alignas(16) float m_Z[MaxPlanes];
+        alignas(16) float m_D[MaxPlanes];
+    };
+}
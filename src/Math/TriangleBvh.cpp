@@ -0,0 +1,508 @@
+#include <Math/TriangleBvh.h>
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstring>
+#include <thread>
+
+namespace Math
+{
+    namespace
+    {
+        // subtrees at least this large are handed to the other workers
+        const uint32_t kTaskThreshold = 4096;
+
+        // nodes at least this large bin their triangles on every thread
+        const uint32_t kParallelBinThreshold = 1 << 16;
+
+        const BoundingBox kEmptyBox = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+
+        // function(first, last, chunk) over [0, count) split in 'threadCount'
+        // chunks, the first one on the calling thread
+        template <typename Function>
+        void ParallelFor(uint32_t count, uint32_t threadCount, const Function& function)
+        {
+            if (threadCount <= 1 || count < threadCount)
+            {
+                function(0u, count, 0u);
+                return;
+            }
+
+            const uint32_t chunk = (count + threadCount - 1) / threadCount;
+            std::vector<std::thread> threads;
+            for (uint32_t i = 1; i < threadCount; i++)
+            {
+                uint32_t first = std::min(i * chunk, count);
+                uint32_t last = std::min(first + chunk, count);
+                threads.emplace_back([&function, first, last, i]() { function(first, last, i); });
+            }
+            function(0u, chunk, 0u);
+            for (auto& thread : threads)
+                thread.join();
+        }
+
+        uint32_t BinIndex(float centroid, float origin, float scale)
+        {
+            return std::min(uint32_t(glm::max((centroid - origin) * scale, 0.f)), TriangleBvh::BinCount - 1);
+        }
+
+        float AsFloat(uint32_t bits)
+        {
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        uint32_t AsUint(float value)
+        {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+
+        void AtomicMax(std::atomic<uint32_t>& target, uint32_t value)
+        {
+            uint32_t current = target.load();
+            while (current < value && !target.compare_exchange_weak(current, value))
+                ;
+        }
+    }
+
+    TriangleBvh::TriangleBvh() noexcept
+        : m_Depth(0)
+        , m_LeafCount(0)
+        , m_NodeCount(0)
+        , m_MaxDepth(0)
+        , m_Leaves(0)
+        , m_Pending(0)
+        , m_ThreadCount(1)
+    {
+    }
+
+    void TriangleBvh::clear() noexcept
+    {
+        m_Nodes.clear();
+        m_Triangles.clear();
+        m_Depth = 0;
+        m_LeafCount = 0;
+    }
+
+    void TriangleBvh::build(const std::vector<glm::vec3>& vertices, uint32_t threadCount) noexcept
+    {
+        clear();
+        const uint32_t count = uint32_t(vertices.size() / 3);
+        if (count == 0)
+            return;
+
+        m_ThreadCount = threadCount > 0 ? threadCount : std::max(std::thread::hardware_concurrency(), 1u);
+
+        m_Refs.resize(count);
+        m_Boxes.resize(count);
+        m_Centroids.resize(count);
+        ParallelFor(count, m_ThreadCount, [&](uint32_t first, uint32_t last, uint32_t)
+        {
+            for (uint32_t i = first; i < last; i++)
+            {
+                const glm::vec3* v = &vertices[i * 3];
+                BoundingBox box = { glm::min(v[0], glm::min(v[1], v[2])), glm::max(v[0], glm::max(v[1], v[2])) };
+                m_Refs[i] = i;
+                m_Boxes[i] = box;
+                m_Centroids[i] = box.getCenter();
+            }
+        });
+
+        // the root is alone in the first pair, a binary tree with N leaves
+        // has N - 1 inner nodes
+        m_Nodes.resize(std::max(count * 2, 2u));
+        m_Nodes[1] = Node { glm::vec3(0.f), 0, glm::vec3(0.f), 0 };
+        m_NodeCount = 2;
+        m_MaxDepth = 0;
+        m_Leaves = 0;
+        m_Tasks.assign(1, Task { 0, 0, count, 1 });
+        m_Pending = 1;
+
+        std::vector<std::thread> workers;
+        for (uint32_t i = 1; i < m_ThreadCount; i++)
+            workers.emplace_back([this]() { runWorker(); });
+        runWorker();
+        for (auto& worker : workers)
+            worker.join();
+
+        m_Nodes.resize(m_NodeCount);
+        m_Depth = m_MaxDepth;
+        m_LeafCount = m_Leaves;
+
+        m_Triangles.resize(count);
+        ParallelFor(count, m_ThreadCount, [&](uint32_t first, uint32_t last, uint32_t)
+        {
+            for (uint32_t i = first; i < last; i++)
+            {
+                uint32_t ref = m_Refs[i];
+                const glm::vec3* v = &vertices[ref * 3];
+                m_Triangles[i].V0 = glm::vec4(v[0], AsFloat(ref));
+                m_Triangles[i].E1 = glm::vec4(v[1] - v[0], 0.f);
+                m_Triangles[i].E2 = glm::vec4(v[2] - v[0], 0.f);
+            }
+        });
+
+        m_Refs = std::vector<uint32_t>();
+        m_Boxes = std::vector<BoundingBox>();
+        m_Centroids = std::vector<glm::vec3>();
+    }
+
+    void TriangleBvh::runWorker() noexcept
+    {
+        for (;;)
+        {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Condition.wait(lock, [this]() { return !m_Tasks.empty() || m_Pending == 0; });
+                if (m_Tasks.empty())
+                    return;
+                task = m_Tasks.back();
+                m_Tasks.pop_back();
+            }
+
+            buildSubtree(task);
+
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (--m_Pending == 0)
+                m_Condition.notify_all();
+        }
+    }
+
+    void TriangleBvh::buildSubtree(const Task& root) noexcept
+    {
+        Task stack[MaxDepth + 1];
+        uint32_t size = 0;
+        stack[size++] = root;
+        while (size > 0)
+        {
+            Task task = stack[--size];
+            Task left, right;
+            if (!split(task, left, right))
+                continue;
+
+            if (m_ThreadCount > 1 && right.End - right.Begin >= kTaskThreshold)
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Tasks.push_back(right);
+                m_Pending++;
+                m_Condition.notify_one();
+            }
+            else
+                stack[size++] = right;
+            stack[size++] = left;
+        }
+    }
+
+    void TriangleBvh::computeBins(uint32_t begin, uint32_t end, BoundingBox& box, BoundingBox& centroids, Bin bins[3][BinCount]) const noexcept
+    {
+        auto bound = [&](uint32_t first, uint32_t last, BoundingBox& b, BoundingBox& c)
+        {
+            b = c = kEmptyBox;
+            for (uint32_t i = first; i < last; i++)
+            {
+                uint32_t ref = m_Refs[i];
+                b.Min = glm::min(b.Min, m_Boxes[ref].Min);
+                b.Max = glm::max(b.Max, m_Boxes[ref].Max);
+                c.Min = glm::min(c.Min, m_Centroids[ref]);
+                c.Max = glm::max(c.Max, m_Centroids[ref]);
+            }
+        };
+
+        glm::vec3 scale;
+        auto bin = [&](uint32_t first, uint32_t last, Bin* local)
+        {
+            for (uint32_t k = 0; k < 3 * BinCount; k++)
+                local[k] = Bin { kEmptyBox, 0 };
+            for (uint32_t i = first; i < last; i++)
+            {
+                uint32_t ref = m_Refs[i];
+                for (uint32_t axis = 0; axis < 3; axis++)
+                {
+                    Bin& b = local[axis * BinCount + BinIndex(m_Centroids[ref][axis], centroids.Min[axis], scale[axis])];
+                    b.Box.Min = glm::min(b.Box.Min, m_Boxes[ref].Min);
+                    b.Box.Max = glm::max(b.Box.Max, m_Boxes[ref].Max);
+                    b.Count++;
+                }
+            }
+        };
+
+        // most nodes are small, they are binned in place
+        const uint32_t count = end - begin;
+        const uint32_t threadCount = count >= kParallelBinThreshold ? m_ThreadCount : 1;
+        if (threadCount == 1)
+        {
+            bound(begin, end, box, centroids);
+            scale = float(BinCount) / glm::max(centroids.Max - centroids.Min, glm::vec3(1e-20f));
+            bin(begin, end, &bins[0][0]);
+            return;
+        }
+
+        std::vector<BoundingBox> chunkBoxes(threadCount * 2);
+        ParallelFor(count, threadCount, [&](uint32_t first, uint32_t last, uint32_t chunk)
+        {
+            bound(begin + first, begin + last, chunkBoxes[chunk * 2 + 0], chunkBoxes[chunk * 2 + 1]);
+        });
+        box = centroids = kEmptyBox;
+        for (uint32_t i = 0; i < threadCount; i++)
+        {
+            box = box.merge(chunkBoxes[i * 2 + 0]);
+            centroids = centroids.merge(chunkBoxes[i * 2 + 1]);
+        }
+
+        scale = float(BinCount) / glm::max(centroids.Max - centroids.Min, glm::vec3(1e-20f));
+        std::vector<Bin> chunkBins(threadCount * 3 * BinCount);
+        ParallelFor(count, threadCount, [&](uint32_t first, uint32_t last, uint32_t chunk)
+        {
+            bin(begin + first, begin + last, &chunkBins[chunk * 3 * BinCount]);
+        });
+        for (uint32_t k = 0; k < 3 * BinCount; k++)
+        {
+            Bin& b = (&bins[0][0])[k];
+            b = chunkBins[k];
+            for (uint32_t i = 1; i < threadCount; i++)
+            {
+                b.Box = b.Box.merge(chunkBins[i * 3 * BinCount + k].Box);
+                b.Count += chunkBins[i * 3 * BinCount + k].Count;
+            }
+        }
+    }
+
+    bool TriangleBvh::split(const Task& task, Task& left, Task& right) noexcept
+    {
+        Bin bins[3][BinCount];
+        BoundingBox box, centroids;
+        computeBins(task.Begin, task.End, box, centroids, bins);
+
+        const uint32_t count = task.End - task.Begin;
+        Node& node = m_Nodes[task.Node];
+        node.Min = box.Min;
+        node.Max = box.Max;
+
+        auto makeLeaf = [&]()
+        {
+            node.Index = int32_t(task.Begin);
+            node.Count = int32_t(count);
+            m_Leaves++;
+            AtomicMax(m_MaxDepth, task.Depth);
+            return false;
+        };
+
+        // the traversal stacks hold one entry per level
+        if (count <= 2 || task.Depth >= MaxDepth)
+            return makeLeaf();
+
+        // sweeps of the bin bounds from both sides
+        float bestCost = FLT_MAX;
+        int32_t bestAxis = -1;
+        uint32_t bestSplit = 0;
+        for (uint32_t axis = 0; axis < 3; axis++)
+        {
+            if (centroids.Max[axis] - centroids.Min[axis] <= 0.f)
+                continue;
+
+            float rightArea[BinCount];
+            uint32_t rightCount[BinCount];
+            BoundingBox accumulated = kEmptyBox;
+            uint32_t accumulatedCount = 0;
+            for (uint32_t k = BinCount - 1; k > 0; k--)
+            {
+                accumulated = accumulated.merge(bins[axis][k].Box);
+                accumulatedCount += bins[axis][k].Count;
+                rightArea[k] = accumulatedCount > 0 ? accumulated.getSurfaceArea() : 0.f;
+                rightCount[k] = accumulatedCount;
+            }
+
+            accumulated = kEmptyBox;
+            accumulatedCount = 0;
+            for (uint32_t k = 1; k < BinCount; k++)
+            {
+                accumulated = accumulated.merge(bins[axis][k - 1].Box);
+                accumulatedCount += bins[axis][k - 1].Count;
+                if (accumulatedCount == 0 || rightCount[k] == 0)
+                    continue;
+
+                float cost = accumulated.getSurfaceArea() * accumulatedCount + rightArea[k] * rightCount[k];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = int32_t(axis);
+                    bestSplit = k;
+                }
+            }
+        }
+
+        // a traversal step costs about one triangle test
+        const float leafCost = float(count);
+        const float splitCost = bestAxis >= 0 ? 1.f + bestCost / glm::max(box.getSurfaceArea(), 1e-20f) : FLT_MAX;
+        if (splitCost >= leafCost && count <= MaxLeafSize)
+            return makeLeaf();
+
+        uint32_t middle = (task.Begin + task.End) / 2;
+        if (bestAxis >= 0)
+        {
+            const float origin = centroids.Min[bestAxis];
+            const float scale = float(BinCount) / glm::max(centroids.Max[bestAxis] - origin, 1e-20f);
+            auto it = std::partition(m_Refs.begin() + task.Begin, m_Refs.begin() + task.End, [&](uint32_t ref)
+            {
+                return BinIndex(m_Centroids[ref][bestAxis], origin, scale) < bestSplit;
+            });
+            middle = uint32_t(it - m_Refs.begin());
+            assert(middle > task.Begin && middle < task.End);
+        }
+
+        // coincident centroids fall back to halving the range
+        const uint32_t child = m_NodeCount.fetch_add(2);
+        node.Index = int32_t(child);
+        node.Count = 0;
+        left = Task { child, task.Begin, middle, task.Depth + 1 };
+        right = Task { child + 1, middle, task.End, task.Depth + 1 };
+        return true;
+    }
+
+    float TriangleBvh::intersectBox(const Node& node, const glm::vec3& origin, const glm::vec3& invDir, float tMax) noexcept
+    {
+        glm::vec3 t0 = (node.Min - origin) * invDir;
+        glm::vec3 t1 = (node.Max - origin) * invDir;
+        glm::vec3 tNear = glm::min(t0, t1);
+        glm::vec3 tFar = glm::max(t0, t1);
+        float enter = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.f));
+        float exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, tMax));
+        return enter <= exit ? enter : FLT_MAX;
+    }
+
+    bool TriangleBvh::intersectTriangle(const Triangle& tri, const glm::vec3& origin, const glm::vec3& dir, float tMax, float& t, float& u, float& v) noexcept
+    {
+        // Moller-Trumbore
+        const glm::vec3 e1 = glm::vec3(tri.E1);
+        const glm::vec3 e2 = glm::vec3(tri.E2);
+        glm::vec3 p = glm::cross(dir, e2);
+        float det = glm::dot(e1, p);
+        if (glm::abs(det) < 1e-20f)
+            return false;
+
+        float invDet = 1.f / det;
+        glm::vec3 s = origin - glm::vec3(tri.V0);
+        u = glm::dot(s, p) * invDet;
+        if (u < 0.f || u > 1.f)
+            return false;
+
+        glm::vec3 q = glm::cross(s, e1);
+        v = glm::dot(dir, q) * invDet;
+        if (v < 0.f || u + v > 1.f)
+            return false;
+
+        t = glm::dot(e2, q) * invDet;
+        return t > 0.f && t < tMax;
+    }
+
+    bool TriangleBvh::intersect(const Ray& ray, RayHit& hit) const noexcept
+    {
+        hit.T = ray.TMax;
+        hit.Triangle = InvalidTriangle;
+        if (m_Nodes.empty())
+            return false;
+
+        const glm::vec3 invDir = 1.f / ray.Direction;
+        if (intersectBox(m_Nodes[0], ray.Origin, invDir, hit.T) == FLT_MAX)
+            return false;
+
+        struct Entry
+        {
+            uint32_t Node;
+            float T;
+        };
+        Entry stack[MaxDepth];
+        uint32_t size = 0;
+        uint32_t index = 0;
+        for (;;)
+        {
+            const Node& node = m_Nodes[index];
+            if (node.Count > 0)
+            {
+                for (int32_t i = node.Index; i < node.Index + node.Count; i++)
+                {
+                    float t, u, v;
+                    if (intersectTriangle(m_Triangles[i], ray.Origin, ray.Direction, hit.T, t, u, v))
+                        hit = RayHit { t, u, v, AsUint(m_Triangles[i].V0.w) };
+                }
+            }
+            else
+            {
+                // nearest child first, the other one waits on the stack
+                uint32_t near = uint32_t(node.Index);
+                uint32_t far = near + 1;
+                float tNear = intersectBox(m_Nodes[near], ray.Origin, invDir, hit.T);
+                float tFar = intersectBox(m_Nodes[far], ray.Origin, invDir, hit.T);
+                if (tFar < tNear)
+                {
+                    std::swap(near, far);
+                    std::swap(tNear, tFar);
+                }
+                if (tNear != FLT_MAX)
+                {
+                    if (tFar != FLT_MAX)
+                        stack[size++] = Entry { far, tFar };
+                    index = near;
+                    continue;
+                }
+            }
+
+            // skips the nodes behind the closest hit
+            while (size > 0 && stack[size - 1].T >= hit.T)
+                size--;
+            if (size == 0)
+                break;
+            index = stack[--size].Node;
+        }
+        return hit.Triangle != InvalidTriangle;
+    }
+
+    bool TriangleBvh::occluded(const Ray& ray) const noexcept
+    {
+        if (m_Nodes.empty())
+            return false;
+
+        const glm::vec3 invDir = 1.f / ray.Direction;
+        if (intersectBox(m_Nodes[0], ray.Origin, invDir, ray.TMax) == FLT_MAX)
+            return false;
+
+        uint32_t stack[MaxDepth];
+        uint32_t size = 0;
+        uint32_t index = 0;
+        for (;;)
+        {
+            const Node& node = m_Nodes[index];
+            if (node.Count > 0)
+            {
+                for (int32_t i = node.Index; i < node.Index + node.Count; i++)
+                {
+                    float t, u, v;
+                    if (intersectTriangle(m_Triangles[i], ray.Origin, ray.Direction, ray.TMax, t, u, v))
+                        return true;
+                }
+            }
+            else
+            {
+                uint32_t left = uint32_t(node.Index);
+                bool bLeft = intersectBox(m_Nodes[left], ray.Origin, invDir, ray.TMax) != FLT_MAX;
+                bool bRight = intersectBox(m_Nodes[left + 1], ray.Origin, invDir, ray.TMax) != FLT_MAX;
+                if (bLeft || bRight)
+                {
+                    if (bLeft && bRight)
+                        stack[size++] = left + 1;
+                    index = bLeft ? left : left + 1;
+                    continue;
+                }
+            }
+
+            if (size == 0)
+                break;
+            index = stack[--size];
+        }
+        return false;
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <Math/Culling.h>
+#include <glm/glm.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+namespace Math
+{
+    struct Ray
+    {
+        glm::vec3 Origin;
+        glm::vec3 Direction;
+        float TMax;
+    };
+
+    struct RayHit
+    {
+        float T;
+        float U, V;         // barycentrics of the second and third vertices
+        uint32_t Triangle;  // index in the source list
+    };
+
+    // Static bounding volume hierarchy over a triangle soup, for ray queries.
+    // Built top-down with a binned SAH; the subtrees are split among worker
+    // threads and the largest nodes also bin their triangles in parallel.
+    // The result is a flat array of 32 bytes nodes whose two children are
+    // adjacent and start on an even index (one 64 bytes line) and the
+    // triangles in leaf order, both uploaded as is for BvhUtility.glsli.
+    class TriangleBvh
+    {
+    public:
+
+        static const uint32_t InvalidTriangle = 0xFFFFFFFF;
+        static const uint32_t BinCount = 16;
+        static const uint32_t MaxLeafSize = 8;
+        static const uint32_t MaxDepth = 64;
+
+        // std430 layouts, see BvhUtility.glsli
+        struct Node
+        {
+            glm::vec3 Min;
+            int32_t Index;      // first child, or first triangle of a leaf
+            glm::vec3 Max;
+            int32_t Count;      // triangles of a leaf, 0 for an inner node
+        };
+
+        struct Triangle
+        {
+            glm::vec4 V0;       // w : index in the source list, as float bits
+            glm::vec4 E1;       // second vertex - first
+            glm::vec4 E2;       // third vertex - first
+        };
+
+        TriangleBvh() noexcept;
+
+        // 'vertices' holds 3 vertices per triangle; 0 threads uses every core
+        void build(const std::vector<glm::vec3>& vertices, uint32_t threadCount = 0) noexcept;
+        void clear() noexcept;
+
+        // closest hit within (0, ray.TMax)
+        bool intersect(const Ray& ray, RayHit& hit) const noexcept;
+
+        // any hit within (0, ray.TMax), for the shadow rays
+        bool occluded(const Ray& ray) const noexcept;
+
+        const std::vector<Node>& getNodes() const noexcept { return m_Nodes; }
+        const std::vector<Triangle>& getTriangles() const noexcept { return m_Triangles; }
+        uint32_t getDepth() const noexcept { return m_Depth; }
+        uint32_t getLeafCount() const noexcept { return m_LeafCount; }
+
+    private:
+
+        struct Task
+        {
+            uint32_t Node;
+            uint32_t Begin;
+            uint32_t End;
+            uint32_t Depth;
+        };
+
+        struct Bin
+        {
+            BoundingBox Box;
+            uint32_t Count;
+        };
+
+        // writes the node, returns false for a leaf; 'left' and 'right' are
+        // the ranges of the children otherwise
+        bool split(const Task& task, Task& left, Task& right) noexcept;
+        void buildSubtree(const Task& root) noexcept;
+        void runWorker() noexcept;
+
+        // node bounds, centroid bounds and the bins along each axis
+        void computeBins(uint32_t begin, uint32_t end, BoundingBox& box, BoundingBox& centroids, Bin bins[3][BinCount]) const noexcept;
+
+        static float intersectBox(const Node& node, const glm::vec3& origin, const glm::vec3& invDir, float tMax) noexcept;
+        static bool intersectTriangle(const Triangle& tri, const glm::vec3& origin, const glm::vec3& dir, float tMax, float& t, float& u, float& v) noexcept;
+
+        std::vector<Node> m_Nodes;
+        std::vector<Triangle> m_Triangles;
+        uint32_t m_Depth;
+        uint32_t m_LeafCount;
+
+        // build state
+        std::vector<uint32_t> m_Refs;
+        std::vector<BoundingBox> m_Boxes;
+        std::vector<glm::vec3> m_Centroids;
+        std::vector<Task> m_Tasks;
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::atomic<uint32_t> m_NodeCount;
+        std::atomic<uint32_t> m_MaxDepth;
+        std::atomic<uint32_t> m_Leaves;
+        uint32_t m_Pending;
+        uint32_t m_ThreadCount;
+    };
+}
@@ -9,12 +9,15 @@
 #include <cstdio>
 #include <cassert>
 #include <vector>
+#include <chrono>
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
 #include <tools/gltools.hpp>
+#include <tools/FileUtility.h>
 #include "Mesh.h"
+#include "MeshFile.h"
 
 
 void Mesh::destroy()
@@ -22,77 +25,87 @@ void Mesh::destroy()
     m_vertexBuffer.destroy();
 }
 
+uint32_t Mesh::getTriangleCount(uint32_t lod) const
+{
+    if (m_vertexBuffer.getLodCount() > 0)
+        return m_vertexBuffer.getLod(lod).indexCount / 3;
+    return (m_mode == GL_TRIANGLES) ? m_count / 3 : glm::max(m_count - 2, 0);
+}
+
+void Mesh::drawIndirect(GLintptr offset) const
+{
+    assert(m_bInitialized);
+    assert(m_vertexBuffer.getInstanceVBO() != 0);
+
+    m_vertexBuffer.enable();
+    m_vertexBuffer.drawIndirect(m_mode, offset);
+    m_vertexBuffer.disable();
+
+    CHECKGLERROR();
+}
+
+void Mesh::drawInstanced(GLsizei instanceCount, uint32_t lod, GLuint baseInstance) const
+{
+    assert(m_bInitialized);
+    assert(m_vertexBuffer.getInstanceVBO() != 0);
+
+    m_vertexBuffer.enable();
+    m_vertexBuffer.draw(m_mode, instanceCount, lod, baseInstance);
+    m_vertexBuffer.disable();
+
+    CHECKGLERROR();
+}
+
 /** PLANE MESH ----------------------------------------- */
 
 void PlaneMesh::create()
 {
-    /**
-     *  todo : use indexed tristrip instead
-     */
-
     assert(!m_bInitialized);
     m_bInitialized = true;
 
     const float SIZE = m_size; //
     const int RES = static_cast<int>(m_res); //  
+    const int ROW = RES + 1;
 
     m_count = 3 * 2 * (RES*RES);
 
     std::vector<glm::vec3> &positions = m_vertexBuffer.getPosition();
     std::vector<glm::vec3> &normals = m_vertexBuffer.getNormal();
     std::vector<glm::vec2> &texCoords = m_vertexBuffer.getTexcoord();
+    std::vector<uint32_t> &indices = m_vertexBuffer.getIndices();
 
-    positions.resize(m_count);
-    normals.resize(m_count, glm::vec3(0.0f, 1.0f, 0.0f));
-    texCoords.resize(m_count);
-
-    glm::vec3 *pPos = &(positions[0]);
-    glm::vec2 *pUV = &(texCoords[0]);
+    positions.resize(ROW*ROW);
+    normals.resize(ROW*ROW, glm::vec3(0.0f, 1.0f, 0.0f));
+    texCoords.resize(ROW*ROW);
+    indices.reserve(m_count);
 
 	float UVScale = m_UVScale;
 
     const float Delta = 1.0f / float(RES);
 
+    for(int j = 0; j < ROW; ++j)
+    {
+        for(int i = 0; i < ROW; ++i)
+        {
+            glm::vec2 uv = Delta * glm::vec2(i, j);
+            positions[j*ROW + i] = SIZE * glm::vec3(uv.x - 0.5f, 0.0f, uv.y - 0.5f);
+            texCoords[j*ROW + i] = glm::vec2(uv.x, 1.0f - uv.y) * UVScale;
+        }
+    }
+
+    /* same winding as the former triangle list */
     for(int j = 0; j < RES; ++j)
     {
         for(int i = 0; i < RES; ++i)
         {
-            glm::vec4 vInd = Delta * glm::vec4(i, j, i + 1, j + 1);
-
-            *pUV = glm::vec2(vInd.x, vInd.y);
-            *pPos = SIZE * glm::vec3(pUV->x - 0.5f, 0.0f, pUV->y - 0.5f);
-			*pUV *= UVScale;
-            ++pPos; ++pUV;
-
-            *pUV = glm::vec2(vInd.x, vInd.w);
-            *pPos = SIZE * glm::vec3(pUV->x - 0.5f, 0.0f, pUV->y - 0.5f);
-			*pUV *= UVScale;
-            ++pPos; ++pUV;
+            uint32_t v00 = j*ROW + i, v10 = v00 + 1;
+            uint32_t v01 = v00 + ROW, v11 = v01 + 1;
 
-            *pUV = glm::vec2(vInd.z, vInd.y);
-            *pPos = SIZE * glm::vec3(pUV->x - 0.5f, 0.0f, pUV->y - 0.5f);
-			*pUV *= UVScale;
-            ++pPos; ++pUV;
-
-
-            *pUV = pUV[-1];
-            *pPos = pPos[-1];
-            ++pPos; ++pUV;
-
-            *pUV = pUV[-3];
-            *pPos = pPos[-3];
-            ++pPos; ++pUV;
-
-            *pUV = glm::vec2(vInd.z, vInd.w);
-            *pPos = SIZE * glm::vec3(pUV->x - 0.5f, 0.0f, pUV->y - 0.5f);
-			*pUV *= UVScale;
-            ++pPos; ++pUV;
+            indices.insert(indices.end(), { v00, v01, v10 });
+            indices.insert(indices.end(), { v10, v01, v11 });
         }
     }
 
-    for (auto& coord : texCoords)
-        coord.g = 1 - coord.g;
-
     m_vertexBuffer.initialize();
     m_vertexBuffer.complete(GL_STATIC_DRAW);
     m_vertexBuffer.cleanData();
@@ -105,7 +118,7 @@ void PlaneMesh::draw() const
     assert(m_bInitialized);
 
     m_vertexBuffer.enable();
-    glDrawArrays(GL_TRIANGLES, 0, m_count);
+    m_vertexBuffer.draw(m_mode);
     m_vertexBuffer.disable();
 
     CHECKGLERROR();
@@ -122,81 +135,59 @@ void SphereMesh::create()
 
 
     const float RADIUS = m_radius; //
+    const int RES = m_meshResolution;
+    const int ROW = RES + 1;
 
-    m_count = 2 * m_meshResolution*(m_meshResolution + 2);
+    m_count = 3 * 2 * (RES*RES);
+    m_mode = GL_TRIANGLES;
 
     std::vector<glm::vec3> &positions = m_vertexBuffer.getPosition();
     std::vector<glm::vec3> &normals = m_vertexBuffer.getNormal();
     std::vector<glm::vec2> &texCoords = m_vertexBuffer.getTexcoord();
+    std::vector<uint32_t> &indices = m_vertexBuffer.getIndices();
 
-    positions.resize(m_count);
-    normals.resize(m_count);
-    texCoords.resize(m_count);
-
-    glm::vec3 *pPos = &(positions[0]);
-    glm::vec3 *pNor = &(normals[0]);
-    glm::vec2 *pUV = &(texCoords[0]);
-
+    positions.resize(ROW*ROW);
+    normals.resize(ROW*ROW);
+    texCoords.resize(ROW*ROW);
+    indices.reserve(m_count);
 
-    float theta2, phi;    // next theta angle, phi angle
+    float theta, phi;     // theta angle, phi angle
     float ct, st;         // cos(theta), sin(theta)
-    float ct2, st2;       // cos(next theta), sin(next theta)
     float cp, sp;         // cos(phi), sin(phi)
 
-
     const float TwoPI = 2.0f*(float)M_PI;
-    const float Delta = 1.0f / float(m_meshResolution);
-
-    ct2 = 0.0f; st2 = -1.0f;
+    const float Delta = 1.0f / float(RES);
 
-    /* Create the sphere from bottom to top (like a spiral) as a tristrip */
-    for(int j = 0; j < m_meshResolution; ++j)
+    /* Latitude rows from bottom to top, the seam column is duplicated for the uvs */
+    for(int j = 0; j < ROW; ++j)
     {
-        ct = ct2;
-        st = st2;
+        theta = (j * Delta - 0.5f) * (float)M_PI;
+        ct = cos(theta);
+        st = sin(theta);
 
-        theta2 = ((j + 1) * Delta - 0.5f) * (float)M_PI;
-        ct2 = cos(theta2);
-        st2 = sin(theta2);
-
-        pNor->x = ct;
-        pNor->y = st;
-        pNor->z = 0.0f;
-        *pPos = RADIUS * (*pNor);
-        pUV->x = 0.0f;
-        pUV->y = j * Delta;
-        ++pPos; ++pNor; ++pUV;
-
-        for(int i = 0; i < m_meshResolution + 1; ++i)
+        for(int i = 0; i < ROW; ++i)
         {
             phi = TwoPI * i * Delta;
             cp = cos(phi);
             sp = sin(phi);
 
-            pNor->x = ct2 * cp;
-            pNor->y = st2;
-            pNor->z = ct2 * sp;
-            *pPos = RADIUS * (*pNor);
-            pUV->x = i * Delta;
-            pUV->y = (j + 1) * Delta;
-            ++pPos; ++pNor; ++pUV;
-
-            pNor->x = ct * cp;
-            pNor->y = st;
-            pNor->z = ct * sp;
-            *pPos = RADIUS * (*pNor);
-            pUV->x = i * Delta;
-            pUV->y = j * Delta;
-            ++pPos; ++pNor; ++pUV;
+            glm::vec3 n(ct * cp, st, ct * sp);
+            normals[j*ROW + i] = n;
+            positions[j*ROW + i] = RADIUS * n;
+            texCoords[j*ROW + i] = glm::vec2(i * Delta, j * Delta);
         }
+    }
 
-        pNor->x = ct2;
-        pNor->y = st2;
-        pNor->z = 0.0f;
-        *pPos = RADIUS * (*pNor);
-        pUV->x = 1.0f;
-        pUV->y = 1.0f;
-        ++pPos; ++pNor; ++pUV;
+    for(int j = 0; j < RES; ++j)
+    {
+        for(int i = 0; i < RES; ++i)
+        {
+            uint32_t l0 = j*ROW + i, l1 = l0 + 1;
+            uint32_t u0 = l0 + ROW, u1 = u0 + 1;
+
+            indices.insert(indices.end(), { l0, u0, u1 });
+            indices.insert(indices.end(), { l0, u1, l1 });
+        }
     }
 
     //-------------------------
@@ -214,7 +205,7 @@ void SphereMesh::draw() const
     assert(m_bInitialized);
 
     m_vertexBuffer.enable();
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, m_count);
+    m_vertexBuffer.draw(m_mode);
     m_vertexBuffer.disable();
 
     CHECKGLERROR();
@@ -327,7 +318,7 @@ void ConeMesh::draw() const
     assert(m_bInitialized);
 
     m_vertexBuffer.enable();
-    glDrawArrays(GL_TRIANGLES, 0, m_count);
+    m_vertexBuffer.draw(m_mode);
     m_vertexBuffer.disable();
 
     CHECKGLERROR();
@@ -339,8 +330,6 @@ void ConeMesh::draw() const
 
 void CubeMesh::create()
 {
-    /// not optimized at all, better with indices
-
     assert(!m_bInitialized);
     m_bInitialized = true;
 
@@ -353,77 +342,54 @@ void CubeMesh::create()
     std::vector<glm::vec3> &positions = m_vertexBuffer.getPosition();
     std::vector<glm::vec3> &normals = m_vertexBuffer.getNormal();
     std::vector<glm::vec2> &coords = m_vertexBuffer.getTexcoord();
+    std::vector<uint32_t> &indices = m_vertexBuffer.getIndices();
 
-    positions.resize(m_count);
-    normals.resize(m_count);
-    coords.resize(m_count);
+    /// 4 corners per face, (0,1,2) (2,3,0)
+    const glm::vec3 faces[6][4] =
+    {
+        /// POSITIVE-X
+        { glm::vec3(1.0f, -1.0f, 1.0f), glm::vec3(1.0f, -1.0f, -1.0f), glm::vec3(1.0f, 1.0f, -1.0f), glm::vec3(1.0f, 1.0f, 1.0f) },
+        /// NEGATIVE-X
+        { glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(-1.0f, -1.0f, 1.0f), glm::vec3(-1.0f, 1.0f, 1.0f), glm::vec3(-1.0f, 1.0f, -1.0f) },
+        /// POSITIVE-Y
+        { glm::vec3(-1.0f, 1.0f, 1.0f), glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(1.0f, 1.0f, -1.0f), glm::vec3(-1.0f, 1.0f, -1.0f) },
+        /// NEGATIVE-Y
+        { glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(1.0f, -1.0f, -1.0f), glm::vec3(1.0f, -1.0f, 1.0f), glm::vec3(-1.0f, -1.0f, 1.0f) },
+        /// POSITIVE-Z
+        { glm::vec3(-1.0f, -1.0f, 1.0f), glm::vec3(1.0f, -1.0f, 1.0f), glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(-1.0f, 1.0f, 1.0f) },
+        /// NEGATIVE-Z
+        { glm::vec3(1.0f, -1.0f, -1.0f), glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(-1.0f, 1.0f, -1.0f), glm::vec3(1.0f, 1.0f, -1.0f) },
+    };
 
-#define PX  0u
-#define NX  6u
-#define PY  12u
-#define NY  18u
-#define PZ  24u
-#define NZ  30u
+    const glm::vec3 default_normals[] =
+    {
+        glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+        glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+        glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+    };
 
-    glm::vec3 default_normals[] =
+    const glm::vec2 default_coords[] =
     {
-        glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)
+        glm::vec2(1.0f, 0.f), glm::vec2(0.0f, 0.f), glm::vec2(0.0f, 1.f), glm::vec2(1.0f, 1.f)
     };
 
-    /// POSITIVE-X
-    positions[PX + 0u] = positions[PX + 5u] = glm::vec3(1.0f, -1.0f, 1.0f);
-    positions[PX + 1u] = glm::vec3(1.0f, -1.0f, -1.0f);
-    positions[PX + 2u] = positions[PX + 3u] = glm::vec3(1.0f, 1.0f, -1.0f);
-    positions[PX + 4u] = glm::vec3(1.0f, 1.0f, 1.0f);
-    normals[PX + 0u] = normals[PX + 1u] = normals[PX + 2u] =
-        normals[PX + 3u] = normals[PX + 4u] = normals[PX + 5u] = default_normals[0u];
-
-    /// NEGATIVE-X
-    positions[NX + 0u] = positions[NX + 5u] = glm::vec3(-1.0f, -1.0f, -1.0f);
-    positions[NX + 1u] = glm::vec3(-1.0f, -1.0f, 1.0f);
-    positions[NX + 2u] = positions[NX + 3u] = glm::vec3(-1.0f, 1.0f, 1.0f);
-    positions[NX + 4u] = glm::vec3(-1.0f, 1.0f, -1.0f);
-    normals[NX + 0u] = normals[NX + 1u] = normals[NX + 2u] =
-        normals[NX + 3u] = normals[NX + 4u] = normals[NX + 5u] = -default_normals[0u];
-
-    /// POSITIVE-Y
-    positions[PY + 0u] = positions[PY + 5u] = glm::vec3(-1.0f, 1.0f, 1.0f);
-    positions[PY + 1u] = glm::vec3(1.0f, 1.0f, 1.0f);
-    positions[PY + 2u] = positions[PY + 3u] = glm::vec3(1.0f, 1.0f, -1.0f);
-    positions[PY + 4u] = glm::vec3(-1.0f, 1.0f, -1.0f);
-    normals[PY + 0u] = normals[PY + 1u] = normals[PY + 2u] =
-        normals[PY + 3u] = normals[PY + 4u] = normals[PY + 5u] = default_normals[1u];
-
-    /// NEGATIVE-Y
-    positions[NY + 0u] = positions[NY + 5u] = glm::vec3(-1.0f, -1.0f, -1.0f);
-    positions[NY + 1u] = glm::vec3(1.0f, -1.0f, -1.0f);
-    positions[NY + 2u] = positions[NY + 3u] = glm::vec3(1.0f, -1.0f, 1.0f);
-    positions[NY + 4u] = glm::vec3(-1.0f, -1.0f, 1.0f);
-    normals[NY + 0u] = normals[NY + 1u] = normals[NY + 2u] =
-        normals[NY + 3u] = normals[NY + 4u] = normals[NY + 5u] = -default_normals[1u];
-
-    /// POSITIVE-Z
-    positions[PZ + 0u] = positions[PZ + 5u] = glm::vec3(-1.0f, -1.0f, 1.0f);
-    positions[PZ + 1u] = glm::vec3(1.0f, -1.0f, 1.0f);
-    positions[PZ + 2u] = positions[PZ + 3u] = glm::vec3(1.0f, 1.0f, 1.0f);
-    positions[PZ + 4u] = glm::vec3(-1.0f, 1.0f, 1.0f);
-    normals[PZ + 0u] = normals[PZ + 1u] = normals[PZ + 2u] =
-        normals[PZ + 3u] = normals[PZ + 4u] = normals[PZ + 5u] = default_normals[2u];
-
-    /// NEGATIVE-Z
-    positions[NZ + 0u] = positions[NZ + 5u] = glm::vec3(1.0f, -1.0f, -1.0f);
-    positions[NZ + 1u] = glm::vec3(-1.0f, -1.0f, -1.0f);
-    positions[NZ + 2u] = positions[NZ + 3u] = glm::vec3(-1.0f, 1.0f, -1.0f);
-    positions[NZ + 4u] = glm::vec3(1.0f, 1.0f, -1.0f);
-    normals[NZ + 0u] = normals[NZ + 1u] = normals[NZ + 2u] =
-        normals[NZ + 3u] = normals[NZ + 4u] = normals[NZ + 5u] = -default_normals[2u];
-
-    coords[PX + 0u] = coords[NX + 0u] = coords[PY + 0u] = coords[NY + 0u] = coords[PZ + 0u] = coords[NZ + 0u] = glm::vec2(1.0f, 0.f);
-    coords[PX + 1u] = coords[NX + 1u] = coords[PY + 1u] = coords[NY + 1u] = coords[PZ + 1u] = coords[NZ + 1u] = glm::vec2(0.0f, 0.f);
-    coords[PX + 2u] = coords[NX + 2u] = coords[PY + 2u] = coords[NY + 2u] = coords[PZ + 2u] = coords[NZ + 2u] = glm::vec2(0.0f, 1.f);
-    coords[PX + 3u] = coords[NX + 3u] = coords[PY + 3u] = coords[NY + 3u] = coords[PZ + 3u] = coords[NZ + 3u] = glm::vec2(0.0f, 1.f);
-    coords[PX + 4u] = coords[NX + 4u] = coords[PY + 4u] = coords[NY + 4u] = coords[PZ + 4u] = coords[NZ + 4u] = glm::vec2(1.0f, 1.f);
-    coords[PX + 5u] = coords[NX + 5u] = coords[PY + 5u] = coords[NY + 5u] = coords[PZ + 5u] = coords[NZ + 5u] = glm::vec2(1.0f, 0.f);
+    positions.reserve(4u * 6u);
+    normals.reserve(4u * 6u);
+    coords.reserve(4u * 6u);
+    indices.reserve(m_count);
+
+    for (uint32_t f = 0u; f < 6u; ++f)
+    {
+        uint32_t base = (uint32_t)positions.size();
+        for (uint32_t k = 0u; k < 4u; ++k)
+        {
+            positions.push_back(faces[f][k]);
+            normals.push_back(default_normals[f]);
+            coords.push_back(default_coords[k]);
+        }
+        indices.insert(indices.end(), { base + 0u, base + 1u, base + 2u });
+        indices.insert(indices.end(), { base + 2u, base + 3u, base + 0u });
+    }
 
     //-------------------------
 
@@ -439,7 +405,7 @@ void CubeMesh::draw() const
     assert(m_bInitialized);
 
     m_vertexBuffer.enable();
-    glDrawArrays(GL_TRIANGLES, 0, m_count);
+    m_vertexBuffer.draw(m_mode);
     m_vertexBuffer.disable();
 
     CHECKGLERROR();
@@ -483,7 +449,81 @@ void FullscreenTriangleMesh::draw() const
     assert(m_bInitialized);
 
     m_vertexBuffer.enable();
-    glDrawArrays(GL_TRIANGLES, 0, m_count);
+    m_vertexBuffer.draw(m_mode);
+    m_vertexBuffer.disable();
+
+    CHECKGLERROR();
+}
+
+/** FILE MESH ------------------------------------------ */
+
+void FileMesh::create()
+{
+    assert(!m_bInitialized);
+
+    using namespace std::chrono;
+    typedef duration<double, std::milli> milliseconds;
+
+    std::string cookedName = m_fileName;
+    size_t ext = m_fileName.find_last_of('.');
+    if (ext != std::string::npos && m_fileName.compare(ext, std::string::npos, ".mesh") != 0)
+    {
+        cookedName = mesh::GetCookedName(m_fileName);
+        if (mesh::IsOutdated(m_fileName, cookedName, m_vertexBuffer))
+        {
+            auto start = high_resolution_clock::now();
+            bool bCooked = mesh::ImportObj(m_fileName, m_vertexBuffer) && mesh::WriteMeshFile(cookedName, m_vertexBuffer);
+            m_vertexBuffer.cleanData();
+            if (!bCooked)
+            {
+                fprintf(stderr, "Error : failed to import %s\n", m_fileName.c_str());
+                return;
+            }
+            m_importTime = milliseconds(high_resolution_clock::now() - start).count();
+
+            auto& before = m_vertexBuffer.getCacheStatsBefore();
+            auto& after = m_vertexBuffer.getCacheStatsAfter();
+            printf("Import %s : %.2f ms, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", m_fileName.c_str(), m_importTime,
+                before.ACMR, after.ACMR, before.ATVR, after.ATVR);
+        }
+    }
+
+    auto start = high_resolution_clock::now();
+
+    auto file = util::MapFileSync(cookedName);
+    if (!file || file->size() < sizeof(mesh::MeshFileHeader))
+    {
+        fprintf(stderr, "Error : %s not found\n", cookedName.c_str());
+        return;
+    }
+
+    const mesh::MeshFileHeader& header = *reinterpret_cast<const mesh::MeshFileHeader*>(file->data());
+    const VertexBufferLayout& layout = header.Layout;
+    if (!mesh::IsValid(header, file->size()))
+    {
+        fprintf(stderr, "Error : %s is not a valid mesh file\n", cookedName.c_str());
+        return;
+    }
+
+    // straight from the mapped pages to the driver
+    m_vertexBuffer.initialize();
+    m_vertexBuffer.upload(layout, file->data() + header.VertexOffset, file->data() + header.IndexOffset, GL_STATIC_DRAW);
+    m_count = layout.lodCount > 0 ? layout.lods[0].indexCount : layout.vertexCount;
+    m_bInitialized = true;
+
+    m_loadTime = milliseconds(high_resolution_clock::now() - start).count();
+    printf("Load %s : %.2f ms, %u vertices, %u triangles, %u lods\n", cookedName.c_str(), m_loadTime,
+        layout.vertexCount, m_count / 3, layout.lodCount);
+
+    CHECKGLERROR();
+}
+
+void FileMesh::draw() const
+{
+    assert(m_bInitialized);
+
+    m_vertexBuffer.enable();
+    m_vertexBuffer.draw(m_mode);
     m_vertexBuffer.disable();
 
     CHECKGLERROR();
@@ -17,6 +17,7 @@
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <string>
 
 #include <GLType/VertexBuffer.h>
 
@@ -39,6 +40,7 @@ protected:
 
 	VertexBuffer m_vertexBuffer;
 	GLsizei m_count;
+	GLenum m_mode;
 
 	/* TODO Move in another object */
 	glm::mat4 m_model;
@@ -49,7 +51,7 @@ protected:
 
 public:
 	Mesh()
-		: m_bInitialized(false), m_model(1.f), m_normal(1.f)
+		: m_bInitialized(false), m_count(0), m_mode(GL_TRIANGLES), m_model(1.f), m_normal(1.f)
 	{}
 
 	virtual ~Mesh() { destroy(); }
@@ -58,6 +60,26 @@ public:
 	virtual void draw() const {}
 	virtual void destroy();
 
+	/** Draw 'instanceCount' copies, world matrices come from the instance buffer
+	    starting at 'baseInstance' */
+	void drawInstanced(GLsizei instanceCount, uint32_t lod = 0, GLuint baseInstance = 0) const;
+	void setInstanceBuffer(GLuint buffer) { m_vertexBuffer.setInstanceBuffer(buffer); }
+
+	/** Draw the command at 'offset' in the bound indirect buffer, see
+	    VertexBuffer::getDrawCommand */
+	void drawIndirect(GLintptr offset) const;
+
+	/** Must be called before create() */
+	void setQuantization(VertexQuantizeFlags flags) { m_vertexBuffer.setQuantization(flags); }
+	const glm::mat4& getDequantMatrix() const { return m_vertexBuffer.getDequantMatrix(); }
+	const VertexBuffer& getVertexBuffer() const { return m_vertexBuffer; }
+
+	/** Must be called before create(), only indexed meshes get simplified levels */
+	void setLodCount(uint32_t count) { m_vertexBuffer.setLodCount(count); }
+	uint32_t getLodCount() const { return glm::max(m_vertexBuffer.getLodCount(), 1u); }
+	float getLodError(uint32_t lod) const { return m_vertexBuffer.getLodCount() > 0 ? m_vertexBuffer.getLod(lod).error : 0.f; }
+	uint32_t getTriangleCount(uint32_t lod = 0) const;
+
 	void setModelMatrix(const glm::mat4 &model)     {m_model = model;}
 	void setNormalMatrix(const glm::mat3 &normal)   {m_normal = normal;}
 
@@ -149,4 +171,34 @@ public:
 	void draw() const override;
 };
 
+/** FILE MESH ------------------------------------------ */
+
+/**
+ *  Loads a cooked '.mesh' file by mapping it, an '.obj' source is first
+ *  imported and cooked into the cooked directory when the cooked file is
+ *  missing or older.
+ */
+class FileMesh : public Mesh
+{
+protected:
+	std::string m_fileName;
+	double m_importTime;  // ms, 0 when the cooked file was up to date
+	double m_loadTime;    // ms
+
+public:
+	FileMesh(const std::string& fileName)
+		: Mesh(),
+		m_fileName(fileName),
+		m_importTime(0.0),
+		m_loadTime(0.0)
+	{}
+
+	void create() override;
+	void draw() const override;
+
+	bool isLoaded() const { return m_bInitialized; }
+	double getImportTime() const { return m_importTime; }
+	double getLoadTime() const { return m_loadTime; }
+};
+
 #endif //MESH_HPP
@@ -0,0 +1,290 @@
+#include <MeshFile.h>
+#include <AssetManifest.h>
+#include <tools/FileUtility.h>
+#include <unordered_map>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace mesh
+{
+    namespace
+    {
+        const char* skipSpace(const char* p, const char* end)
+        {
+            while (p < end && (*p == ' ' || *p == '\t'))
+                p++;
+            return p;
+        }
+
+        const char* nextLine(const char* p, const char* end)
+        {
+            while (p < end && *p != '\n')
+                p++;
+            return p < end ? p + 1 : end;
+        }
+
+        // obj indices are 1 based, negative ones are relative to the end
+        int32_t resolveIndex(long index, size_t count)
+        {
+            if (index > 0)
+                return int32_t(index - 1);
+            if (index < 0)
+                return int32_t(count + index);
+            return -1;
+        }
+
+        struct ObjVertex
+        {
+            int32_t Position;
+            int32_t Texcoord;
+            int32_t Normal;
+
+            bool operator==(const ObjVertex& v) const
+            {
+                return Position == v.Position && Texcoord == v.Texcoord && Normal == v.Normal;
+            }
+        };
+
+        struct ObjVertexHash
+        {
+            size_t operator()(const ObjVertex& v) const
+            {
+                size_t h = std::hash<int32_t>()(v.Position);
+                h ^= std::hash<int32_t>()(v.Texcoord) + 0x9e3779b9 + (h << 6) + (h >> 2);
+                h ^= std::hash<int32_t>()(v.Normal) + 0x9e3779b9 + (h << 6) + (h >> 2);
+                return h;
+            }
+        };
+
+        const char* parseVertex(const char* p, const char* end, ObjVertex& v, size_t numPosition, size_t numTexcoord, size_t numNormal)
+        {
+            char* next = nullptr;
+            v.Position = resolveIndex(strtol(p, &next, 10), numPosition);
+            v.Texcoord = v.Normal = -1;
+            p = next;
+            if (p < end && *p == '/')
+            {
+                p++;
+                if (p < end && *p != '/')
+                {
+                    v.Texcoord = resolveIndex(strtol(p, &next, 10), numTexcoord);
+                    p = next;
+                }
+                if (p < end && *p == '/')
+                {
+                    v.Normal = resolveIndex(strtol(p + 1, &next, 10), numNormal);
+                    p = next;
+                }
+            }
+            return p;
+        }
+    }
+
+    bool ImportObj(const std::string& fileName, VertexBuffer& buffer)
+    {
+        auto file = util::ReadFileSync(fileName);
+        if (file == util::NullFile || file->empty())
+        {
+            fprintf(stderr, "Error : %s not found\n", fileName.c_str());
+            return false;
+        }
+        // strtof/strtol stop on the terminator
+        file->push_back('\0');
+
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec2> texcoords;
+        std::vector<ObjVertex> face;
+
+        auto& outPosition = buffer.getPosition();
+        auto& outNormal = buffer.getNormal();
+        auto& outTexcoord = buffer.getTexcoord();
+        auto& outIndices = buffer.getIndices();
+        std::vector<int32_t> sourcePosition;
+
+        // position, texcoord, normal indices to the output vertex
+        std::unordered_map<ObjVertex, uint32_t, ObjVertexHash> vertexMap;
+
+        const char* p = file->data();
+        const char* end = file->data() + file->size() - 1;
+        char* next = nullptr;
+        while (p < end)
+        {
+            p = skipSpace(p, end);
+            if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+            {
+                glm::vec3 v;
+                v.x = strtof(p + 2, &next);
+                v.y = strtof(next, &next);
+                v.z = strtof(next, &next);
+                positions.push_back(v);
+            }
+            else if (p[0] == 'v' && p[1] == 'n')
+            {
+                glm::vec3 n;
+                n.x = strtof(p + 2, &next);
+                n.y = strtof(next, &next);
+                n.z = strtof(next, &next);
+                normals.push_back(n);
+            }
+            else if (p[0] == 'v' && p[1] == 't')
+            {
+                glm::vec2 t;
+                t.x = strtof(p + 2, &next);
+                t.y = strtof(next, &next);
+                texcoords.push_back(t);
+            }
+            else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+            {
+                face.clear();
+                const char* q = skipSpace(p + 1, end);
+                while (q < end && *q != '\n' && *q != '\r')
+                {
+                    ObjVertex v;
+                    q = parseVertex(q, end, v, positions.size(), texcoords.size(), normals.size());
+                    q = skipSpace(q, end);
+                    if (v.Position < 0 || v.Position >= (int32_t)positions.size())
+                        break;
+                    face.push_back(v);
+                }
+
+                // fan triangulation
+                for (size_t k = 2; k < face.size(); k++)
+                {
+                    for (size_t c : { size_t(0), k - 1, k })
+                    {
+                        const ObjVertex& v = face[c];
+                        auto it = vertexMap.find(v);
+                        if (it == vertexMap.end())
+                        {
+                            uint32_t index = (uint32_t)outPosition.size();
+                            outPosition.push_back(positions[v.Position]);
+                            outTexcoord.push_back(v.Texcoord >= 0 ? texcoords[v.Texcoord] : glm::vec2(0.f));
+                            outNormal.push_back(v.Normal >= 0 ? glm::normalize(normals[v.Normal]) : glm::vec3(0.f));
+                            sourcePosition.push_back(v.Normal >= 0 ? -1 : v.Position);
+                            it = vertexMap.emplace(v, index).first;
+                        }
+                        outIndices.push_back(it->second);
+                    }
+                }
+            }
+            p = nextLine(p, end);
+        }
+
+        if (outIndices.empty())
+        {
+            fprintf(stderr, "Error : %s has no face\n", fileName.c_str());
+            return false;
+        }
+
+        // smooth normals for the vertices without one, shared by position
+        bool bMissingNormal = false;
+        for (auto index : sourcePosition)
+            bMissingNormal |= (index >= 0);
+        if (bMissingNormal)
+        {
+            std::vector<glm::vec3> accum(positions.size(), glm::vec3(0.f));
+            for (size_t i = 0; i < outIndices.size(); i += 3)
+            {
+                uint32_t a = outIndices[i], b = outIndices[i + 1], c = outIndices[i + 2];
+                glm::vec3 n = glm::cross(outPosition[b] - outPosition[a], outPosition[c] - outPosition[a]);
+                for (auto v : { a, b, c })
+                    if (sourcePosition[v] >= 0)
+                        accum[sourcePosition[v]] += n;
+            }
+            for (size_t i = 0; i < outNormal.size(); i++)
+            {
+                if (sourcePosition[i] < 0)
+                    continue;
+                glm::vec3 n = accum[sourcePosition[i]];
+                float len = glm::length(n);
+                outNormal[i] = len > 0.f ? n / len : glm::vec3(0.f, 1.f, 0.f);
+            }
+        }
+
+        if (texcoords.empty())
+            outTexcoord.clear();
+
+        return true;
+    }
+
+    bool WriteMeshFile(const std::string& fileName, VertexBuffer& buffer)
+    {
+        std::vector<uint8_t> vertices, indices;
+        buffer.pack(vertices, indices);
+
+        MeshFileHeader header;
+        memset(&header, 0, sizeof(header));
+        header.Magic = kMeshFileMagic;
+        header.Version = kMeshFileVersion;
+        header.Quantization = buffer.getQuantization();
+        header.LodRequest = buffer.getLodRequest();
+        header.Optimization = buffer.getOptimization() ? 1u : 0u;
+        header.Layout = buffer.getLayout();
+        header.VertexOffset = (sizeof(MeshFileHeader) + 15) & ~uint64_t(15);
+        header.IndexOffset = (header.VertexOffset + vertices.size() + 15) & ~uint64_t(15);
+
+        std::ofstream file(fileName, std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        const char zero[16] = { 0 };
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(zero, header.VertexOffset - sizeof(header));
+        file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size());
+        file.write(zero, header.IndexOffset - header.VertexOffset - vertices.size());
+        file.write(reinterpret_cast<const char*>(indices.data()), indices.size());
+        return file.good();
+    }
+
+    bool IsValid(const MeshFileHeader& header, size_t fileSize)
+    {
+        const VertexBufferLayout& layout = header.Layout;
+        if (header.Magic != kMeshFileMagic || header.Version != kMeshFileVersion ||
+            header.VertexOffset + layout.getVertexSize() > fileSize ||
+            header.IndexOffset + layout.getIndexSize() > fileSize)
+            return false;
+
+        if (layout.lodCount > kMaxVertexBufferLods)
+            return false;
+        for (uint32_t i = 0; i < layout.lodCount; i++)
+        {
+            if (uint64_t(layout.lods[i].firstIndex) + layout.lods[i].indexCount > layout.indexCount)
+                return false;
+        }
+        return true;
+    }
+
+    std::string GetCookedName(const std::string& sourceName)
+    {
+        std::string name = sourceName.substr(0, sourceName.find_last_of('.'));
+        for (auto& c : name)
+        {
+            if (c == '/' || c == '\\' || c == ':')
+                c = '_';
+        }
+        return std::string(asset::kCookedDirectory) + "/" + name + ".mesh";
+    }
+
+    bool IsOutdated(const std::string& sourceName, const std::string& cookedName, const VertexBuffer& buffer)
+    {
+        struct stat source, cooked;
+        if (stat(cookedName.c_str(), &cooked) != 0)
+            return true;
+        if (stat(sourceName.c_str(), &source) != 0)
+            return false;
+        if (source.st_mtime > cooked.st_mtime)
+            return true;
+
+        MeshFileHeader header;
+        std::ifstream file(cookedName, std::ios::binary);
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+            return true;
+        return header.Magic != kMeshFileMagic || header.Version != kMeshFileVersion ||
+            header.Quantization != buffer.getQuantization() ||
+            header.LodRequest != buffer.getLodRequest() ||
+            header.Optimization != (buffer.getOptimization() ? 1u : 0u);
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <GLType/VertexBuffer.h>
+
+// Cooked mesh : the header is followed by the vertex and the index buffers
+// exactly as VertexBuffer::pack() lays them out, so that a mapped file is
+// handed to glBufferData without any parsing
+namespace mesh
+{
+    const uint32_t kMeshFileMagic = 0x4853454D; // 'MESH'
+    const uint32_t kMeshFileVersion = 3;
+
+    struct MeshFileHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t Quantization;  // requested VertexQuantizeFlags, the layout has the applied ones
+        uint32_t LodRequest;
+        uint32_t Optimization;
+        uint32_t Padding;
+        uint64_t VertexOffset;
+        uint64_t IndexOffset;
+        VertexBufferLayout Layout;
+    };
+
+    // Fills the client side arrays of 'buffer' (triangulated, de-duplicated)
+    bool ImportObj(const std::string& fileName, VertexBuffer& buffer);
+
+    // Packs the client side arrays of 'buffer' and writes them
+    bool WriteMeshFile(const std::string& fileName, VertexBuffer& buffer);
+
+    // Header of a file of 'fileSize' bytes whose buffers and index ranges
+    // can be read and drawn as is
+    bool IsValid(const MeshFileHeader& header, size_t fileSize);
+
+    // The cooked file of an '.obj' source, in the cooked directory of the
+    // build (see AssetManifest.h) and named after the flattened source path
+    std::string GetCookedName(const std::string& sourceName);
+
+    // Source file newer than the cooked one, cooked file missing, of another
+    // version or cooked with other settings than the ones of 'buffer'
+    bool IsOutdated(const std::string& sourceName, const std::string& cookedName, const VertexBuffer& buffer);
+}
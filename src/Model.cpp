@@ -0,0 +1,492 @@
+#include <Model.h>
+#include <Mesh.h>
+#include <GLType/GraphicsDevice.h>
+#include <GLType/ProgramShader.h>
+#include <tools/gltools.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+Model::Model() noexcept
+    : m_bDirty(true)
+    , m_World(1.f)
+{
+}
+
+Model::~Model() noexcept
+{
+}
+
+void Model::appendMesh(MeshPtr&& mesh, uint32_t material) noexcept
+{
+    m_Meshes.emplace_back(std::move(mesh));
+    m_Materials.push_back(material);
+}
+
+void Model::setWorld(const glm::mat4& world) noexcept
+{
+    m_World = world;
+    m_bDirty = true;
+}
+
+const glm::mat4& Model::getWorld() const noexcept
+{
+    return m_World;
+}
+
+const MeshList& Model::getMeshes() const noexcept
+{
+    return m_Meshes;
+}
+
+const std::vector<uint32_t>& Model::getMaterials() const noexcept
+{
+    return m_Materials;
+}
+
+uint32_t Model::selectLod(const Mesh& mesh, uint32_t current, const LodSelection& selection) const noexcept
+{
+    const uint32_t lodCount = mesh.getLodCount();
+    if (!selection.bEnable || lodCount < 2)
+        return 0;
+
+    auto& vb = mesh.getVertexBuffer();
+    glm::vec3 center = glm::vec3(m_World * glm::vec4((vb.getBoundMin() + vb.getBoundMax()) * 0.5f, 1.f));
+    float scale = glm::max(glm::max(glm::length(glm::vec3(m_World[0])), glm::length(glm::vec3(m_World[1]))), glm::length(glm::vec3(m_World[2])));
+    float radius = glm::length(vb.getBoundMax() - vb.getBoundMin()) * 0.5f * scale;
+
+    // the camera is inside the bounds
+    float distance = glm::distance(selection.Eye, center) - radius;
+    if (distance <= 0.f)
+        return 0;
+
+    const float pixels = selection.ScreenScale / distance;
+    uint32_t lod = 0;
+    for (uint32_t i = 1; i < lodCount; i++)
+    {
+        float tolerance = selection.PixelError;
+        if (i > current)
+            tolerance *= 1.f - selection.Hysteresis;
+        if (mesh.getLodError(i) * scale * pixels > tolerance)
+            break;
+        lod = i;
+    }
+    return lod;
+}
+
+ModelBatch::ModelBatch() noexcept
+    : m_InstanceBuffer(GL_NONE)
+    , m_InstanceTexture(GL_NONE)
+    , m_Version(0)
+    , m_CandidateBuffer(GL_NONE)
+    , m_CommandBuffer(GL_NONE)
+    , m_bIndirect(false)
+    , m_DrawCount(0)
+{
+}
+
+ModelBatch::~ModelBatch() noexcept
+{
+    destroy();
+    destroyIndirect();
+}
+
+void ModelBatch::create(const ModelList& models) noexcept
+{
+    destroy();
+
+    m_Version++;
+    m_Models = models;
+    m_Bounds.resize(models.size());
+    m_Proxies.resize(models.size());
+    m_ModelVersions.assign(models.size(), m_Version);
+    for (uint32_t index = 0; index < models.size(); index++)
+    {
+        auto& model = models[index];
+        for (size_t i = 0; i < model->getMeshes().size(); i++)
+        {
+            auto& mesh = model->getMeshes()[i];
+            auto it = std::find_if(m_Groups.begin(), m_Groups.end(),
+                [&mesh](const InstanceGroup& group) { return group.Mesh == mesh; });
+            if (it == m_Groups.end())
+            {
+                InstanceGroup group;
+                group.Mesh = mesh;
+                group.Buffer = GL_NONE;
+                group.First = 0;
+                m_Groups.emplace_back(std::move(group));
+                it = m_Groups.end() - 1;
+            }
+            it->Models.push_back(index);
+            it->Lods.push_back(0);
+            it->Materials.push_back(model->getMaterials()[i]);
+        }
+
+        updateBounds(index);
+        m_Proxies[index] = m_Tree.insert(m_Bounds[index], index);
+    }
+
+    // the records of a group are contiguous
+    uint32_t recordCount = 0;
+    for (auto& group : m_Groups)
+    {
+        group.First = recordCount;
+        recordCount += (uint32_t)group.Models.size();
+    }
+    m_InstanceData.resize(recordCount * 4);
+    for (auto& group : m_Groups)
+    {
+        for (size_t i = 0; i < group.Models.size(); i++)
+            writeInstance(group, i);
+    }
+
+    glGenBuffers(1, &m_InstanceBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, m_InstanceBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, m_InstanceData.size() * sizeof(glm::vec4), m_InstanceData.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glGenTextures(1, &m_InstanceTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, m_InstanceTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_InstanceBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    // record indices, filled per pass, see draw()
+    for (auto& group : m_Groups)
+    {
+        glGenBuffers(1, &group.Buffer);
+        group.Mesh->setInstanceBuffer(group.Buffer);
+    }
+    for (auto& model : models)
+        model->m_bDirty = false;
+
+    CHECKGLERROR();
+}
+
+void ModelBatch::destroy() noexcept
+{
+    for (auto& group : m_Groups)
+    {
+        if (group.Buffer != GL_NONE)
+            glDeleteBuffers(1, &group.Buffer);
+    }
+    if (m_InstanceTexture != GL_NONE)
+        glDeleteTextures(1, &m_InstanceTexture);
+    if (m_InstanceBuffer != GL_NONE)
+        glDeleteBuffers(1, &m_InstanceBuffer);
+    m_InstanceTexture = GL_NONE;
+    m_InstanceBuffer = GL_NONE;
+    m_InstanceData.clear();
+    m_Groups.clear();
+    m_Models.clear();
+    m_Bounds.clear();
+    m_Proxies.clear();
+    m_ModelVersions.clear();
+    m_Tree.clear();
+}
+
+void ModelBatch::updateBounds(uint32_t index) noexcept
+{
+    auto& model = m_Models[index];
+    Math::BoundingBox bounds = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+    for (auto& mesh : model->getMeshes())
+    {
+        auto& vb = mesh->getVertexBuffer();
+        Math::BoundingBox box = { vb.getBoundMin(), vb.getBoundMax() };
+        bounds = bounds.merge(Math::BoundingBox::transform(box, model->getWorld()));
+    }
+    m_Bounds[index] = bounds;
+}
+
+void ModelBatch::writeInstance(const InstanceGroup& group, size_t i) noexcept
+{
+    // the first three rows of the affine world matrix, then the material
+    const glm::mat4 world = glm::transpose(m_Models[group.Models[i]]->getWorld() * group.Mesh->getDequantMatrix());
+    glm::vec4* record = &m_InstanceData[(group.First + i) * 4];
+    record[0] = world[0];
+    record[1] = world[1];
+    record[2] = world[2];
+    record[3] = glm::vec4(float(group.Materials[i]), 0.f, 0.f, 0.f);
+}
+
+void ModelBatch::update(const LodSelection& selection) noexcept
+{
+    bool bMoved = false;
+    for (uint32_t index = 0; index < m_Models.size(); index++)
+    {
+        if (!m_Models[index]->m_bDirty)
+            continue;
+        updateBounds(index);
+        m_Tree.update(m_Proxies[index], m_Bounds[index]);
+        m_ModelVersions[index] = m_Version + 1;
+        bMoved = true;
+    }
+    if (bMoved)
+    {
+        m_Version++;
+        glBindBuffer(GL_TEXTURE_BUFFER, m_InstanceBuffer);
+    }
+
+    for (auto& group : m_Groups)
+    {
+        size_t first = group.Models.size(), last = 0;
+        for (size_t i = 0; i < group.Models.size(); i++)
+        {
+            auto& model = m_Models[group.Models[i]];
+            if (model->m_bDirty)
+            {
+                writeInstance(group, i);
+                first = std::min(first, i);
+                last = i;
+            }
+            group.Lods[i] = model->selectLod(*group.Mesh, group.Lods[i], selection);
+        }
+
+        // the span of the records that moved, the static groups are left alone
+        if (first <= last)
+        {
+            const size_t offset = (group.First + first) * 4 * sizeof(glm::vec4);
+            const size_t size = (last - first + 1) * 4 * sizeof(glm::vec4);
+            glBufferSubData(GL_TEXTURE_BUFFER, offset, size, &m_InstanceData[(group.First + first) * 4]);
+        }
+    }
+    if (bMoved)
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    // a model may live in several groups, clear once all of them are updated
+    for (auto& model : m_Models)
+        model->m_bDirty = false;
+}
+
+void ModelBatch::cull(const Math::CullVolume& volume, VisibilityMask& visible, const VisibilityMask* within) const noexcept
+{
+    visible.assign(m_Models.size(), 0);
+
+    m_Query.clear();
+    m_Tree.query(volume, m_Query);
+    for (auto index : m_Query)
+    {
+        // the tree keeps fattened boxes, test the tight one
+        if (volume.test(m_Bounds[index]) == Math::CullOutside)
+            continue;
+        visible[index] = within ? (*within)[index] : 1;
+    }
+}
+
+void ModelBatch::bind(const ShaderPtr& program) const noexcept
+{
+    program->setUniform("uInstanceData", InstanceUnit);
+    glActiveTexture(GL_TEXTURE0 + InstanceUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, m_InstanceTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+uint32_t ModelBatch::draw(const VisibilityMask& visible) const noexcept
+{
+    assert(visible.size() == m_Models.size());
+
+    uint32_t triangles = 0;
+    m_DrawCount = 0;
+    for (auto& group : m_Groups)
+    {
+        // counting sort of the visible instances by level
+        const uint32_t lodCount = group.Mesh->getLodCount();
+        m_LodInstances.assign(lodCount + 1, 0);
+        for (size_t i = 0; i < group.Models.size(); i++)
+        {
+            if (visible[group.Models[i]])
+                m_LodInstances[group.Lods[i] + 1]++;
+        }
+        for (uint32_t lod = 0; lod < lodCount; lod++)
+            m_LodInstances[lod + 1] += m_LodInstances[lod];
+
+        const uint32_t instanceCount = m_LodInstances[lodCount];
+        if (instanceCount == 0)
+            continue;
+
+        m_Upload.resize(instanceCount);
+        m_LodFill.assign(m_LodInstances.begin(), m_LodInstances.end() - 1);
+        for (size_t i = 0; i < group.Models.size(); i++)
+        {
+            if (visible[group.Models[i]])
+                m_Upload[m_LodFill[group.Lods[i]]++] = group.First + (uint32_t)i;
+        }
+
+        // orphan the previous pass storage instead of waiting on its draws,
+        // only the record indices change from a pass to the next
+        GLsizeiptr size = instanceCount * sizeof(uint32_t);
+        glBindBuffer(GL_ARRAY_BUFFER, group.Buffer);
+        glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, m_Upload.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        for (uint32_t lod = 0; lod < lodCount; lod++)
+        {
+            uint32_t first = m_LodInstances[lod];
+            uint32_t count = m_LodInstances[lod + 1] - first;
+            if (count == 0)
+                continue;
+            group.Mesh->drawInstanced((GLsizei)count, lod, first);
+            triangles += count * group.Mesh->getTriangleCount(lod);
+            m_DrawCount++;
+        }
+    }
+    return triangles;
+}
+
+bool ModelBatch::createIndirect(const GraphicsDevicePtr& device) noexcept
+{
+    assert(device);
+    if (device->getGraphicsDeviceDesc().getDeviceType() != GraphicsDeviceTypeOpenGLCore)
+        return false;
+
+    m_CompactShader.setDevice(device);
+    m_CompactShader.initialize();
+    m_CompactShader.addShader(GL_COMPUTE_SHADER, "ModelBatch.Compact");
+    m_CompactShader.link();
+
+    glCreateBuffers(1, &m_CandidateBuffer);
+    glCreateBuffers(1, &m_CommandBuffer);
+    m_bIndirect = true;
+
+    CHECKGLERROR();
+    return true;
+}
+
+void ModelBatch::destroyIndirect() noexcept
+{
+    if (m_CandidateBuffer != GL_NONE)
+        glDeleteBuffers(1, &m_CandidateBuffer);
+    if (m_CommandBuffer != GL_NONE)
+        glDeleteBuffers(1, &m_CommandBuffer);
+    m_CandidateBuffer = GL_NONE;
+    m_CommandBuffer = GL_NONE;
+    m_CompactShader.destroy();
+    m_bIndirect = false;
+}
+
+uint32_t ModelBatch::drawIndirect(const VisibilityMask& visible, GLuint flags) const noexcept
+{
+    assert(visible.size() == m_Models.size());
+    assert(m_bIndirect);
+
+    // a command per group and level holding candidates, their instances
+    // get the slots of the group stream in level order
+    uint32_t triangles = 0;
+    m_Candidates.clear();
+    m_Commands.clear();
+    m_GroupCandidates.clear();
+    m_GroupCommands.clear();
+    for (auto& group : m_Groups)
+    {
+        m_GroupCandidates.push_back((uint32_t)m_Candidates.size());
+        m_GroupCommands.push_back((uint32_t)m_Commands.size());
+
+        const uint32_t lodCount = group.Mesh->getLodCount();
+        m_LodInstances.assign(lodCount + 1, 0);
+        for (size_t i = 0; i < group.Models.size(); i++)
+        {
+            if (visible[group.Models[i]])
+                m_LodInstances[group.Lods[i] + 1]++;
+        }
+
+        m_LodFill.assign(lodCount, 0);
+        uint32_t first = 0;
+        for (uint32_t lod = 0; lod < lodCount; lod++)
+        {
+            const uint32_t count = m_LodInstances[lod + 1];
+            if (count == 0)
+                continue;
+            m_LodFill[lod] = (uint32_t)m_Commands.size();
+            m_Commands.push_back(group.Mesh->getVertexBuffer().getDrawCommand(lod, first));
+            triangles += count * group.Mesh->getTriangleCount(lod);
+            first += count;
+        }
+        for (size_t i = 0; i < group.Models.size(); i++)
+        {
+            const uint32_t model = group.Models[i];
+            if (visible[model])
+                m_Candidates.push_back(glm::uvec4(group.First + (uint32_t)i, model, m_LodFill[group.Lods[i]], 0u));
+        }
+    }
+    m_GroupCandidates.push_back((uint32_t)m_Candidates.size());
+    m_GroupCommands.push_back((uint32_t)m_Commands.size());
+    if (m_Candidates.empty())
+        return 0;
+
+    GLint program = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+
+    // orphaned as the instance streams of draw()
+    glNamedBufferData(m_CandidateBuffer, m_Candidates.size() * sizeof(glm::uvec4), m_Candidates.data(), GL_STREAM_DRAW);
+    glNamedBufferData(m_CommandBuffer, m_Commands.size() * sizeof(VertexBufferDrawCommand), m_Commands.data(), GL_STREAM_DRAW);
+
+    // the flags come from a compute pass as well
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    m_CompactShader.bind();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_CandidateBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, flags);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_CommandBuffer);
+    for (size_t g = 0; g < m_Groups.size(); g++)
+    {
+        const uint32_t first = m_GroupCandidates[g];
+        const uint32_t count = m_GroupCandidates[g + 1] - first;
+        if (count == 0)
+            continue;
+        glNamedBufferData(m_Groups[g].Buffer, count * sizeof(uint32_t), nullptr, GL_STREAM_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_Groups[g].Buffer);
+        m_CompactShader.setUniform("uFirst", GLint(first));
+        m_CompactShader.setUniform("uCount", GLint(count));
+        m_CompactShader.Dispatch1D(count, 64);
+    }
+    for (GLuint binding = 0; binding < 4; binding++)
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    glUseProgram(GLuint(program));
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_CommandBuffer);
+    m_DrawCount = 0;
+    for (size_t g = 0; g < m_Groups.size(); g++)
+    {
+        for (uint32_t command = m_GroupCommands[g]; command < m_GroupCommands[g + 1]; command++)
+        {
+            m_Groups[g].Mesh->drawIndirect(command * sizeof(VertexBufferDrawCommand));
+            m_DrawCount++;
+        }
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    CHECKGLERROR();
+    return triangles;
+}
+
+const std::vector<Math::BoundingBox>& ModelBatch::getBounds() const noexcept
+{
+    return m_Bounds;
+}
+
+uint32_t ModelBatch::getVersion() const noexcept
+{
+    return m_Version;
+}
+
+const std::vector<uint32_t>& ModelBatch::getModelVersions() const noexcept
+{
+    return m_ModelVersions;
+}
+
+uint32_t ModelBatch::getModelCount() const noexcept
+{
+    return (uint32_t)m_Models.size();
+}
+
+uint32_t ModelBatch::getDrawCount() const noexcept
+{
+    return m_DrawCount;
+}
+
+uint32_t ModelBatch::getInstanceCount() const noexcept
+{
+    uint32_t count = 0;
+    for (auto& group : m_Groups)
+        count += (uint32_t)group.Models.size();
+    return count;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <Math/AabbTree.h>
+#include <GLType/VertexBuffer.h>
+#include <GLType/ProgramShader.h>
+#include <GraphicsTypes.h>
+
+typedef std::shared_ptr<class Model> ModelPtr;
+typedef std::shared_ptr<class Mesh> MeshPtr;
+typedef std::vector<MeshPtr> MeshList;
+typedef std::vector<ModelPtr> ModelList;
+
+struct LodSelection
+{
+    bool bEnable;
+    glm::vec3 Eye;
+    float ScreenScale;  // pixels per world unit at distance 1 : height * 0.5 * projection[1][1]
+    float PixelError;   // tolerated projected deviation in pixels
+    float Hysteresis;   // a coarser level is taken only below (1 - Hysteresis) * PixelError
+};
+
+class Model final
+{
+public:
+
+    Model() noexcept;
+    ~Model() noexcept;
+
+    // 'material' is an index in the MaterialLibrary
+    void appendMesh(MeshPtr&& mesh, uint32_t material = 0) noexcept;
+    void setWorld(const glm::mat4& world) noexcept;
+
+    const glm::mat4& getWorld() const noexcept;
+    const MeshList& getMeshes() const noexcept;
+    const std::vector<uint32_t>& getMaterials() const noexcept;
+
+    // coarsest level of 'mesh' whose error, projected on the screen at the
+    // bounding sphere distance, stays below the selection tolerance
+    uint32_t selectLod(const Mesh& mesh, uint32_t current, const LodSelection& selection) const noexcept;
+
+private:
+
+    friend class ModelBatch;
+
+    bool m_bDirty;
+    glm::mat4 m_World;
+    MeshList m_Meshes;
+    std::vector<uint32_t> m_Materials;  // per mesh
+};
+
+// per model flag, indexed like the list given to ModelBatch::create
+typedef std::vector<uint8_t> VisibilityMask;
+
+// Groups models sharing a mesh; each group is drawn with a single instanced
+// call per level of detail, the materials sharing the texture arrays of the
+// library. The world matrices (with the mesh dequantization folded in) and
+// material indices of all the instances live in one texture buffer, updated
+// for the models that moved only; each pass streams the indices of its
+// visible instances, sorted by level. World bounds are kept in a dynamic
+// AABB tree so that each pass only lists the instances passing its cull
+// volume. On the core device, drawIndirect leaves the last visibility test
+// to the GPU: a compute pass compacts the instances passing it into the
+// streams and the instance counts of indirect commands.
+class ModelBatch final
+{
+public:
+
+    ModelBatch() noexcept;
+    ~ModelBatch() noexcept;
+
+    void create(const ModelList& models) noexcept;
+    void destroy() noexcept;
+
+    // refit the tree and upload the transforms of the models touched by
+    // Model::setWorld, select the level of each instance
+    void update(const LodSelection& selection) noexcept;
+
+    // visible[i] is set when model i intersects 'volume' (and was set in 'within')
+    void cull(const Math::CullVolume& volume, VisibilityMask& visible, const VisibilityMask* within = nullptr) const noexcept;
+
+    // the instance data on InstanceUnit, for the programs drawing the batch
+    // (see InstanceWorld in VertexUtility.glsli)
+    void bind(const ShaderPtr& program) const noexcept;
+
+    // returns the number of triangles submitted
+    uint32_t draw(const VisibilityMask& visible) const noexcept;
+
+    // the compute pass of drawIndirect, requires the OpenGL core device
+    bool createIndirect(const GraphicsDevicePtr& device) noexcept;
+    void destroyIndirect() noexcept;
+
+    // draws the instances of 'visible' whose flag is set in 'flags', a uint
+    // per model written on the GPU (see HiZBuffer::getVisibilityBuffer);
+    // nothing is read back and the program of the caller is bound again
+    // after the compute pass. Returns the number of triangles of the
+    // instances of 'visible', a bound of the drawn ones.
+    uint32_t drawIndirect(const VisibilityMask& visible, GLuint flags) const noexcept;
+
+    // world bounds, indexed like the visibility masks
+    const std::vector<Math::BoundingBox>& getBounds() const noexcept;
+
+    // changes whenever a model moves or the batch is rebuilt
+    uint32_t getVersion() const noexcept;
+
+    // the version of the last move of each model, indexed like the masks
+    const std::vector<uint32_t>& getModelVersions() const noexcept;
+
+    uint32_t getModelCount() const noexcept;
+    uint32_t getDrawCount() const noexcept;
+    uint32_t getInstanceCount() const noexcept;
+
+    // clear of the units of the material and shading textures
+    static const GLint InstanceUnit = 8;
+
+private:
+
+    struct InstanceGroup
+    {
+        MeshPtr Mesh;
+        GLuint Buffer;                      // visible records of a pass
+        uint32_t First;                     // record of the first model
+        std::vector<uint32_t> Models;       // index in m_Models
+        std::vector<uint32_t> Lods;         // per model
+        std::vector<uint32_t> Materials;    // per model
+    };
+
+    void updateBounds(uint32_t index) noexcept;
+    void writeInstance(const InstanceGroup& group, size_t i) noexcept;
+
+    ModelList m_Models;
+    std::vector<Math::BoundingBox> m_Bounds;
+    std::vector<int32_t> m_Proxies;
+    std::vector<uint32_t> m_ModelVersions;
+    Math::AabbTree m_Tree;
+    std::vector<InstanceGroup> m_Groups;
+    std::vector<glm::vec4> m_InstanceData;  // 4 texels per record, see writeInstance
+    GLuint m_InstanceBuffer;
+    GLuint m_InstanceTexture;
+    uint32_t m_Version;
+
+    // compaction of drawIndirect, a command per group and level
+    mutable ProgramShader m_CompactShader;
+    GLuint m_CandidateBuffer;
+    GLuint m_CommandBuffer;
+    bool m_bIndirect;
+
+    // per draw scratch
+    mutable uint32_t m_DrawCount;
+    mutable std::vector<uint32_t> m_Query;
+    mutable std::vector<uint32_t> m_LodInstances;
+    mutable std::vector<uint32_t> m_LodFill;
+    mutable std::vector<uint32_t> m_Upload;
+    mutable std::vector<glm::uvec4> m_Candidates;    // record, model, command
+    mutable std::vector<VertexBufferDrawCommand> m_Commands;
+    mutable std::vector<uint32_t> m_GroupCandidates; // first candidate per group, and the end
+    mutable std::vector<uint32_t> m_GroupCommands;   // first command per group, and the end
+};
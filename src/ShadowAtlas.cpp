@@ -0,0 +1,326 @@
+#include <ShadowAtlas.h>
+#include <GLType/GraphicsDevice.h>
+#include <GLType/GraphicsTexture.h>
+#include <GLType/GraphicsFramebuffer.h>
+#include <GLType/ProgramShader.h>
+#include <tools/gltools.hpp>
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+    // the light frustum, wide enough for most of the emitting hemisphere
+    const float ShadowFovY = 120.f;
+    const float ShadowNear = 0.05f;
+    const float ShadowFar = 100.f;
+
+    // in shadow map texels
+    const float NormalOffset = 1.5f;
+    const float DepthBias = 1e-5f;
+}
+
+ShadowAtlas::ShadowAtlas() noexcept
+    : m_Size(0)
+    , m_TileSize(1024)
+    , m_bEnabled(true)
+    , m_UnshadowedCount(0)
+{
+    m_Unshadowed.ViewProj = glm::mat4(1.f);
+    m_Unshadowed.Rect = m_Unshadowed.Params = m_Unshadowed.Bias = glm::vec4(0.f);
+}
+
+ShadowAtlas::~ShadowAtlas() noexcept
+{
+    destroy();
+}
+
+bool ShadowAtlas::create(const GraphicsDevicePtr& device, uint32_t size) noexcept
+{
+    assert(device);
+    assert((size & (size - 1)) == 0 && size >= MinTileSize);
+
+    m_Device = device;
+    m_Size = size;
+    m_TileSize = std::min(m_TileSize, size);
+
+    GraphicsTextureDesc depthDesc;
+    depthDesc.setWidth(size);
+    depthDesc.setHeight(size);
+    depthDesc.setFormat(gli::FORMAT_D32_SFLOAT_PACK32);
+    depthDesc.setMinFilter(GL_NEAREST);
+    depthDesc.setMagFilter(GL_NEAREST);
+    m_DepthTex = device->createTexture(depthDesc);
+
+    GraphicsFramebufferDesc desc;
+    desc.addComponent(GraphicsAttachmentBinding(m_DepthTex, GL_DEPTH_ATTACHMENT));
+    m_Framebuffer = device->createFramebuffer(desc);
+
+    releaseAll();
+    return m_DepthTex && m_Framebuffer;
+}
+
+void ShadowAtlas::destroy() noexcept
+{
+    m_Entries.clear();
+    m_FreeTiles.clear();
+    m_Framebuffer.reset();
+    m_DepthTex.reset();
+    m_Size = 0;
+}
+
+void ShadowAtlas::setEnabled(bool bEnabled) noexcept
+{
+    m_bEnabled = bEnabled;
+}
+
+bool ShadowAtlas::isEnabled() const noexcept
+{
+    return m_bEnabled;
+}
+
+void ShadowAtlas::setTileSize(uint32_t size) noexcept
+{
+    assert((size & (size - 1)) == 0);
+    size = glm::clamp(size, MinTileSize, m_Size);
+    if (m_TileSize == size)
+        return;
+    m_TileSize = size;
+    releaseAll();
+}
+
+uint32_t ShadowAtlas::getTileSize() const noexcept
+{
+    return m_TileSize;
+}
+
+uint32_t ShadowAtlas::getLevel(uint32_t size) const noexcept
+{
+    uint32_t level = 0;
+    while ((m_Size >> level) > size)
+        level++;
+    return level;
+}
+
+bool ShadowAtlas::allocate(uint32_t size, Tile& tile) noexcept
+{
+    const uint32_t level = getLevel(size);
+
+    // smallest free tile holding the request, split down to its size
+    int32_t from = int32_t(level);
+    while (from >= 0 && m_FreeTiles[from].empty())
+        from--;
+    if (from < 0)
+        return false;
+
+    glm::ivec2 offset = m_FreeTiles[from].back();
+    m_FreeTiles[from].pop_back();
+    for (uint32_t l = uint32_t(from) + 1; l <= level; l++)
+    {
+        const int32_t half = int32_t(m_Size >> l);
+        m_FreeTiles[l].push_back(offset + glm::ivec2(half, 0));
+        m_FreeTiles[l].push_back(offset + glm::ivec2(0, half));
+        m_FreeTiles[l].push_back(offset + glm::ivec2(half, half));
+    }
+    tile.Offset = offset;
+    tile.Size = m_Size >> level;
+    return true;
+}
+
+void ShadowAtlas::release(const Tile& tile) noexcept
+{
+    const uint32_t level = getLevel(tile.Size);
+    auto& freeTiles = m_FreeTiles[level];
+    if (level == 0)
+    {
+        freeTiles.push_back(tile.Offset);
+        return;
+    }
+
+    // merge with the three buddies when they are all free
+    const int32_t size = int32_t(tile.Size);
+    const glm::ivec2 parent = tile.Offset & ~glm::ivec2(size * 2 - 1);
+    std::vector<glm::ivec2>::iterator buddies[3];
+    uint32_t found = 0;
+    for (int32_t i = 0; i < 4; i++)
+    {
+        glm::ivec2 offset = parent + glm::ivec2(i & 1, i >> 1) * size;
+        if (offset == tile.Offset)
+            continue;
+        auto it = std::find(freeTiles.begin(), freeTiles.end(), offset);
+        if (it == freeTiles.end())
+            break;
+        buddies[found++] = it;
+    }
+    if (found < 3)
+    {
+        freeTiles.push_back(tile.Offset);
+        return;
+    }
+
+    // erase from the back so that the iterators stay valid
+    std::sort(buddies, buddies + 3);
+    for (int32_t i = 2; i >= 0; i--)
+        freeTiles.erase(buddies[i]);
+    release(Tile { parent, tile.Size * 2 });
+}
+
+void ShadowAtlas::releaseAll() noexcept
+{
+    m_FreeTiles.assign(getLevel(MinTileSize) + 1, std::vector<glm::ivec2>());
+    m_FreeTiles[0].push_back(glm::ivec2(0));
+    for (auto& entry : m_Entries)
+    {
+        entry.bAllocated = false;
+        entry.bValid = false;
+    }
+}
+
+ShadowData ShadowAtlas::computeShadowData(const Light& light, const Tile& tile) const noexcept
+{
+    // emits toward local +y, the quad spans local x and z
+    glm::mat4 world = light.getWorld();
+    glm::vec3 forward = glm::normalize(glm::vec3(world[1]));
+    glm::vec3 up = glm::normalize(glm::vec3(world[2]));
+
+    // view x follows the light width, view y its height
+    glm::mat4 view = glm::lookAt(light.m_Position, light.m_Position + forward, up);
+    glm::mat4 projection = glm::perspective(glm::radians(ShadowFovY), 1.f, ShadowNear, ShadowFar);
+
+    const float frustumWidth = 2.f * glm::tan(glm::radians(ShadowFovY) * 0.5f);
+    const float texel = frustumWidth / float(tile.Size);
+
+    ShadowData data;
+    data.ViewProj = projection * view;
+    data.Rect = glm::vec4(glm::vec2(tile.Offset), glm::vec2(float(tile.Size))) / float(m_Size);
+    data.Params = glm::vec4(light.m_Width / frustumWidth, light.m_Height / frustumWidth, ShadowNear, ShadowFar);
+    data.Bias = glm::vec4(NormalOffset * texel, DepthBias, 0.f, 0.f);
+    return data;
+}
+
+bool ShadowAtlas::isTouched(const Entry& entry, const Math::CullVolume& volume, const ModelBatch& batch) const noexcept
+{
+    const auto& versions = batch.getModelVersions();
+    const auto& bounds = batch.getBounds();
+    if (entry.Visible.size() != versions.size())
+        return true;
+    for (size_t i = 0; i < versions.size(); i++)
+    {
+        if (versions[i] <= entry.Version)
+            continue;
+        // the old position was drawn in the tile, or the new one is seen
+        if (entry.Visible[i] || volume.test(bounds[i]) != Math::CullOutside)
+            return true;
+    }
+    return false;
+}
+
+uint32_t ShadowAtlas::update(const std::vector<std::shared_ptr<Light>>& lights, const ModelBatch& batch) noexcept
+{
+    m_UnshadowedCount = 0;
+    if (!m_bEnabled)
+        return 0;
+
+    auto device = m_Device.lock();
+    assert(device);
+
+    // the lights beyond the list give their tiles back
+    for (size_t i = lights.size(); i < m_Entries.size(); i++)
+    {
+        if (m_Entries[i].bAllocated)
+            release(m_Entries[i].Region);
+    }
+    Entry empty = { Tile { glm::ivec2(0), 0 }, false, false, 0, m_Unshadowed, {} };
+    m_Entries.resize(lights.size(), empty);
+
+    uint32_t rendered = 0;
+    for (size_t i = 0; i < lights.size(); i++)
+    {
+        auto& entry = m_Entries[i];
+        if (!entry.bAllocated)
+        {
+            // out of space, the light stays unshadowed
+            entry.bAllocated = allocate(m_TileSize, entry.Region);
+            if (!entry.bAllocated)
+            {
+                m_UnshadowedCount++;
+                continue;
+            }
+        }
+
+        ShadowData data = computeShadowData(*lights[i], entry.Region);
+        auto volume = Math::CullVolume::fromViewProjection(data.ViewProj);
+        bool bChanged = data.ViewProj != entry.Data.ViewProj || data.Params != entry.Data.Params;
+        if (entry.bValid && !bChanged)
+        {
+            if (entry.Version == batch.getVersion() || !isTouched(entry, volume, batch))
+            {
+                entry.Version = batch.getVersion();
+                continue;
+            }
+        }
+
+        if (rendered == 0)
+        {
+            device->setFramebuffer(m_Framebuffer);
+            glEnable(GL_SCISSOR_TEST);
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(1.5f, 4.f);
+            glDisable(GL_CULL_FACE);
+            glDepthMask(GL_TRUE);
+            glDepthFunc(GL_LEQUAL);
+        }
+
+        const Tile& tile = entry.Region;
+        glViewport(tile.Offset.x, tile.Offset.y, tile.Size, tile.Size);
+        glScissor(tile.Offset.x, tile.Offset.y, tile.Size, tile.Size);
+        glClearDepthf(1.f);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        batch.cull(volume, entry.Visible);
+        RenderingData renderData { false, lights[i]->m_Position, glm::mat4(1.f), data.ViewProj };
+        batch.bind(Light::BindProgram(renderData, true));
+        batch.draw(entry.Visible);
+
+        entry.Data = data;
+        entry.Version = batch.getVersion();
+        entry.bValid = true;
+        rendered++;
+    }
+
+    if (rendered > 0)
+    {
+        glEnable(GL_CULL_FACE);
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glDisable(GL_SCISSOR_TEST);
+    }
+
+    CHECKGLERROR();
+    return rendered;
+}
+
+uint32_t ShadowAtlas::getUnshadowedCount() const noexcept
+{
+    return m_UnshadowedCount;
+}
+
+const ShadowData& ShadowAtlas::getShadowData(uint32_t index) const noexcept
+{
+    if (!m_bEnabled || index >= m_Entries.size() || !m_Entries[index].bValid)
+        return m_Unshadowed;
+    return m_Entries[index].Data;
+}
+
+const GraphicsTexturePtr& ShadowAtlas::getTexture() const noexcept
+{
+    return m_DepthTex;
+}
+
+void ShadowAtlas::submit(const ShaderPtr& shader, uint32_t index, GLint unit) const noexcept
+{
+    const ShadowData& data = getShadowData(index);
+    shader->setUniform("uShadowViewProj", data.ViewProj);
+    shader->setUniform("uShadowRect", data.Rect);
+    shader->setUniform("uShadowParams", data.Params);
+    shader->setUniform("uShadowBias", data.Bias);
+    shader->bindTexture("uShadowAtlas", m_DepthTex, unit);
+}
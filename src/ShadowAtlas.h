@@ -0,0 +1,90 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <GraphicsTypes.h>
+#include <Light.h>
+#include <Model.h>
+#include <vector>
+
+// Depth atlas shared by the area light shadow maps. Each light renders a
+// perspective map from its center along its normal (the front side only
+// for two-sided lights) into a power of two tile of the atlas. The tiles
+// are only rendered again when the light or the tile size changes, or when
+// a model moves from or into the light frustum; they are filtered with a
+// PCSS lookup sized by the light width and height, see ShadowUtility.glsli.
+// The lights finding no room left in the atlas stay unshadowed.
+class ShadowAtlas final
+{
+public:
+
+    static const uint32_t MinTileSize = 256;
+
+    ShadowAtlas() noexcept;
+    ~ShadowAtlas() noexcept;
+
+    // 'size' is a power of two
+    bool create(const GraphicsDevicePtr& device, uint32_t size) noexcept;
+    void destroy() noexcept;
+
+    // disabled, the lookups return unshadowed data and no tile is rendered
+    void setEnabled(bool bEnabled) noexcept;
+    bool isEnabled() const noexcept;
+
+    // a power of two, every tile is allocated again on change
+    void setTileSize(uint32_t size) noexcept;
+    uint32_t getTileSize() const noexcept;
+
+    // renders the tiles that are out of date, returns how many were rendered
+    uint32_t update(const std::vector<std::shared_ptr<Light>>& lights, const ModelBatch& batch) noexcept;
+
+    // the lights left without a tile by the last update
+    uint32_t getUnshadowedCount() const noexcept;
+
+    // indexed like the light list given to update
+    const ShadowData& getShadowData(uint32_t index) const noexcept;
+    const GraphicsTexturePtr& getTexture() const noexcept;
+
+    // uniforms of the forward program, see Ltc.glsl
+    void submit(const ShaderPtr& shader, uint32_t index, GLint unit) const noexcept;
+
+private:
+
+    struct Tile
+    {
+        glm::ivec2 Offset;
+        uint32_t Size;
+    };
+
+    struct Entry
+    {
+        Tile Region;
+        bool bAllocated;
+        bool bValid;
+        uint32_t Version;       // of the batch, when last checked
+        ShadowData Data;
+        VisibilityMask Visible; // the models in the rendered tile
+    };
+
+    // buddy allocation in the quadtree of the atlas
+    uint32_t getLevel(uint32_t size) const noexcept;
+    bool allocate(uint32_t size, Tile& tile) noexcept;
+    void release(const Tile& tile) noexcept;
+    void releaseAll() noexcept;
+
+    ShadowData computeShadowData(const Light& light, const Tile& tile) const noexcept;
+
+    // a model moved since 'entry' was checked, out of or into 'volume'
+    bool isTouched(const Entry& entry, const Math::CullVolume& volume, const ModelBatch& batch) const noexcept;
+
+    GraphicsDeviceWeakPtr m_Device;
+    GraphicsTexturePtr m_DepthTex;
+    GraphicsFramebufferPtr m_Framebuffer;
+    uint32_t m_Size;
+    uint32_t m_TileSize;
+    bool m_bEnabled;
+    std::vector<std::vector<glm::ivec2>> m_FreeTiles; // per level, the atlas first
+    std::vector<Entry> m_Entries;
+    ShadowData m_Unshadowed;
+    uint32_t m_UnshadowedCount;
+};
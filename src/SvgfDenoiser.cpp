@@ -0,0 +1,222 @@
+#include <SvgfDenoiser.h>
+#include <GLType/GraphicsDevice.h>
+#include <GLType/GraphicsTexture.h>
+#include <GLType/OGLCoreTexture.h>
+#include <GLType/RenderTargetPool.h>
+#include <tools/gltools.hpp>
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+    void BindOutput(ProgramShader& shader, const char* name, const GraphicsTexturePtr& texture, GLuint unit)
+    {
+        shader.bindImage(name, texture->downcast_pointer<OGLCoreTexture>(), unit, 0, GL_FALSE, 0, GL_WRITE_ONLY);
+    }
+}
+
+SvgfDenoiser::SvgfDenoiser() noexcept
+    : m_PrevViewProj(1.f)
+    , m_Width(0)
+    , m_Height(0)
+    , m_Current(0)
+    , m_MaxHistory(32)
+    , m_PhiColor(4.f)
+    , m_bReset(true)
+{
+}
+
+SvgfDenoiser::~SvgfDenoiser() noexcept
+{
+    destroy();
+}
+
+bool SvgfDenoiser::create(const GraphicsDevicePtr& device) noexcept
+{
+    assert(device);
+    if (device->getGraphicsDeviceDesc().getDeviceType() != GraphicsDeviceTypeOpenGLCore)
+        return false;
+
+    m_Device = device;
+
+    m_GuideShader.setDevice(device);
+    m_GuideShader.initialize();
+    m_GuideShader.addShader(GL_COMPUTE_SHADER, "Svgf.Guide");
+    m_GuideShader.link();
+
+    m_TemporalShader.setDevice(device);
+    m_TemporalShader.initialize();
+    m_TemporalShader.addShader(GL_COMPUTE_SHADER, "Svgf.Temporal");
+    m_TemporalShader.link();
+
+    m_VarianceShader.setDevice(device);
+    m_VarianceShader.initialize();
+    m_VarianceShader.addShader(GL_COMPUTE_SHADER, "Svgf.Variance");
+    m_VarianceShader.link();
+
+    m_AtrousShader.setDevice(device);
+    m_AtrousShader.initialize();
+    m_AtrousShader.addShader(GL_COMPUTE_SHADER, "Svgf.Atrous");
+    m_AtrousShader.link();
+
+    CHECKGLERROR();
+    return true;
+}
+
+void SvgfDenoiser::destroy() noexcept
+{
+    m_GuideShader.destroy();
+    m_TemporalShader.destroy();
+    m_VarianceShader.destroy();
+    m_AtrousShader.destroy();
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        m_Guide[i].reset();
+        m_History[i].reset();
+        m_Moments[i].reset();
+    }
+    m_bReset = true;
+}
+
+void SvgfDenoiser::resize(int32_t width, int32_t height) noexcept
+{
+    auto device = m_Device.lock();
+    if (!device)
+        return;
+
+    // every pass reads with texelFetch, the reprojection filters by hand to
+    // drop the taps of other surfaces
+    GraphicsTextureDesc desc;
+    desc.setWidth(width);
+    desc.setHeight(height);
+    desc.setFormat(gli::FORMAT_RGBA16_SFLOAT_PACK16);
+    desc.setMinFilter(GL_NEAREST);
+    desc.setMagFilter(GL_NEAREST);
+
+    // the squared luminance needs the precision
+    GraphicsTextureDesc momentsDesc = desc;
+    momentsDesc.setFormat(gli::FORMAT_RGBA32_SFLOAT_PACK32);
+
+    auto& pool = device->getRenderTargetPool();
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        m_Guide[i] = pool.acquire(desc, m_Guide[i]);
+        m_History[i] = pool.acquire(desc, m_History[i]);
+        m_Moments[i] = pool.acquire(momentsDesc, m_Moments[i]);
+    }
+    m_Width = width;
+    m_Height = height;
+    m_bReset = true;
+}
+
+void SvgfDenoiser::reset() noexcept
+{
+    m_bReset = true;
+}
+
+GraphicsTexturePtr SvgfDenoiser::denoise(const GraphicsTexturePtr& color, const GraphicsTexturePtr& depth, const glm::mat4& viewProj, const glm::vec3& viewPosition) noexcept
+{
+    assert(m_Guide[0]);
+    auto device = m_Device.lock();
+    const uint32_t prev = m_Current;
+    const uint32_t next = m_Current ^ 1;
+    const GLuint width = m_Width;
+    const GLuint height = m_Height;
+    const glm::ivec2 size(m_Width, m_Height);
+    const glm::mat4 viewProjInv = glm::inverse(viewProj);
+
+    // the wavelet ping-pong lives for this call only, the same pooled
+    // targets serve the other passes of the frame
+    auto& pool = device->getRenderTargetPool();
+    GraphicsTexturePtr filter[2];
+    for (auto& target : filter)
+        target = pool.acquire(m_Guide[next]->getGraphicsTextureDesc());
+
+    m_GuideShader.bind();
+    m_GuideShader.bindTexture("uDepth", depth, 0);
+    BindOutput(m_GuideShader, "uGuide", m_Guide[next], 0);
+    m_GuideShader.setUniform("uViewProj", viewProj);
+    m_GuideShader.setUniform("uViewProjInv", viewProjInv);
+    m_GuideShader.setUniform("uViewPositionW", viewPosition);
+    m_GuideShader.setUniform("uSize", size);
+    m_GuideShader.Dispatch2D(width, height, 8, 8);
+    m_GuideShader.unbind();
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    // the integrated color goes in the first filter texture, the variance
+    // estimate in the second and the wavelet starts from there
+    m_TemporalShader.bind();
+    m_TemporalShader.bindTexture("uColor", color, 0);
+    m_TemporalShader.bindTexture("uDepth", depth, 1);
+    m_TemporalShader.bindTexture("uGuide", m_Guide[next], 2);
+    m_TemporalShader.bindTexture("uPrevGuide", m_Guide[prev], 3);
+    m_TemporalShader.bindTexture("uPrevColor", m_History[prev], 4);
+    m_TemporalShader.bindTexture("uPrevMoments", m_Moments[prev], 5);
+    BindOutput(m_TemporalShader, "uColorOut", filter[0], 0);
+    BindOutput(m_TemporalShader, "uMomentsOut", m_Moments[next], 1);
+    m_TemporalShader.setUniform("uViewProjInv", viewProjInv);
+    m_TemporalShader.setUniform("uPrevViewProj", m_PrevViewProj);
+    m_TemporalShader.setUniform("uMaxHistory", GLfloat(m_MaxHistory));
+    m_TemporalShader.setUniform("ubReset", m_bReset);
+    m_TemporalShader.setUniform("uSize", size);
+    m_TemporalShader.Dispatch2D(width, height, 8, 8);
+    m_TemporalShader.unbind();
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    m_VarianceShader.bind();
+    m_VarianceShader.bindTexture("uColor", filter[0], 0);
+    m_VarianceShader.bindTexture("uMoments", m_Moments[next], 1);
+    m_VarianceShader.bindTexture("uGuide", m_Guide[next], 2);
+    BindOutput(m_VarianceShader, "uDest", filter[1], 0);
+    m_VarianceShader.setUniform("uSize", size);
+    m_VarianceShader.Dispatch2D(width, height, 8, 8);
+    m_VarianceShader.unbind();
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    // the first iteration is the color history of the next frame
+    uint32_t source = 1;
+    m_AtrousShader.bind();
+    m_AtrousShader.bindTexture("uGuide", m_Guide[next], 1);
+    m_AtrousShader.setUniform("uPhiColor", m_PhiColor);
+    m_AtrousShader.setUniform("uSize", size);
+    for (uint32_t i = 0; i < Iterations; i++)
+    {
+        const GraphicsTexturePtr& src = (i == 1) ? m_History[next] : filter[source];
+        const GraphicsTexturePtr& dst = (i == 0) ? m_History[next] : filter[source ^ 1];
+        m_AtrousShader.bindTexture("uSource", src, 0);
+        BindOutput(m_AtrousShader, "uDest", dst, 0);
+        m_AtrousShader.setUniform("uStepSize", GLint(1 << i));
+        m_AtrousShader.Dispatch2D(width, height, 8, 8);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        if (i != 0)
+            source ^= 1;
+    }
+    m_AtrousShader.unbind();
+
+    m_PrevViewProj = viewProj;
+    m_Current = next;
+    m_bReset = false;
+
+    CHECKGLERROR();
+    return filter[source];
+}
+
+void SvgfDenoiser::setMaxHistory(uint32_t frames) noexcept
+{
+    m_MaxHistory = std::max(frames, 1u);
+}
+
+uint32_t SvgfDenoiser::getMaxHistory() const noexcept
+{
+    return m_MaxHistory;
+}
+
+void SvgfDenoiser::setPhiColor(float phi) noexcept
+{
+    m_PhiColor = std::max(phi, 0.f);
+}
+
+float SvgfDenoiser::getPhiColor() const noexcept
+{
+    return m_PhiColor;
+}
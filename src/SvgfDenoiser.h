@@ -0,0 +1,63 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <GraphicsTypes.h>
+#include <GLType/ProgramShader.h>
+
+// Spatiotemporal variance-guided filter for the low sample count frames.
+// The frame is integrated over time with its luminance moments, the variance
+// comes from the moments (or from the neighbourhood while the history is
+// short) and drives the luminance edge stopping of an a-trous wavelet guided
+// by the depth and normals. The first wavelet iteration is fed back as the
+// color history.
+class SvgfDenoiser final
+{
+public:
+
+    static const uint32_t Iterations = 5;
+
+    SvgfDenoiser() noexcept;
+    ~SvgfDenoiser() noexcept;
+
+    // requires compute shaders, i.e. the OpenGL core device
+    bool create(const GraphicsDevicePtr& device) noexcept;
+    void destroy() noexcept;
+
+    // the histories come from the render target pool
+    void resize(int32_t width, int32_t height) noexcept;
+
+    // drops the history on the next denoise
+    void reset() noexcept;
+
+    // 'color' holds this frame only, 'viewProj' is the camera matrix without
+    // the AA jitter; returns the filtered frame, a pooled target released
+    // to the other passes once the caller drops it
+    GraphicsTexturePtr denoise(const GraphicsTexturePtr& color, const GraphicsTexturePtr& depth, const glm::mat4& viewProj, const glm::vec3& viewPosition) noexcept;
+
+    // upper bound of the history length, shorter ones trade noise for lag
+    void setMaxHistory(uint32_t frames) noexcept;
+    uint32_t getMaxHistory() const noexcept;
+
+    // luminance edge stopping, in standard deviations
+    void setPhiColor(float phi) noexcept;
+    float getPhiColor() const noexcept;
+
+private:
+
+    GraphicsDeviceWeakPtr m_Device;
+    ProgramShader m_GuideShader;
+    ProgramShader m_TemporalShader;
+    ProgramShader m_VarianceShader;
+    ProgramShader m_AtrousShader;
+    GraphicsTexturePtr m_Guide[2];   // normal, view depth
+    GraphicsTexturePtr m_History[2]; // first wavelet iteration, variance
+    GraphicsTexturePtr m_Moments[2]; // luminance moments, history length
+    glm::mat4 m_PrevViewProj;
+    int32_t m_Width;
+    int32_t m_Height;
+    uint32_t m_Current;
+    uint32_t m_MaxHistory;
+    float m_PhiColor;
+    bool m_bReset;
+};
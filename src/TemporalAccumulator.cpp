@@ -0,0 +1,132 @@
+#include <TemporalAccumulator.h>
+#include <GLType/GraphicsDevice.h>
+#include <GLType/GraphicsTexture.h>
+#include <GLType/OGLCoreTexture.h>
+#include <GLType/RenderTargetPool.h>
+#include <tools/gltools.hpp>
+#include <algorithm>
+#include <cassert>
+
+TemporalAccumulator::TemporalAccumulator() noexcept
+    : m_PrevViewProj(1.f)
+    , m_Width(0)
+    , m_Height(0)
+    , m_Current(0)
+    , m_MaxHistory(1024)
+    , m_bReset(true)
+{
+}
+
+TemporalAccumulator::~TemporalAccumulator() noexcept
+{
+    destroy();
+}
+
+bool TemporalAccumulator::create(const GraphicsDevicePtr& device) noexcept
+{
+    assert(device);
+    if (device->getGraphicsDeviceDesc().getDeviceType() != GraphicsDeviceTypeOpenGLCore)
+        return false;
+
+    m_Device = device;
+
+    m_ResolveShader.setDevice(device);
+    m_ResolveShader.initialize();
+    m_ResolveShader.addShader(GL_COMPUTE_SHADER, "TemporalAccumulation.Resolve");
+    m_ResolveShader.link();
+
+    CHECKGLERROR();
+    return true;
+}
+
+void TemporalAccumulator::destroy() noexcept
+{
+    m_ResolveShader.destroy();
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        m_History[i].reset();
+        m_HistoryLength[i].reset();
+    }
+    m_bReset = true;
+}
+
+void TemporalAccumulator::resize(int32_t width, int32_t height) noexcept
+{
+    auto device = m_Device.lock();
+    if (!device)
+        return;
+
+    // 32 bits, the mean converges over hundreds of frames
+    GraphicsTextureDesc historyDesc;
+    historyDesc.setWidth(width);
+    historyDesc.setHeight(height);
+    historyDesc.setFormat(gli::FORMAT_RGBA32_SFLOAT_PACK32);
+    historyDesc.setMinFilter(GL_LINEAR);
+    historyDesc.setMagFilter(GL_LINEAR);
+
+    GraphicsTextureDesc lengthDesc;
+    lengthDesc.setWidth(width);
+    lengthDesc.setHeight(height);
+    lengthDesc.setFormat(gli::FORMAT_R32_SFLOAT_PACK32);
+    lengthDesc.setMinFilter(GL_NEAREST);
+    lengthDesc.setMagFilter(GL_NEAREST);
+
+    auto& pool = device->getRenderTargetPool();
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        m_History[i] = pool.acquire(historyDesc, m_History[i]);
+        m_HistoryLength[i] = pool.acquire(lengthDesc, m_HistoryLength[i]);
+    }
+    m_Width = width;
+    m_Height = height;
+    m_bReset = true;
+}
+
+void TemporalAccumulator::reset() noexcept
+{
+    m_bReset = true;
+}
+
+const GraphicsTexturePtr& TemporalAccumulator::resolve(const GraphicsTexturePtr& color, const GraphicsTexturePtr& depth, const glm::mat4& viewProj, bool bCameraMoved) noexcept
+{
+    assert(m_History[0]);
+    const uint32_t prev = m_Current;
+    const uint32_t next = m_Current ^ 1;
+
+    m_ResolveShader.bind();
+    m_ResolveShader.bindTexture("uColor", color, 0);
+    m_ResolveShader.bindTexture("uDepth", depth, 1);
+    m_ResolveShader.bindTexture("uHistory", m_History[prev], 2);
+    m_ResolveShader.bindTexture("uHistoryLength", m_HistoryLength[prev], 3);
+    m_ResolveShader.bindImage("uHistoryOut", m_History[next]->downcast_pointer<OGLCoreTexture>(), 0, 0, GL_FALSE, 0, GL_WRITE_ONLY);
+    m_ResolveShader.bindImage("uHistoryLengthOut", m_HistoryLength[next]->downcast_pointer<OGLCoreTexture>(), 1, 0, GL_FALSE, 0, GL_WRITE_ONLY);
+    m_ResolveShader.setUniform("uViewProj", viewProj);
+    m_ResolveShader.setUniform("uViewProjInv", glm::inverse(viewProj));
+    m_ResolveShader.setUniform("uPrevViewProj", m_PrevViewProj);
+    m_ResolveShader.setUniform("uMaxHistory", GLfloat(m_MaxHistory));
+    m_ResolveShader.setUniform("ubCameraMoved", bCameraMoved);
+    m_ResolveShader.setUniform("ubReset", m_bReset);
+    m_ResolveShader.setUniform("uSize", glm::ivec2(m_Width, m_Height));
+    m_ResolveShader.Dispatch2D(m_Width, m_Height, 8, 8);
+    m_ResolveShader.unbind();
+
+    // sampled by the blit and by the next resolve
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    m_PrevViewProj = viewProj;
+    m_Current = next;
+    m_bReset = false;
+
+    CHECKGLERROR();
+    return m_History[next];
+}
+
+void TemporalAccumulator::setMaxHistory(uint32_t frames) noexcept
+{
+    m_MaxHistory = std::max(frames, 1u);
+}
+
+uint32_t TemporalAccumulator::getMaxHistory() const noexcept
+{
+    return m_MaxHistory;
+}
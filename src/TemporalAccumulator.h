@@ -0,0 +1,51 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <GraphicsTypes.h>
+#include <GLType/ProgramShader.h>
+
+// Running mean of the frames, carried through camera motion. Each texel of
+// the current frame is reprojected with the pre-pass depth and the previous
+// frame matrices; the history is rejected on disocclusion and clamped to the
+// current neighbourhood while the camera moves. The number of frames in the
+// mean of each texel is kept in a separate length buffer.
+class TemporalAccumulator final
+{
+public:
+
+    TemporalAccumulator() noexcept;
+    ~TemporalAccumulator() noexcept;
+
+    // requires compute shaders, i.e. the OpenGL core device
+    bool create(const GraphicsDevicePtr& device) noexcept;
+    void destroy() noexcept;
+
+    // the histories come from the render target pool
+    void resize(int32_t width, int32_t height) noexcept;
+
+    // drops the history on the next resolve
+    void reset() noexcept;
+
+    // blends 'color', holding this frame only, in the history and returns the
+    // new mean; 'viewProj' is the camera matrix without the AA jitter
+    const GraphicsTexturePtr& resolve(const GraphicsTexturePtr& color, const GraphicsTexturePtr& depth, const glm::mat4& viewProj, bool bCameraMoved) noexcept;
+
+    // upper bound of the history length, the blend weight of a new frame
+    // never goes below its inverse
+    void setMaxHistory(uint32_t frames) noexcept;
+    uint32_t getMaxHistory() const noexcept;
+
+private:
+
+    GraphicsDeviceWeakPtr m_Device;
+    ProgramShader m_ResolveShader;
+    GraphicsTexturePtr m_History[2];       // mean, view depth
+    GraphicsTexturePtr m_HistoryLength[2]; // frames in the mean
+    glm::mat4 m_PrevViewProj;
+    int32_t m_Width;
+    int32_t m_Height;
+    uint32_t m_Current;
+    uint32_t m_MaxHistory;
+    bool m_bReset;
+};
@@ -0,0 +1,338 @@
+#include <TiledDeferred.h>
+#include <GLType/GraphicsDevice.h>
+#include <GLType/GraphicsTexture.h>
+#include <GLType/GraphicsFramebuffer.h>
+#include <GLType/OGLCoreTexture.h>
+#include <GLType/ProgramShader.h>
+#include <GLType/RenderTargetPool.h>
+#include <tools/gltools.hpp>
+#include <cassert>
+
+TiledDeferred::TiledDeferred() noexcept
+    : m_LightBuffer(GL_NONE)
+    , m_LightCapacity(0)
+    , m_ErrorBuffer(GL_NONE)
+    , m_OverflowBuffer(GL_NONE)
+    , m_OverflowFence(nullptr)
+    , m_OverflowTiles(0)
+    , m_DiffuseScale(1)
+    , m_bMeasureError(false)
+    , m_bRatioShadows(false)
+    , m_DiffuseError(-1.f)
+    , m_Width(0)
+    , m_Height(0)
+{
+}
+
+TiledDeferred::~TiledDeferred() noexcept
+{
+    destroy();
+}
+
+bool TiledDeferred::create(const GraphicsDevicePtr& device) noexcept
+{
+    assert(device);
+    if (device->getGraphicsDeviceDesc().getDeviceType() != GraphicsDeviceTypeOpenGLCore)
+        return false;
+
+    m_Device = device;
+
+    m_GeometryShader = ProgramShader::create(device, {
+        { GL_VERTEX_SHADER, "TiledDeferred.Vertex" },
+        { GL_FRAGMENT_SHADER, "TiledDeferred.Fragment" } });
+    m_ShadingShader = ProgramShader::create(device, { { GL_COMPUTE_SHADER, "TiledDeferred.Shading" } });
+    m_DenoiseShader = ProgramShader::create(device, { { GL_COMPUTE_SHADER, "TiledDeferred.Denoise" } });
+
+    glCreateBuffers(1, &m_LightBuffer);
+    glCreateBuffers(1, &m_ErrorBuffer);
+    glCreateBuffers(1, &m_OverflowBuffer);
+    glNamedBufferData(m_OverflowBuffer, sizeof(uint32_t), nullptr, GL_STREAM_READ);
+
+    CHECKGLERROR();
+    return true;
+}
+
+void TiledDeferred::destroy() noexcept
+{
+    if (m_LightBuffer != GL_NONE)
+        glDeleteBuffers(1, &m_LightBuffer);
+    m_LightBuffer = GL_NONE;
+    m_LightCapacity = 0;
+    if (m_ErrorBuffer != GL_NONE)
+        glDeleteBuffers(1, &m_ErrorBuffer);
+    m_ErrorBuffer = GL_NONE;
+    if (m_OverflowFence)
+        glDeleteSync(m_OverflowFence);
+    m_OverflowFence = nullptr;
+    if (m_OverflowBuffer != GL_NONE)
+        glDeleteBuffers(1, &m_OverflowBuffer);
+    m_OverflowBuffer = GL_NONE;
+    m_OverflowTiles = 0;
+
+    m_GeometryShader.reset();
+    m_ShadingShader.reset();
+    m_DenoiseShader.reset();
+    m_GBuffer.reset();
+    m_GBuffer0Tex.reset();
+    m_GBuffer1Tex.reset();
+    m_DepthTex.reset();
+}
+
+void TiledDeferred::resize(int32_t width, int32_t height, const GraphicsTexturePtr& depth) noexcept
+{
+    auto device = m_Device.lock();
+    if (!device)
+        return;
+
+    auto& pool = device->getRenderTargetPool();
+    auto gbuffer0 = m_GBuffer0Tex;
+    auto gbuffer1 = m_GBuffer1Tex;
+
+    GraphicsTextureDesc normalDesc;
+    normalDesc.setWidth(width);
+    normalDesc.setHeight(height);
+    normalDesc.setFormat(gli::FORMAT_RGBA16_SFLOAT_PACK16);
+    m_GBuffer0Tex = pool.acquire(normalDesc, m_GBuffer0Tex);
+
+    GraphicsTextureDesc colorDesc;
+    colorDesc.setWidth(width);
+    colorDesc.setHeight(height);
+    colorDesc.setFormat(gli::FORMAT_RGBA8_UNORM_PACK8);
+    m_GBuffer1Tex = pool.acquire(colorDesc, m_GBuffer1Tex);
+
+    // a resize within the size bucket keeps the textures and the target
+    if (!m_GBuffer || gbuffer0 != m_GBuffer0Tex || gbuffer1 != m_GBuffer1Tex || depth != m_DepthTex)
+    {
+        GraphicsFramebufferDesc desc;
+        desc.addComponent(GraphicsAttachmentBinding(m_GBuffer0Tex, GL_COLOR_ATTACHMENT0));
+        desc.addComponent(GraphicsAttachmentBinding(m_GBuffer1Tex, GL_COLOR_ATTACHMENT1));
+        desc.addComponent(GraphicsAttachmentBinding(depth, GL_DEPTH_ATTACHMENT));
+        m_GBuffer = device->createFramebuffer(desc);
+    }
+    m_Width = width;
+    m_Height = height;
+    m_DepthTex = depth;
+
+    const size_t tileCount = Math::DivideByMultiple(width, TileSize) * Math::DivideByMultiple(height, TileSize);
+    m_TileErrors.resize(tileCount);
+    glNamedBufferData(m_ErrorBuffer, tileCount * sizeof(glm::vec2), nullptr, GL_STREAM_READ);
+}
+
+GraphicsTextureDesc TiledDeferred::getTransientDesc(int32_t width, int32_t height) const noexcept
+{
+    // read with texelFetch only, the same description as the denoiser
+    // targets so that the pool shares them
+    GraphicsTextureDesc desc;
+    desc.setWidth(width);
+    desc.setHeight(height);
+    desc.setFormat(gli::FORMAT_RGBA16_SFLOAT_PACK16);
+    desc.setMinFilter(GL_NEAREST);
+    desc.setMagFilter(GL_NEAREST);
+    return desc;
+}
+
+void TiledDeferred::setDiffuseScale(uint32_t scale) noexcept
+{
+    assert(scale == 1 || scale == 2 || scale == 4);
+    if (m_DiffuseScale == scale)
+        return;
+    m_DiffuseScale = scale;
+    m_DiffuseError = -1.f;
+}
+
+uint32_t TiledDeferred::getDiffuseScale() const noexcept
+{
+    return m_DiffuseScale;
+}
+
+void TiledDeferred::setRatioShadows(bool bEnabled) noexcept
+{
+    m_bRatioShadows = bEnabled;
+}
+
+bool TiledDeferred::getRatioShadows() const noexcept
+{
+    return m_bRatioShadows;
+}
+
+void TiledDeferred::requestDiffuseError() noexcept
+{
+    m_bMeasureError = true;
+}
+
+float TiledDeferred::getDiffuseError() const noexcept
+{
+    return m_DiffuseError;
+}
+
+uint32_t TiledDeferred::getOverflowTiles() const noexcept
+{
+    return m_OverflowTiles;
+}
+
+ShaderPtr TiledDeferred::bindGeometryProgram(const RenderingData& data) noexcept
+{
+    auto device = m_Device.lock();
+    assert(device && m_GBuffer);
+
+    device->setFramebuffer(m_GBuffer);
+
+    // keep the pre-pass depth, a zero roughness marks the empty texels
+    const GLfloat zero[] = { 0.f, 0.f, 0.f, 0.f };
+    glClearBufferfv(GL_COLOR, 0, zero);
+    glClearBufferfv(GL_COLOR, 1, zero);
+
+    m_GeometryShader->bind();
+    m_GeometryShader->setUniform("uView", data.View);
+    m_GeometryShader->setUniform("uProjection", data.Projection);
+    return m_GeometryShader;
+}
+
+ShaderPtr TiledDeferred::bindShadingProgram(const RenderingData& data, const std::vector<LightData>& lights, const GraphicsTexturePtr& filteredMap) noexcept
+{
+    GLsizeiptr size = lights.size() * sizeof(LightData);
+    if (size > m_LightCapacity)
+    {
+        m_LightCapacity = size;
+        glNamedBufferData(m_LightBuffer, size, nullptr, GL_DYNAMIC_DRAW);
+    }
+    if (size > 0)
+        glNamedBufferSubData(m_LightBuffer, 0, size, lights.data());
+
+    auto& program = m_ShadingShader;
+    program->bind();
+    program->setUniform("uViewProjInv", glm::inverse(data.Projection * data.View));
+    program->setUniform("uProjectionInv", glm::inverse(data.Projection));
+    program->setUniform("uViewPositionW", data.Position);
+    program->setUniform("uLightCount", GLint(lights.size()));
+    program->setUniform("uSamples", data.Samples.data(), data.Samples.size());
+    program->bindTexture("uDepth", m_DepthTex, 0);
+    program->bindTexture("uGBuffer0", m_GBuffer0Tex, 1);
+    program->bindTexture("uGBuffer1", m_GBuffer1Tex, 2);
+    program->bindTexture("uLtc1", light::getLtc1Texture(), 3);
+    program->bindTexture("uLtc2", light::getLtc2Texture(), 4);
+    if (filteredMap)
+        program->bindTexture("uFilteredMap", filteredMap, 5);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_LightBuffer);
+    return program;
+}
+
+void TiledDeferred::dispatch(const GraphicsTexturePtr& color) noexcept
+{
+    auto device = m_Device.lock();
+    assert(device);
+    auto& pool = device->getRenderTargetPool();
+    const glm::ivec2 size(m_Width, m_Height);
+
+    auto& program = m_ShadingShader;
+    program->setUniform("uDiffuseScale", GLint(m_DiffuseScale));
+    program->setUniform("uShadowMode", GLint(m_bRatioShadows ? 1 : 0));
+    program->setUniform("uSize", size);
+
+    // held until the shading pass is done
+    GraphicsTexturePtr ratioTex[2];
+    GraphicsTexturePtr diffuseTex;
+
+    if (m_bRatioShadows)
+    {
+        // view depth in the third channel for the denoiser
+        for (auto& target : ratioTex)
+            target = pool.acquire(getTransientDesc(m_Width, m_Height));
+
+        // noisy estimates, then a horizontal and a vertical blur back in the
+        // first texture; the units are kept clear of the shading ones
+        program->setUniform("uPass", 2);
+        program->bindImage("uRatioOut", ratioTex[0]->downcast_pointer<OGLCoreTexture>(), 2, 0, GL_FALSE, 0, GL_WRITE_ONLY);
+        program->Dispatch2D(m_Width, m_Height, TileSize, TileSize);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        m_DenoiseShader->bind();
+        m_DenoiseShader->bindTexture("uGBuffer0", m_GBuffer0Tex, 1);
+        m_DenoiseShader->setUniform("uSize", size);
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            m_DenoiseShader->setUniform("uDirection", i == 0 ? glm::vec2(1.f, 0.f) : glm::vec2(0.f, 1.f));
+            m_DenoiseShader->bindTexture("uSource", ratioTex[i], 9);
+            m_DenoiseShader->bindImage("uDest", ratioTex[i ^ 1]->downcast_pointer<OGLCoreTexture>(), 3, 0, GL_FALSE, 0, GL_WRITE_ONLY);
+            m_DenoiseShader->Dispatch2D(m_Width, m_Height, TileSize, TileSize);
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+
+        program->bind();
+        program->bindTexture("uRatio", ratioTex[0], 8);
+    }
+
+    const bool bReduced = m_DiffuseScale != 1;
+    if (bReduced)
+    {
+        // linear depth in alpha for the upsampling
+        const int32_t width = Math::DivideByMultiple(m_Width, m_DiffuseScale);
+        const int32_t height = Math::DivideByMultiple(m_Height, m_DiffuseScale);
+        diffuseTex = pool.acquire(getTransientDesc(width, height));
+
+        auto diffuse = diffuseTex->downcast_pointer<OGLCoreTexture>();
+        program->setUniform("uPass", 0);
+        program->bindImage("uDiffuse", diffuse, 1, 0, GL_FALSE, 0, GL_WRITE_ONLY);
+        program->Dispatch2D(width, height, TileSize, TileSize);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        program->bindTexture("uDiffuseLow", diffuseTex, 6);
+    }
+
+    const bool bMeasure = m_bMeasureError && bReduced;
+    program->setUniform("ubMeasureError", bMeasure);
+    if (bMeasure)
+    {
+        // tiles without surface do not write their sums
+        glClearNamedBufferData(m_ErrorBuffer, GL_RG32F, GL_RG, GL_FLOAT, nullptr);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_ErrorBuffer);
+    }
+
+    // counts again once the previous count is read, never waits on it
+    if (m_OverflowFence && glClientWaitSync(m_OverflowFence, 0, 0) != GL_TIMEOUT_EXPIRED)
+    {
+        glGetNamedBufferSubData(m_OverflowBuffer, 0, sizeof(uint32_t), &m_OverflowTiles);
+        glDeleteSync(m_OverflowFence);
+        m_OverflowFence = nullptr;
+    }
+    const bool bCountOverflow = m_OverflowFence == nullptr;
+    program->setUniform("ubCountOverflow", bCountOverflow);
+    if (bCountOverflow)
+    {
+        glClearNamedBufferData(m_OverflowBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_OverflowBuffer);
+    }
+
+    auto image = color->downcast_pointer<OGLCoreTexture>();
+    program->setUniform("uPass", 1);
+    program->bindImage("uColor", image, 0, 0, GL_FALSE, 0, GL_READ_WRITE);
+    program->Dispatch2D(m_Width, m_Height, TileSize, TileSize);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+
+    // the color target is blended and sampled afterward
+    glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    if (bCountOverflow)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, 0);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        m_OverflowFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    if (bMeasure)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glGetNamedBufferSubData(m_ErrorBuffer, 0, m_TileErrors.size() * sizeof(glm::vec2), m_TileErrors.data());
+
+        double error = 0.0, reference = 0.0;
+        for (auto& tile : m_TileErrors)
+        {
+            error += tile.x;
+            reference += tile.y;
+        }
+        m_DiffuseError = reference > 0.0 ? float(error / reference) : 0.f;
+        m_bMeasureError = false;
+    }
+
+    CHECKGLERROR();
+}
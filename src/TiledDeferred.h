@@ -0,0 +1,88 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <GraphicsTypes.h>
+#include <Light.h>
+#include <vector>
+
+// Deferred alternative to the per-light forward color pass. The G-buffer
+// is written once over the pre-pass depth, then a compute pass builds the
+// light list of each 16x16 tile from its depth bounds and runs the LTC
+// evaluation for those lights only. The diffuse term can be evaluated at a
+// reduced resolution and upsampled with the G-buffer depth and normals.
+// The shadows are either filtered per light (PCSS) or, with the ratio
+// estimator, the analytic lighting is scaled by the ratio of denoised
+// stochastic shadowed and unshadowed estimates.
+class TiledDeferred final
+{
+public:
+
+    static const uint32_t TileSize = 16;
+    static const uint32_t MaxTileLights = 64;  // MAX_TILE_LIGHTS of the shader
+
+    TiledDeferred() noexcept;
+    ~TiledDeferred() noexcept;
+
+    // requires compute shaders, i.e. the OpenGL core device
+    bool create(const GraphicsDevicePtr& device) noexcept;
+    void destroy() noexcept;
+
+    // 'depth' is the pre-pass depth buffer, shared by the G-buffer target;
+    // the G-buffer comes from the render target pool
+    void resize(int32_t width, int32_t height, const GraphicsTexturePtr& depth) noexcept;
+
+    // binds the G-buffer target and its program; the material textures and
+    // the draws are left to the caller
+    ShaderPtr bindGeometryProgram(const RenderingData& data) noexcept;
+
+    // uploads the lights and binds the tile shading program
+    ShaderPtr bindShadingProgram(const RenderingData& data, const std::vector<LightData>& lights, const GraphicsTexturePtr& filteredMap) noexcept;
+
+    // accumulates the shading in 'color'; the reduced diffuse and ratio
+    // targets are pooled for the dispatch only
+    void dispatch(const GraphicsTexturePtr& color) noexcept;
+
+    // 1, 2 or 4 : full, half or quarter resolution diffuse
+    void setDiffuseScale(uint32_t scale) noexcept;
+    uint32_t getDiffuseScale() const noexcept;
+
+    // ratio estimator instead of the PCSS lookups
+    void setRatioShadows(bool bEnabled) noexcept;
+    bool getRatioShadows() const noexcept;
+
+    // the next reduced dispatch also evaluates the full resolution diffuse and
+    // reads back the mean relative luminance error, negative until measured
+    void requestDiffuseError() noexcept;
+    float getDiffuseError() const noexcept;
+
+    // tiles reaching more lights than their list holds, shaded by testing
+    // every light per texel; read back a few frames late
+    uint32_t getOverflowTiles() const noexcept;
+
+private:
+
+    GraphicsTextureDesc getTransientDesc(int32_t width, int32_t height) const noexcept;
+
+    GraphicsDeviceWeakPtr m_Device;
+    ShaderPtr m_GeometryShader;
+    ShaderPtr m_ShadingShader;
+    ShaderPtr m_DenoiseShader;
+    GraphicsTexturePtr m_DepthTex;
+    GraphicsTexturePtr m_GBuffer0Tex; // normal, roughness
+    GraphicsTexturePtr m_GBuffer1Tex; // base color, metalness
+    GraphicsFramebufferPtr m_GBuffer;
+    GLuint m_LightBuffer;
+    GLsizeiptr m_LightCapacity;
+    GLuint m_ErrorBuffer;
+    GLuint m_OverflowBuffer;
+    GLsync m_OverflowFence;     // of the counting dispatch, null once read
+    uint32_t m_OverflowTiles;
+    uint32_t m_DiffuseScale;
+    bool m_bMeasureError;
+    bool m_bRatioShadows;
+    float m_DiffuseError;
+    std::vector<glm::vec2> m_TileErrors;
+    int32_t m_Width;
+    int32_t m_Height;
+};
@@ -21,76 +21,69 @@
 #include <GLType/OGLTexture.h>
 #include <GLType/OGLCoreTexture.h>
 #include <GLType/OGLCoreFramebuffer.h>
+#include <GLType/RenderTargetPool.h>
+#include <GLType/ResourceCache.h>
 
 #include <GraphicsTypes.h>
 #include <Light.h>
 #include <SkyBox.h>
 #include <Mesh.h>
+#include <Model.h>
+#include <HiZBuffer.h>
+#include <TiledDeferred.h>
+#include <TemporalAccumulator.h>
+#include <ShadowAtlas.h>
+#include <SvgfDenoiser.h>
+#include <LightBvh.h>
+#include <BvhBenchmark.h>
+#include <AssetManifest.h>
+#include <MaterialLibrary.h>
 
 #include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <typeinfo>
 #include <memory>
 #include <vector>
 #include <algorithm>
 #include <GameCore.h>
 
-typedef std::shared_ptr<class Model> ModelPtr;
-typedef std::shared_ptr<class Mesh> MeshPtr;
 typedef std::shared_ptr<class Light> LightPtr;
-typedef std::vector<MeshPtr> MeshList;
-typedef std::vector<ModelPtr> ModelList;
 typedef std::vector<LightPtr> LightList;
 
-class Model final
-{
-public:
-
-    Model() noexcept;
-    virtual ~Model() noexcept;
-
-    void appendMesh(MeshPtr&& mesh) noexcept;
-    void setWorld(const glm::mat4& world) noexcept;
-    void submit(const ShaderPtr& shader) noexcept;
-
-private:
-
-    glm::mat4 m_World;
-    MeshList m_Meshes;
-};
-
-Model::Model() noexcept
-    : m_World(1.f)
-{
-}
-
-Model::~Model() noexcept
-{
-}
+const uint32_t kLodCount = 5;
+const float kFloorSize = 100.f;
+const float kFloorTiling = 20.f; // texture repeats across the floor
 
-void Model::appendMesh(MeshPtr&& mesh) noexcept
+void printCacheStats(const char* name, const Mesh& mesh)
 {
-    m_Meshes.emplace_back(std::move(mesh));
-}
-
-void Model::setWorld(const glm::mat4& world) noexcept
-{
-    m_World = world;
-}
-
-void Model::submit(const ShaderPtr& shader) noexcept
-{
-    shader->setUniform("uWorld", m_World);
-    for (auto& mesh : m_Meshes)
-        mesh->draw();
+    auto& vb = mesh.getVertexBuffer();
+    auto& before = vb.getCacheStatsBefore();
+    auto& after = vb.getCacheStatsAfter();
+    printf("%-8s ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%d vertices)\n",
+        name, before.ACMR, after.ACMR, before.ATVR, after.ATVR, vb.getVertexCount());
 }
 
+// the models of a same primitive share its mesh
 template <typename T, typename... Args>
-ModelPtr createPrimitive(const glm::mat4& world, Args&&... args)
+ModelPtr createPrimitive(const GraphicsDevicePtr& device, const glm::mat4& world, uint32_t material, Args&&... args)
 {
-    auto mesh = std::make_shared<T>(std::forward<Args>(args)...);
-    mesh->create();
+    // 9 digits tell any two floats apart
+    std::ostringstream key;
+    key << std::setprecision(9) << typeid(T).name();
+    using expand = int[];
+    (void)expand{ 0, ((key << ' ' << args), 0)... };
+
+    auto mesh = device->getResourceCache().findOrCreate<T>(key.str(), [&]() {
+        auto mesh = std::make_shared<T>(std::forward<Args>(args)...);
+        mesh->setQuantization(VertexQuantizeAll);
+        mesh->setLodCount(kLodCount);
+        mesh->create();
+        return mesh;
+    });
 
     ModelPtr model = std::make_shared<Model>();;
-    model->appendMesh(mesh);
+    model->appendMesh(mesh, material);
     model->setWorld(world);
     return model;
 }
@@ -100,6 +93,26 @@ struct SceneSettings
     bool bProgressiveSampling = true;
     bool bGroudTruth = false;
     bool bClipless = true;
+    bool bInstanceStress = false;
+    bool bLightStress = false;
+    bool bLightBvh = true; // single pass ground truth
+    bool bLod = true;
+    bool bCulling = true;
+    bool bOcclusionCulling = true;
+    bool bTiledDeferred = false;
+    int DiffuseResolution = 0; // full, half, quarter
+    bool bTemporalAccumulation = true;
+    int MaxHistory = 1024;
+    bool bDenoise = false; // replaces the temporal accumulation
+    int DenoiseHistory = 32;
+    bool bShadows = true;
+    int ShadowResolution = 1; // 512, 1024, 2048
+    int ShadowEstimator = 0; // PCSS, ratio estimator (tiled deferred only)
+    float LightCullThreshold = 0.01f;
+    float LodPixelError = 1.f;
+    float LodHysteresis = 0.25f;
+    int TextureBudget = 64; // MB, streamed textures
+    int MaxAnisotropy = 16; // every sampler, 1 for none
     uint32_t LightIndex = 0;
     float JitterAASigma = 0.6f;
     float F0 = 0.04f; // fresnel
@@ -157,16 +170,31 @@ glm::mat4 jitterProjMatrix(const glm::mat4& proj, int sampleCount, float jitterA
     return ret;
 }
 
-enum ProfilerType { ProfilerTypeMainRender = 0 };
+enum ProfilerType { ProfilerTypeMainRender = 0, ProfilerTypeHiZ, ProfilerTypeForward, ProfilerTypeDeferred, ProfilerTypeShadow, ProfilerTypeDenoise };
 
 namespace 
 {
     static const uint32_t NumSamples = 4;
 
     bool s_bSampleReset = false;
+    bool s_bHistoryReset = false; // not covered by the reprojection
+    bool s_bCameraMoved = false;
     bool s_bUiChanged = false;
     float s_CpuTick = 0.f;
     float s_GpuTick = 0.f;
+    float s_HiZCpuTick = 0.f;
+    float s_HiZGpuTick = 0.f;
+    float s_ForwardCpuTick = 0.f;
+    float s_ForwardGpuTick = 0.f;
+    float s_DeferredCpuTick = 0.f;
+    float s_DeferredGpuTick = 0.f;
+    float s_DeferredGpuTicks[3] = { 0.f, 0.f, 0.f }; // per diffuse resolution, of the current view
+    uint32_t s_DeferredFrames = 0; // since the view or the diffuse resolution changed
+    const uint32_t kProfilerLatency = 4; // frames, a GPU tick may read an older query
+    float s_ShadowCpuTick = 0.f;
+    float s_ShadowGpuTick = 0.f;
+    float s_DenoiseCpuTick = 0.f;
+    float s_DenoiseGpuTick = 0.f;
     int32_t s_SampleCount = 0;
 }
 
@@ -191,20 +219,50 @@ public:
 
     ShaderPtr submitPerFrameUniformLight(ShaderPtr& shader) noexcept;
 
+    void buildModelBatch() noexcept;
+    void buildLightList() noexcept;
+    void benchmarkTriangleBvh() noexcept;
+
 private:
 
     SceneSettings m_Settings;
 	TCamera m_Camera;
     LightList m_Lights;
+    LightList m_SceneLights;
+    LightList m_StressLights;
     ModelList m_Models;
+    ModelList m_StressModels;
+    ModelBatch m_ModelBatch;
+    VisibilityMask m_CameraVisible;
+    VisibilityMask m_LightVisible;
+    VisibilityMask m_DepthVisible;  // first phase of the pre-pass
+    VisibilityMask m_Retested;      // second phase, occluded at the latest finished test
+    VisibilityMask m_Occluded;      // latest finished Hi-Z test
+    HiZBuffer m_HiZ;
+    bool m_bHiZSupported = false;
+    TiledDeferred m_TiledDeferred;
+    std::vector<LightData> m_LightData;
+    bool m_bDeferredSupported = false;
+    TemporalAccumulator m_Temporal;
+    bool m_bTemporalSupported = false;
+    SvgfDenoiser m_Denoiser;
+    bool m_bDenoiserSupported = false;
+    LightBvh m_LightBvh;
+    bool m_bLightBvhSupported = false;
+    bvh::BenchmarkReport m_BvhReport = {};
+    ShadowAtlas m_Shadows;
+    uint32_t m_ShadowTilesRendered = 0;
+    uint32_t m_OccludedCount = 0;
+    uint32_t m_CameraVisibleCount = 0;
+    uint32_t m_LightVisibleCount = 0;
+    uint32_t m_DepthTriangles = 0;
+    uint32_t m_ColorTriangles = 0;
     FullscreenTriangleMesh m_ScreenTraingle;
     ProgramShader m_BlitShader;
 
     GraphicsTexturePtr m_ScreenColorTex;
-	GraphicsTexturePtr m_NormalTex;
-	GraphicsTexturePtr m_RoughnessTex;
-	GraphicsTexturePtr m_MetalnessTex;
-	GraphicsTexturePtr m_AlbedoTex;
+    GraphicsTexturePtr m_DepthTex;
+    MaterialLibrary m_Materials;
     GraphicsFramebufferPtr m_ColorRenderTarget;
     GraphicsDevicePtr m_Device;
 };
@@ -243,6 +301,18 @@ void AreaLight::startup() noexcept
 	m_BlitShader.link();
 
     m_ScreenTraingle.create();
+
+    // compute shaders are not available on the 4.1 path
+    m_bHiZSupported = m_HiZ.create(m_Device) && m_ModelBatch.createIndirect(m_Device);
+    m_Settings.bOcclusionCulling &= m_bHiZSupported;
+    m_bDeferredSupported = m_TiledDeferred.create(m_Device);
+    m_bTemporalSupported = m_Temporal.create(m_Device);
+    m_Settings.bTemporalAccumulation &= m_bTemporalSupported;
+    m_bDenoiserSupported = m_Denoiser.create(m_Device);
+    m_Settings.bDenoise &= m_bDenoiserSupported;
+    m_bLightBvhSupported = m_LightBvh.create(m_Device);
+    m_Settings.bLightBvh &= m_bLightBvhSupported;
+    m_Shadows.create(m_Device, 4096);
 	
 	GraphicsTextureDesc filteredDesc;
     filteredDesc.setFilename("resources/hatsune-miku-in-the-rain_filtered.dds");
@@ -251,30 +321,36 @@ void AreaLight::startup() noexcept
     filteredDesc.setMinFilter(GL_LINEAR);
     filteredDesc.setMagFilter(GL_LINEAR);
     filteredDesc.setAnisotropyLevel(16);
-    auto filteredTex = m_Device->createTexture(filteredDesc);
+    // decoded on the loader threads, placeholders until the first uploads
+    auto filteredTex = m_Device->createTextureAsync(filteredDesc);
 
     GraphicsTextureDesc source;
     source.setFilename("resources/hatsune-miku-in-the-rain.zlib");
     source.setAnisotropyLevel(16);
-    auto lightSource = m_Device->createTexture(source);
-
-	{
-		GraphicsTextureDesc normal;
-		normal.setFilename("resources/floor/normal.dds");
-		m_NormalTex = m_Device->createTexture(normal);
-
-		GraphicsTextureDesc roughness;
-		roughness.setFilename("resources/floor/roughness.dds");
-		m_RoughnessTex = m_Device->createTexture(roughness);
-
-		GraphicsTextureDesc metalness;
-		metalness.setFilename("resources/floor/metalness.dds");
-		m_MetalnessTex = m_Device->createTexture(metalness);
-
-		GraphicsTextureDesc albedo;
-		albedo.setFilename("resources/floor/albedo.dds");
-		m_AlbedoTex = m_Device->createTexture(albedo);
-	}
+    auto lightSource = m_Device->createTextureAsync(source);
+
+    // the finer levels of the material arrays follow the texel density of
+    // the floor, the maps are cooked with their mips by the AssetCooker
+    m_Materials.create(m_Device);
+    const uint32_t floorMaterial = m_Materials.add(m_Materials.createMaterial("resources/floor"));
+    const uint32_t marbleMaterial = m_Materials.add(m_Materials.createMaterial("resources/marble"));
+
+    // tinted marbles for the small cubes, all drawn by the same batches
+    const glm::vec4 tints[] = {
+        glm::vec4(0.9f, 0.3f, 0.3f, 1.f),
+        glm::vec4(0.3f, 0.9f, 0.3f, 1.f),
+        glm::vec4(0.3f, 0.3f, 0.9f, 1.f),
+        glm::vec4(0.9f, 0.8f, 0.3f, 1.f),
+    };
+    std::vector<uint32_t> stressMaterials;
+    for (auto& tint : tints)
+    {
+        auto material = m_Materials.createMaterial("resources/marble");
+        material->m_BaseColor = tint;
+        stressMaterials.push_back(m_Materials.add(material));
+    }
+    stressMaterials.push_back(floorMaterial);
+    stressMaterials.push_back(marbleMaterial);
 
 	auto rot = glm::angleAxis(glm::half_pi<float>(), glm::vec3(1, 0, 0));
     auto light = std::make_shared<Light>();
@@ -292,29 +368,95 @@ void AreaLight::startup() noexcept
     backLight->setLightSource(lightSource);
     backLight->setLightFilterd(filteredTex);
     m_Lights.emplace_back(std::move(backLight));
+    m_SceneLights = m_Lights;
+
+    // 16x16 small lights facing down, for the many-light ground truth
+    for (int j = 0; j < 16; j++)
+    for (int i = 0; i < 16; i++)
+    {
+        auto stressLight = std::make_shared<Light>();
+        stressLight->setRotation(glm::vec3(180.f, 0, 0));
+        stressLight->setPosition(glm::vec3((i - 7.5f) * 3.f, 4.f, (j - 7.5f) * 3.f));
+        stressLight->setIntensity(2.f);
+        stressLight->setTexturedLight(false);
+        stressLight->setLightSource(lightSource);
+        stressLight->setLightFilterd(filteredTex);
+        stressLight->m_Width = stressLight->m_Height = 0.25f;
+        m_StressLights.emplace_back(std::move(stressLight));
+    }
 
     // Ground plane
 	{
 		glm::mat4 world = glm::mat4(1.f);
-		m_Models.emplace_back(createPrimitive<PlaneMesh>(world, 100.f, 32.f, 20.f));
+		m_Models.emplace_back(createPrimitive<PlaneMesh>(m_Device, world, floorMaterial, kFloorSize, 32.f, kFloorTiling));
+		printCacheStats("Plane", *m_Models.back()->getMeshes()[0]);
 	}
 
     // Simple cube
     {
         glm::mat4 world = glm::mat4(1.f);
         world = glm::translate(world, glm::vec3(-2.f, 1.f, 8.f));
-        m_Models.emplace_back(createPrimitive<CubeMesh>(world));
+        m_Models.emplace_back(createPrimitive<CubeMesh>(m_Device, world, marbleMaterial));
+        printCacheStats("Cube", *m_Models.back()->getMeshes()[0]);
     }
     // Simple sphere
     {
         glm::mat4 world = glm::mat4(1.f);
         world = glm::translate(world, glm::vec3(2.f, 0.f, 8.f));
-        m_Models.emplace_back(createPrimitive<SphereMesh>(world, 32));
+        m_Models.emplace_back(createPrimitive<SphereMesh>(m_Device, world, marbleMaterial, 32));
+        printCacheStats("Sphere", *m_Models.back()->getMeshes()[0]);
     }
+    // Torus knot imported from an OBJ, cooked to a '.mesh' on the first run
+    // and mapped on the next ones
+    {
+        const std::string path = "resources/models/knot.obj";
+        auto mesh = m_Device->getResourceCache().findOrCreate<FileMesh>(path, [&]() {
+            auto mesh = std::make_shared<FileMesh>(path);
+            mesh->setQuantization(VertexQuantizeAll);
+            mesh->setLodCount(kLodCount);
+            mesh->create();
+            return mesh;
+        });
+        if (mesh->isLoaded())
+        {
+            ModelPtr model = std::make_shared<Model>();
+            model->appendMesh(mesh, marbleMaterial);
+            model->setWorld(glm::translate(glm::mat4(1.f), glm::vec3(6.f, 1.5f, 8.f)));
+            m_Models.emplace_back(std::move(model));
+        }
+    }
+    // 100x100 small cubes sharing a single mesh
+    {
+        auto mesh = std::make_shared<CubeMesh>();
+        mesh->setQuantization(VertexQuantizeAll);
+        mesh->create();
+        for (int j = 0; j < 100; j++)
+        for (int i = 0; i < 100; i++)
+        {
+            glm::mat4 world = glm::mat4(1.f);
+            world = glm::translate(world, glm::vec3(i - 50.f, 0.1f, j - 50.f) * 0.8f);
+            world = glm::scale(world, glm::vec3(0.1f));
+
+            ModelPtr model = std::make_shared<Model>();
+            model->appendMesh(mesh, stressMaterials[(i + j) % stressMaterials.size()]);
+            model->setWorld(world);
+            m_StressModels.emplace_back(std::move(model));
+        }
+    }
+    buildModelBatch();
 }
 
 void AreaLight::closeup() noexcept
 {
+    m_ModelBatch.destroy();
+    m_ModelBatch.destroyIndirect();
+    m_HiZ.destroy();
+    m_TiledDeferred.destroy();
+    m_Temporal.destroy();
+    m_Denoiser.destroy();
+    m_LightBvh.destroy();
+    m_Shadows.destroy();
+    m_Materials.destroy();
     m_ScreenTraingle.destroy();
     light::shutdown();
     profiler::shutdown();
@@ -324,6 +466,19 @@ void AreaLight::update() noexcept
 {
     bool bCameraUpdated = m_Camera.update();
 
+    // the floor material is sampled the most finely right below the camera
+    const float projScale = m_Camera.getProjectionMatrix()[1][1];
+    const float pixelsPerUnit = getFrameHeight() * 0.5f * projScale / std::max(m_Camera.getPosition().y, 0.1f);
+    const float uvPerPixel = kFloorTiling / kFloorSize / pixelsPerUnit;
+    m_Materials.requestDensity(uvPerPixel);
+    m_Materials.update();
+    m_Device->setTextureBudget(uint64_t(m_Settings.TextureBudget) << 20);
+    m_Device->setMaxAnisotropy(float(m_Settings.MaxAnisotropy));
+    m_Device->getRenderTargetPool().update();
+
+    // the accumulated history was shaded with the placeholders or coarser levels
+    bool bTexturesLoaded = m_Device->flushTextureUploads() > 0;
+
     static float preWidth = 0.f;
     static float preHeight = 0.f;
 
@@ -335,7 +490,28 @@ void AreaLight::update() noexcept
         preWidth = width, preHeight = height;
         bResized = true;
     }
-    s_bSampleReset = (s_bUiChanged || bCameraUpdated || bResized);
+    s_bHistoryReset = (s_bUiChanged || bResized || bTexturesLoaded);
+    s_bCameraMoved = bCameraUpdated;
+    s_bSampleReset = (s_bHistoryReset || s_bCameraMoved);
+
+    // the deferred timings of the diffuse resolutions compare the same view :
+    // any other change drops them
+    static int preDiffuseResolution = 0;
+    const bool bDiffuseChanged = preDiffuseResolution != m_Settings.DiffuseResolution;
+    preDiffuseResolution = m_Settings.DiffuseResolution;
+    if (bCameraUpdated || bResized || bTexturesLoaded || (s_bUiChanged && !bDiffuseChanged))
+        std::fill(std::begin(s_DeferredGpuTicks), std::end(s_DeferredGpuTicks), 0.f);
+    if (s_bSampleReset)
+        s_DeferredFrames = 0;
+
+    const LodSelection selection {
+        m_Settings.bLod,
+        m_Camera.getPosition(),
+        height * 0.5f * projScale,
+        m_Settings.LodPixelError,
+        m_Settings.LodHysteresis
+    };
+    m_ModelBatch.update(selection);
 }
 
 void AreaLight::updateHUD() noexcept
@@ -358,10 +534,112 @@ void AreaLight::updateHUD() noexcept
         {
             ImGui::Text("CPU %s: %10.5f ms\n", "Main", s_CpuTick);
             ImGui::Text("GPU %s: %10.5f ms\n", "Main", s_GpuTick);
+            ImGui::Text("Draws: %u, Instances: %u\n", m_ModelBatch.getDrawCount(), m_ModelBatch.getInstanceCount());
+            ImGui::Text("Triangles depth: %u, color: %u\n", m_DepthTriangles, m_ColorTriangles);
+            ImGui::Text("Visible: %u / %u, lit (sum): %u\n", m_CameraVisibleCount, m_ModelBatch.getModelCount(), m_LightVisibleCount);
+            ImGui::Text("Occluded (latest read): %u\n", m_OccludedCount);
+            if (m_Device->getPendingTextureCount() > 0)
+                ImGui::Text("Textures loading: %u\n", m_Device->getPendingTextureCount());
+            {
+                const TextureStreamingStats stats = m_Device->getTextureStreamingStats();
+                if (stats.TextureCount > 0)
+                {
+                    const float MB = 1.f / (1 << 20);
+                    ImGui::Text("Streamed textures: %u, resident %.1f / %.1f MB (wanted %.1f, budget %.0f)\n",
+                        stats.TextureCount, stats.ResidentBytes * MB, stats.FullBytes * MB, stats.WantedBytes * MB, stats.BudgetBytes * MB);
+                    ImGui::Text("Texture uploads %.1f MB/s, pending: %u, evicted levels: %llu\n",
+                        stats.UploadRate * MB, stats.PendingCount, (unsigned long long)stats.EvictedLevels);
+                }
+            }
+            {
+                const RenderTargetPool& pool = m_Device->getRenderTargetPool();
+                ImGui::Text("Render targets: %u, %.1f MB\n", pool.getTextureCount(), pool.getTextureBytes() / float(1 << 20));
+            }
+            ImGui::Text("Hi-Z CPU %10.5f ms, GPU %10.5f ms\n", s_HiZCpuTick, s_HiZGpuTick);
+            ImGui::Text("Forward  CPU %10.5f ms, GPU %10.5f ms\n", s_ForwardCpuTick, s_ForwardGpuTick);
+            ImGui::Text("Deferred CPU %10.5f ms, GPU %10.5f ms\n", s_DeferredCpuTick, s_DeferredGpuTick);
+            if (m_Settings.bTiledDeferred && m_TiledDeferred.getOverflowTiles() > 0)
+                ImGui::Text("  tiles over %u lights: %u (all lights tested)\n", TiledDeferred::MaxTileLights, m_TiledDeferred.getOverflowTiles());
+            ImGui::Text("Shadow   CPU %10.5f ms, GPU %10.5f ms, maps rendered: %u, unshadowed lights: %u\n",
+                s_ShadowCpuTick, s_ShadowGpuTick, m_ShadowTilesRendered, m_Shadows.getUnshadowedCount());
+            if (m_Settings.bGroudTruth && m_Settings.bLightBvh)
+                ImGui::Text("Light BVH nodes: %u, depth: %u\n", m_LightBvh.getNodeCount(), m_LightBvh.getDepth());
+            if (m_BvhReport.TriangleCount > 0)
+            {
+                ImGui::Text("Triangle BVH: %u tris, build %.2f ms (%u threads)\n", m_BvhReport.TriangleCount, m_BvhReport.BuildTime, m_BvhReport.ThreadCount);
+                ImGui::Text("  primary %.2f Mrays/s, shadow %.2f Mrays/s\n", m_BvhReport.ClosestRate, m_BvhReport.ShadowRate);
+            }
+            if (m_Settings.bDenoise)
+                ImGui::Text("Denoise  CPU %10.5f ms, GPU %10.5f ms\n", s_DenoiseCpuTick, s_DenoiseGpuTick);
+            if (m_Settings.DiffuseResolution > 0 && s_DeferredGpuTicks[0] > 0.f && s_DeferredGpuTicks[m_Settings.DiffuseResolution] > 0.f)
+            {
+                float saved = s_DeferredGpuTicks[0] - s_DeferredGpuTicks[m_Settings.DiffuseResolution];
+                float error = m_TiledDeferred.getDiffuseError();
+                if (error >= 0.f)
+                    ImGui::Text("Diffuse saved %10.5f ms, error %6.3f %%\n", saved, error * 100.f);
+                else
+                    ImGui::Text("Diffuse saved %10.5f ms\n", saved);
+            }
+            else if (m_Settings.DiffuseResolution > 0)
+            {
+                float error = m_TiledDeferred.getDiffuseError();
+                if (error >= 0.f)
+                    ImGui::Text("Diffuse error %6.3f %%, run Full then this resolution on a still view for the time saved\n", error * 100.f);
+                else
+                    ImGui::Text("Diffuse saved : run Full then this resolution on a still view\n");
+            }
             ImGui::Separator();
             bUpdated |= ImGui::Checkbox("Ground Truth", &m_Settings.bGroudTruth);
             bUpdated |= ImGui::Checkbox("Progressive Sampling", &m_Settings.bProgressiveSampling);
+            if (m_bTemporalSupported)
+            {
+                bUpdated |= ImGui::Checkbox("Temporal Accumulation", &m_Settings.bTemporalAccumulation);
+                // the cap applies to the next frames, the history stays valid
+                ImGui::SliderInt("Max History", &m_Settings.MaxHistory, 1, 4096);
+            }
+            if (m_bDenoiserSupported)
+            {
+                bUpdated |= ImGui::Checkbox("SVGF Denoiser", &m_Settings.bDenoise);
+                ImGui::SliderInt("Denoiser History", &m_Settings.DenoiseHistory, 1, 256);
+            }
             bUpdated |= ImGui::Checkbox("Use Clipless", &m_Settings.bClipless);
+            if (m_bDeferredSupported)
+            {
+                bUpdated |= ImGui::Checkbox("Tiled Deferred", &m_Settings.bTiledDeferred);
+                bUpdated |= ImGui::Combo("Diffuse Resolution", &m_Settings.DiffuseResolution, "Full\0Half\0Quarter\0\0");
+                if (m_Settings.DiffuseResolution > 0 && ImGui::Button("Measure Diffuse Error"))
+                {
+                    // the measuring dispatch also shades the full diffuse, not timed
+                    m_TiledDeferred.requestDiffuseError();
+                    s_DeferredFrames = 0;
+                }
+            }
+            if (ImGui::Checkbox("Instance Stress (10k)", &m_Settings.bInstanceStress))
+            {
+                buildModelBatch();
+                bUpdated = true;
+            }
+            if (ImGui::Checkbox("Light Stress (256)", &m_Settings.bLightStress))
+            {
+                buildLightList();
+                bUpdated = true;
+            }
+            if (m_bLightBvhSupported)
+                bUpdated |= ImGui::Checkbox("Light BVH Sampling", &m_Settings.bLightBvh);
+            if (ImGui::Button("Benchmark Triangle BVH"))
+                benchmarkTriangleBvh();
+            bUpdated |= ImGui::Checkbox("Mesh LOD", &m_Settings.bLod);
+            bUpdated |= ImGui::SliderFloat("LOD Pixel Error", &m_Settings.LodPixelError, 0.1f, 8.f);
+            ImGui::SliderInt("Texture Budget (MB)", &m_Settings.TextureBudget, 1, 1024);
+            bUpdated |= ImGui::SliderInt("Max Anisotropy", &m_Settings.MaxAnisotropy, 1, 16);
+            bUpdated |= ImGui::Checkbox("Area Light Shadows", &m_Settings.bShadows);
+            bUpdated |= ImGui::Combo("Shadow Resolution", &m_Settings.ShadowResolution, "512\0" "1024\0" "2048\0\0");
+            if (m_bDeferredSupported)
+                bUpdated |= ImGui::Combo("Shadow Estimator", &m_Settings.ShadowEstimator, "PCSS\0Ratio Estimator\0\0");
+            bUpdated |= ImGui::Checkbox("Culling", &m_Settings.bCulling);
+            if (m_bHiZSupported)
+                bUpdated |= ImGui::Checkbox("Hi-Z Occlusion Culling", &m_Settings.bOcclusionCulling);
+            bUpdated |= ImGui::SliderFloat("Light Cull Threshold", &m_Settings.LightCullThreshold, 0.001f, 1.f, "%.3f", 2.f);
             ImGui::Separator();
             bUpdated |= ImGui::SliderFloat("Fresnel", &m_Settings.F0, 0.01f, 1.f);
             bUpdated |= ImGui::SliderFloat("Jitter Radius", &m_Settings.JitterAASigma, 0.01f, 2.f);
@@ -410,8 +688,12 @@ void AreaLight::render() noexcept
 {
     profiler::start(ProfilerTypeMainRender);
 
-    // reset sampling count
-    if (s_bSampleReset)
+    // reset sampling count, the temporal accumulator and the denoiser
+    // reproject their history through the camera motion and only restart on
+    // the other changes
+    const bool bDenoise = m_bDenoiserSupported && m_Settings.bDenoise;
+    const bool bTemporal = bDenoise || (m_bTemporalSupported && m_Settings.bTemporalAccumulation);
+    if (bTemporal ? s_bHistoryReset : s_bSampleReset)
         s_SampleCount = 0;
 
     // set the jittered projection matrix
@@ -433,8 +715,48 @@ void AreaLight::render() noexcept
         samples
     };
 
+    // visible models, against the jittered frustum
+    if (m_Settings.bCulling)
+        m_ModelBatch.cull(Math::CullVolume::fromViewProjection(projection*renderData.View), m_CameraVisible);
+    else
+        m_CameraVisible.assign(m_ModelBatch.getModelCount(), 1);
+
+    // two phases: the pre-pass first draws the models the latest finished
+    // test (read without waiting on the GPU) found visible, the pyramid of
+    // their depth then tests every model in the frustum. The ones the first
+    // phase skipped and this test finds visible complete the pre-pass, and
+    // the color passes only draw the models passing it; the flags never
+    // leave the GPU, see ModelBatch::drawIndirect.
+    const bool bOcclusion = m_Settings.bCulling && m_Settings.bOcclusionCulling;
+    m_Occluded.clear();
+    m_OccludedCount = 0;
+    if (bOcclusion)
+        m_OccludedCount = m_HiZ.readOccluded(m_ModelBatch.getModelCount(), m_Occluded);
+    m_DepthVisible = m_CameraVisible;
+    m_Retested.assign(m_CameraVisible.size(), 0);
+    if (bOcclusion && m_Occluded.size() == m_DepthVisible.size())
+    {
+        for (size_t i = 0; i < m_DepthVisible.size(); i++)
+        {
+            m_Retested[i] = m_DepthVisible[i] & m_Occluded[i];
+            m_DepthVisible[i] &= !m_Occluded[i];
+        }
+    }
+    auto drawVisible = [&](const VisibilityMask& visible) {
+        return bOcclusion ? m_ModelBatch.drawIndirect(visible, m_HiZ.getVisibilityBuffer()) : m_ModelBatch.draw(visible);
+    };
+
+    // shadow maps of the lights or the models that moved, the ground truth
+    // has no visibility term
+    profiler::start(ProfilerTypeShadow);
+    m_Shadows.setEnabled(m_Settings.bShadows && !m_Settings.bGroudTruth);
+    m_Shadows.setTileSize(512u << m_Settings.ShadowResolution);
+    m_ShadowTilesRendered = m_Shadows.update(m_Lights, m_ModelBatch);
+    profiler::stop(ProfilerTypeShadow);
+    profiler::tick(ProfilerTypeShadow, s_ShadowCpuTick, s_ShadowGpuTick);
+
     GLenum clearFlag = GL_DEPTH_BUFFER_BIT;
-    if (s_SampleCount == 0)
+    if (s_SampleCount == 0 || bTemporal)
         clearFlag |= GL_COLOR_BUFFER_BIT;
     m_Device->setFramebuffer(m_ColorRenderTarget);
 	glViewport(0, 0, getFrameWidth(), getFrameHeight());
@@ -452,15 +774,68 @@ void AreaLight::render() noexcept
             light->submit(depthLightProgram, true);
         glEnable(GL_CULL_FACE);
 
-        auto program = Light::BindProgram(renderData, true);
-        for (auto& model : m_Models)
-            model->submit(program);
+        auto depthProgram = Light::BindProgram(renderData, true);
+        m_ModelBatch.bind(depthProgram);
+        m_DepthTriangles = m_ModelBatch.draw(m_DepthVisible);
+
+        if (bOcclusion)
+        {
+            // the whole frustum against the pyramid of the first phase
+            profiler::start(ProfilerTypeHiZ);
+            m_HiZ.build(m_DepthTex);
+            m_HiZ.test(m_ModelBatch.getBounds(), projection*renderData.View, m_CameraVisible);
+            profiler::stop(ProfilerTypeHiZ);
+            profiler::tick(ProfilerTypeHiZ, s_HiZCpuTick, s_HiZGpuTick);
+
+            // the color pass tests with GL_EQUAL, each model it draws must
+            // be in the depth buffer
+            depthProgram->bind();
+            m_DepthTriangles += m_ModelBatch.drawIndirect(m_Retested, m_HiZ.getVisibilityBuffer());
+        }
+
+        m_CameraVisibleCount = (uint32_t)std::count(m_CameraVisible.begin(), m_CameraVisible.end(), 1);
         glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
     }
-    // color pass
+    // color pass, the ground truth only exists in forward
+    const bool bDeferred = m_bDeferredSupported && m_Settings.bTiledDeferred && !m_Settings.bGroudTruth;
+    if (bDeferred)
     {
-        glDepthMask(GL_TRUE);
+        profiler::start(ProfilerTypeDeferred);
+
+        // G-buffer over the pre-pass depth
+        glDepthMask(GL_FALSE);
         glDepthFunc(GL_EQUAL);
+        auto program = m_TiledDeferred.bindGeometryProgram(renderData);
+        m_Materials.bind(program, 0);
+        m_ModelBatch.bind(program);
+        m_ColorTriangles = drawVisible(m_CameraVisible);
+        glDepthMask(GL_TRUE);
+
+        // tile light lists and LTC shading; a single filtered map is bound,
+        // the one of the first textured light
+        GraphicsTexturePtr filteredMap;
+        m_LightData.clear();
+        for (uint32_t i = 0; i < m_Lights.size(); i++)
+        {
+            auto& light = m_Lights[i];
+            float threshold = m_Settings.bCulling ? m_Settings.LightCullThreshold : 0.f;
+            m_LightData.push_back(light->getLightData(renderData.View, threshold));
+            m_LightData.back().Shadow = m_Shadows.getShadowData(i);
+            if (!filteredMap && light->m_bTexturedLight)
+                filteredMap = light->m_LightFilteredTex;
+        }
+        if (!filteredMap)
+            filteredMap = m_Lights[0]->m_LightFilteredTex;
+        auto shading = m_TiledDeferred.bindShadingProgram(renderData, m_LightData, filteredMap);
+        shading = submitPerFrameUniformLight(shading);
+        shading->bindTexture("uShadowAtlas", m_Shadows.getTexture(), 7);
+        m_TiledDeferred.setDiffuseScale(1u << m_Settings.DiffuseResolution);
+        m_TiledDeferred.setRatioShadows(m_Shadows.isEnabled() && m_Settings.ShadowEstimator == 1);
+        m_TiledDeferred.dispatch(m_ScreenColorTex);
+        m_LightVisibleCount = 0;
+
+        // emissive quads, as in the forward pass
+        m_Device->setFramebuffer(m_ColorRenderTarget);
         glEnable(GL_BLEND);
         glBlendFunc(GL_ONE, GL_ONE); // additive
         glDisable(GL_CULL_FACE);
@@ -468,23 +843,76 @@ void AreaLight::render() noexcept
         for (auto& light : m_Lights)
             light->submit(lightProgram, false);
         glEnable(GL_CULL_FACE);
+        glDisable(GL_BLEND);
 
-        auto program = Light::BindProgram(renderData, false);
-        program = submitPerFrameUniformLight(program);
+        profiler::stop(ProfilerTypeDeferred);
+        profiler::tick(ProfilerTypeDeferred, s_DeferredCpuTick, s_DeferredGpuTick);
+        if (++s_DeferredFrames > kProfilerLatency)
+            s_DeferredGpuTicks[m_Settings.DiffuseResolution] = s_DeferredGpuTick;
+    }
+    else
+    {
+        profiler::start(ProfilerTypeForward);
+
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_EQUAL);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE); // additive
+        glDisable(GL_CULL_FACE);
+        auto lightProgram = Light::BindLightProgram(renderData, false);
         for (auto& light : m_Lights)
+            light->submit(lightProgram, false);
+        glEnable(GL_CULL_FACE);
+
+        m_ColorTriangles = 0;
+        m_LightVisibleCount = 0;
+        if (m_Settings.bGroudTruth && m_bLightBvhSupported && m_Settings.bLightBvh)
+        {
+            // a single pass, each sample picks its light in the BVH; the
+            // textured lights share the source of the first one
+            GraphicsTexturePtr lightSource;
+            for (auto& light : m_Lights)
+            {
+                if (!lightSource && light->m_bTexturedLight)
+                    lightSource = light->m_LightSourceTex;
+            }
+            if (!lightSource)
+                lightSource = m_Lights[0]->m_LightSourceTex;
+
+            m_LightBvh.build(m_Lights);
+            auto program = m_LightBvh.bindProgram(renderData);
+            program = submitPerFrameUniformLight(program);
+            program->bindTexture("uTexColor", lightSource, 0);
+            m_Materials.bind(program, 3);
+            m_ModelBatch.bind(program);
+            m_ColorTriangles = drawVisible(m_CameraVisible);
+        }
+        else
         {
-            program = light->submitPerLightUniforms(renderData, program);
-            for (auto& model : m_Models)
-			{
-				program->bindTexture("uAlbedo", m_AlbedoTex, 3);
-				program->bindTexture("uNormal", m_NormalTex, 4);
-				program->bindTexture("uMetalness", m_MetalnessTex, 5);
-				program->bindTexture("uRoughness", m_RoughnessTex, 6);
-
-                model->submit(program);
-			}
+            auto program = Light::BindProgram(renderData, false);
+            program = submitPerFrameUniformLight(program);
+            m_ModelBatch.bind(program);
+            for (uint32_t i = 0; i < m_Lights.size(); i++)
+            {
+                auto& light = m_Lights[i];
+
+                // visible models in reach of the light
+                auto& visible = m_Settings.bCulling ? m_LightVisible : m_CameraVisible;
+                if (m_Settings.bCulling)
+                    m_ModelBatch.cull(light->getInfluenceVolume(m_Settings.LightCullThreshold), m_LightVisible, &m_CameraVisible);
+                m_LightVisibleCount += (uint32_t)std::count(visible.begin(), visible.end(), 1);
+
+                program = light->submitPerLightUniforms(renderData, program);
+                m_Materials.bind(program, 3);
+                if (!m_Settings.bGroudTruth)
+                    m_Shadows.submit(program, i, 7);
+                m_ColorTriangles += drawVisible(visible);
+            }
         }
         glDisable(GL_BLEND);
+
+        profiler::stop(ProfilerTypeForward);
+        profiler::tick(ProfilerTypeForward, s_ForwardCpuTick, s_ForwardGpuTick);
     }
     // TAA resolve, tone mapping
     {
@@ -492,10 +920,39 @@ void AreaLight::render() noexcept
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
         glViewport(0, 0, getFrameWidth(), getFrameHeight());
 
+        // the accumulated mean is already normalized
+        GraphicsTexturePtr source = m_ScreenColorTex;
+        int32_t sampleCount = s_SampleCount;
+        if (bDenoise)
+        {
+            profiler::start(ProfilerTypeDenoise);
+            if (s_bHistoryReset)
+                m_Denoiser.reset();
+            m_Denoiser.setMaxHistory(m_Settings.DenoiseHistory);
+            const glm::mat4 viewProj = m_Camera.getProjectionMatrix() * m_Camera.getViewMatrix();
+            source = m_Denoiser.denoise(m_ScreenColorTex, m_DepthTex, viewProj, m_Camera.getPosition());
+            sampleCount = 0;
+            profiler::stop(ProfilerTypeDenoise);
+            profiler::tick(ProfilerTypeDenoise, s_DenoiseCpuTick, s_DenoiseGpuTick);
+        }
+        else if (bTemporal)
+        {
+            if (s_bHistoryReset)
+                m_Temporal.reset();
+            m_Temporal.setMaxHistory(m_Settings.MaxHistory);
+            const glm::mat4 viewProj = m_Camera.getProjectionMatrix() * m_Camera.getViewMatrix();
+            source = m_Temporal.resolve(m_ScreenColorTex, m_DepthTex, viewProj, s_bCameraMoved);
+            sampleCount = 0;
+        }
+
         glDisable(GL_DEPTH_TEST);
         m_BlitShader.bind();
-        m_BlitShader.bindTexture("uTexSource", m_ScreenColorTex, 0);
-        m_BlitShader.setUniform("uSampleCount", s_SampleCount);
+        m_BlitShader.bindTexture("uTexSource", source, 0);
+        m_BlitShader.setUniform("uSampleCount", sampleCount);
+        auto& sourceDesc = source->getGraphicsTextureDesc();
+        m_BlitShader.setUniform("uTexcoordScale", glm::vec2(
+            float(getFrameWidth()) / sourceDesc.getWidth(),
+            float(getFrameHeight()) / sourceDesc.getHeight()));
         m_ScreenTraingle.draw();
         glEnable(GL_DEPTH_TEST);
     }
@@ -569,23 +1026,41 @@ void AreaLight::framesizeCallback(int32_t width, int32_t height) noexcept
 	float aspectRatio = (float)width/height;
 	m_Camera.setProjectionParams(45.0f, aspectRatio, 0.1f, 100.0f);
 
+    // a resize within the size bucket of the pool keeps the targets, the
+    // passes render in the corner of the textures
+    auto& pool = m_Device->getRenderTargetPool();
+    auto screenColorTex = m_ScreenColorTex;
+    auto depthTex = m_DepthTex;
+
     GraphicsTextureDesc colorDesc;
     colorDesc.setWidth(width);
     colorDesc.setHeight(height);
     colorDesc.setFormat(gli::FORMAT_RGBA16_SFLOAT_PACK16);
-    m_ScreenColorTex = m_Device->createTexture(colorDesc);
+    m_ScreenColorTex = pool.acquire(colorDesc, m_ScreenColorTex);
 
     GraphicsTextureDesc depthDesc;
     depthDesc.setWidth(width);
     depthDesc.setHeight(height);
     depthDesc.setFormat(gli::FORMAT_D24_UNORM_S8_UINT_PACK32);
-    auto depthTex = m_Device->createTexture(depthDesc);
+    m_DepthTex = pool.acquire(depthDesc, m_DepthTex);
 
-    GraphicsFramebufferDesc desc;  
-    desc.addComponent(GraphicsAttachmentBinding(m_ScreenColorTex, GL_COLOR_ATTACHMENT0));
-    desc.addComponent(GraphicsAttachmentBinding(depthTex, GL_DEPTH_ATTACHMENT));
-    
-    m_ColorRenderTarget = m_Device->createFramebuffer(desc);;
+    if (!m_ColorRenderTarget || screenColorTex != m_ScreenColorTex || depthTex != m_DepthTex)
+    {
+        GraphicsFramebufferDesc desc;
+        desc.addComponent(GraphicsAttachmentBinding(m_ScreenColorTex, GL_COLOR_ATTACHMENT0));
+        desc.addComponent(GraphicsAttachmentBinding(m_DepthTex, GL_DEPTH_ATTACHMENT));
+
+        m_ColorRenderTarget = m_Device->createFramebuffer(desc);
+    }
+
+    if (m_bHiZSupported)
+        m_HiZ.resize(width, height);
+    if (m_bDeferredSupported)
+        m_TiledDeferred.resize(width, height, m_DepthTex);
+    if (m_bTemporalSupported)
+        m_Temporal.resize(width, height);
+    if (m_bDenoiserSupported)
+        m_Denoiser.resize(width, height);
 }
 
 void AreaLight::motionCallback(float xpos, float ypos, bool bPressed) noexcept
@@ -627,3 +1102,54 @@ ShaderPtr AreaLight::submitPerFrameUniformLight(ShaderPtr& shader) noexcept
         shader->setUniform("ubClipless", m_Settings.bClipless);
     return shader;
 }
+
+void AreaLight::buildModelBatch() noexcept
+{
+    ModelList models = m_Models;
+    if (m_Settings.bInstanceStress)
+        models.insert(models.end(), m_StressModels.begin(), m_StressModels.end());
+    m_ModelBatch.create(models);
+}
+
+void AreaLight::buildLightList() noexcept
+{
+    m_Lights = m_SceneLights;
+    if (m_Settings.bLightStress)
+        m_Lights.insert(m_Lights.end(), m_StressLights.begin(), m_StressLights.end());
+    m_Settings.LightIndex = std::min(m_Settings.LightIndex, (uint32_t)m_Lights.size() - 1);
+}
+
+void AreaLight::benchmarkTriangleBvh() noexcept
+{
+    ModelList models = m_Models;
+    if (m_Settings.bInstanceStress)
+        models.insert(models.end(), m_StressModels.begin(), m_StressModels.end());
+
+    // each mesh is read back once, then instanced in world space
+    std::vector<std::pair<const Mesh*, std::vector<glm::vec3>>> meshes;
+    std::vector<glm::vec3> triangles;
+    for (auto& model : models)
+    {
+        for (auto& mesh : model->getMeshes())
+        {
+            auto it = std::find_if(meshes.begin(), meshes.end(), [&](const std::pair<const Mesh*, std::vector<glm::vec3>>& entry) { return entry.first == mesh.get(); });
+            if (it == meshes.end())
+            {
+                meshes.emplace_back(mesh.get(), std::vector<glm::vec3>());
+                mesh->getVertexBuffer().readTriangles(meshes.back().second);
+                it = meshes.end() - 1;
+            }
+            for (auto& v : it->second)
+                triangles.push_back(glm::vec3(model->getWorld() * glm::vec4(v, 1.f)));
+        }
+    }
+
+    const uint32_t width = 512;
+    const uint32_t height = std::max(uint32_t(width * getWindowHeight() / std::max(getWindowWidth(), 1)), 1u);
+    const glm::mat4 viewProj = m_Camera.getProjectionMatrix() * m_Camera.getViewMatrix();
+    std::vector<Math::Ray> rays;
+    bvh::GeneratePrimaryRays(glm::inverse(viewProj), m_Camera.getPosition(), width, height, rays);
+
+    m_BvhReport = bvh::Run(triangles, rays, m_Lights[m_Settings.LightIndex]->m_Position);
+    bvh::Print(m_Settings.bInstanceStress ? "demo scene (stress)" : "demo scene", m_BvhReport);
+}
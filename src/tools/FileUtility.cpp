@@ -2,6 +2,20 @@
 #include <tools/FileUtility.h>
 #include <zlib.h>
 #include <algorithm>
+#include <limits>
+#include <cstring>
+
+#if _WIN32
+#   ifndef NOMINMAX
+#   define NOMINMAX
+#   endif
+#   include <windows.h>
+#else
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
 
 using namespace util;
 
@@ -24,6 +38,104 @@ namespace util
         return buf;
     }
 
+    MappedFile::MappedFile() noexcept
+        : m_Data(nullptr)
+        , m_Size(0)
+    #if _WIN32
+        , m_File(INVALID_HANDLE_VALUE)
+        , m_Mapping(nullptr)
+    #endif
+    {
+    }
+
+    MappedFile::~MappedFile() noexcept
+    {
+        close();
+    }
+
+    bool MappedFile::open(const std::string& fileName) noexcept
+    {
+        close();
+
+    #if _WIN32
+        m_File = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (m_File == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+        m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_Mapping == nullptr)
+        {
+            close();
+            return false;
+        }
+        m_Data = static_cast<const uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+        m_Size = static_cast<size_t>(size.QuadPart);
+    #else
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file
+        ::close(fd);
+        if (data == MAP_FAILED)
+            return false;
+        m_Data = static_cast<const uint8_t*>(data);
+        m_Size = static_cast<size_t>(st.st_size);
+    #endif
+        if (m_Data == nullptr)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void MappedFile::close() noexcept
+    {
+    #if _WIN32
+        if (m_Data) UnmapViewOfFile(m_Data);
+        if (m_Mapping) CloseHandle(m_Mapping);
+        if (m_File != INVALID_HANDLE_VALUE) CloseHandle(m_File);
+        m_Mapping = nullptr;
+        m_File = INVALID_HANDLE_VALUE;
+    #else
+        if (m_Data) munmap(const_cast<uint8_t*>(m_Data), m_Size);
+    #endif
+        m_Data = nullptr;
+        m_Size = 0;
+    }
+
+    void MappedFile::prefetch() const noexcept
+    {
+    #if !_WIN32
+        madvise(const_cast<uint8_t*>(m_Data), m_Size, MADV_WILLNEED);
+    #endif
+        const size_t pageSize = 4096;
+        volatile uint8_t sum = 0;
+        for (size_t offset = 0; offset < m_Size; offset += pageSize)
+            sum += m_Data[offset];
+        (void)sum;
+    }
+
+    MappedFilePtr MapFileSync(const std::string& fileName)
+    {
+        auto file = std::make_shared<MappedFile>();
+        if (!file->open(fileName))
+            return nullptr;
+        return file;
+    }
+
     bool WriteFileSync(const std::string& fileName, const BytesArray& plainSource)
     {
         std::ofstream outputFile;
@@ -40,8 +40,41 @@ namespace util
 
     extern BytesArray NullFile;
 
+    // Read-only memory mapping of a whole file, pages are faulted in on access
+    class MappedFile
+    {
+    public:
+        MappedFile() noexcept;
+        ~MappedFile() noexcept;
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const std::string& fileName) noexcept;
+        void close() noexcept;
+
+        // faults the pages in on the calling thread (a loader thread) so that
+        // the later reads from the mapping do not wait on the disk
+        void prefetch() const noexcept;
+
+        const uint8_t* data() const noexcept { return m_Data; }
+        size_t size() const noexcept { return m_Size; }
+
+    private:
+        const uint8_t* m_Data;
+        size_t m_Size;
+    #if _WIN32
+        void* m_File;
+        void* m_Mapping;
+    #endif
+    };
+    using MappedFilePtr = std::shared_ptr<MappedFile>;
+
     // Reads the entire contents of a binary file.  
     BytesArray ReadFileSync(const std::string& fileName);
+
+    // Maps the file instead of reading it, nullptr on failure
+    MappedFilePtr MapFileSync(const std::string& fileName);
     bool WriteFileSync(const std::string& fileName, const BytesArray& plainSource);
 
     BytesArray DecompressFile(const std::string& fileName);
@@ -0,0 +1,470 @@
+#include <tools/MeshOptimizer.h>
+#include <algorithm>
+#include <numeric>
+#include <cassert>
+#include <cmath>
+#include <unordered_map>
+
+namespace util
+{
+    VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+    {
+        VertexCacheStats stats = { 0.f, 0.f };
+        if (indices.empty())
+            return stats;
+
+        std::vector<uint32_t> timestamps(vertexCount, 0);
+        std::vector<bool> used(vertexCount, false);
+        uint32_t time = cacheSize + 1;
+        uint32_t misses = 0;
+        uint32_t unique = 0;
+
+        for (auto index : indices)
+        {
+            assert(index < vertexCount);
+            if (time - timestamps[index] > cacheSize)
+            {
+                timestamps[index] = time++;
+                misses++;
+            }
+            if (!used[index])
+            {
+                used[index] = true;
+                unique++;
+            }
+        }
+
+        stats.ACMR = float(misses) / float(indices.size() / 3);
+        stats.ATVR = float(misses) / float(unique);
+        return stats;
+    }
+
+    void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& clusters, uint32_t cacheSize)
+    {
+        const size_t triangleCount = indices.size() / 3;
+
+        clusters.clear();
+        if (triangleCount == 0)
+            return;
+
+        // vertex -> triangles adjacency
+        std::vector<uint32_t> liveCount(vertexCount, 0);
+        for (auto index : indices)
+            liveCount[index]++;
+
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        std::partial_sum(liveCount.begin(), liveCount.end(), offsets.begin() + 1);
+
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (size_t k = 0; k < 3; k++)
+                adjacency[fill[indices[t*3 + k]]++] = (uint32_t)t;
+
+        std::vector<uint32_t> timestamps(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint32_t> deadEnd;
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+
+        uint32_t time = cacheSize + 1;
+        uint32_t cursor = 0;
+        int32_t fanning = 0;
+
+        // skip the vertices without triangles
+        while (cursor < vertexCount && liveCount[cursor] == 0)
+            cursor++;
+        if (cursor == vertexCount)
+            return;
+        fanning = (int32_t)cursor;
+        clusters.push_back(0);
+
+        while (fanning >= 0)
+        {
+            candidates.clear();
+            for (uint32_t i = offsets[fanning]; i < offsets[fanning + 1]; i++)
+            {
+                uint32_t t = adjacency[i];
+                if (emitted[t])
+                    continue;
+                for (size_t k = 0; k < 3; k++)
+                {
+                    uint32_t v = indices[t*3 + k];
+                    result.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    liveCount[v]--;
+                    if (time - timestamps[v] > cacheSize)
+                        timestamps[v] = time++;
+                }
+                emitted[t] = true;
+            }
+
+            // best candidate still in the cache after its fan is emitted
+            int32_t next = -1;
+            int32_t best = -1;
+            for (auto v : candidates)
+            {
+                if (liveCount[v] == 0)
+                    continue;
+                int32_t priority = 0;
+                if (time - timestamps[v] + 2 * liveCount[v] <= cacheSize)
+                    priority = time - timestamps[v];
+                if (priority > best)
+                {
+                    best = priority;
+                    next = (int32_t)v;
+                }
+            }
+
+            if (next < 0)
+            {
+                // dead-end : recently referenced vertices first, then scan
+                while (!deadEnd.empty() && next < 0)
+                {
+                    uint32_t v = deadEnd.back();
+                    deadEnd.pop_back();
+                    if (liveCount[v] > 0)
+                        next = (int32_t)v;
+                }
+                while (next < 0 && cursor < vertexCount)
+                {
+                    if (liveCount[cursor] > 0)
+                        next = (int32_t)cursor;
+                    cursor++;
+                }
+                if (next >= 0)
+                    clusters.push_back((uint32_t)(result.size() / 3));
+            }
+            fanning = next;
+        }
+
+        assert(result.size() == indices.size());
+        indices.swap(result);
+    }
+
+    void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& clusters, float threshold)
+    {
+        const size_t triangleCount = indices.size() / 3;
+        if (clusters.size() < 2 || positions.empty())
+            return;
+
+        struct Cluster
+        {
+            uint32_t Begin;
+            uint32_t End;
+            float Sort;
+        };
+
+        glm::vec3 meshCentroid(0.f);
+        for (auto& p : positions)
+            meshCentroid += p;
+        meshCentroid /= float(positions.size());
+
+        std::vector<Cluster> sorted(clusters.size());
+        for (size_t c = 0; c < clusters.size(); c++)
+        {
+            Cluster& cluster = sorted[c];
+            cluster.Begin = clusters[c];
+            cluster.End = (c + 1 < clusters.size()) ? clusters[c + 1] : (uint32_t)triangleCount;
+
+            glm::vec3 centroid(0.f), normal(0.f);
+            float area = 0.f;
+            for (uint32_t t = cluster.Begin; t < cluster.End; t++)
+            {
+                const glm::vec3& p0 = positions[indices[t*3 + 0]];
+                const glm::vec3& p1 = positions[indices[t*3 + 1]];
+                const glm::vec3& p2 = positions[indices[t*3 + 2]];
+                glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+                float a = glm::length(n);
+                centroid += (p0 + p1 + p2) * (a / 3.f);
+                normal += n;
+                area += a;
+            }
+            if (area > 0.f)
+                centroid /= area;
+            float len = glm::length(normal);
+            if (len > 0.f)
+                normal /= len;
+
+            // outward facing clusters far from the center occlude the most
+            cluster.Sort = glm::dot(centroid - meshCentroid, normal);
+        }
+
+        std::stable_sort(sorted.begin(), sorted.end(),
+            [](const Cluster& a, const Cluster& b) { return a.Sort > b.Sort; });
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for (auto& cluster : sorted)
+            result.insert(result.end(), indices.begin() + cluster.Begin*3, indices.begin() + cluster.End*3);
+
+        const size_t vertexCount = positions.size();
+        float before = AnalyzeVertexCache(indices, vertexCount).ACMR;
+        float after = AnalyzeVertexCache(result, vertexCount).ACMR;
+        if (after <= before * threshold)
+            indices.swap(result);
+    }
+
+    size_t OptimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& remap)
+    {
+        remap.assign(vertexCount, ~0u);
+
+        uint32_t next = 0;
+        for (auto& index : indices)
+        {
+            if (remap[index] == ~0u)
+                remap[index] = next++;
+            index = remap[index];
+        }
+        return next;
+    }
+
+    namespace
+    {
+        // symmetric 4x4 matrix of the plane equations, in double for the precision,
+        // and the sum of the plane weights
+        struct Quadric
+        {
+            double a00, a01, a02, a03;
+            double a11, a12, a13;
+            double a22, a23;
+            double a33;
+            double weight;
+
+            void add(const Quadric& q)
+            {
+                a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+                a11 += q.a11; a12 += q.a12; a13 += q.a13;
+                a22 += q.a22; a23 += q.a23;
+                a33 += q.a33;
+                weight += q.weight;
+            }
+
+            void addPlane(const glm::dvec3& n, double d, double w)
+            {
+                a00 += w*n.x*n.x; a01 += w*n.x*n.y; a02 += w*n.x*n.z; a03 += w*n.x*d;
+                a11 += w*n.y*n.y; a12 += w*n.y*n.z; a13 += w*n.y*d;
+                a22 += w*n.z*n.z; a23 += w*n.z*d;
+                a33 += w*d*d;
+                weight += w;
+            }
+
+            double error(const glm::vec3& v) const
+            {
+                double x = v.x, y = v.y, z = v.z;
+                double e = a00*x*x + 2*a01*x*y + 2*a02*x*z + 2*a03*x
+                         + a11*y*y + 2*a12*y*z + 2*a13*y
+                         + a22*z*z + 2*a23*z
+                         + a33;
+                return e > 0.0 ? e : 0.0;
+            }
+
+            // weighted mean of the squared distances to the planes
+            double distanceSq(const glm::vec3& v) const
+            {
+                return weight > 0.0 ? error(v) / weight : 0.0;
+            }
+        };
+
+        // borders are held by planes this much stronger than the faces
+        const double kBorderWeight = 10.0;
+
+        struct Collapse
+        {
+            uint32_t From;
+            uint32_t To;
+            double Error;       // (Qfrom + Qto)(to), the order of the collapses
+            double DistanceSq;  // the same normalized, see Quadric::distanceSq
+        };
+
+        uint64_t edgeKey(uint32_t a, uint32_t b)
+        {
+            return (uint64_t(a) << 32) | b;
+        }
+    }
+
+    float SimplifyMesh(std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, size_t targetIndexCount, float maxError)
+    {
+        const size_t vertexCount = positions.size();
+        const double maxErrorSq = double(maxError) * double(maxError);
+
+        // vertices sharing a position carry an attribute seam : never moved
+        std::vector<bool> locked(vertexCount, false);
+        {
+            struct PositionHash
+            {
+                size_t operator()(const glm::vec3& p) const
+                {
+                    const uint32_t* u = reinterpret_cast<const uint32_t*>(&p);
+                    return size_t(u[0] * 73856093u ^ u[1] * 19349663u ^ u[2] * 83492791u);
+                }
+            };
+            std::unordered_map<glm::vec3, uint32_t, PositionHash> first;
+            for (uint32_t v = 0; v < vertexCount; v++)
+            {
+                auto it = first.emplace(positions[v], v);
+                if (!it.second)
+                    locked[v] = locked[it.first->second] = true;
+            }
+        }
+
+        std::vector<Quadric> quadrics(vertexCount, Quadric { 0 });
+        std::unordered_map<uint64_t, uint32_t> edges;
+        for (size_t i = 0; i < indices.size(); i += 3)
+            for (size_t k = 0; k < 3; k++)
+                edges[edgeKey(indices[i + k], indices[i + (k + 1) % 3])]++;
+
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            glm::dvec3 p[3];
+            for (size_t k = 0; k < 3; k++)
+                p[k] = glm::dvec3(positions[indices[i + k]]);
+            glm::dvec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+            double len = glm::length(n);
+            if (len == 0.0)
+                continue;
+            n /= len;
+
+            Quadric q = { 0 };
+            q.addPlane(n, -glm::dot(n, p[0]), 1.0);
+            for (size_t k = 0; k < 3; k++)
+                quadrics[indices[i + k]].add(q);
+
+            // open border : the opposite half edge does not exist
+            for (size_t k = 0; k < 3; k++)
+            {
+                uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+                if (edges.count(edgeKey(b, a)))
+                    continue;
+                glm::dvec3 e = p[(k + 1) % 3] - p[k];
+                glm::dvec3 m = glm::cross(e, n);
+                double mlen = glm::length(m);
+                if (mlen == 0.0)
+                    continue;
+                m /= mlen;
+                Quadric border = { 0 };
+                border.addPlane(m, -glm::dot(m, p[k]), kBorderWeight);
+                quadrics[a].add(border);
+                quadrics[b].add(border);
+            }
+        }
+
+        std::vector<uint32_t> remap(vertexCount);
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+        std::vector<uint32_t> adjacency;
+        std::vector<Collapse> collapses;
+        std::vector<bool> touched(vertexCount);
+        double reachedError = 0.0;
+
+        while (indices.size() > targetIndexCount)
+        {
+            const size_t triangleCount = indices.size() / 3;
+
+            // vertex -> triangles of the current indices
+            std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+            for (auto index : indices)
+                adjacencyOffsets[index + 1]++;
+            std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+            adjacency.resize(indices.size());
+            std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t t = 0; t < triangleCount; t++)
+                for (size_t k = 0; k < 3; k++)
+                    adjacency[fill[indices[t*3 + k]]++] = (uint32_t)t;
+
+            // the merged vertex holds the planes of both ends
+            auto addCollapse = [&](uint32_t from, uint32_t to) {
+                Quadric q = quadrics[from];
+                q.add(quadrics[to]);
+                collapses.push_back({ from, to, q.error(positions[to]), q.distanceSq(positions[to]) });
+            };
+
+            collapses.clear();
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                for (size_t k = 0; k < 3; k++)
+                {
+                    uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+                    if (!locked[a])
+                        addCollapse(a, b);
+                    // border half edges are only visited once
+                    if (!locked[b] && !edges.count(edgeKey(b, a)))
+                        addCollapse(b, a);
+                }
+            }
+            if (collapses.empty())
+                break;
+
+            std::sort(collapses.begin(), collapses.end(),
+                [](const Collapse& x, const Collapse& y) { return x.Error < y.Error; });
+
+            for (uint32_t v = 0; v < vertexCount; v++)
+                remap[v] = v;
+            std::fill(touched.begin(), touched.end(), false);
+
+            // each collapse removes about two triangles
+            size_t budget = (indices.size() - targetIndexCount) / 6 + 1;
+            size_t applied = 0;
+            for (auto& c : collapses)
+            {
+                if (applied >= budget)
+                    break;
+                if (c.DistanceSq > maxErrorSq || touched[c.From] || touched[c.To])
+                    continue;
+
+                // reject the collapses flipping a triangle around 'From'
+                bool bFlip = false;
+                const glm::vec3& target = positions[c.To];
+                for (uint32_t j = adjacencyOffsets[c.From]; j < adjacencyOffsets[c.From + 1] && !bFlip; j++)
+                {
+                    const uint32_t* tri = &indices[adjacency[j] * 3];
+                    if (tri[0] == c.To || tri[1] == c.To || tri[2] == c.To)
+                        continue;
+                    glm::vec3 p[3], q[3];
+                    for (size_t k = 0; k < 3; k++)
+                    {
+                        p[k] = positions[tri[k]];
+                        q[k] = tri[k] == c.From ? target : p[k];
+                    }
+                    glm::vec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+                    glm::vec3 n1 = glm::cross(q[1] - q[0], q[2] - q[0]);
+                    bFlip = glm::dot(n0, n1) <= 0.f;
+                }
+                if (bFlip)
+                    continue;
+
+                // lock the one-ring so that the flip test stays valid
+                for (uint32_t j = adjacencyOffsets[c.From]; j < adjacencyOffsets[c.From + 1]; j++)
+                    for (size_t k = 0; k < 3; k++)
+                        touched[indices[adjacency[j] * 3 + k]] = true;
+
+                remap[c.From] = c.To;
+                quadrics[c.To].add(quadrics[c.From]);
+                reachedError = std::max(reachedError, c.DistanceSq);
+                applied++;
+            }
+            if (applied == 0)
+                break;
+
+            size_t write = 0;
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                uint32_t a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+                if (a == b || b == c || c == a)
+                    continue;
+                indices[write++] = a;
+                indices[write++] = b;
+                indices[write++] = c;
+            }
+            indices.resize(write);
+
+            edges.clear();
+            for (size_t i = 0; i < indices.size(); i += 3)
+                for (size_t k = 0; k < 3; k++)
+                    edges[edgeKey(indices[i + k], indices[i + (k + 1) % 3])]++;
+        }
+
+        return float(std::sqrt(reachedError));
+    }
+}
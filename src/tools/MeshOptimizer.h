@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace util
+{
+    // Post-transform cache statistics of an indexed triangle list,
+    // simulated on a FIFO cache
+    struct VertexCacheStats
+    {
+        float ACMR; // average cache miss ratio : transformed vertices per triangle
+        float ATVR; // average transform to vertex ratio : 1.0 is optimal
+    };
+
+    const uint32_t kVertexCacheSize = 16;
+
+    VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = kVertexCacheSize);
+
+    // Tipsify (Sander et al. 2007) triangle reordering, 'clusters' receives the
+    // first triangle of each run started after a cache flush
+    void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& clusters, uint32_t cacheSize = kVertexCacheSize);
+
+    // Sorts the clusters from the most to the least occluding so that early-Z
+    // rejects more fragments. The new order is kept only while the ACMR stays
+    // below 'threshold' times the input one
+    void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& clusters, float threshold = 1.05f);
+
+    // Renumbers the vertices in the order of their first use and drops the
+    // unreferenced ones. 'remap[old]' gives the new index (~0u when dropped),
+    // returns the new vertex count
+    size_t OptimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& remap);
+
+    // Quadric error edge collapse (Garland & Heckbert 97) onto existing vertices,
+    // so the result indexes the same vertex buffer. Open borders are kept by
+    // perpendicular quadrics, attribute seams (shared positions) are locked.
+    // Stops at 'targetIndexCount' or when no collapse keeps the surface within
+    // 'maxError', returns the reached error : both are object space distances,
+    // the RMS distance of a merged vertex to the planes of its original faces
+    float SimplifyMesh(std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, size_t targetIndexCount, float maxError);
+
+    template <typename T>
+    void RemapVertices(std::vector<T>& vertices, const std::vector<uint32_t>& remap, size_t vertexCount)
+    {
+        if (vertices.empty())
+            return;
+        std::vector<T> result(vertexCount);
+        for (size_t i = 0; i < remap.size(); i++)
+        {
+            if (remap[i] != ~0u)
+                result[remap[i]] = vertices[i];
+        }
+        vertices.swap(result);
+    }
+}
@@ -0,0 +1,75 @@
+// Cooks the source images of the materials into the DDS files the runtime
+// loads, with their mip chains and block compressed in the format of their
+// usage. The ao, roughness and metalness maps of a material are packed in
+// one texture unless -s keeps them separate. The maps of each directory form
+// a material, a layer in the texture array of each kind of map. Only the
+// sources whose contents changed since the last run are cooked again.
+//
+//   AssetCooker.app [-j threads] [-o directory] [-p fast|quality|none] [-s] [-f] [-v] [image ...]
+
+#include <AssetCooker.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+    asset::CookOptions options;
+    std::vector<std::string> sources;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            options.ThreadCount = uint32_t(atoi(argv[++i]));
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            options.OutputDirectory = argv[++i];
+            options.ManifestFile = options.OutputDirectory + "/manifest.txt";
+            options.MaterialFile = options.OutputDirectory + "/materials.txt";
+        }
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+        {
+            const char* preset = argv[++i];
+            if (strcmp(preset, "fast") == 0)
+                options.Preset = asset::EncodePresetFast;
+            else if (strcmp(preset, "none") == 0)
+                options.Preset = asset::EncodePresetUncompressed;
+            else
+                options.Preset = asset::EncodePresetQuality;
+        }
+        else if (strcmp(argv[i], "-s") == 0)
+            options.bPackOrm = false;
+        else if (strcmp(argv[i], "-f") == 0)
+            options.bForce = true;
+        else if (strcmp(argv[i], "-v") == 0)
+            options.bVerbose = true;
+        else
+            sources.push_back(argv[i]);
+    }
+    if (sources.empty())
+    {
+        sources = {
+            "resources/floor/albedo.tiff",
+            "resources/floor/ao.tiff",
+            "resources/floor/metalness.tiff",
+            "resources/floor/roughness.tiff",
+            "resources/marble/metalness.png",
+            "resources/marble/normal.png",
+            "resources/marble/roughness.png",
+        };
+    }
+
+    asset::CookReport report = asset::CookAssets(sources, options);
+    printf("%u cooked, %u up to date, %u failed\n", report.Cooked, report.UpToDate, report.Failed);
+    if (report.CookedBytes > 0)
+    {
+        const double megabytes = 1.0 / (1024.0 * 1024.0);
+        printf("%.2f MB instead of %.2f MB uncompressed, %.2f MB saved\n",
+            report.CookedBytes * megabytes, report.UncompressedBytes * megabytes,
+            (double(report.UncompressedBytes) - double(report.CookedBytes)) * megabytes);
+    }
+    if (report.EncodeSeconds > 0.0)
+        printf("%.2f MPix encoded at %.1f MPix/s\n", report.EncodedTexels * 1e-6, report.EncodedTexels * 1e-6 / report.EncodeSeconds);
+    return report.Failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,178 @@
+// Builds a Math::TriangleBvh over imported scenes and traces primary and
+// shadow rays through it, for scenes larger than the demo one. Without any
+// scene a generated room of spheres and pillars is traced.
+//
+//   BvhBenchmark.app [-t threads] [-s size] [scene.obj|scene.mesh ...]
+
+#include <BvhBenchmark.h>
+#include <MeshFile.h>
+#include <tools/FileUtility.h>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    bool EndsWith(const std::string& name, const char* suffix)
+    {
+        size_t length = strlen(suffix);
+        return name.size() >= length && name.compare(name.size() - length, length, suffix) == 0;
+    }
+
+    bool LoadTriangles(const std::string& fileName, std::vector<glm::vec3>& triangles)
+    {
+        if (EndsWith(fileName, ".mesh"))
+        {
+            auto file = util::MapFileSync(fileName);
+            if (!file || file->size() < sizeof(mesh::MeshFileHeader))
+                return false;
+
+            const mesh::MeshFileHeader& header = *reinterpret_cast<const mesh::MeshFileHeader*>(file->data());
+            if (!mesh::IsValid(header, file->size()))
+                return false;
+
+            VertexBuffer::unpackTriangles(header.Layout, file->data() + header.VertexOffset, file->data() + header.IndexOffset, triangles);
+            return true;
+        }
+
+        VertexBuffer buffer;
+        if (!mesh::ImportObj(fileName, buffer))
+            return false;
+
+        auto& positions = buffer.getPosition();
+        auto& indices = buffer.getIndices();
+        triangles.clear();
+        triangles.reserve(indices.size());
+        for (auto index : indices)
+            triangles.push_back(positions[index]);
+        return true;
+    }
+
+    void AppendQuad(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, std::vector<glm::vec3>& triangles)
+    {
+        triangles.insert(triangles.end(), { p0, p1, p2, p0, p2, p3 });
+    }
+
+    void AppendBox(const glm::vec3& boundMin, const glm::vec3& boundMax, std::vector<glm::vec3>& triangles)
+    {
+        const glm::vec3 corners[8] = {
+            { boundMin.x, boundMin.y, boundMin.z }, { boundMax.x, boundMin.y, boundMin.z },
+            { boundMin.x, boundMax.y, boundMin.z }, { boundMax.x, boundMax.y, boundMin.z },
+            { boundMin.x, boundMin.y, boundMax.z }, { boundMax.x, boundMin.y, boundMax.z },
+            { boundMin.x, boundMax.y, boundMax.z }, { boundMax.x, boundMax.y, boundMax.z },
+        };
+        const int faces[6][4] = {
+            { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 4, 6, 2 },
+            { 1, 3, 7, 5 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 },
+        };
+        for (auto& face : faces)
+            AppendQuad(corners[face[0]], corners[face[1]], corners[face[2]], corners[face[3]], triangles);
+    }
+
+    void AppendSphere(const glm::vec3& center, float radius, int slices, int stacks, std::vector<glm::vec3>& triangles)
+    {
+        auto point = [&](int slice, int stack) {
+            float phi = glm::pi<float>() * stack / stacks;
+            float theta = glm::two_pi<float>() * slice / slices;
+            return center + radius * glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+        };
+        for (int stack = 0; stack < stacks; stack++)
+        {
+            for (int slice = 0; slice < slices; slice++)
+            {
+                glm::vec3 p00 = point(slice, stack), p10 = point(slice + 1, stack);
+                glm::vec3 p01 = point(slice, stack + 1), p11 = point(slice + 1, stack + 1);
+                if (stack > 0)
+                    triangles.insert(triangles.end(), { p00, p10, p11 });
+                if (stack + 1 < stacks)
+                    triangles.insert(triangles.end(), { p00, p11, p01 });
+            }
+        }
+    }
+
+    // a room open to the camera with a grid of pillars holding spheres, about
+    // 140k triangles of very different sizes that shadow each other
+    void GenerateScene(std::vector<glm::vec3>& triangles)
+    {
+        const int grid = 8;
+        const float spacing = 4.f;
+        const float extent = grid * spacing * 0.5f;
+        const float height = 12.f;
+        triangles.clear();
+        AppendQuad(glm::vec3(-extent, 0.f, -extent), glm::vec3(-extent, 0.f, extent), glm::vec3(extent, 0.f, extent), glm::vec3(extent, 0.f, -extent), triangles);
+        AppendQuad(glm::vec3(-extent, 0.f, -extent), glm::vec3(extent, 0.f, -extent), glm::vec3(extent, height, -extent), glm::vec3(-extent, height, -extent), triangles);
+        AppendQuad(glm::vec3(-extent, 0.f, -extent), glm::vec3(-extent, height, -extent), glm::vec3(-extent, height, extent), glm::vec3(-extent, 0.f, extent), triangles);
+        AppendQuad(glm::vec3(extent, 0.f, -extent), glm::vec3(extent, 0.f, extent), glm::vec3(extent, height, extent), glm::vec3(extent, height, -extent), triangles);
+        for (int z = 0; z < grid; z++)
+        {
+            for (int x = 0; x < grid; x++)
+            {
+                glm::vec3 base((x + 0.5f) * spacing - extent, 0.f, (z + 0.5f) * spacing - extent);
+                float pillar = 2.f + float((x * 7 + z * 3) % 5);
+                AppendBox(base - glm::vec3(0.3f, 0.f, 0.3f), base + glm::vec3(0.3f, pillar, 0.3f), triangles);
+                AppendSphere(base + glm::vec3(0.f, pillar + 1.f, 0.f), 1.f, 48, 24, triangles);
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t threadCount = 0;
+    uint32_t size = 1024;
+    std::vector<std::string> scenes;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            threadCount = uint32_t(atoi(argv[++i]));
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            size = uint32_t(std::max(atoi(argv[++i]), 1));
+        else
+            scenes.push_back(argv[i]);
+    }
+    if (scenes.empty())
+        scenes.push_back(std::string());
+
+    int result = EXIT_SUCCESS;
+    for (auto& scene : scenes)
+    {
+        std::vector<glm::vec3> triangles;
+        if (scene.empty())
+        {
+            GenerateScene(triangles);
+            scene = "generated";
+        }
+        else if (!LoadTriangles(scene, triangles) || triangles.empty())
+        {
+            fprintf(stderr, "Error : failed to load %s\n", scene.c_str());
+            result = EXIT_FAILURE;
+            continue;
+        }
+
+        // framed from outside the bounds, the light near the top
+        glm::vec3 boundMin = triangles[0], boundMax = triangles[0];
+        for (auto& v : triangles)
+        {
+            boundMin = glm::min(boundMin, v);
+            boundMax = glm::max(boundMax, v);
+        }
+        glm::vec3 center = (boundMin + boundMax) * 0.5f;
+        float radius = glm::max(glm::length(boundMax - boundMin) * 0.5f, 1e-3f);
+        glm::vec3 eye = center + glm::vec3(0.f, 0.5f, 1.5f) * radius;
+        glm::vec3 light = center + glm::vec3(0.f, (boundMax.y - center.y) * 0.9f, 0.f);
+
+        glm::mat4 view = glm::lookAt(eye, center, glm::vec3(0.f, 1.f, 0.f));
+        glm::mat4 proj = glm::perspective(glm::radians(45.f), 1.f, radius * 1e-3f, radius * 4.f);
+
+        std::vector<Math::Ray> rays;
+        bvh::GeneratePrimaryRays(glm::inverse(proj * view), eye, size, size, rays);
+        bvh::Print(scene.c_str(), bvh::Run(triangles, rays, light, threadCount));
+    }
+    return result;
+}